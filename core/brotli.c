@@ -0,0 +1,90 @@
+#include <uwsgi.h>
+#include <brotli/encode.h>
+
+extern struct uwsgi_server uwsgi;
+
+// one-shot brotli compression (used for static files variants)
+struct uwsgi_buffer *uwsgi_brotli(char *buf, size_t len) {
+	size_t dlen = BrotliEncoderMaxCompressedSize(len);
+	if (!dlen) return NULL;
+	struct uwsgi_buffer *ub = uwsgi_buffer_new(dlen);
+	// variants are compressed in the request path, 11 is an order of magnitude slower for a few % gain
+	if (!BrotliEncoderCompress(9, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_GENERIC, len, (const uint8_t *) buf, &dlen, (uint8_t *) ub->buf)) {
+		uwsgi_buffer_destroy(ub);
+		return NULL;
+	}
+	ub->pos = dlen;
+	return ub;
+}
+
+/*
+
+	brotli streaming compressor (used by the pooled transformations)
+
+	the encoder has no reset api, so a finished instance is replaced on reuse
+	(the context and its output buffer are still recycled)
+
+*/
+struct uwsgi_brotli_state {
+	BrotliEncoderState *bs;
+};
+
+static BrotliEncoderState *brotli_encoder_new() {
+	BrotliEncoderState *bs = BrotliEncoderCreateInstance(NULL, NULL, NULL);
+	if (!bs) return NULL;
+	// the default quality (11) is way too slow for dynamic content
+	BrotliEncoderSetParameter(bs, BROTLI_PARAM_QUALITY, 5);
+	BrotliEncoderSetParameter(bs, BROTLI_PARAM_LGWIN, 19);
+	return bs;
+}
+
+static void *brotli_state_create() {
+	BrotliEncoderState *bs = brotli_encoder_new();
+	if (!bs) return NULL;
+	struct uwsgi_brotli_state *ubs = uwsgi_malloc(sizeof(struct uwsgi_brotli_state));
+	ubs->bs = bs;
+	return ubs;
+}
+
+static int brotli_state_reset(void *state) {
+	struct uwsgi_brotli_state *ubs = (struct uwsgi_brotli_state *) state;
+	BrotliEncoderState *bs = brotli_encoder_new();
+	if (!bs) return -1;
+	BrotliEncoderDestroyInstance(ubs->bs);
+	ubs->bs = bs;
+	return 0;
+}
+
+static int brotli_state_compress(void *state, char *buf, size_t len, struct uwsgi_buffer *ub, int final) {
+	struct uwsgi_brotli_state *ubs = (struct uwsgi_brotli_state *) state;
+	BrotliEncoderOperation op = final ? BROTLI_OPERATION_FINISH : BROTLI_OPERATION_FLUSH;
+	size_t avail_in = len;
+	const uint8_t *next_in = (const uint8_t *) buf;
+
+	for (;;) {
+		if (uwsgi_buffer_ensure(ub, avail_in + 1024)) return -1;
+		size_t avail = ub->len - ub->pos;
+		size_t avail_out = avail;
+		uint8_t *next_out = (uint8_t *) ub->buf + ub->pos;
+		if (!BrotliEncoderCompressStream(ubs->bs, op, &avail_in, &next_in, &avail_out, &next_out, NULL)) return -1;
+		ub->pos += avail - avail_out;
+		if (avail_in > 0 || BrotliEncoderHasMoreOutput(ubs->bs)) continue;
+		if (!final || BrotliEncoderIsFinished(ubs->bs)) break;
+	}
+	return 0;
+}
+
+static void brotli_state_destroy(void *state) {
+	struct uwsgi_brotli_state *ubs = (struct uwsgi_brotli_state *) state;
+	BrotliEncoderDestroyInstance(ubs->bs);
+	free(ubs);
+}
+
+struct uwsgi_compressor uwsgi_compressor_brotli = {
+	.name = "br",
+	.name_len = 2,
+	.create = brotli_state_create,
+	.reset = brotli_state_reset,
+	.compress = brotli_state_compress,
+	.destroy = brotli_state_destroy,
+};
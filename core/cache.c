@@ -344,6 +344,7 @@ void uwsgi_cache_init(struct uwsgi_cache *uc) {
 	uc->hashtable = uwsgi_calloc_shared(sizeof(uint64_t) * uc->hashsize);
 	uc->unused_blocks_stack = uwsgi_calloc_shared(sizeof(uint64_t) * uc->max_items);
 	uc->unused_blocks_stack_ptr = 0;
+	uc->generations = uwsgi_calloc_shared(sizeof(uint64_t) * uc->max_items);
 	uc->filesize = ( (sizeof(struct uwsgi_cache_item)+uc->keysize) * uc->max_items) + (uc->blocksize * uc->blocks);
 
 	uint64_t i;
@@ -693,6 +694,7 @@ int uwsgi_cache_del2(struct uwsgi_cache *uc, char *key, uint16_t keylen, uint64_
 
 		ret = 0;
 
+		uc->generations[index]++;
 		uci->keysize = 0;
 		uci->valsize = 0;
 		uci->hash = 0;
@@ -804,6 +806,7 @@ int uwsgi_cache_set2(struct uwsgi_cache *uc, char *key, uint16_t keylen, char *v
 				uc->next_scan = expires;
 		}
 		uci->expires = expires;
+		uc->generations[index]++;
 		uci->hash = uc->hash->func(key, keylen);
 		uci->hits = 0;
 		uci->flags = flags;
@@ -899,6 +902,7 @@ int uwsgi_cache_set2(struct uwsgi_cache *uc, char *key, uint16_t keylen, char *v
 			// unmark the old blocks
 			cache_unmark_blocks(uc, old_first_block, uci->valsize);
 		}
+		uc->generations[index]++;
 		if ( !(flags & UWSGI_CACHE_FLAG_MATH)) {
 			memcpy(((char *) uc->data) + (uci->first_block * uc->blocksize), val, vallen);
 		}
@@ -1213,6 +1217,61 @@ next:
         }
 }
 
+static void uwsgi_cache_numa_bind(struct uwsgi_cache *uc, void (*func)(void *, size_t, int), int node) {
+	func(uc->hashtable, sizeof(uint64_t) * uc->hashsize, node);
+	func(uc->unused_blocks_stack, sizeof(uint64_t) * uc->max_items, node);
+	if (uc->blocks_bitmap) func(uc->blocks_bitmap, uc->blocks_bitmap_size, node);
+	// the store is file-backed, its pages belong to the page cache
+	if (!uc->store) func(uc->items, uc->filesize, node);
+}
+
+static void numa_interleave(void *addr, size_t len, int node) {
+	uwsgi_numa_interleave(addr, len);
+}
+
+// a cache shared by all of the workers is spread across the nodes
+static void uwsgi_cache_numa_interleave(struct uwsgi_cache *uc) {
+	if (!uwsgi.numa) return;
+	uwsgi_cache_numa_bind(uc, numa_interleave, -1);
+}
+
+/*
+	numa=1 caches get a local replica on each node, workers only see the one of their node
+	(the master, mules and spoolers use the first). Items are not shared between nodes so this
+	is only for memoization-like caches where a miss is harmless.
+*/
+static struct uwsgi_cache *uwsgi_cache_create_numa(struct uwsgi_cache *uc) {
+	struct uwsgi_cache **replicas = uwsgi_calloc(sizeof(struct uwsgi_cache *) * uwsgi.numa_nodes_cnt);
+	replicas[0] = uc;
+	struct uwsgi_cache *last = uc;
+	int i;
+	for (i = 1; i < uwsgi.numa_nodes_cnt; i++) {
+		struct uwsgi_cache *replica = uwsgi_calloc_shared(sizeof(struct uwsgi_cache));
+		memcpy(replica, uc, sizeof(struct uwsgi_cache));
+		replica->numa_replica = 1;
+		replica->numa_node = i;
+		last->next = replica;
+		last = replica;
+		replicas[i] = replica;
+	}
+
+	for (i = 0; i < uwsgi.numa_nodes_cnt; i++) {
+		replicas[i]->numa_replicas = replicas;
+		uwsgi_cache_init(replicas[i]);
+		uwsgi_numa_bind(replicas[i], sizeof(struct uwsgi_cache), i);
+		uwsgi_cache_numa_bind(replicas[i], uwsgi_numa_bind, i);
+	}
+	return uc;
+}
+
+// resolve a cache to the replica local to the current worker
+static struct uwsgi_cache *uwsgi_cache_numa_local(struct uwsgi_cache *uc) {
+	if (uc && uc->numa_replicas && uwsgi.numa_node > 0) {
+		return uc->numa_replicas[uwsgi.numa_node];
+	}
+	return uc;
+}
+
 struct uwsgi_cache *uwsgi_cache_create(char *arg) {
 	struct uwsgi_cache *old_uc = NULL, *uc = uwsgi.caches;
 	while(uc) {
@@ -1273,6 +1332,7 @@ struct uwsgi_cache *uwsgi_cache_create(char *arg) {
 		char *c_sweep_on_full = NULL;
 		char *c_clear_on_full = NULL;
 		char *c_no_expire = NULL;
+		char *c_numa = NULL;
 
 		if (uwsgi_kvlist_parse(arg, strlen(arg), ',', '=',
                         "name", &c_name,
@@ -1310,6 +1370,7 @@ struct uwsgi_cache *uwsgi_cache_create(char *arg) {
 			"sweep_on_full", &c_sweep_on_full,
 			"clear_on_full", &c_clear_on_full,
 			"no_expire", &c_no_expire,
+			"numa", &c_numa,
                 	NULL)) {
 			uwsgi_log("unable to parse cache definition\n");
 			exit(1);
@@ -1403,20 +1464,29 @@ struct uwsgi_cache *uwsgi_cache_create(char *arg) {
 		
 		if (c_purge_lru)
 			uc->purge_lru = 1;
+
+		if (c_numa && uwsgi.numa && uwsgi.numa_nodes_cnt > 1) {
+			if (uc->store || uc->nodes || uc->sync_nodes || uc->udp_servers) {
+				uwsgi_log("NUMA replicas of cache \"%s\" cannot be persistent or synchronized\n", uc->name);
+				exit(1);
+			}
+			return uwsgi_cache_create_numa(uc);
+		}
 	}
 
 	uwsgi_cache_init(uc);
+	uwsgi_cache_numa_interleave(uc);
 	return uc;
 }
 
 struct uwsgi_cache *uwsgi_cache_by_name(char *name) {
 	struct uwsgi_cache *uc = uwsgi.caches;
 	if (!name || *name == 0) {
-		return uwsgi.caches;
+		return uwsgi_cache_numa_local(uwsgi.caches);
 	}
 	while(uc) {
-		if (uc->name && !strcmp(uc->name, name)) {
-			return uc;
+		if (!uc->numa_replica && uc->name && !strcmp(uc->name, name)) {
+			return uwsgi_cache_numa_local(uc);
 		}
 		uc = uc->next;
 	}
@@ -1426,11 +1496,11 @@ struct uwsgi_cache *uwsgi_cache_by_name(char *name) {
 struct uwsgi_cache *uwsgi_cache_by_namelen(char *name, uint16_t len) {
         struct uwsgi_cache *uc = uwsgi.caches;
         if (!name || *name == 0) {
-                return uwsgi.caches;
+                return uwsgi_cache_numa_local(uwsgi.caches);
         }
         while(uc) {
-                if (uc->name && !uwsgi_strncmp(uc->name, uc->name_len, name, len)) {
-                        return uc;
+                if (!uc->numa_replica && uc->name && !uwsgi_strncmp(uc->name, uc->name_len, name, len)) {
+                        return uwsgi_cache_numa_local(uc);
                 }
                 uc = uc->next;
         }
@@ -1678,7 +1748,7 @@ char *uwsgi_cache_magic_get(char *key, uint16_t keylen, uint64_t *vallen, uint64
 		int fd = uwsgi_connect(cache_server, 0, 1);
 		if (fd < 0) return NULL;
 
-		int ret = uwsgi.wait_write_hook(fd, uwsgi.socket_timeout);
+		int ret = uwsgi_wait_write_ms(fd, uwsgi.socket_timeout_ms);
 		if (ret <= 0) {
 			close(fd);
 			return NULL;
@@ -1742,6 +1812,77 @@ char *uwsgi_cache_magic_get(char *key, uint16_t keylen, uint64_t *vallen, uint64
 	return NULL;
 }
 
+/*
+	cache leases
+
+	a lease references a local cache item without copying its value. It is valid until the item
+	is updated or removed (its generation changes), so the value can be streamed in chunks
+	(for example by an offload thread) re-checking the lease under the cache lock for each one.
+
+	returns 0 on success, -1 if the item does not exist and 1 if the cache is not a local one
+*/
+int uwsgi_cache_lease(char *key, uint16_t keylen, char *cache, struct uwsgi_cache_lease *ucl) {
+	struct uwsgi_cache *uc = NULL;
+	if (cache) {
+		if (strchr(cache, '@')) return 1;
+		uc = uwsgi_cache_by_name(cache);
+	}
+	else {
+		// the NUMA-local replica, like the other cache functions
+		uc = uwsgi_cache_by_name(NULL);
+	}
+	if (!uc) return 1;
+
+	// the lookup updates the hits/misses counters (and the lru list)
+	uwsgi_wlock(uc->lock);
+	uint64_t index = uwsgi_cache_get_index(uc, key, keylen);
+	if (!index) {
+		uc->miss++;
+		uwsgi_rwunlock(uc->lock);
+		return -1;
+	}
+	struct uwsgi_cache_item *uci = cache_item(index);
+	if (uci->flags & UWSGI_CACHE_FLAG_UNGETTABLE) {
+		uwsgi_rwunlock(uc->lock);
+		return -1;
+	}
+	if (uc->purge_lru) {
+		lru_remove_item(uc, index);
+		lru_add_item(uc, index);
+	}
+	uci->hits++;
+	uc->hits++;
+	ucl->cache = uc;
+	ucl->index = index;
+	ucl->generation = uc->generations[index];
+	ucl->valsize = uci->valsize;
+	ucl->expires = uci->expires;
+	uwsgi_rwunlock(uc->lock);
+	return 0;
+}
+
+// the cache lock must be held by the caller, NULL if the lease is expired
+char *uwsgi_cache_lease_value(struct uwsgi_cache_lease *ucl) {
+	struct uwsgi_cache *uc = ucl->cache;
+	if (uc->generations[ucl->index] != ucl->generation) return NULL;
+	struct uwsgi_cache_item *uci = cache_item(ucl->index);
+	if (!uci->keysize || uci->valsize != ucl->valsize) return NULL;
+	return uc->data + (uci->first_block * uc->blocksize);
+}
+
+// get a copy of the leased value (to be freed)
+char *uwsgi_cache_lease_get(struct uwsgi_cache_lease *ucl) {
+	char *buf = NULL;
+	uwsgi_rlock(ucl->cache->lock);
+	char *value = uwsgi_cache_lease_value(ucl);
+	if (value) {
+		buf = uwsgi_malloc(ucl->valsize);
+		memcpy(buf, value, ucl->valsize);
+	}
+	uwsgi_rwunlock(ucl->cache->lock);
+	return buf;
+}
+
 int uwsgi_cache_magic_exists(char *key, uint16_t keylen, char *cache) {
         struct uwsgi_cache_magic_context ucmc;
         struct uwsgi_cache *uc = NULL;
@@ -1780,7 +1921,7 @@ int uwsgi_cache_magic_exists(char *key, uint16_t keylen, char *cache) {
                 int fd = uwsgi_connect(cache_server, 0, 1);
                 if (fd < 0) return 0;
 
-                int ret = uwsgi.wait_write_hook(fd, uwsgi.socket_timeout);
+                int ret = uwsgi_wait_write_ms(fd, uwsgi.socket_timeout_ms);
                 if (ret <= 0) {
                         close(fd);
 			return 0;
@@ -1847,7 +1988,7 @@ int uwsgi_cache_magic_set(char *key, uint16_t keylen, char *value, uint64_t vall
 		int fd = uwsgi_connect(cache_server, 0, 1);
                 if (fd < 0) return -1;
 
-                int ret = uwsgi.wait_write_hook(fd, uwsgi.socket_timeout);
+                int ret = uwsgi_wait_write_ms(fd, uwsgi.socket_timeout_ms);
                 if (ret <= 0) {
                         close(fd);
                         return -1;
@@ -1925,7 +2066,7 @@ int uwsgi_cache_magic_del(char *key, uint16_t keylen, char *cache) {
                 int fd = uwsgi_connect(cache_server, 0, 1);
                 if (fd < 0) return -1;
 
-                int ret = uwsgi.wait_write_hook(fd, uwsgi.socket_timeout);
+                int ret = uwsgi_wait_write_ms(fd, uwsgi.socket_timeout_ms);
                 if (ret <= 0) {
                         close(fd);
                         return -1;
@@ -1998,7 +2139,7 @@ int uwsgi_cache_magic_clear(char *cache) {
                 int fd = uwsgi_connect(cache_server, 0, 1);
                 if (fd < 0) return -1;
 
-                int ret = uwsgi.wait_write_hook(fd, uwsgi.socket_timeout);
+                int ret = uwsgi_wait_write_ms(fd, uwsgi.socket_timeout_ms);
                 if (ret <= 0) {
                         close(fd);
                         return -1;
@@ -1177,6 +1177,155 @@ void emperor_add_with_attrs(struct uwsgi_emperor_scanner *ues, char *name, time_
 
 static void uwsgi_emperor_spawn_vassal(struct uwsgi_instance *);
 
+/*
+
+	zygotes
+
+	--emperor-zygote "<name> <config>" makes the Emperor exec a fork server (one for each
+	profile) that loads the specified config (plugins and common options) and waits for
+	vassals. When --emperor-use-fork-server (or the vassal attribute set with
+	--emperor-fork-server-attr) matches the name of a zygote, vassals are forked from it,
+	skipping exec and plugin loading. The zygote dies with the Emperor (or when its
+	channel is closed) and it is respawned on demand if it crashes.
+
+*/
+struct uwsgi_emperor_zygote {
+	char *name;
+	char *config;
+	char *socket;
+	pid_t pid;
+	// the Emperor side of the channel (closing it kills the zygote)
+	int fd;
+	time_t last_spawn;
+	struct uwsgi_emperor_zygote *next;
+};
+
+static struct uwsgi_emperor_zygote *emperor_zygotes;
+
+static void emperor_zygote_spawn(struct uwsgi_emperor_zygote *uez) {
+	int pipe[2];
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, pipe)) {
+		uwsgi_error("emperor_zygote_spawn()/socketpair()");
+		return;
+	}
+	uez->last_spawn = uwsgi_now();
+	pid_t pid = fork();
+	if (pid < 0) {
+		uwsgi_error("emperor_zygote_spawn()/fork()");
+		close(pipe[0]);
+		close(pipe[1]);
+		return;
+	}
+	if (pid == 0) {
+		int i;
+		for (i = 3; i < (int) uwsgi.max_fd; i++) {
+			if (uwsgi_fd_is_safe(i))
+				continue;
+			if (i != pipe[1]) {
+				close(i);
+			}
+		}
+		// the fork server exits when the Emperor channel is closed
+		char *uef = uwsgi_num2str(pipe[1]);
+		if (setenv("UWSGI_EMPEROR_FD", uef, 1)) {
+			uwsgi_error("emperor_zygote_spawn()/setenv()");
+			exit(1);
+		}
+		free(uef);
+		unsetenv("UWSGI_EMPEROR_FD_CONFIG");
+		char *argv[5];
+		argv[0] = uwsgi.binary_path;
+		argv[1] = "--fork-server";
+		argv[2] = uez->socket;
+		argv[3] = uez->config;
+		argv[4] = NULL;
+		execvp(argv[0], argv);
+		uwsgi_error("emperor_zygote_spawn()/execvp()");
+		exit(1);
+	}
+	close(pipe[1]);
+	uez->pid = pid;
+	uez->fd = pipe[0];
+	uwsgi_log("[uwsgi-emperor] spawned zygote \"%s\" (pid: %d socket: %s)\n", uez->name, (int) pid, uez->socket);
+}
+
+static void emperor_zygotes_init() {
+	struct uwsgi_string_list *usl;
+	uwsgi_foreach(usl, uwsgi.emperor_zygotes) {
+		char *space = strchr(usl->value, ' ');
+		if (!space) {
+			uwsgi_log("invalid emperor-zygote syntax, must be: <name> <config>\n");
+			exit(1);
+		}
+		struct uwsgi_emperor_zygote *uez = uwsgi_calloc(sizeof(struct uwsgi_emperor_zygote));
+		uez->name = uwsgi_concat2n(usl->value, space - usl->value, "", 0);
+		uez->config = space + 1;
+#ifdef __linux__
+		uez->socket = uwsgi_concat2(uwsgi_concat3("@uwsgi-zygote-", uwsgi_num2str((int) getpid()), "-"), uez->name);
+#else
+		uez->socket = uwsgi_concat2(uwsgi_concat3("/tmp/uwsgi-zygote-", uwsgi_num2str((int) getpid()), "-"), uez->name);
+#endif
+		uez->fd = -1;
+		uez->next = emperor_zygotes;
+		emperor_zygotes = uez;
+		emperor_zygote_spawn(uez);
+	}
+}
+
+// returns the socket of the zygote, NULL if the fork server is not a zygote
+static char *emperor_zygote_socket(char *name, int *found) {
+	struct uwsgi_emperor_zygote *uez = emperor_zygotes;
+	while (uez) {
+		if (!strcmp(uez->name, name)) {
+			*found = 1;
+			// respawn a dead zygote (no more than once per second)
+			if (uez->pid <= 0 && uwsgi_now() > uez->last_spawn) {
+				emperor_zygote_spawn(uez);
+			}
+			if (uez->pid <= 0) return NULL;
+			return uez->socket;
+		}
+		uez = uez->next;
+	}
+	*found = 0;
+	return NULL;
+}
+
+static int emperor_zygote_check_death(pid_t diedpid) {
+	struct uwsgi_emperor_zygote *uez = emperor_zygotes;
+	while (uez) {
+		if (uez->pid == diedpid) {
+			uwsgi_log("[uwsgi-emperor] zygote \"%s\" (pid: %d) died\n", uez->name, (int) diedpid);
+			uez->pid = 0;
+			if (uez->fd > -1) {
+				close(uez->fd);
+				uez->fd = -1;
+			}
+#ifndef __linux__
+			unlink(uez->socket);
+#endif
+			return 1;
+		}
+		uez = uez->next;
+	}
+	return 0;
+}
+
+static void emperor_zygotes_destroy() {
+	struct uwsgi_emperor_zygote *uez = emperor_zygotes;
+	while (uez) {
+		if (uez->fd > -1) {
+			close(uez->fd);
+			uez->fd = -1;
+		}
+#ifndef __linux__
+		unlink(uez->socket);
+#endif
+		uez = uez->next;
+	}
+}
+
+
 static void vassal_fork_server_parser_hook(char *key, uint16_t key_len, char *value, uint16_t value_len, void *data) {
 	pid_t *pid = (pid_t *) data;
 
@@ -1326,11 +1475,24 @@ int uwsgi_emperor_vassal_start(struct uwsgi_instance *n_ui) {
 	char *fork_server = uwsgi.emperor_use_fork_server;
 	char *fork_server_attr = vassal_attr_get(n_ui, uwsgi.emperor_fork_server_attr);
 	if (fork_server_attr) fork_server = fork_server_attr;
+	int is_a_zygote = 0;
+	if (fork_server) {
+		char *zygote_socket = emperor_zygote_socket(fork_server, &is_a_zygote);
+		if (is_a_zygote) {
+			fork_server = zygote_socket;
+		}
+	}
 	// a new uWSGI instance will start
 	if (fork_server && !uwsgi_string_list_has_item(uwsgi.vassal_fork_base, n_ui->name, strlen(n_ui->name))) {
 		// pid can only be > 0 or -1
 		n_ui->adopted = 1;
 		pid = emperor_connect_to_fork_server(fork_server, n_ui);
+		// the zygote could be still loading, fallback to a plain fork()
+		if (pid < 0 && is_a_zygote) {
+			uwsgi_log_verbose("[uwsgi-emperor] %s: zygote \"%s\" not ready, spawning the vassal with fork()\n", n_ui->name, fork_server_attr ? fork_server_attr : uwsgi.emperor_use_fork_server);
+			n_ui->adopted = 0;
+			pid = fork();
+		}
 	}
 #if defined(__linux__) && !defined(OBSOLETE_LINUX_KERNEL) && !defined(__ia64__)
 	else if (uwsgi.emperor_clone) {
@@ -1913,14 +2075,14 @@ static void emperor_cleanup() {
 void emperor_loop() {
 
 #if defined(__linux__) && defined(PR_SET_CHILD_SUBREAPER)
-        if (uwsgi.emperor_use_fork_server || uwsgi.emperor_subreaper || uwsgi.emperor_fork_server_attr) {
+        if (uwsgi.emperor_use_fork_server || uwsgi.emperor_subreaper || uwsgi.emperor_fork_server_attr || uwsgi.emperor_zygotes) {
                 if (prctl(PR_SET_CHILD_SUBREAPER, 1, 0, 0, 0)) {
                         uwsgi_error("uwsgi_fork_server()/fork()");
                         exit(1);
                 }
         }
 #else
-	if (uwsgi.emperor_use_fork_server || uwsgi.emperor_subreaper || uwsgi.emperor_fork_server_attr) {
+	if (uwsgi.emperor_use_fork_server || uwsgi.emperor_subreaper || uwsgi.emperor_fork_server_attr || uwsgi.emperor_zygotes) {
 		uwsgi_log("*** DANGER: your kernel misses PR_SET_CHILD_SUBREAPER feature, required by the fork server ***\n");
 		uwsgi_log("*** your Emperor will not be able to correctly wait() on vassals ***\n");
 	}
@@ -2006,6 +2168,8 @@ void emperor_loop() {
 
 	int freq = 0;
 
+	emperor_zygotes_init();
+
 	uwsgi_hooks_run(uwsgi.hook_emperor_start, "emperor-start", 1);
 
 	// signal parent-Emperor about my loyalty
@@ -2190,7 +2354,7 @@ recheck:
 			}
 		}
 
-		if (has_children) {
+		if (has_children || emperor_zygotes) {
 			diedpid = waitpid(WAIT_ANY, &waitpid_status, WNOHANG);
 		}
 		else {
@@ -2215,6 +2379,9 @@ recheck:
 			}
 		}
 
+		if (diedpid > 0 && emperor_zygote_check_death(diedpid))
+			goto recheck;
+
 		ui_current = ui;
 		while (ui_current->ui_next) {
 			ui_current = ui_current->ui_next;
@@ -2298,6 +2465,8 @@ recheck:
 
 	}
 
+	emperor_zygotes_destroy();
+
 	uwsgi_log_verbose("The Emperor is buried.\n");
 	uwsgi_notify("The Emperor is buried.");
 	exit(0);
@@ -28,6 +28,12 @@ void uwsgi_500(struct wsgi_request *wsgi_req) {
 	uwsgi_response_write_body_do(wsgi_req, "Internal Server Error", 21);
 }
 
+void uwsgi_503(struct wsgi_request *wsgi_req) {
+	if (uwsgi_response_prepare_headers(wsgi_req, "503 Service Unavailable", 23)) return;
+	if (uwsgi_response_add_connection_close(wsgi_req)) return;
+	if (uwsgi_response_add_header(wsgi_req, "Content-Type", 12, "text/plain", 10)) return;
+	uwsgi_response_write_body_do(wsgi_req, "Service Unavailable", 19);
+}
 
 void uwsgi_404(struct wsgi_request *wsgi_req) {
 	if (uwsgi_response_prepare_headers(wsgi_req, "404 Not Found", 13)) return;
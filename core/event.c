@@ -61,11 +61,11 @@ static void uwsgi_poll_queue_rebuild(struct uwsgi_poll_event *upe) {
 	}
 }
 
-int event_queue_wait(int eq, int timeout, int *interesting_fd) {
+int event_queue_wait_ms(int eq, int timeout, int *interesting_fd) {
 	struct uwsgi_poll_event *upe = uwsgi_poll_event_queue[eq];
 	pthread_mutex_lock(&upe->lock);
 	uwsgi_poll_queue_rebuild(upe);
-	int ret = poll(upe->poll, upe->nevents, timeout * 1000);
+	int ret = poll(upe->poll, upe->nevents, timeout);
 	if (ret > 0) {
 		int i;
 		for(i=0;i<upe->nevents;i++) {
@@ -163,11 +163,11 @@ int event_queue_del_fd(int eq, int fd, int event) {
 	pthread_mutex_unlock(&upe->lock);
 	return ret;
 }
-int event_queue_wait_multi(int eq, int timeout, void *events, int nevents) {
+int event_queue_wait_multi_ms(int eq, int timeout, void *events, int nevents) {
 	struct uwsgi_poll_event *upe = uwsgi_poll_event_queue[eq];
 	pthread_mutex_lock(&upe->lock);
         uwsgi_poll_queue_rebuild(upe);
-        int ret = poll(upe->poll, upe->nevents, timeout * 1000);
+        int ret = poll(upe->poll, upe->nevents, timeout);
 	int cnt = 0;
         if (ret > 0) {
                 int i;
@@ -397,7 +397,7 @@ int event_queue_interesting_fd(void *events, int id) {
 	return fd;
 }
 
-int event_queue_wait_multi(int eq, int timeout, void *events, int nevents) {
+int event_queue_wait_multi_ms(int eq, int timeout, void *events, int nevents) {
 
 	int ret;
 	uint_t nget = 1;
@@ -405,8 +405,8 @@ int event_queue_wait_multi(int eq, int timeout, void *events, int nevents) {
 	
 
 	if (timeout >= 0) {
-		ts.tv_sec = timeout;
-		ts.tv_nsec = 0;
+		ts.tv_sec = timeout / 1000;
+		ts.tv_nsec = (timeout % 1000) * 1000000;
 		ret = port_getn(eq, events, nevents, &nget, &ts);
 	}
 	else {
@@ -438,15 +438,15 @@ int event_queue_wait_multi(int eq, int timeout, void *events, int nevents) {
 
 
 
-int event_queue_wait(int eq, int timeout, int *interesting_fd) {
+int event_queue_wait_ms(int eq, int timeout, int *interesting_fd) {
 
 	int ret;
 	port_event_t pe;
 	timespec_t ts;
 
-	if (timeout > 0) {
-		ts.tv_sec = timeout;
-		ts.tv_nsec = 0;
+	if (timeout >= 0) {
+		ts.tv_sec = timeout / 1000;
+		ts.tv_nsec = (timeout % 1000) * 1000000;
 		ret = port_get(eq, &pe, &ts);
 	}
 	else {
@@ -691,14 +691,10 @@ int event_queue_interesting_fd_is_write(void *events, int id) {
 }
 
 
-int event_queue_wait_multi(int eq, int timeout, void *events, int nevents) {
+int event_queue_wait_multi_ms(int eq, int timeout, void *events, int nevents) {
 
 	int ret;
 
-	if (timeout > 0) {
-		timeout = timeout * 1000;
-	}
-
 	ret = epoll_wait(eq, (struct epoll_event *) events, nevents, timeout);
 	if (ret < 0) {
 		if (errno != EINTR)
@@ -708,15 +704,11 @@ int event_queue_wait_multi(int eq, int timeout, void *events, int nevents) {
 	return ret;
 }
 
-int event_queue_wait(int eq, int timeout, int *interesting_fd) {
+int event_queue_wait_ms(int eq, int timeout, int *interesting_fd) {
 
 	int ret;
 	struct epoll_event ee;
 
-	if (timeout > 0) {
-		timeout = timeout * 1000;
-	}
-
 	ret = epoll_wait(eq, &ee, 1, timeout);
 	if (ret < 0) {
 		if (errno != EINTR)
@@ -886,7 +878,7 @@ void *event_queue_alloc(int nevents) {
 	return uwsgi_malloc(sizeof(struct kevent) * nevents);
 }
 
-int event_queue_wait_multi(int eq, int timeout, void *events, int nevents) {
+int event_queue_wait_multi_ms(int eq, int timeout, void *events, int nevents) {
 
 	int ret;
 	struct timespec ts;
@@ -895,8 +887,8 @@ int event_queue_wait_multi(int eq, int timeout, void *events, int nevents) {
 		ret = kevent(eq, NULL, 0, events, nevents, NULL);
 	}
 	else {
-		memset(&ts, 0, sizeof(struct timespec));
-		ts.tv_sec = timeout;
+		ts.tv_sec = timeout / 1000;
+		ts.tv_nsec = (timeout % 1000) * 1000000;
 		ret = kevent(eq, NULL, 0, (struct kevent *) events, nevents, &ts);
 	}
 
@@ -942,7 +934,7 @@ int event_queue_interesting_fd_is_write(void *events, int id) {
 	return 0;
 }
 
-int event_queue_wait(int eq, int timeout, int *interesting_fd) {
+int event_queue_wait_ms(int eq, int timeout, int *interesting_fd) {
 
 	int ret;
 	struct timespec ts;
@@ -952,8 +944,8 @@ int event_queue_wait(int eq, int timeout, int *interesting_fd) {
 		ret = kevent(eq, NULL, 0, &ev, 1, NULL);
 	}
 	else {
-		memset(&ts, 0, sizeof(struct timespec));
-		ts.tv_sec = timeout;
+		ts.tv_sec = timeout / 1000;
+		ts.tv_nsec = (timeout % 1000) * 1000000;
 		ret = kevent(eq, NULL, 0, &ev, 1, &ts);
 	}
 
@@ -1409,6 +1401,15 @@ struct uwsgi_timer *event_queue_ack_timer(int id) {
 }
 #endif
 
+// backends work in milliseconds, those are the historical (seconds based) entry points
+int event_queue_wait(int eq, int timeout, int *interesting_fd) {
+	return event_queue_wait_ms(eq, timeout > 0 ? timeout * 1000 : timeout, interesting_fd);
+}
+
+int event_queue_wait_multi(int eq, int timeout, void *events, int nevents) {
+	return event_queue_wait_multi_ms(eq, timeout > 0 ? timeout * 1000 : timeout, events, nevents);
+}
+
 int event_queue_read() {
 	return UWSGI_EVENT_IN;
 }
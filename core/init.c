@@ -97,6 +97,10 @@ void uwsgi_init_default() {
 	uwsgi.rpc_max = 64;
 
 	uwsgi.offload_threads_events = 64;
+	uwsgi.static_open_cache_ttl = 10;
+	uwsgi.static_compress_store_limit = 256 * 1024 * 1024;
+	uwsgi.static_compress_max_size = 8 * 1024 * 1024;
+	uwsgi.static_compress_inline_max_size = 64 * 1024;
 
 	uwsgi.default_app = -1;
 
@@ -121,6 +125,8 @@ void uwsgi_init_default() {
 	uwsgi.vec_size = 4 + 1 + (4 * MAX_VARS);
 
 	uwsgi.socket_timeout = 4;
+	uwsgi.socket_timeout_ms = 4000;
+	uwsgi.listen_shed_interval = 100;
 	uwsgi.logging_options.enabled = 1;
 
 	// a workers hould be running for at least 10 seconds
@@ -327,16 +333,21 @@ void uwsgi_commandline_config() {
 
 void uwsgi_setup_workers() {
 	int i, j;
-	// allocate shared memory for workers + master
-	uwsgi.workers = (struct uwsgi_worker *) uwsgi_calloc_shared(sizeof(struct uwsgi_worker) * (uwsgi.numproc + 1));
+	// allocate shared memory for workers + master (+ the scratch slots of the spares)
+	uwsgi.workers = (struct uwsgi_worker *) uwsgi_calloc_shared(sizeof(struct uwsgi_worker) * uwsgi_spare_slots());
+	uwsgi_numa_interleave(uwsgi.workers, sizeof(struct uwsgi_worker) * uwsgi_spare_slots());
 
-	for (i = 0; i <= uwsgi.numproc; i++) {
+	for (i = 0; i < uwsgi_spare_slots(); i++) {
 		// allocate memory for apps
 		uwsgi.workers[i].apps = (struct uwsgi_app *) uwsgi_calloc_shared(sizeof(struct uwsgi_app) * uwsgi.max_apps);
 
 		// allocate memory for cores
 		uwsgi.workers[i].cores = (struct uwsgi_core *) uwsgi_calloc_shared(sizeof(struct uwsgi_core) * uwsgi.cores);
 
+		// apps and cores are (mostly) touched only by their worker
+		uwsgi_numa_bind(uwsgi.workers[i].apps, sizeof(struct uwsgi_app) * uwsgi.max_apps, uwsgi_numa_worker_node(i));
+		uwsgi_numa_bind(uwsgi.workers[i].cores, sizeof(struct uwsgi_core) * uwsgi.cores, uwsgi_numa_worker_node(i));
+
 		// this is a trick for avoiding too much memory areas
 		void *ts = uwsgi_calloc_shared(sizeof(void *) * uwsgi.max_apps * uwsgi.cores);
 		// add 4 bytes for uwsgi header
@@ -363,20 +374,31 @@ void uwsgi_setup_workers() {
 			continue;
 		uwsgi.workers[i].signal_pipe[0] = -1;
 		uwsgi.workers[i].signal_pipe[1] = -1;
+		if (i > uwsgi.numproc) {
+			snprintf(uwsgi.workers[i].name, 0xff, "uWSGI spare %d", i - uwsgi.numproc);
+			continue;
+		}
 		snprintf(uwsgi.workers[i].name, 0xff, "uWSGI worker %d", i);
 	}
 
+	if (uwsgi.spare_workers > 0) {
+		uwsgi.spares = uwsgi_calloc(sizeof(struct uwsgi_spare) * uwsgi.spare_workers);
+		for (i = 0; i < uwsgi.spare_workers; i++) {
+			uwsgi.spares[i].fd = -1;
+		}
+	}
+
 	uint64_t total_memory = (sizeof(struct uwsgi_app) * uwsgi.max_apps) + (sizeof(struct uwsgi_core) * uwsgi.cores) + (sizeof(void *) * uwsgi.max_apps * uwsgi.cores) + (uwsgi.buffer_size * uwsgi.cores) + (sizeof(struct iovec) * uwsgi.vec_size * uwsgi.cores);
 	if (uwsgi.post_buffering > 0) {
 		total_memory += (uwsgi.post_buffering_bufsize * uwsgi.cores);
 	}
 
-	total_memory *= (uwsgi.numproc + uwsgi.master_process);
+	total_memory *= (uwsgi.numproc + uwsgi.master_process + uwsgi.spare_workers);
 	if (uwsgi.numproc > 0)
 		uwsgi_log("mapped %llu bytes (%llu KB) for %d cores\n", (unsigned long long) total_memory, (unsigned long long) (total_memory / 1024), uwsgi.cores * uwsgi.numproc);
 
 	// allocate signal table
-        uwsgi.shared->signal_table = uwsgi_calloc_shared(sizeof(struct uwsgi_signal_entry) * 256 * (uwsgi.numproc + 1));
+        uwsgi.shared->signal_table = uwsgi_calloc_shared(sizeof(struct uwsgi_signal_entry) * 256 * uwsgi_spare_slots());
 
 #ifdef UWSGI_ROUTING
 	uwsgi_fixup_routes(uwsgi.routes);
@@ -429,6 +451,15 @@ void sanitize_args() {
                 uwsgi.cores = uwsgi.threads;
         }
 
+#if !defined(__linux__) || !defined(TCP_INFO)
+        if (uwsgi.listen_shed) {
+                uwsgi_log("*** WARNING: --listen-shed is not supported on this platform ***\n");
+        }
+#endif
+
+        // legacy users of the socket timeout work in seconds
+        uwsgi.socket_timeout = (uwsgi.socket_timeout_ms + 999) / 1000;
+
         if (uwsgi.harakiri_options.workers > 0) {
                 if (!uwsgi.post_buffering) {
                         uwsgi_log(" *** WARNING: you have enabled harakiri without post buffering. Slow upload could be rejected on post-unbuffered webservers *** \n");
@@ -465,6 +496,55 @@ void sanitize_args() {
 		}
         }
 
+	if (uwsgi.accept_reuseport) {
+		// every per-core socket must always have someone accepting on it
+		if (uwsgi.async > 1 || uwsgi.loop || uwsgi.cheaper_count || uwsgi.status.is_cheap || uwsgi.idle) {
+			uwsgi_log("--accept-reuseport requires the default loop engine and a fixed number of workers (no async, cheap, cheaper or idle modes)\n");
+			exit(1);
+		}
+		uwsgi.reuse_port = 1;
+		// each core has its own socket, there is nothing to serialize
+		uwsgi.use_thunder_lock = 0;
+	}
+
+	if (uwsgi.thread_sched) {
+		if (uwsgi.threads < 2 || uwsgi.async > 1 || uwsgi.loop || uwsgi.accept_reuseport) {
+			uwsgi_log("--thread-scheduler requires multiple threads and the default loop engine (no async or --accept-reuseport)\n");
+			exit(1);
+		}
+		if (uwsgi.thread_sched_queue <= 0) uwsgi.thread_sched_queue = uwsgi.threads;
+		// the acceptor thread is the only one waiting on the sockets
+		uwsgi.use_thunder_lock = 0;
+		uwsgi.accept_batch = 0;
+	}
+
+	if (uwsgi.spare_workers > 0) {
+		if (!uwsgi.master_process || uwsgi.worker_exec || uwsgi.worker_exec2) {
+			uwsgi_log("--spare-workers requires the master process (and no --worker-exec), disabling it\n");
+			uwsgi.spare_workers = 0;
+		}
+		else if (!uwsgi.lazy && !uwsgi.lazy_apps) {
+			uwsgi_log("*** WARNING: --spare-workers is useful only with --lazy-apps ***\n");
+		}
+	}
+
+	if (uwsgi.accept_batch > 1) {
+		// pre-accepted connections are only consumed by the default loop
+		if (uwsgi.async > 1 || uwsgi.loop) {
+			uwsgi_log("--accept-batch is supported only by the default loop engine, disabling it\n");
+			uwsgi.accept_batch = 0;
+		}
+		else {
+			int i;
+			uwsgi.accepted = uwsgi_calloc(sizeof(struct uwsgi_accepted) * uwsgi.cores);
+			for(i=0;i<uwsgi.cores;i++) {
+				uwsgi.accepted[i].fds = uwsgi_malloc(sizeof(int) * uwsgi.accept_batch);
+				uwsgi.accepted[i].addrs = uwsgi_malloc(sizeof(struct sockaddr_un) * uwsgi.accept_batch);
+				uwsgi.accepted[i].addrs_len = uwsgi_malloc(sizeof(socklen_t) * uwsgi.accept_batch);
+			}
+		}
+	}
+
 	if (uwsgi.max_worker_lifetime > 0 && uwsgi.min_worker_lifetime >= uwsgi.max_worker_lifetime) {
 		uwsgi_log("invalid min-worker-lifetime value (%d), must be lower than max-worker-lifetime (%d)\n",
 			uwsgi.min_worker_lifetime, uwsgi.max_worker_lifetime);
@@ -10,14 +10,35 @@ extern struct uwsgi_server uwsgi;
 
 */
 int uwsgi_waitfd_event(int fd, int timeout, int event) {
+	return uwsgi_waitfd_event_ms(fd, timeout * 1000, event);
+}
+
+/*
+	wait for an fd with a timeout in milliseconds (generally uwsgi.socket_timeout_ms).
+	The hooks of the loop engines work in seconds (the timeout is rounded up for them),
+	the default ones keep the milliseconds precision.
+*/
+int uwsgi_wait_read_ms(int fd, int timeout) {
+	if (uwsgi.wait_read_hook == uwsgi_simple_wait_read_hook)
+		return uwsgi_waitfd_event_ms(fd, timeout, POLLIN);
+	return uwsgi.wait_read_hook(fd, timeout < 0 ? -1 : (timeout + 999) / 1000);
+}
+
+int uwsgi_wait_write_ms(int fd, int timeout) {
+	if (uwsgi.wait_write_hook == uwsgi_simple_wait_write_hook)
+		return uwsgi_waitfd_event_ms(fd, timeout, POLLOUT);
+	return uwsgi.wait_write_hook(fd, timeout < 0 ? -1 : (timeout + 999) / 1000);
+}
+
+// timeout is in milliseconds (0 means --socket-timeout)
+int uwsgi_waitfd_event_ms(int fd, int timeout, int event) {
 
 	int ret;
 	struct pollfd upoll;
 
 	if (!timeout)
-		timeout = uwsgi.socket_timeout;
+		timeout = uwsgi.socket_timeout_ms;
 
-	timeout = timeout * 1000;
 	if (timeout < 0)
 		timeout = -1;
 
@@ -1166,6 +1166,21 @@ static ssize_t uwsgi_lf_msecs(struct wsgi_request * wsgi_req, char **buf) {
 	return strlen(*buf);
 }
 
+static ssize_t uwsgi_lf_cpu_us(struct wsgi_request * wsgi_req, char **buf) {
+	*buf = uwsgi_64bit2str(wsgi_req->cpu_us);
+	return strlen(*buf);
+}
+
+static ssize_t uwsgi_lf_sys_us(struct wsgi_request * wsgi_req, char **buf) {
+	*buf = uwsgi_64bit2str(wsgi_req->sys_us);
+	return strlen(*buf);
+}
+
+static ssize_t uwsgi_lf_alloc(struct wsgi_request * wsgi_req, char **buf) {
+	*buf = uwsgi_64bit2str(wsgi_req->alloc);
+	return strlen(*buf);
+}
+
 static ssize_t uwsgi_lf_pid(struct wsgi_request * wsgi_req, char **buf) {
 	*buf = uwsgi_num2str(uwsgi.mypid);
 	return strlen(*buf);
@@ -1932,6 +1947,9 @@ void uwsgi_register_logchunks() {
 	r_logchunk(msecs);
 	r_logchunk(tmsecs);
 	r_logchunk(tmicros);
+	r_logchunk(cpu_us);
+	r_logchunk(sys_us);
+	r_logchunk(alloc);
 	r_logchunk(time);
 	r_logchunk(ltime);
 	r_logchunk(ftime);
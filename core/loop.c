@@ -64,6 +64,9 @@ void simple_loop() {
 
 void uwsgi_loop_cores_run(void *(*func) (void *)) {
 	int i;
+	if (uwsgi.thread_sched) {
+		uwsgi_sched_init();
+	}
 	for (i = 1; i < uwsgi.threads; i++) {
 		long j = i;
 		pthread_create(&uwsgi.workers[uwsgi.mywid].cores[i].thread_id, &uwsgi.threads_attr, func, (void *) j);
@@ -124,7 +127,13 @@ void *simple_loop_run(void *arg1) {
 	// initialize the main event queue to monitor sockets
 	int main_queue = event_queue_init();
 
-	uwsgi_add_sockets_to_queue(main_queue, core_id);
+	// with --thread-scheduler connections come from the acceptor thread
+	if (uwsgi.thread_sched) {
+		uwsgi_sched_add_to_queue(main_queue, core_id);
+	}
+	else {
+		uwsgi_add_sockets_to_queue(main_queue, core_id);
+	}
 
 	if (uwsgi.signal_socket > -1) {
 		event_queue_add_fd_read(main_queue, uwsgi.signal_socket);
@@ -137,7 +146,7 @@ void *simple_loop_run(void *arg1) {
 
 		wsgi_req_setup(wsgi_req, core_id, NULL);
 
-		if (wsgi_req_accept(main_queue, wsgi_req)) {
+		if (uwsgi.thread_sched ? uwsgi_sched_accept(main_queue, wsgi_req) : wsgi_req_accept(main_queue, wsgi_req)) {
 			continue;
 		}
 
@@ -149,6 +158,34 @@ void *simple_loop_run(void *arg1) {
 		uwsgi_close_request(wsgi_req);
 	}
 
+	// the connections already taken from the listen queue (by --thread-scheduler or --accept-batch) are served before leaving
+	if (uwsgi.thread_sched) {
+		for(;;) {
+			wsgi_req_setup(wsgi_req, core_id, NULL);
+			if (uwsgi_sched_drain(wsgi_req)) break;
+			if (wsgi_req_recv(main_queue, wsgi_req)) {
+				uwsgi_destroy_request(wsgi_req);
+				continue;
+			}
+			uwsgi_close_request(wsgi_req);
+		}
+		if (core_id == 0) {
+			uwsgi_sched_join();
+		}
+	}
+
+	while (uwsgi_accepted_fd(wsgi_req) > -1) {
+		wsgi_req_setup(wsgi_req, core_id, NULL);
+		if (wsgi_req_accept(main_queue, wsgi_req)) {
+			continue;
+		}
+		if (wsgi_req_recv(main_queue, wsgi_req)) {
+			uwsgi_destroy_request(wsgi_req);
+			continue;
+		}
+		uwsgi_close_request(wsgi_req);
+	}
+
 	// end of the loop
 	if (uwsgi.workers[uwsgi.mywid].destroy && uwsgi.workers[0].pid > 0) {
 #ifdef __APPLE__
@@ -159,7 +159,7 @@ void uwsgi_master_check_mercy() {
 
 void expire_rb_timeouts(struct uwsgi_rbtree *tree) {
 
-	uint64_t current = (uint64_t) uwsgi_now();
+	uint64_t current = uwsgi_millis();
 	struct uwsgi_rb_timer *urbt;
 	struct uwsgi_signal_rb_timer *usrbt;
 
@@ -178,7 +178,7 @@ void expire_rb_timeouts(struct uwsgi_rbtree *tree) {
 			usrbt->iterations_done++;
 			uwsgi_route_signal(usrbt->sig);
 			if (!usrbt->iterations || usrbt->iterations_done < usrbt->iterations) {
-				usrbt->uwsgi_rb_timer = uwsgi_add_rb_timer(tree, uwsgi_now() + usrbt->value, usrbt);
+				usrbt->uwsgi_rb_timer = uwsgi_add_rb_timer(tree, uwsgi_millis() + ((uint64_t) usrbt->value * 1000), usrbt);
 			}
 			continue;
 		}
@@ -643,6 +643,10 @@ int master_loop(char **argv, char **environ) {
 		}
 
 
+		// keep the spare workers ready
+		if (uwsgi_spares_check())
+			return 0;
+
 		// check if someone is dead
 		diedpid = waitpid(WAIT_ANY, &waitpid_status, WNOHANG);
 		if (diedpid == -1) {
@@ -663,12 +667,11 @@ int master_loop(char **argv, char **environ) {
 		// no one died just run all of the standard master tasks
 		if (diedpid == 0) {
 
-			/* all processes ok, doing status scan after N seconds */
-			check_interval = uwsgi.master_interval;
-			if (!check_interval) {
-				check_interval = 1;
+			/* all processes ok, doing status scan after N seconds (the wait is in milliseconds) */
+			if (!uwsgi.master_interval) {
 				uwsgi.master_interval = 1;
 			}
+			check_interval = uwsgi.master_interval * 1000;
 
 
 			// add unregistered file monitors
@@ -694,7 +697,7 @@ int master_loop(char **argv, char **environ) {
 			// locking is not needed as rb_timers can only increase
 			for (i = 0; i < ushared->rb_timers_cnt; i++) {
 				if (!ushared->rb_timers[i].registered) {
-					ushared->rb_timers[i].uwsgi_rb_timer = uwsgi_add_rb_timer(rb_timers, uwsgi_now() + ushared->rb_timers[i].value, &ushared->rb_timers[i]);
+					ushared->rb_timers[i].uwsgi_rb_timer = uwsgi_add_rb_timer(rb_timers, uwsgi_millis() + ((uint64_t) ushared->rb_timers[i].value * 1000), &ushared->rb_timers[i]);
 					ushared->rb_timers[i].registered = 1;
 				}
 			}
@@ -704,7 +707,7 @@ int master_loop(char **argv, char **environ) {
 			if (ushared->rb_timers_cnt > 0) {
 				min_timeout = uwsgi_min_rb_timer(rb_timers, NULL);
 				if (min_timeout) {
-					int delta = min_timeout->value - uwsgi_now();
+					int64_t delta = (int64_t) min_timeout->value - (int64_t) uwsgi_millis();
 					if (delta <= 0) {
 						expire_rb_timeouts(rb_timers);
 					}
@@ -715,8 +718,14 @@ int master_loop(char **argv, char **environ) {
 				}
 			}
 
+			// harakiri could have sub-second resolution, wake up in time for the nearest deadline
+			int harakiri_wait = uwsgi_master_harakiri_wait();
+			if (harakiri_wait >= 0 && harakiri_wait < check_interval) {
+				check_interval = harakiri_wait;
+			}
+
 			// wait for event
-			rlen = event_queue_wait(uwsgi.master_queue, check_interval, &interesting_fd);
+			rlen = event_queue_wait_ms(uwsgi.master_queue, check_interval, &interesting_fd);
 
 			if (rlen == 0) {
 				if (ushared->rb_timers_cnt > 0) {
@@ -747,6 +756,13 @@ int master_loop(char **argv, char **environ) {
 
 			now = uwsgi_now();
 			if (now - uwsgi.current_time < 1) {
+				// enforce expired harakiri without waiting for the next cycle
+				if (harakiri_wait >= 0 && uwsgi_master_harakiri_wait() == 0) {
+					uwsgi_master_check_workers_deadline();
+					uwsgi_master_check_gateways_deadline();
+					uwsgi_master_check_mules_deadline();
+					uwsgi_master_check_spoolers_deadline();
+				}
 				continue;
 			}
 			uwsgi.current_time = now;
@@ -766,12 +782,6 @@ int master_loop(char **argv, char **environ) {
 			// check for idle
 			uwsgi_master_check_idle();
 
-			check_interval = uwsgi.master_interval;
-			if (!check_interval) {
-				check_interval = 1;
-				uwsgi.master_interval = 1;
-			}
-
 
 			// check listen_queue status
 			master_check_listen_queue();
@@ -888,6 +898,9 @@ int master_loop(char **argv, char **environ) {
 		// check for deadlocks first
 		uwsgi_deadlock_check(diedpid);
 
+		if (uwsgi_master_check_spares_death(diedpid))
+			continue;
+
 		// reload gateways and daemons only on normal workflow (+outworld status)
 		if (!uwsgi_instance_is_reloading && !uwsgi_instance_is_dying) {
 
@@ -1062,6 +1075,7 @@ next:
 
 void uwsgi_reload_workers() {
 	int i;
+	uwsgi_spares_recycle();
 	uwsgi_block_signal(SIGHUP);
 	for (i = 1; i <= uwsgi.numproc; i++) {
 		if (uwsgi.workers[i].pid > 0) {
@@ -1072,6 +1086,7 @@ void uwsgi_reload_workers() {
 }
 
 void uwsgi_chain_reload() {
+	uwsgi_spares_recycle();
 	if (!uwsgi.status.chain_reloading) {
 		uwsgi_log_verbose("chain reload starting...\n");
 		uwsgi.status.chain_reloading = 1;
@@ -1083,6 +1098,7 @@ void uwsgi_chain_reload() {
 
 void uwsgi_brutally_reload_workers() {
 	int i;
+	uwsgi_spares_recycle();
 	for (i = 1; i <= uwsgi.numproc; i++) {
 		if (uwsgi.workers[i].pid > 0) {
 			uwsgi_log_verbose("killing worker %d (pid: %d)\n", i, (int) uwsgi.workers[i].pid);
@@ -172,11 +172,12 @@ done:
 int uwsgi_master_check_workers_deadline() {
 	int i,j;
 	int ret = 0;
+	uint64_t now = uwsgi_millis();
 	for (i = 1; i <= uwsgi.numproc; i++) {
 		for(j=0;j<uwsgi.cores;j++) {
 			/* first check for harakiri */
 			if (uwsgi.workers[i].cores[j].harakiri > 0) {
-				if (uwsgi.workers[i].cores[j].harakiri < (time_t) uwsgi.current_time) {
+				if (uwsgi.workers[i].cores[j].harakiri < now) {
 					uwsgi_log_verbose("HARAKIRI triggered by worker %d core %d !!!\n", i, j);
 					trigger_harakiri(i);
 					ret = 1;
@@ -186,7 +187,7 @@ int uwsgi_master_check_workers_deadline() {
 			/* then user-defined harakiri */
 			if (uwsgi.workers[i].cores[j].user_harakiri > 0) {
 				uwsgi_log_verbose("HARAKIRI (user) triggered by worker %d core %d !!!\n", i, j);
-				if (uwsgi.workers[i].cores[j].user_harakiri < (time_t) uwsgi.current_time) {
+				if (uwsgi.workers[i].cores[j].user_harakiri < now) {
 					trigger_harakiri(i);
 					ret = 1;
 					break;
@@ -234,9 +235,10 @@ int uwsgi_master_check_gateways_deadline() {
 
 	int i;
 	int ret = 0;
+	uint64_t now = uwsgi_millis();
 	for (i = 0; i < ushared->gateways_cnt; i++) {
 		if (ushared->gateways_harakiri[i] > 0) {
-			if (ushared->gateways_harakiri[i] < (time_t) uwsgi.current_time) {
+			if (ushared->gateways_harakiri[i] < now) {
 				if (ushared->gateways[i].pid > 0) {
 					uwsgi_log("*** HARAKIRI ON GATEWAY %s %d (pid: %d) ***\n", ushared->gateways[i].name, ushared->gateways[i].num, ushared->gateways[i].pid);
 					kill(ushared->gateways[i].pid, SIGKILL);
@@ -252,10 +254,11 @@ int uwsgi_master_check_gateways_deadline() {
 int uwsgi_master_check_mules_deadline() {
 	int i;
 	int ret = 0;
+	uint64_t now = uwsgi_millis();
 
 	for (i = 0; i < uwsgi.mules_cnt; i++) {
 		if (uwsgi.mules[i].harakiri > 0) {
-			if (uwsgi.mules[i].harakiri < (time_t) uwsgi.current_time) {
+			if (uwsgi.mules[i].harakiri < now) {
 				uwsgi_log("*** HARAKIRI ON MULE %d HANDLING SIGNAL %d (pid: %d) ***\n", i + 1, uwsgi.mules[i].signum, uwsgi.mules[i].pid);
 				kill(uwsgi.mules[i].pid, SIGKILL);
 				uwsgi.mules[i].harakiri = 0;
@@ -264,7 +267,7 @@ int uwsgi_master_check_mules_deadline() {
 		}
 		// user harakiri
 		if (uwsgi.mules[i].user_harakiri > 0) {
-                        if (uwsgi.mules[i].user_harakiri < (time_t) uwsgi.current_time) {
+                        if (uwsgi.mules[i].user_harakiri < now) {
                                 uwsgi_log("*** HARAKIRI ON MULE %d (pid: %d) ***\n", i + 1, uwsgi.mules[i].pid);
                                 kill(uwsgi.mules[i].pid, SIGKILL);
                                 uwsgi.mules[i].user_harakiri = 0;
@@ -277,15 +280,16 @@ int uwsgi_master_check_mules_deadline() {
 
 int uwsgi_master_check_spoolers_deadline() {
 	int ret = 0;
+	uint64_t now = uwsgi_millis();
 	struct uwsgi_spooler *uspool = uwsgi.spoolers;
 	while (uspool) {
-		if (uspool->harakiri > 0 && uspool->harakiri < (time_t) uwsgi.current_time) {
+		if (uspool->harakiri > 0 && uspool->harakiri < now) {
 			uwsgi_log("*** HARAKIRI ON THE SPOOLER (pid: %d) ***\n", uspool->pid);
 			kill(uspool->pid, SIGKILL);
 			uspool->harakiri = 0;
 			ret = 1;
 		}
-		if (uspool->user_harakiri > 0 && uspool->user_harakiri < (time_t) uwsgi.current_time) {
+		if (uspool->user_harakiri > 0 && uspool->user_harakiri < now) {
                         uwsgi_log("*** HARAKIRI ON THE SPOOLER (pid: %d) ***\n", uspool->pid);
                         kill(uspool->pid, SIGKILL);
                         uspool->user_harakiri = 0;
@@ -297,6 +301,49 @@ int uwsgi_master_check_spoolers_deadline() {
 }
 
 
+static void harakiri_nearest(uint64_t deadline, uint64_t *nearest) {
+	if (deadline > 0 && (!*nearest || deadline < *nearest)) {
+		*nearest = deadline;
+	}
+}
+
+/*
+	milliseconds before the nearest harakiri deadline (-1 if none is armed)
+	the master uses it to wake up in time for sub-second harakiri values
+*/
+int uwsgi_master_harakiri_wait() {
+	int i,j;
+	uint64_t nearest = 0;
+	for (i = 1; i <= uwsgi.numproc; i++) {
+		// already killed, the standard cycle will retry if needed
+		if (uwsgi.workers[i].pending_harakiri) continue;
+		for(j=0;j<uwsgi.cores;j++) {
+			harakiri_nearest(uwsgi.workers[i].cores[j].harakiri, &nearest);
+			harakiri_nearest(uwsgi.workers[i].cores[j].user_harakiri, &nearest);
+		}
+	}
+	for (i = 0; i < ushared->gateways_cnt; i++) {
+		harakiri_nearest(ushared->gateways_harakiri[i], &nearest);
+	}
+	for (i = 0; i < uwsgi.mules_cnt; i++) {
+		harakiri_nearest(uwsgi.mules[i].harakiri, &nearest);
+		harakiri_nearest(uwsgi.mules[i].user_harakiri, &nearest);
+	}
+	struct uwsgi_spooler *uspool = uwsgi.spoolers;
+	while (uspool) {
+		harakiri_nearest(uspool->harakiri, &nearest);
+		harakiri_nearest(uspool->user_harakiri, &nearest);
+		uspool = uspool->next;
+	}
+
+	if (!nearest) return -1;
+	uint64_t now = uwsgi_millis();
+	// deadlines are checked with '<', so wake up just after them
+	if (nearest < now) return 0;
+	if (nearest - now >= INT_MAX) return INT_MAX;
+	return (nearest - now) + 1;
+}
+
 int uwsgi_master_check_spoolers_death(int diedpid) {
 
 	struct uwsgi_spooler *uspool = uwsgi.spoolers;
@@ -135,7 +135,7 @@ int uwsgi_master_manage_events(int interesting_fd) {
 		while (uwsgi_sock) {
 			if (interesting_fd == uwsgi_sock->fd) {
 				uwsgi.status.is_cheap = 0;
-				uwsgi_del_sockets_from_queue(uwsgi.master_queue);
+				uwsgi_del_sockets_from_queue(uwsgi.master_queue, -1);
 				// how many worker we need to respawn ?
 				int needed = uwsgi.numproc;
 				// if in cheaper mode, just respawn the minimal amount
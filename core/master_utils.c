@@ -54,6 +54,8 @@ void uwsgi_destroy_processes() {
 
         uwsgi_detach_daemons();
 
+	uwsgi_spares_destroy();
+
         for (i = 0; i < ushared->gateways_cnt; i++) {
                 if (ushared->gateways[i].pid > 0) {
                         kill(ushared->gateways[i].pid, SIGKILL);
@@ -440,7 +442,7 @@ void uwsgi_reload(char **argv) {
 
 		struct uwsgi_socket *uwsgi_sock = uwsgi.sockets;
 		while (uwsgi_sock) {
-			if (i == uwsgi_sock->fd) {
+			if (i == uwsgi_sock->fd || uwsgi_socket_has_core_fd(uwsgi_sock, i)) {
 				uwsgi_log("found fd %d mapped to socket %d (%s)\n", i, uwsgi_get_socket_num(uwsgi_sock), uwsgi_sock->name);
 				found = 1;
 				break;
@@ -560,6 +562,13 @@ void uwsgi_fixup_fds(int wid, int muleid, struct uwsgi_gateway *ug) {
 			}
 			ugs = ugs->next;
 		}
+		// only the master talks with the spares
+		for (i = 0; i < uwsgi.spare_workers; i++) {
+			if (uwsgi.spares[i].fd > -1) {
+				close(uwsgi.spares[i].fd);
+				uwsgi.spares[i].fd = -1;
+			}
+		}
 		// fix the communication pipe
 		close(uwsgi.shared->worker_signal_pipe[0]);
 		for (i = 1; i <= uwsgi.numproc; i++) {
@@ -664,6 +673,10 @@ int uwsgi_respawn_worker(int wid) {
 	// this is required for various checks
 	uwsgi.workers[wid].delta_requests = 0;
 
+	// a parked spare has already loaded the apps
+	if (uwsgi_spare_adopt(wid))
+		return 0;
+
 	if (uwsgi.threaded_logger) {
 		pthread_mutex_lock(&uwsgi.threaded_logger_lock);
 	}
@@ -851,6 +864,14 @@ struct uwsgi_stats *uwsgi_master_generate_stats() {
 	if (uwsgi_stats_comma(us))
 		goto end;
 
+#ifdef UWSGI_SSL
+	if (uwsgi_ssl_stats(us))
+		goto end;
+#endif
+
+	if (uwsgi_numa_stats(us))
+		goto end;
+
 	if (uwsgi.caches) {
 
 		
@@ -897,6 +918,11 @@ struct uwsgi_stats *uwsgi_master_generate_stats() {
 			if (uwsgi_stats_keylong_comma(us, "full", (unsigned long long) uc->full))
 				goto end;
 
+			if (uc->numa_replicas) {
+				if (uwsgi_stats_keylong_comma(us, "numa_node", (unsigned long long) uwsgi.numa_nodes[uc->numa_node].id))
+					goto end;
+			}
+
 			if (uwsgi_stats_keylong(us, "last_modified_at", (unsigned long long) uc->last_modified_at))
 				goto end;
 
@@ -1049,6 +1075,24 @@ struct uwsgi_stats *uwsgi_master_generate_stats() {
 			goto end;
 		if (uwsgi_stats_keylong_comma(us, "harakiri_count", (unsigned long long) uwsgi.workers[i + 1].harakiri_count))
 			goto end;
+		if (uwsgi_stats_keylong_comma(us, "shed", (unsigned long long) uwsgi.workers[i + 1].shed))
+			goto end;
+		if (uwsgi_stats_keylong_comma(us, "expired", (unsigned long long) uwsgi.workers[i + 1].expired))
+			goto end;
+		if (uwsgi.thread_sched) {
+			if (uwsgi_stats_keylong_comma(us, "sched_stolen", (unsigned long long) __atomic_load_n(&uwsgi.workers[i + 1].sched_stolen, __ATOMIC_RELAXED)))
+				goto end;
+			if (uwsgi_stats_keylong_comma(us, "sched_prioritized", (unsigned long long) __atomic_load_n(&uwsgi.workers[i + 1].sched_prioritized, __ATOMIC_RELAXED)))
+				goto end;
+		}
+		if (uwsgi.spare_workers) {
+			if (uwsgi_stats_keylong_comma(us, "spare_respawns", (unsigned long long) uwsgi.workers[i + 1].spare_respawns))
+				goto end;
+		}
+		if (uwsgi.numa) {
+			if (uwsgi_stats_keylong_comma(us, "numa_node", (unsigned long long) uwsgi.numa_nodes[uwsgi_numa_worker_node(i + 1)].id))
+				goto end;
+		}
 		if (uwsgi_stats_keylong_comma(us, "signals", (unsigned long long) uwsgi.workers[i + 1].signals))
 			goto end;
 
@@ -1126,6 +1170,14 @@ struct uwsgi_stats *uwsgi_master_generate_stats() {
 				goto end;
 			if (uwsgi_stats_keylong_comma(us, "exceptions", ua->exceptions))
 				goto end;
+			if (uwsgi.logging_options.request_accounting) {
+				if (uwsgi_stats_keylong_comma(us, "cpu_us", ua->cpu_us))
+					goto end;
+				if (uwsgi_stats_keylong_comma(us, "sys_us", ua->sys_us))
+					goto end;
+				if (uwsgi_stats_keyslong_comma(us, "alloc", ua->alloc))
+					goto end;
+			}
 
 			if (*ua->chdir) {
 				if (uwsgi_stats_keyval(us, "chdir", ua->chdir))
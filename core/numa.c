@@ -0,0 +1,292 @@
+#include <uwsgi.h>
+
+extern struct uwsgi_server uwsgi;
+
+/*
+
+	NUMA placement (Linux only)
+
+	with --numa workers are spread across the memory nodes of the system (worker N
+	goes to node (N-1) % nodes), pinned to the cpus of their node and configured to
+	prefer node-local memory. The shared memory areas owned by a single worker (its
+	cores and apps) are moved to its node, while the areas shared by everyone (the
+	workers table, caches and sharedareas) are interleaved so no node becomes the
+	hot one. Caches declared with numa=1 get a replica per node.
+
+	nodes are discovered from sysfs and memory policies are applied with the raw
+	syscalls, so libnuma is not required.
+
+*/
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+#if defined(__linux__) && defined(SYS_mbind) && defined(SYS_set_mempolicy)
+#define UWSGI_NUMA
+
+// from linux/mempolicy.h
+#define UWSGI_MPOL_PREFERRED 1
+#define UWSGI_MPOL_INTERLEAVE 3
+#define UWSGI_MPOL_MF_MOVE (1<<1)
+
+// enough for 1024 nodes
+#define UWSGI_NUMA_MASK_WORDS (1024 / (8 * sizeof(unsigned long)))
+#endif
+
+#ifdef UWSGI_NUMA
+static int numa_read_sysfs(char *path, char *buf, size_t len) {
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) return -1;
+	ssize_t rlen = read(fd, buf, len - 1);
+	close(fd);
+	if (rlen <= 0) return -1;
+	buf[rlen] = 0;
+	return 0;
+}
+
+// parse a sysfs list (like "0-3,8-11") calling the callback for each item
+static void numa_parse_list(char *list, void (*func)(int, void *), void *data) {
+	char *p, *ctx = NULL;
+	uwsgi_foreach_token(list, ",", p, ctx) {
+		char *dash = strchr(p, '-');
+		int first = atoi(p);
+		int last = dash ? atoi(dash + 1) : first;
+		int i;
+		for (i = first; i <= last; i++) {
+			func(i, data);
+		}
+	}
+}
+
+static void numa_add_node(int id, void *data) {
+	struct uwsgi_numa_node *nodes = realloc(uwsgi.numa_nodes, sizeof(struct uwsgi_numa_node) * (uwsgi.numa_nodes_cnt + 1));
+	if (!nodes) {
+		uwsgi_error("numa_add_node()/realloc()");
+		exit(1);
+	}
+	uwsgi.numa_nodes = nodes;
+	struct uwsgi_numa_node *node = &uwsgi.numa_nodes[uwsgi.numa_nodes_cnt];
+	memset(node, 0, sizeof(struct uwsgi_numa_node));
+	node->id = id;
+	uwsgi.numa_nodes_cnt++;
+}
+
+static void numa_add_cpu(int cpu, void *data) {
+	struct uwsgi_numa_node *node = (struct uwsgi_numa_node *) data;
+	int *cpus = realloc(node->cpus, sizeof(int) * (node->cpus_cnt + 1));
+	if (!cpus) {
+		uwsgi_error("numa_add_cpu()/realloc()");
+		exit(1);
+	}
+	node->cpus = cpus;
+	node->cpus[node->cpus_cnt] = cpu;
+	node->cpus_cnt++;
+}
+
+static void numa_mask(unsigned long *mask, struct uwsgi_numa_node *node) {
+	memset(mask, 0, sizeof(unsigned long) * UWSGI_NUMA_MASK_WORDS);
+	if (node) {
+		mask[node->id / (8 * sizeof(unsigned long))] |= 1UL << (node->id % (8 * sizeof(unsigned long)));
+		return;
+	}
+	int i;
+	for (i = 0; i < uwsgi.numa_nodes_cnt; i++) {
+		int id = uwsgi.numa_nodes[i].id;
+		mask[id / (8 * sizeof(unsigned long))] |= 1UL << (id % (8 * sizeof(unsigned long)));
+	}
+}
+
+static void numa_mbind(void *addr, size_t len, int mode, struct uwsgi_numa_node *node) {
+	unsigned long mask[UWSGI_NUMA_MASK_WORDS];
+	if (!addr || !len) return;
+	// mbind() wants page aligned areas
+	uintptr_t start = ((uintptr_t) addr) & ~((uintptr_t) uwsgi.page_size - 1);
+	len += ((uintptr_t) addr) - start;
+	numa_mask(mask, node);
+	if (syscall(SYS_mbind, start, len, mode, mask, UWSGI_NUMA_MASK_WORDS * 8 * sizeof(unsigned long), UWSGI_MPOL_MF_MOVE)) {
+		uwsgi_error("uwsgi_numa/mbind()");
+	}
+}
+#endif
+
+void uwsgi_numa_setup() {
+	uwsgi.numa_node = -1;
+	if (!uwsgi.numa) return;
+#ifdef UWSGI_NUMA
+	char buf[4096];
+	if (numa_read_sysfs("/sys/devices/system/node/online", buf, sizeof(buf))) {
+		uwsgi_log("*** WARNING: unable to detect NUMA nodes, --numa disabled ***\n");
+		uwsgi.numa = 0;
+		return;
+	}
+	numa_parse_list(buf, numa_add_node, NULL);
+
+	int i;
+	for (i = 0; i < uwsgi.numa_nodes_cnt; i++) {
+		struct uwsgi_numa_node *node = &uwsgi.numa_nodes[i];
+		char path[PATH_MAX];
+		if (snprintf(path, PATH_MAX, "/sys/devices/system/node/node%d/cpulist", node->id) >= PATH_MAX) continue;
+		if (numa_read_sysfs(path, buf, sizeof(buf))) continue;
+		numa_parse_list(buf, numa_add_cpu, node);
+	}
+
+	// memory-only nodes cannot host workers
+	int j = 0;
+	for (i = 0; i < uwsgi.numa_nodes_cnt; i++) {
+		if (uwsgi.numa_nodes[i].cpus_cnt > 0) {
+			uwsgi.numa_nodes[j++] = uwsgi.numa_nodes[i];
+		}
+		else {
+			uwsgi_log("NUMA node %d has no cpus, skipping it\n", uwsgi.numa_nodes[i].id);
+		}
+	}
+	uwsgi.numa_nodes_cnt = j;
+
+	if (uwsgi.numa_nodes_cnt < 1) {
+		uwsgi_log("*** WARNING: no usable NUMA node found, --numa disabled ***\n");
+		uwsgi.numa = 0;
+		return;
+	}
+
+	for (i = 0; i < uwsgi.numa_nodes_cnt; i++) {
+		uwsgi_log("NUMA node %d: %d cpus\n", uwsgi.numa_nodes[i].id, uwsgi.numa_nodes[i].cpus_cnt);
+	}
+#else
+	uwsgi_log("*** WARNING: NUMA placement is not supported on this platform ***\n");
+	uwsgi.numa = 0;
+#endif
+}
+
+// the node index (not the id) a worker is assigned to, -1 if NUMA placement is off
+int uwsgi_numa_worker_node(int wid) {
+	if (!uwsgi.numa || wid <= 0) return -1;
+	return (wid - 1) % uwsgi.numa_nodes_cnt;
+}
+
+// move an already allocated area to a node (by index)
+void uwsgi_numa_bind(void *addr, size_t len, int node) {
+#ifdef UWSGI_NUMA
+	if (!uwsgi.numa || node < 0 || uwsgi.numa_nodes_cnt < 2) return;
+	numa_mbind(addr, len, UWSGI_MPOL_PREFERRED, &uwsgi.numa_nodes[node]);
+#endif
+}
+
+// spread an area shared by all of the workers across all of the nodes
+void uwsgi_numa_interleave(void *addr, size_t len) {
+#ifdef UWSGI_NUMA
+	if (!uwsgi.numa || uwsgi.numa_nodes_cnt < 2) return;
+	numa_mbind(addr, len, UWSGI_MPOL_INTERLEAVE, NULL);
+#endif
+}
+
+// called by each worker after fork()
+void uwsgi_numa_worker() {
+	int node_index = uwsgi_numa_worker_node(uwsgi.mywid);
+	if (node_index < 0) return;
+#ifdef UWSGI_NUMA
+	struct uwsgi_numa_node *node = &uwsgi.numa_nodes[node_index];
+	uwsgi.numa_node = node_index;
+
+	cpu_set_t cpuset;
+	CPU_ZERO(&cpuset);
+	int i;
+	// --cpu-affinity is honoured inside the node
+	if (uwsgi.cpu_affinity > 0) {
+		int base_cpu = (((uwsgi.mywid - 1) / uwsgi.numa_nodes_cnt) * uwsgi.cpu_affinity) % node->cpus_cnt;
+		for (i = 0; i < uwsgi.cpu_affinity && i < node->cpus_cnt; i++) {
+			CPU_SET(node->cpus[(base_cpu + i) % node->cpus_cnt], &cpuset);
+		}
+	}
+	else {
+		for (i = 0; i < node->cpus_cnt; i++) {
+			CPU_SET(node->cpus[i], &cpuset);
+		}
+	}
+	if (sched_setaffinity(0, sizeof(cpu_set_t), &cpuset)) {
+		uwsgi_error("uwsgi_numa_worker()/sched_setaffinity()");
+	}
+
+	if (uwsgi.numa_nodes_cnt > 1) {
+		unsigned long mask[UWSGI_NUMA_MASK_WORDS];
+		numa_mask(mask, node);
+		if (syscall(SYS_set_mempolicy, UWSGI_MPOL_PREFERRED, mask, UWSGI_NUMA_MASK_WORDS * 8 * sizeof(unsigned long))) {
+			uwsgi_error("uwsgi_numa_worker()/set_mempolicy()");
+		}
+	}
+
+	uwsgi_log("mapping worker %d to NUMA node %d\n", uwsgi.mywid, node->id);
+#endif
+}
+
+/*
+	called by a spare becoming a worker: the memory it allocated while parked (the apps)
+	is moved to the node of the worker slot, uwsgi_numa_worker() only covers the future allocations
+*/
+void uwsgi_numa_migrate() {
+#if defined(UWSGI_NUMA) && defined(SYS_migrate_pages)
+	if (uwsgi.numa_node < 0 || uwsgi.numa_nodes_cnt < 2) return;
+	unsigned long from[UWSGI_NUMA_MASK_WORDS];
+	unsigned long to[UWSGI_NUMA_MASK_WORDS];
+	numa_mask(from, NULL);
+	numa_mask(to, &uwsgi.numa_nodes[uwsgi.numa_node]);
+	if (syscall(SYS_migrate_pages, 0, UWSGI_NUMA_MASK_WORDS * 8 * sizeof(unsigned long), from, to) < 0) {
+		uwsgi_error("uwsgi_numa_migrate()/migrate_pages()");
+	}
+#endif
+}
+
+/*
+	locality counters
+
+	the kernel accounts (in pages) allocations satisfied by the intended node (numa_hit)
+	or by another one (numa_miss), and the ones made by a process running on the node
+	(local_node) or elsewhere (other_node)
+*/
+int uwsgi_numa_stats(struct uwsgi_stats *us) {
+	if (!uwsgi.numa) return 0;
+	if (uwsgi_stats_key(us, "numa")) return -1;
+	if (uwsgi_stats_list_open(us)) return -1;
+	int i;
+	for (i = 0; i < uwsgi.numa_nodes_cnt; i++) {
+		struct uwsgi_numa_node *node = &uwsgi.numa_nodes[i];
+		unsigned long long numa_hit = 0, numa_miss = 0, local_node = 0, other_node = 0;
+#ifdef UWSGI_NUMA
+		char buf[4096];
+		char path[PATH_MAX];
+		if (snprintf(path, PATH_MAX, "/sys/devices/system/node/node%d/numastat", node->id) < PATH_MAX && !numa_read_sysfs(path, buf, sizeof(buf))) {
+			char *p, *ctx = NULL;
+			uwsgi_foreach_token(buf, "\n", p, ctx) {
+				char *space = strchr(p, ' ');
+				if (!space) continue;
+				*space = 0;
+				unsigned long long value = strtoull(space + 1, NULL, 10);
+				if (!strcmp(p, "numa_hit")) numa_hit = value;
+				else if (!strcmp(p, "numa_miss")) numa_miss = value;
+				else if (!strcmp(p, "local_node")) local_node = value;
+				else if (!strcmp(p, "other_node")) other_node = value;
+			}
+		}
+#endif
+		int workers = 0;
+		int j;
+		for (j = 1; j <= uwsgi.numproc; j++) {
+			if (uwsgi_numa_worker_node(j) == i) workers++;
+		}
+		if (uwsgi_stats_object_open(us)) return -1;
+		if (uwsgi_stats_keylong_comma(us, "node", (unsigned long long) node->id)) return -1;
+		if (uwsgi_stats_keylong_comma(us, "cpus", (unsigned long long) node->cpus_cnt)) return -1;
+		if (uwsgi_stats_keylong_comma(us, "workers", (unsigned long long) workers)) return -1;
+		if (uwsgi_stats_keylong_comma(us, "numa_hit", numa_hit)) return -1;
+		if (uwsgi_stats_keylong_comma(us, "numa_miss", numa_miss)) return -1;
+		if (uwsgi_stats_keylong_comma(us, "local_node", local_node)) return -1;
+		if (uwsgi_stats_keylong(us, "other_node", other_node)) return -1;
+		if (uwsgi_stats_object_close(us)) return -1;
+		if (i < uwsgi.numa_nodes_cnt - 1) {
+			if (uwsgi_stats_comma(us)) return -1;
+		}
+	}
+	if (uwsgi_stats_list_close(us)) return -1;
+	if (uwsgi_stats_comma(us)) return -1;
+	return 0;
+}
@@ -94,6 +94,22 @@ static int u_offload_memory_prepare(struct wsgi_request *wsgi_req, struct uwsgi_
 }
 
 
+/*
+
+	cache offload engine:
+		lease -> the cache item to transfer (the value is read directly from the cache memory)
+
+*/
+
+static int u_offload_cache_prepare(struct wsgi_request *wsgi_req, struct uwsgi_offload_request *uor) {
+
+	if (!uor->lease.cache || !uor->lease.valsize) {
+		return -1;
+	}
+	uor->len = uor->lease.valsize;
+	return 0;
+}
+
 /*
 
 	transfer offload engine:
@@ -140,8 +156,8 @@ static int u_offload_sendfile_prepare(struct wsgi_request *wsgi_req, struct uwsg
 		}
 	}
 
-	// make a fstat to get the file size
-	if (!uor->len) {
+	// make a fstat to get the file size (multipart transfers have their own sizes)
+	if (!uor->len && !uor->ubuf1) {
 		struct stat st;
 		if (fstat(uor->fd, &st)) {
 			uwsgi_error("u_offload_sendfile_prepare()/fstat()");
@@ -161,8 +177,45 @@ static int u_offload_sendfile_prepare(struct wsgi_request *wsgi_req, struct uwsg
 	return 0;
 }
 
+/*
+	every file descriptor of a task is mapped to it in a per-thread table (grown on demand),
+	so events are resolved without walking the list of running tasks.
+	The engines can change the descriptors at every step, so the table is updated after each call.
+*/
+static void uwsgi_offload_index_fd(struct uwsgi_thread *ut, int fd, struct uwsgi_offload_request *uor) {
+	if (fd < 0) return;
+	if (fd >= ut->offload_fds_size) {
+		if (!uor) return;
+		int new_size = ut->offload_fds_size ? ut->offload_fds_size : 64;
+		while (new_size <= fd) new_size *= 2;
+		struct uwsgi_offload_request **offload_fds = realloc(ut->offload_fds, sizeof(struct uwsgi_offload_request *) * new_size);
+		if (!offload_fds) {
+			uwsgi_error("uwsgi_offload_index_fd()/realloc()");
+			exit(1);
+		}
+		memset(offload_fds + ut->offload_fds_size, 0, sizeof(struct uwsgi_offload_request *) * (new_size - ut->offload_fds_size));
+		ut->offload_fds = offload_fds;
+		ut->offload_fds_size = new_size;
+	}
+	ut->offload_fds[fd] = uor;
+}
+
+static void uwsgi_offload_index(struct uwsgi_thread *ut, struct uwsgi_offload_request *uor) {
+	uwsgi_offload_index_fd(ut, uor->s, uor);
+	uwsgi_offload_index_fd(ut, uor->fd, uor);
+	uwsgi_offload_index_fd(ut, uor->fd2, uor);
+}
+
+static void uwsgi_offload_unindex(struct uwsgi_thread *ut, struct uwsgi_offload_request *uor) {
+	if (uor->s > -1 && uor->s < ut->offload_fds_size && ut->offload_fds[uor->s] == uor) ut->offload_fds[uor->s] = NULL;
+	if (uor->fd > -1 && uor->fd < ut->offload_fds_size && ut->offload_fds[uor->fd] == uor) ut->offload_fds[uor->fd] = NULL;
+	if (uor->fd2 > -1 && uor->fd2 < ut->offload_fds_size && ut->offload_fds[uor->fd2] == uor) ut->offload_fds[uor->fd2] = NULL;
+}
+
 static void uwsgi_offload_close(struct uwsgi_thread *ut, struct uwsgi_offload_request *uor) {
 
+	uwsgi_offload_unindex(ut, uor);
+
 	// call the free function asap
 	if (uor->free) {
 		uor->free(uor);
@@ -236,11 +289,19 @@ static void uwsgi_offload_close(struct uwsgi_thread *ut, struct uwsgi_offload_re
 		close(uor->pipe[0]);
 	}
 
-	free(uor);
-
 #ifdef UWSGI_DEBUG
 	uwsgi_log("[offload] destroyed session %p\n", uor);
 #endif
+
+	// keep up to offload_threads_events structures for the next tasks
+	if (ut->offload_requests_free_cnt < uwsgi.offload_threads_events) {
+		uor->next = ut->offload_requests_free;
+		ut->offload_requests_free = uor;
+		ut->offload_requests_free_cnt++;
+		return;
+	}
+
+	free(uor);
 }
 
 static void uwsgi_offload_append(struct uwsgi_thread *ut, struct uwsgi_offload_request *uor) {
@@ -258,14 +319,12 @@ static void uwsgi_offload_append(struct uwsgi_thread *ut, struct uwsgi_offload_r
 }
 
 static struct uwsgi_offload_request *uwsgi_offload_get_by_fd(struct uwsgi_thread *ut, int s) {
-	struct uwsgi_offload_request *uor = ut->offload_requests_head;
-	while (uor) {
-		if (uor->s == s || uor->fd == s || uor->fd2 == s) {
-			return uor;
-		}
-		uor = uor->next;
+	if (s < 0 || s >= ut->offload_fds_size) return NULL;
+	struct uwsgi_offload_request *uor = ut->offload_fds[s];
+	// the table could point to a task that has changed its descriptors
+	if (uor && (uor->s == s || uor->fd == s || uor->fd2 == s)) {
+		return uor;
 	}
-
 	return NULL;
 }
 
@@ -280,7 +339,14 @@ static void uwsgi_offload_loop(struct uwsgi_thread *ut) {
 		for (i = 0; i < nevents; i++) {
 			int interesting_fd = event_queue_interesting_fd(events, i);
 			if (interesting_fd == ut->pipe[1]) {
-				struct uwsgi_offload_request *uor = uwsgi_malloc(sizeof(struct uwsgi_offload_request));
+				struct uwsgi_offload_request *uor = ut->offload_requests_free;
+				if (uor) {
+					ut->offload_requests_free = uor->next;
+					ut->offload_requests_free_cnt--;
+				}
+				else {
+					uor = uwsgi_malloc(sizeof(struct uwsgi_offload_request));
+				}
 				ssize_t len = read(ut->pipe[1], uor, sizeof(struct uwsgi_offload_request));
 				if (len != sizeof(struct uwsgi_offload_request)) {
 					uwsgi_error("read()");
@@ -293,6 +359,7 @@ static void uwsgi_offload_loop(struct uwsgi_thread *ut) {
 					continue;
 				}
 				uwsgi_offload_append(ut, uor);
+				uwsgi_offload_index(ut, uor);
 				continue;
 			}
 
@@ -303,7 +370,9 @@ static void uwsgi_offload_loop(struct uwsgi_thread *ut) {
 			// run the hook
 			if (uor->engine->event_func(ut, uor, interesting_fd)) {
 				uwsgi_offload_close(ut, uor);
+				continue;
 			}
+			uwsgi_offload_index(ut, uor);
 		}
 	}
 }
@@ -345,6 +414,43 @@ static int u_offload_memory_do(struct uwsgi_thread *ut, struct uwsgi_offload_req
 }
 
 
+/*
+
+	the value is written in chunks under the cache read lock,
+	if the item changes in the middle of the transfer the connection is closed
+
+*/
+
+static int u_offload_cache_do(struct uwsgi_thread *ut, struct uwsgi_offload_request *uor, int fd) {
+	if (fd == -1) {
+		if (event_queue_add_fd_write(ut->queue, uor->s)) return -1;
+		return 0;
+	}
+	size_t remains = uor->len - uor->written;
+	if (remains > 128 * 1024) remains = 128 * 1024;
+	uwsgi_rlock(uor->lease.cache->lock);
+	char *value = uwsgi_cache_lease_value(&uor->lease);
+	if (!value) {
+		uwsgi_rwunlock(uor->lease.cache->lock);
+		uwsgi_log("[offload] cache item changed during the transfer, closing the connection\n");
+		return -1;
+	}
+	ssize_t rlen = write(uor->s, value + uor->written, remains);
+	uwsgi_rwunlock(uor->lease.cache->lock);
+	if (rlen > 0) {
+		uor->written += rlen;
+		if (uor->written >= uor->len) {
+			return -1;
+		}
+		return 0;
+	}
+	else if (rlen < 0) {
+		uwsgi_offload_retry
+		uwsgi_error("u_offload_cache_do()");
+	}
+	return -1;
+}
+
 /*
 
 the offload task starts after having acquired the file fd
@@ -352,50 +458,105 @@ the offload task starts after having acquired the file fd
 	uor->len -> the size of the file
 	uor->pos -> start writing from pos (default 0)
 
-	status: none
+	multipart (multiple ranges) transfers:
 
-*/
+	uor->ubuf -> the memory parts (boundaries)
+	uor->ubuf1 -> array of struct uwsgi_sendfile_segment (a memory part followed by a file range)
+	uor->custom1 -> current segment
+	uor->custom2 -> bytes of the memory part already written
 
-static int u_offload_sendfile_do(struct uwsgi_thread *ut, struct uwsgi_offload_request *uor, int fd) {
+	status:
+		0 -> writing the memory part of the current segment
+		1 -> sending the file range of the current segment
 
-	if (fd == -1) {
-		if (event_queue_add_fd_write(ut->queue, uor->fd2)) return -1;
-		return 0;
-	}
+*/
+
+// returns 1 when the range is fully sent, 0 when the socket is not ready, -1 on error
+static int u_offload_sendfile_range(struct uwsgi_offload_request *uor) {
+	size_t remains = uor->len - uor->written;
+	if (remains == 0) return 1;
+	if (remains > 128 * 1024) remains = 128 * 1024;
 #if defined(__linux__) || defined(__sun__) || defined(__GNU_kFreeBSD__)
-	ssize_t len = sendfile(uor->fd2, uor->fd, &uor->pos, 128 * 1024);
+	ssize_t len = sendfile(uor->fd2, uor->fd, &uor->pos, remains);
 	if (len > 0) {
-        	uor->written += len;
-                if (uor->written >= uor->len) {
-			return -1;
-		}
-		return 0;
+		uor->written += len;
+		return uor->written >= uor->len;
 	}
-        else if (len < 0) {
+	else if (len < 0) {
 		uwsgi_offload_retry
-                uwsgi_error("u_offload_sendfile_do()");
+		uwsgi_error("u_offload_sendfile_do()");
 	}
 #elif defined(__FreeBSD__) || defined(__DragonFly__)
 	off_t sbytes = 0;
-	int ret = sendfile(uor->fd, uor->fd2, uor->pos, 0, NULL, &sbytes, 0);
-	// transfer finished
+	int ret = sendfile(uor->fd, uor->fd2, uor->pos, remains, NULL, &sbytes, 0);
+	uor->pos += sbytes;
+	uor->written += sbytes;
+	if (ret == 0 && sbytes > 0) {
+		return uor->written >= uor->len;
+	}
 	if (ret == -1) {
-		uor->pos += sbytes;
 		uwsgi_offload_retry
-                uwsgi_error("u_offload_sendfile_do()");
+		uwsgi_error("u_offload_sendfile_do()");
 	}
 #elif defined(__APPLE__) && !defined(NO_SENDFILE)
-	off_t len = 0;
-        int ret = sendfile(uor->fd, uor->fd2, uor->pos, &len, NULL, 0);
-        // transfer finished
-        if (ret == -1) {
-                uor->pos += len;
-                uwsgi_offload_retry
-                uwsgi_error("u_offload_sendfile_do()");
-        }
+	off_t len = remains;
+	int ret = sendfile(uor->fd, uor->fd2, uor->pos, &len, NULL, 0);
+	uor->pos += len;
+	uor->written += len;
+	if (ret == 0 && len > 0) {
+		return uor->written >= uor->len;
+	}
+	if (ret == -1) {
+		uwsgi_offload_retry
+		uwsgi_error("u_offload_sendfile_do()");
+	}
 #endif
 	return -1;
+}
+
+static int u_offload_sendfile_do(struct uwsgi_thread *ut, struct uwsgi_offload_request *uor, int fd) {
 
+	if (fd == -1) {
+		if (event_queue_add_fd_write(ut->queue, uor->fd2)) return -1;
+		return 0;
+	}
+
+	if (!uor->ubuf1) {
+		if (u_offload_sendfile_range(uor) == 0) return 0;
+		return -1;
+	}
+
+	struct uwsgi_sendfile_segment *segments = (struct uwsgi_sendfile_segment *) uor->ubuf1->buf;
+	int64_t n = uor->ubuf1->pos / sizeof(struct uwsgi_sendfile_segment);
+	while (uor->custom1 < n) {
+		struct uwsgi_sendfile_segment *uss = &segments[uor->custom1];
+		if (uor->status == 0) {
+			if (uor->custom2 < (int64_t) uss->header_len) {
+				ssize_t wlen = write(uor->fd2, uor->ubuf->buf + uss->header_pos + uor->custom2, uss->header_len - uor->custom2);
+				if (wlen <= 0) {
+					if (wlen < 0) {
+						uwsgi_offload_retry
+						uwsgi_error("u_offload_sendfile_do()/write()");
+					}
+					return -1;
+				}
+				uor->custom2 += wlen;
+				if (uor->custom2 < (int64_t) uss->header_len) return 0;
+			}
+			uor->status = 1;
+			uor->pos = uss->pos;
+			uor->len = uss->len;
+			uor->written = 0;
+		}
+		int ret = u_offload_sendfile_range(uor);
+		if (ret < 0) return -1;
+		if (ret == 0) return 0;
+		// next segment
+		uor->custom1++;
+		uor->custom2 = 0;
+		uor->status = 0;
+	}
+	return -1;
 }
 
 /*
@@ -595,6 +756,253 @@ static int u_offload_transfer_do(struct uwsgi_thread *ut, struct uwsgi_offload_r
 	return -1;
 }
 
+/*
+
+	http offload engine:
+		name -> upstream address
+		ubuf -> the whole http request (body included)
+		http_remove -> response headers to remove
+		http_replace -> response headers to replace (or add if missing)
+		http_add -> response headers to add
+
+	hop-by-hop headers are dropped and "Connection: close" is added (the client connection
+	is closed at the end of the transfer), Content-Length is dropped if the response is chunked
+
+*/
+
+static int u_offload_http_prepare(struct wsgi_request *wsgi_req, struct uwsgi_offload_request *uor) {
+
+	if (!uor->name || !uor->ubuf) {
+		return -1;
+	}
+
+	uor->fd = uwsgi_connect(uor->name, 0, 1);
+	if (uor->fd < 0) {
+		uwsgi_error("u_offload_http_prepare()/connect()");
+		return -1;
+	}
+
+	return 0;
+}
+
+static int u_offload_http_header_is(char *line, size_t len, char *name, size_t name_len) {
+	if (len <= name_len || line[name_len] != ':') return 0;
+	return !strncasecmp(line, name, name_len);
+}
+
+static int u_offload_http_header_in(struct uwsgi_string_list *usl, char *line, size_t len) {
+	while(usl) {
+		if (u_offload_http_header_is(line, len, usl->value, usl->custom)) return 1;
+		usl = usl->next;
+	}
+	return 0;
+}
+
+// headers_len includes the final empty line
+static struct uwsgi_buffer *u_offload_http_rewrite(struct uwsgi_offload_request *uor, char *buf, size_t headers_len) {
+	struct uwsgi_buffer *ub = uwsgi_buffer_new(headers_len + 256);
+	int chunked = 0;
+	size_t i, base = 0;
+	// first round, check for chunked encoding
+	for(i=0;i<headers_len;i++) {
+		if (buf[i] != '\n') continue;
+		if (u_offload_http_header_is(buf + base, i - base, "Transfer-Encoding", 17)) chunked = 1;
+		base = i + 1;
+	}
+
+	base = 0;
+	int status_line = 1;
+	for(i=0;i<headers_len;i++) {
+		if (buf[i] != '\n') continue;
+		char *line = buf + base;
+		size_t len = i - base;
+		base = i + 1;
+		if (len > 0 && line[len-1] == '\r') len--;
+		// the final empty line
+		if (len == 0) break;
+		if (!status_line) {
+			if (u_offload_http_header_is(line, len, "Connection", 10)) continue;
+			if (u_offload_http_header_is(line, len, "Keep-Alive", 10)) continue;
+			if (u_offload_http_header_is(line, len, "Proxy-Connection", 16)) continue;
+			if (chunked && u_offload_http_header_is(line, len, "Content-Length", 14)) continue;
+			if (u_offload_http_header_in(uor->http_remove, line, len)) continue;
+			if (u_offload_http_header_in(uor->http_replace, line, len)) continue;
+		}
+		status_line = 0;
+		if (uwsgi_buffer_append(ub, line, len)) goto error;
+		if (uwsgi_buffer_append(ub, "\r\n", 2)) goto error;
+	}
+
+	struct uwsgi_string_list *usl = uor->http_replace;
+	while(usl) {
+		if (uwsgi_buffer_append(ub, usl->value, usl->len)) goto error;
+		if (uwsgi_buffer_append(ub, "\r\n", 2)) goto error;
+		usl = usl->next;
+	}
+	usl = uor->http_add;
+	while(usl) {
+		if (uwsgi_buffer_append(ub, usl->value, usl->len)) goto error;
+		if (uwsgi_buffer_append(ub, "\r\n", 2)) goto error;
+		usl = usl->next;
+	}
+	if (uwsgi_buffer_append(ub, "Connection: close\r\n\r\n", 21)) goto error;
+	return ub;
+error:
+	uwsgi_buffer_destroy(ub);
+	return NULL;
+}
+
+// returns the size of the headers (empty line included) or 0 if they are not complete
+static size_t u_offload_http_headers_len(struct uwsgi_buffer *ub) {
+	size_t i;
+	for(i=3;i<ub->pos;i++) {
+		if (ub->buf[i] == '\n' && ub->buf[i-1] == '\r' && ub->buf[i-2] == '\n' && ub->buf[i-3] == '\r') {
+			return i + 1;
+		}
+	}
+	return 0;
+}
+
+/*
+	status:
+		0 -> waiting for connection on fd
+		1 -> sending request to fd (write event)
+		2 -> reading response headers from fd (in ubuf1)
+		3 -> writing the rewritten headers (ubuf2) to s
+		4 -> waiting for body on fd
+		5 -> write body to s
+*/
+static int u_offload_http_do(struct uwsgi_thread *ut, struct uwsgi_offload_request *uor, int fd) {
+
+	ssize_t rlen;
+
+	// setup
+	if (fd == -1) {
+		event_queue_add_fd_write(ut->queue, uor->fd);
+		return 0;
+	}
+
+	switch(uor->status) {
+		// waiting for connection
+		case 0:
+			if (fd == uor->fd) {
+				uor->status = 1;
+				return u_offload_http_do(ut, uor, fd);
+			}
+			return -1;
+		// write event (or just connected)
+		case 1:
+			if (fd != uor->fd) return -1;
+			rlen = write(uor->fd, uor->ubuf->buf + uor->written, uor->ubuf->pos - uor->written);
+			if (rlen > 0) {
+				uor->written += rlen;
+				if (uor->written >= (size_t)uor->ubuf->pos) {
+					uor->status = 2;
+					if (event_queue_fd_write_to_read(ut->queue, uor->fd)) return -1;
+				}
+				return 0;
+			}
+			else if (rlen < 0) {
+				uwsgi_offload_retry
+				uwsgi_error("u_offload_http_do() -> write()/fd");
+			}
+			return -1;
+		// read response headers
+		case 2:
+			if (fd != uor->fd) return -1;
+			if (!uor->ubuf1) {
+				uor->ubuf1 = uwsgi_buffer_new(4096);
+			}
+			if (uwsgi_buffer_ensure(uor->ubuf1, 4096)) return -1;
+			rlen = read(uor->fd, uor->ubuf1->buf + uor->ubuf1->pos, 4096);
+			if (rlen > 0) {
+				uor->ubuf1->pos += rlen;
+				size_t headers_len = u_offload_http_headers_len(uor->ubuf1);
+				if (!headers_len) {
+					if (uor->ubuf1->pos > UMAX16) {
+						uwsgi_log("[offload] too big http response headers\n");
+						return -1;
+					}
+					return 0;
+				}
+				uor->ubuf2 = u_offload_http_rewrite(uor, uor->ubuf1->buf, headers_len);
+				if (!uor->ubuf2) return -1;
+				// the body already received
+				if (uwsgi_buffer_append(uor->ubuf2, uor->ubuf1->buf + headers_len, uor->ubuf1->pos - headers_len)) return -1;
+				uor->written = 0;
+				if (event_queue_del_fd(ut->queue, uor->fd, event_queue_read())) return -1;
+				if (event_queue_add_fd_write(ut->queue, uor->s)) return -1;
+				uor->status = 3;
+				return 0;
+			}
+			if (rlen < 0) {
+				uwsgi_offload_retry
+				uwsgi_error("u_offload_http_do() -> read()/fd");
+			}
+			return -1;
+		// write headers to s
+		case 3:
+			rlen = write(uor->s, uor->ubuf2->buf + uor->written, uor->ubuf2->pos - uor->written);
+			if (rlen > 0) {
+				uor->written += rlen;
+				if (uor->written >= (size_t)uor->ubuf2->pos) {
+					if (event_queue_del_fd(ut->queue, uor->s, event_queue_write())) return -1;
+					if (event_queue_add_fd_read(ut->queue, uor->fd)) return -1;
+					uor->status = 4;
+				}
+				return 0;
+			}
+			else if (rlen < 0) {
+				uwsgi_offload_retry
+				uwsgi_error("u_offload_http_do() -> write()/s");
+			}
+			return -1;
+		// read body from fd
+		case 4:
+			if (fd != uor->fd) return -1;
+			if (!uor->buf) {
+				uor->buf = uwsgi_malloc(32768);
+			}
+			rlen = read(uor->fd, uor->buf, 32768);
+			if (rlen > 0) {
+				uor->to_write = rlen;
+				uor->pos = 0;
+				if (event_queue_del_fd(ut->queue, uor->fd, event_queue_read())) return -1;
+				if (event_queue_add_fd_write(ut->queue, uor->s)) return -1;
+				uor->status = 5;
+				return 0;
+			}
+			if (rlen < 0) {
+				uwsgi_offload_retry
+				uwsgi_error("u_offload_http_do() -> read()/fd");
+			}
+			// end of the response
+			return -1;
+		// write body to s
+		case 5:
+			rlen = write(uor->s, uor->buf + uor->pos, uor->to_write);
+			if (rlen > 0) {
+				uor->to_write -= rlen;
+				uor->pos += rlen;
+				if (uor->to_write == 0) {
+					if (event_queue_del_fd(ut->queue, uor->s, event_queue_write())) return -1;
+					if (event_queue_add_fd_read(ut->queue, uor->fd)) return -1;
+					uor->status = 4;
+				}
+				return 0;
+			}
+			else if (rlen < 0) {
+				uwsgi_offload_retry
+				uwsgi_error("u_offload_http_do() -> write()/s");
+			}
+			return -1;
+		default:
+			break;
+	}
+
+	return -1;
+}
+
 int uwsgi_offload_run(struct wsgi_request *wsgi_req, struct uwsgi_offload_request *uor, int *wait) {
 
 	if (uor->engine->prepare_func(wsgi_req, uor)) {
@@ -672,16 +1080,33 @@ void uwsgi_offload_engines_register_all() {
 	uwsgi.offload_engine_transfer = uwsgi_offload_register_engine("transfer", u_offload_transfer_prepare, u_offload_transfer_do);
 	uwsgi.offload_engine_memory = uwsgi_offload_register_engine("memory", u_offload_memory_prepare, u_offload_memory_do);
 	uwsgi.offload_engine_pipe = uwsgi_offload_register_engine("pipe", u_offload_pipe_prepare, u_offload_pipe_do);
+	uwsgi.offload_engine_cache = uwsgi_offload_register_engine("cache", u_offload_cache_prepare, u_offload_cache_do);
+	uwsgi.offload_engine_http = uwsgi_offload_register_engine("http", u_offload_http_prepare, u_offload_http_do);
 }
 
 int uwsgi_offload_request_sendfile_do(struct wsgi_request *wsgi_req, int fd, size_t len) {
+	return uwsgi_offload_request_sendfile_range_do(wsgi_req, fd, 0, len);
+}
+
+int uwsgi_offload_request_sendfile_range_do(struct wsgi_request *wsgi_req, int fd, size_t pos, size_t len) {
 	struct uwsgi_offload_request uor;
 	uwsgi_offload_setup(uwsgi.offload_engine_sendfile, &uor, wsgi_req, 1);
 	uor.fd = fd;
+	uor.pos = pos;
 	uor.len = len;
 	return uwsgi_offload_run(wsgi_req, &uor, NULL);
 }
 
+// ubuf (the memory parts) and segments are destroyed at the end of the task
+int uwsgi_offload_request_sendfile_segments_do(struct wsgi_request *wsgi_req, int fd, struct uwsgi_buffer *ubuf, struct uwsgi_buffer *segments) {
+	struct uwsgi_offload_request uor;
+	uwsgi_offload_setup(uwsgi.offload_engine_sendfile, &uor, wsgi_req, 1);
+	uor.fd = fd;
+	uor.ubuf = ubuf;
+	uor.ubuf1 = segments;
+	return uwsgi_offload_run(wsgi_req, &uor, NULL);
+}
+
 int uwsgi_offload_request_net_do(struct wsgi_request *wsgi_req, char *socketname, struct uwsgi_buffer *ubuf) {
 	struct uwsgi_offload_request uor;
 	uwsgi_offload_setup(uwsgi.offload_engine_transfer, &uor, wsgi_req, 1);
@@ -705,3 +1130,21 @@ int uwsgi_offload_request_pipe_do(struct wsgi_request *wsgi_req, int fd, size_t
         uor.len = len;
         return uwsgi_offload_run(wsgi_req, &uor, NULL);
 }
+
+int uwsgi_offload_request_cache_do(struct wsgi_request *wsgi_req, struct uwsgi_cache_lease *ucl) {
+        struct uwsgi_offload_request uor;
+        uwsgi_offload_setup(uwsgi.offload_engine_cache, &uor, wsgi_req, 1);
+        memcpy(&uor.lease, ucl, sizeof(struct uwsgi_cache_lease));
+        return uwsgi_offload_run(wsgi_req, &uor, NULL);
+}
+
+int uwsgi_offload_request_http_do(struct wsgi_request *wsgi_req, char *socketname, struct uwsgi_buffer *ubuf, struct uwsgi_string_list *remove, struct uwsgi_string_list *replace, struct uwsgi_string_list *add) {
+	struct uwsgi_offload_request uor;
+	uwsgi_offload_setup(uwsgi.offload_engine_http, &uor, wsgi_req, 1);
+	uor.name = socketname;
+	uor.ubuf = ubuf;
+	uor.http_remove = remove;
+	uor.http_replace = replace;
+	uor.http_add = add;
+	return uwsgi_offload_run(wsgi_req, &uor, NULL);
+}
@@ -228,38 +228,11 @@ static int uwsgi_proto_check_9(struct wsgi_request *wsgi_req, char *key, char *b
 	return 0;
 }
 
-static void uwsgi_parse_http_range(char *buf, uint16_t len, size_t *from, size_t *to) {
-	*from = 0;
-	*to = 0;
-	uint16_t rlen = 0;
-	uint16_t i;
-	for(i=0;i<len;i++) {
-		if (buf[i] == ',') break;
-		rlen++;
-	}
-
-	// bytes=X-
-	if (rlen < 8) return;
-	char *equal = memchr(buf, '=', rlen);
-	if (!equal) return;
-	if (equal-buf != 5) return;
-	if (memcmp(buf, "bytes", 5)) return;
-	char *range = equal+1;
-	rlen -= 6;
-	char *dash = memchr(range, '-', rlen);
-	if (!dash) return;
-	*from = uwsgi_str_num(range, dash-range);
-	*to = uwsgi_str_num(dash+1, rlen - ((dash+1)-range));
-	if (*to > 0 && *from > *to) {
-		*from = 0;
-		*to = 0;
-	}
-}
-
 static int uwsgi_proto_check_10(struct wsgi_request *wsgi_req, char *key, char *buf, uint16_t len) {
 
 	if (uwsgi.honour_range && !uwsgi_proto_key("HTTP_RANGE", 10)) {
-		uwsgi_parse_http_range(buf, len, &wsgi_req->range_from, &wsgi_req->range_to);
+		wsgi_req->http_range = buf;
+		wsgi_req->http_range_len = len;
 		return 0;
 	}
 
@@ -450,6 +423,11 @@ static int uwsgi_proto_check_14(struct wsgi_request *wsgi_req, char *key, char *
 		return 0;
 	}
 
+	if (!uwsgi_proto_key("UWSGI_DEADLINE", 14)) {
+		wsgi_req->deadline = uwsgi_str_num(buf, len);
+		return 0;
+	}
+
 	return 0;
 }
 
@@ -568,6 +546,14 @@ void uwsgi_proto_hooks_setup() {
 }
 
 
+// milliseconds left before the request deadline, -1 if the request has no deadline
+int64_t uwsgi_request_deadline_left(struct wsgi_request *wsgi_req) {
+	if (!wsgi_req->deadline) return -1;
+	uint64_t now = uwsgi_millis();
+	if (now >= wsgi_req->deadline) return 0;
+	return wsgi_req->deadline - now;
+}
+
 int uwsgi_parse_vars(struct wsgi_request *wsgi_req) {
 
 	char *buffer = wsgi_req->buffer;
@@ -675,6 +661,13 @@ int uwsgi_parse_vars(struct wsgi_request *wsgi_req) {
 
 next:
 
+	// the router gave up on this request while it was queued, do not waste the app on it
+	if (wsgi_req->deadline && uwsgi_millis() >= wsgi_req->deadline) {
+		uwsgi.workers[uwsgi.mywid].expired++;
+		uwsgi_503(wsgi_req);
+		return -1;
+	}
+
 	// manage post buffering (if needed as post_file could be created before)
 	if (uwsgi.post_buffering > 0 && !wsgi_req->post_file) {
 		// read to disk if post_cl > post_buffering (it will eventually do upload progress...)
@@ -98,38 +98,35 @@ static void rpc_context_hook(char *key, uint16_t kl, char *value, uint16_t vl, v
 	}
 }
 
-char *uwsgi_do_rpc(char *node, char *func, uint8_t argc, char *argv[], uint16_t argvs[], uint64_t * len) {
-
-	uint8_t i;
-	uint16_t ulen;
-	struct uwsgi_header *uh = NULL;
-	char *buffer = NULL;
-
-	*len = 0;
-
-	if (node == NULL || !strcmp(node, "")) {
-		// allocate the whole buffer
-		if (!uwsgi.rpc_table) {
-                	uwsgi_log("local rpc subsystem is still not initialized !!!\n");
-                	return NULL;
-        	}
-		*len = uwsgi_rpc(func, argc, argv, argvs, &buffer);
-		if (buffer)
-			return buffer;
-		return NULL;
-	}
+/*
+	remote rpc calls are split in phases, so multiple calls can be in flight
+	(start all of the connections, send all of the requests, then collect the responses)
+*/
 
+// connect to the node and send the request, returns the fd to pass to uwsgi_rpc_remote_finish()
+int uwsgi_rpc_remote_start(char *node, char *func, uint8_t argc, char *argv[], uint16_t argvs[]) {
 
 	// connect to node (async way)
 	int fd = uwsgi_connect(node, 0, 1);
 	if (fd < 0)
-		return NULL;
+		return -1;
+
+	return uwsgi_rpc_remote_send(fd, func, argc, argv, argvs);
+}
+
+// wait for the (non-blocking) connection and send the request, the fd is closed on error
+int uwsgi_rpc_remote_send(int fd, char *func, uint8_t argc, char *argv[], uint16_t argvs[]) {
+
+	uint8_t i;
+	uint16_t ulen;
+	struct uwsgi_header *uh = NULL;
+	char *buffer = NULL;
 
 	// wait for connection;
-	int ret = uwsgi.wait_write_hook(fd, uwsgi.socket_timeout);
+	int ret = uwsgi_wait_write_ms(fd, uwsgi.socket_timeout_ms);
 	if (ret <= 0) {
 		close(fd);
-		return NULL;
+		return -1;
 	}
 
 	// prepare a uwsgi array
@@ -166,11 +163,23 @@ char *uwsgi_do_rpc(char *node, char *func, uint8_t argc, char *argv[], uint16_t
 
 	// ok the request is ready, let's send it in non blocking way
 	if (uwsgi_write_true_nb(fd, buffer, buffer_size+4, uwsgi.socket_timeout)) {
-		goto error;
+		free(buffer);
+		close(fd);
+		return -1;
 	}
 
+	free(buffer);
+	return fd;
+}
+
+// wait for the response of a remote call (fd is closed)
+char *uwsgi_rpc_remote_finish(int fd, uint64_t *len) {
+
+	*len = 0;
+
 	// ok time to wait for the response in non blocking way
-	size_t rlen = buffer_size+4;
+	size_t rlen = uwsgi.page_size;
+	char *buffer = uwsgi_malloc(rlen);
 	uint8_t modifier2 = 0;
 	if (uwsgi_read_with_realloc(fd, &buffer, &rlen, uwsgi.socket_timeout, NULL, &modifier2)) {
 		goto error;
@@ -207,11 +216,35 @@ error:
 error2:
 	free(buffer);
 	return NULL;
+}
+
+char *uwsgi_do_rpc(char *node, char *func, uint8_t argc, char *argv[], uint16_t argvs[], uint64_t * len) {
+
+	char *buffer = NULL;
+
+	*len = 0;
+
+	if (node == NULL || !strcmp(node, "")) {
+		// allocate the whole buffer
+		if (!uwsgi.rpc_table) {
+                	uwsgi_log("local rpc subsystem is still not initialized !!!\n");
+                	return NULL;
+        	}
+		*len = uwsgi_rpc(func, argc, argv, argvs, &buffer);
+		if (buffer)
+			return buffer;
+		return NULL;
+	}
+
+	int fd = uwsgi_rpc_remote_start(node, func, argc, argv, argvs);
+	if (fd < 0)
+		return NULL;
 
+	return uwsgi_rpc_remote_finish(fd, len);
 }
 
 
 void uwsgi_rpc_init() {
-	uwsgi.rpc_table = uwsgi_calloc_shared((sizeof(struct uwsgi_rpc) * uwsgi.rpc_max) * (uwsgi.numproc+1));
-	uwsgi.shared->rpc_count = uwsgi_calloc_shared(sizeof(uint64_t) * (uwsgi.numproc+1));
+	uwsgi.rpc_table = uwsgi_calloc_shared((sizeof(struct uwsgi_rpc) * uwsgi.rpc_max) * uwsgi_spare_slots());
+	uwsgi.shared->rpc_count = uwsgi_calloc_shared(sizeof(uint64_t) * uwsgi_spare_slots());
 }
@@ -0,0 +1,407 @@
+#include <uwsgi.h>
+
+extern struct uwsgi_server uwsgi;
+
+/*
+
+	work-stealing scheduler for multithreaded workers (--thread-scheduler)
+
+	instead of having every thread waiting on the sockets, a single acceptor thread
+	accepts connections and distributes them to per-thread deques (preferring idle threads,
+	round robin otherwise). Only the thread owning the deque is woken (every thread has its
+	own pipe), it takes the first connection of its deque or steals the first one of the busiest
+	deque of its siblings. Threads look for work before going to sleep, so a long request does not
+	block the connections queued behind it. The TLS setup is done by the thread serving the connection.
+
+	Connections whose first bytes match a --thread-scheduler-priority regexp are put in
+	front of the least loaded deque. The bytes are peeked right after accept(), so this relies
+	on TCP_DEFER_ACCEPT (set on tcp sockets unless --no-defer-accept): without it the request
+	has generally not arrived yet and the connection is queued normally.
+	The acceptor stops accepting when --thread-scheduler-queue connections are already waiting,
+	leaving the others in the listen queue for the other workers.
+
+	When the worker is going away the acceptor is stopped first, then the threads serve
+	the connections still in the deques (stealing from each other) before exiting.
+
+*/
+
+struct uwsgi_sched_conn {
+	int fd;
+	struct uwsgi_socket *socket;
+	struct sockaddr_un c_addr;
+	int c_len;
+};
+
+struct uwsgi_sched_deque {
+	pthread_mutex_t lock;
+	struct uwsgi_sched_conn *items;
+	int head;
+	int count;
+	// the owner thread is waiting for connections
+	int idle;
+	int pipe[2];
+};
+
+static struct uwsgi_sched {
+	struct uwsgi_sched_deque *deques;
+	int size;
+	int next;
+	// the acceptor waits here for a free slot
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	int queued;
+	pthread_t acceptor;
+	// wakes up the acceptor when the worker is going away
+	int stop_pipe[2];
+	pthread_mutex_t stop_lock;
+	int stopped;
+} sched;
+
+static void sched_deque_push(struct uwsgi_sched_deque *d, struct uwsgi_sched_conn *conn, int front) {
+	if (front) {
+		d->head = (d->head + sched.size - 1) % sched.size;
+		d->items[d->head] = *conn;
+	}
+	else {
+		d->items[(d->head + d->count) % sched.size] = *conn;
+	}
+	d->count++;
+}
+
+static int sched_deque_pop(struct uwsgi_sched_deque *d, struct uwsgi_sched_conn *conn) {
+	int ret = 0;
+	pthread_mutex_lock(&d->lock);
+	if (d->count > 0) {
+		*conn = d->items[d->head];
+		d->head = (d->head + 1) % sched.size;
+		d->count--;
+		ret = 1;
+	}
+	pthread_mutex_unlock(&d->lock);
+	return ret;
+}
+
+#ifdef UWSGI_PCRE
+static int sched_is_priority(struct uwsgi_sched_conn *conn) {
+	if (!uwsgi.thread_sched_priority) return 0;
+#ifdef UWSGI_SSL
+	// encrypted, nothing to look at
+	if (conn->socket->ssl_ctx) return 0;
+#endif
+	char buf[4096];
+	ssize_t len = recv(conn->fd, buf, 4096, MSG_PEEK | MSG_DONTWAIT);
+	if (len <= 0) return 0;
+	struct uwsgi_regexp_list *url = uwsgi.thread_sched_priority;
+	while(url) {
+		if (uwsgi_regexp_match(url->pattern, url->pattern_extra, buf, len) >= 0) return 1;
+		url = url->next;
+	}
+	return 0;
+}
+#endif
+
+static void sched_push(struct uwsgi_sched_conn *conn) {
+	struct uwsgi_sched_deque *d = NULL;
+	int front = 0;
+	int i;
+#ifdef UWSGI_PCRE
+	if (sched_is_priority(conn)) {
+		// jump the queue of the least loaded thread
+		int min = -1;
+		for (i = 0; i < uwsgi.threads; i++) {
+			if (min == -1 || sched.deques[i].count < min) {
+				min = sched.deques[i].count;
+				d = &sched.deques[i];
+			}
+		}
+		front = 1;
+		__atomic_add_fetch(&uwsgi.workers[uwsgi.mywid].sched_prioritized, 1, __ATOMIC_RELAXED);
+	}
+#endif
+	// the first idle thread (starting from the round robin one)
+	for (i = 0; !d && i < uwsgi.threads; i++) {
+		int id = (sched.next + i) % uwsgi.threads;
+		if (__atomic_load_n(&sched.deques[id].idle, __ATOMIC_ACQUIRE)) {
+			d = &sched.deques[id];
+		}
+	}
+	if (!d) {
+		d = &sched.deques[sched.next];
+	}
+	sched.next = ((d - sched.deques) + 1) % uwsgi.threads;
+
+	pthread_mutex_lock(&d->lock);
+	sched_deque_push(d, conn, front);
+	pthread_mutex_unlock(&d->lock);
+
+	// wake up the owner
+	if (write(d->pipe[1], "x", 1) != 1) {
+		uwsgi_error("sched_push()/write()");
+	}
+}
+
+// get a connection from the deque of the thread or from the busiest one (returns 0 if there is no work)
+static int sched_take(int core_id, struct uwsgi_sched_conn *conn) {
+	if (!sched_deque_pop(&sched.deques[core_id], conn)) {
+		// steal from the busiest sibling
+		int i, victim = -1, max = 0;
+		for (i = 0; i < uwsgi.threads; i++) {
+			if (i == core_id) continue;
+			if (sched.deques[i].count > max) {
+				max = sched.deques[i].count;
+				victim = i;
+			}
+		}
+		if (victim < 0 || !sched_deque_pop(&sched.deques[victim], conn)) {
+			// raced with another thief, look at every deque before giving up
+			for (i = 0; i < uwsgi.threads; i++) {
+				if (i != core_id && sched_deque_pop(&sched.deques[i], conn)) break;
+			}
+			if (i >= uwsgi.threads) return 0;
+		}
+		__atomic_add_fetch(&uwsgi.workers[uwsgi.mywid].sched_stolen, 1, __ATOMIC_RELAXED);
+	}
+
+	pthread_mutex_lock(&sched.lock);
+	sched.queued--;
+	pthread_cond_signal(&sched.cond);
+	pthread_mutex_unlock(&sched.lock);
+	return 1;
+}
+
+static void *sched_acceptor(void *arg) {
+	sigset_t smask;
+	sigfillset(&smask);
+	pthread_sigmask(SIG_BLOCK, &smask, NULL);
+
+	int queue = event_queue_init();
+	struct uwsgi_socket *uwsgi_sock = uwsgi.sockets;
+	while(uwsgi_sock) {
+		if (uwsgi_sock->fd > -1) {
+			event_queue_add_fd_read(queue, uwsgi_sock->fd);
+		}
+		uwsgi_sock = uwsgi_sock->next;
+	}
+	event_queue_add_fd_read(queue, sched.stop_pipe[0]);
+
+	// only used for the accept hooks, the batch accept and the per-thread keepalive are skipped
+	struct wsgi_request *wsgi_req = uwsgi_calloc(sizeof(struct wsgi_request));
+	wsgi_req->async_id = -1;
+
+	while (uwsgi.workers[uwsgi.mywid].manage_next_request) {
+		pthread_mutex_lock(&sched.lock);
+		while (sched.queued >= uwsgi.thread_sched_queue && uwsgi.workers[uwsgi.mywid].manage_next_request) {
+			pthread_cond_wait(&sched.cond, &sched.lock);
+		}
+		pthread_mutex_unlock(&sched.lock);
+
+		int interesting_fd = -1;
+		if (event_queue_wait(queue, -1, &interesting_fd) <= 0) continue;
+		if (interesting_fd == sched.stop_pipe[0]) break;
+
+		uwsgi_sock = uwsgi.sockets;
+		while(uwsgi_sock) {
+			if (interesting_fd == uwsgi_sock->fd) break;
+			uwsgi_sock = uwsgi_sock->next;
+		}
+		if (!uwsgi_sock) continue;
+
+		wsgi_req->socket = uwsgi_sock;
+		// the TLS session is created by the thread serving the connection
+		int fd = uwsgi_proto_base_accept(wsgi_req, interesting_fd);
+		if (fd < 0) continue;
+
+		struct uwsgi_sched_conn conn;
+		conn.fd = fd;
+		conn.socket = uwsgi_sock;
+		memcpy(&conn.c_addr, &wsgi_req->c_addr, sizeof(struct sockaddr_un));
+		conn.c_len = wsgi_req->c_len;
+		pthread_mutex_lock(&sched.lock);
+		sched.queued++;
+		pthread_mutex_unlock(&sched.lock);
+
+		sched_push(&conn);
+	}
+	return NULL;
+}
+
+void uwsgi_sched_init() {
+	int i;
+	struct uwsgi_socket *uwsgi_sock = uwsgi.sockets;
+	while(uwsgi_sock) {
+		if (uwsgi_sock->edge_trigger) {
+			uwsgi_log("--thread-scheduler does not support edge triggered sockets\n");
+			exit(1);
+		}
+		uwsgi_sock = uwsgi_sock->next;
+	}
+
+	sched.size = uwsgi.thread_sched_queue;
+	sched.deques = uwsgi_calloc(sizeof(struct uwsgi_sched_deque) * uwsgi.threads);
+	for (i = 0; i < uwsgi.threads; i++) {
+		pthread_mutex_init(&sched.deques[i].lock, NULL);
+		sched.deques[i].items = uwsgi_calloc(sizeof(struct uwsgi_sched_conn) * sched.size);
+		if (pipe(sched.deques[i].pipe)) {
+			uwsgi_error("uwsgi_sched_init()/pipe()");
+			exit(1);
+		}
+		uwsgi_socket_nb(sched.deques[i].pipe[0]);
+	}
+	pthread_mutex_init(&sched.lock, NULL);
+	pthread_cond_init(&sched.cond, NULL);
+	pthread_mutex_init(&sched.stop_lock, NULL);
+	if (pipe(sched.stop_pipe)) {
+		uwsgi_error("uwsgi_sched_init()/pipe()");
+		exit(1);
+	}
+
+#ifdef UWSGI_PCRE
+	if (uwsgi.thread_sched_priority && uwsgi.no_defer_accept) {
+		uwsgi_log("*** WARNING: --thread-scheduler-priority needs TCP_DEFER_ACCEPT, remove --no-defer-accept ***\n");
+	}
+#endif
+
+	if (pthread_create(&sched.acceptor, NULL, sched_acceptor, NULL)) {
+		uwsgi_error("uwsgi_sched_init()/pthread_create()");
+		exit(1);
+	}
+}
+
+void uwsgi_sched_add_to_queue(int queue, int core_id) {
+	event_queue_add_fd_read(queue, sched.deques[core_id].pipe[0]);
+}
+
+static int sched_serve(struct wsgi_request *wsgi_req, struct uwsgi_sched_conn *conn) {
+	wsgi_req->fd = conn->fd;
+	wsgi_req->socket = conn->socket;
+	memcpy(&wsgi_req->c_addr, &conn->c_addr, sizeof(struct sockaddr_un));
+	wsgi_req->c_len = conn->c_len;
+#ifdef UWSGI_SSL
+	if (conn->socket->ssl_ctx) {
+		wsgi_req->ssl = SSL_new(conn->socket->ssl_ctx);
+		SSL_set_fd(wsgi_req->ssl, conn->fd);
+		SSL_set_accept_state(wsgi_req->ssl);
+	}
+#endif
+	uwsgi_post_accept(wsgi_req);
+	return 0;
+}
+
+/*
+	the worker is going away (manage_next_request is already 0): wake up the acceptor and the
+	threads waiting for connections, they will leave their loops and drain the deques.
+	Only write() is used, it is called by signal handlers too.
+*/
+void uwsgi_sched_wakeup() {
+	int i;
+	if (write(sched.stop_pipe[1], "x", 1) != 1) {
+		// already woken up
+	}
+	for (i = 0; i < uwsgi.threads; i++) {
+		if (write(sched.deques[i].pipe[1], "x", 1) != 1) {
+			// the thread will see it anyway
+		}
+	}
+}
+
+/*
+	called by each thread after leaving its loop: the first caller stops the acceptor,
+	then the connections still queued (in any deque) are served. Returns -1 when the deques are empty.
+*/
+int uwsgi_sched_drain(struct wsgi_request *wsgi_req) {
+	struct uwsgi_sched_conn conn;
+
+	pthread_mutex_lock(&sched.stop_lock);
+	if (!sched.stopped) {
+		uwsgi_sched_wakeup();
+		pthread_mutex_lock(&sched.lock);
+		pthread_cond_broadcast(&sched.cond);
+		pthread_mutex_unlock(&sched.lock);
+		pthread_join(sched.acceptor, NULL);
+		sched.stopped = 1;
+	}
+	pthread_mutex_unlock(&sched.stop_lock);
+
+	if (!sched_take(wsgi_req->async_id, &conn)) return -1;
+	return sched_serve(wsgi_req, &conn);
+}
+
+// the main thread waits for its siblings to finish their requests before the worker exits
+void uwsgi_sched_join() {
+	int i;
+	for (i = 1; i < uwsgi.threads; i++) {
+		pthread_join(uwsgi.workers[uwsgi.mywid].cores[i].thread_id, NULL);
+	}
+}
+
+// the wsgi_req_accept() counterpart for --thread-scheduler
+int uwsgi_sched_accept(int queue, struct wsgi_request *wsgi_req) {
+
+	int ret;
+	int interesting_fd = -1;
+	int timeout = -1;
+	struct uwsgi_sched_deque *d = &sched.deques[wsgi_req->async_id];
+	struct uwsgi_sched_conn conn;
+
+	// http 1.1 keepalive connections stay on their thread
+	struct uwsgi_socket *uwsgi_sock = uwsgi.sockets;
+	while (uwsgi_sock) {
+		if (uwsgi_sock->retry && uwsgi_sock->retry[wsgi_req->async_id]) {
+			wsgi_req->socket = uwsgi_sock;
+			wsgi_req->fd = uwsgi_sock->proto_accept(wsgi_req, uwsgi_sock->fd);
+			if (wsgi_req->fd < 0) return -1;
+			uwsgi_post_accept(wsgi_req);
+			return 0;
+		}
+		uwsgi_sock = uwsgi_sock->next;
+	}
+
+	if (uwsgi.has_emperor && uwsgi.heartbeat) {
+		time_t now = uwsgi_now();
+		timeout = uwsgi.heartbeat;
+		if (!uwsgi.next_heartbeat) {
+			uwsgi.next_heartbeat = now;
+		}
+		if (uwsgi.next_heartbeat >= now) {
+			timeout = uwsgi.next_heartbeat - now;
+		}
+	}
+
+	// look for work (even in the siblings deques) before going to sleep
+	__atomic_store_n(&d->idle, 1, __ATOMIC_RELEASE);
+	if (sched_take(wsgi_req->async_id, &conn)) {
+		__atomic_store_n(&d->idle, 0, __ATOMIC_RELEASE);
+		return sched_serve(wsgi_req, &conn);
+	}
+
+	ret = event_queue_wait(queue, timeout, &interesting_fd);
+	__atomic_store_n(&d->idle, 0, __ATOMIC_RELEASE);
+	if (ret < 0) return -1;
+
+	if (uwsgi.has_emperor && uwsgi.heartbeat) {
+		uwsgi_heartbeat();
+		if (ret == 0) return -1;
+	}
+
+	// kill the thread after the request completion
+	pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &ret);
+
+	if (uwsgi.signal_socket > -1 && (interesting_fd == uwsgi.signal_socket || interesting_fd == uwsgi.my_signal_socket)) {
+		uwsgi_receive_signal(wsgi_req, interesting_fd, "worker", uwsgi.mywid);
+		pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &ret);
+		return -1;
+	}
+
+	if (interesting_fd == d->pipe[0]) {
+		char byte;
+		if (read(d->pipe[0], &byte, 1) != 1 || !sched_take(wsgi_req->async_id, &conn)) {
+			// the connection has been stolen by a sibling
+			pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &ret);
+			return -1;
+		}
+		return sched_serve(wsgi_req, &conn);
+	}
+
+	pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &ret);
+	return -1;
+}
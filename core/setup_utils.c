@@ -96,7 +96,8 @@ void uwsgi_setup_inherited_sockets() {
 	while (uwsgi_sock) {
 		//a bit overengineering
 		if (uwsgi_sock->name[0] != 0 && !uwsgi_sock->bound) {
-			for (j = 3; j < (int) uwsgi.max_fd; j++) {
+			// stop at the first match (the other ones could be its per-core sockets)
+			for (j = 3; j < (int) uwsgi.max_fd && !uwsgi_sock->bound; j++) {
 				uwsgi_add_socket_from_fd(uwsgi_sock, j);
 			}
 		}
@@ -195,7 +196,7 @@ void uwsgi_setup_inherited_sockets() {
 			}
 		}
 
-		if (useless) {
+		if (useless && !uwsgi_reuseport_adopt(j)) {
 			close(j);
 		}
 	}
@@ -298,6 +298,7 @@ struct uwsgi_sharedarea *uwsgi_sharedarea_init(int pages) {
 	uwsgi.sharedareas[id]->fd = -1;
 	uwsgi.sharedareas[id]->pages = pages;
 	uwsgi.sharedareas[id]->max_pos = (uwsgi.page_size * pages) -1;
+	uwsgi_numa_interleave(uwsgi.sharedareas[id]->area, uwsgi.page_size * pages);
 	char *id_str = uwsgi_num2str(id);
 	uwsgi.sharedareas[id]->lock = uwsgi_rwlock_init(uwsgi_concat2("sharedarea", id_str));
 	free(id_str);
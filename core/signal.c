@@ -273,7 +273,7 @@ int uwsgi_remote_signal_send(char *addr, uint8_t sig) {
         if (fd < 0) return -1;
 
         // wait for connection
-        if (uwsgi.wait_write_hook(fd, uwsgi.socket_timeout) <= 0) goto end;
+        if (uwsgi_wait_write_ms(fd, uwsgi.socket_timeout_ms) <= 0) goto end;
 
         if (uwsgi_write_true_nb(fd, (char *) &uh, 4, uwsgi.socket_timeout)) goto end;
 
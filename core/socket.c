@@ -1364,21 +1364,251 @@ void uwsgi_add_sockets_to_queue(int queue, int async_id) {
 			event_queue_add_fd_read(queue, uwsgi_sock->fd_threads[async_id]);
 		}
 		else if (uwsgi_sock->fd > -1) {
-			event_queue_add_fd_read(queue, uwsgi_sock->fd);
+			event_queue_add_fd_read(queue, uwsgi_socket_core_fd(uwsgi_sock, async_id));
 		}
 		uwsgi_sock = uwsgi_sock->next;
 	}
 
 }
 
-void uwsgi_del_sockets_from_queue(int queue) {
+/*
+	--accept-reuseport
 
+	every consumer (a worker, or a worker thread in multithreaded mode) gets its own
+	listening socket in the same SO_REUSEPORT group, so the kernel distributes the
+	connections without waking up everyone and without the thunder lock.
+
+	The sockets are created by the master (all of the group members must have the same owner
+	and they must survive workers respawn), the original socket is the first member.
+	They are inherited on reload too (with their queued connections) and reused by the new master.
+
+	--accept-reuseport-cbpf chooses the member by the cpu that received the connection, so
+	the group has at most one member per cpu (consumers share them round robin).
+*/
+
+static int uwsgi_reuseport_consumers() {
+	return uwsgi.numproc * (uwsgi.threads > 1 ? uwsgi.threads : 1);
+}
+
+static int uwsgi_reuseport_members() {
+	int members = uwsgi_reuseport_consumers();
+#if defined(__linux__) && defined(SO_ATTACH_REUSEPORT_CBPF)
+	if (uwsgi.accept_reuseport_cbpf) {
+		// the cbpf program returns a cpu id, members over the cpu count would never get a connection
+		long ncpu = sysconf(_SC_NPROCESSORS_CONF);
+		if (ncpu > 0 && members > ncpu) members = ncpu;
+	}
+#endif
+	return members;
+}
+
+// the listening socket to use for the specified core of the current worker
+int uwsgi_socket_core_fd(struct uwsgi_socket *uwsgi_sock, int core_id) {
+	if (!uwsgi_sock->fd_cores || core_id < 0 || uwsgi.mywid < 1 || uwsgi.mywid > uwsgi.numproc) return uwsgi_sock->fd;
+	int consumer = uwsgi.mywid - 1;
+	if (uwsgi.threads > 1) {
+		consumer = ((uwsgi.mywid - 1) * uwsgi.threads) + core_id;
+	}
+	return uwsgi_sock->fd_cores[consumer % uwsgi_sock->fd_cores_cnt];
+}
+
+int uwsgi_socket_has_core_fd(struct uwsgi_socket *uwsgi_sock, int fd) {
+	int i;
+	if (!uwsgi_sock->fd_cores) return 0;
+	for(i=0;i<uwsgi_sock->fd_cores_cnt;i++) {
+		if (uwsgi_sock->fd_cores[i] == fd) return 1;
+	}
+	return 0;
+}
+
+/*
+	called on reload for every inherited fd not mapped to a socket: the per-core sockets
+	of the previous instance are kept as group members (in fd order, so the group order
+	is preserved), the exceeding ones are closed by the caller
+*/
+int uwsgi_reuseport_adopt(int fd) {
+	union uwsgi_sockaddr usa, sock_usa;
+	socklen_t addr_len = sizeof(union uwsgi_sockaddr);
+	int on = 0;
+	socklen_t on_len = sizeof(int);
+
+	if (!uwsgi.accept_reuseport) return 0;
+	if (getsockopt(fd, SOL_SOCKET, SO_ACCEPTCONN, &on, &on_len) || !on) return 0;
+	if (getsockname(fd, (struct sockaddr *) &usa, &addr_len)) return 0;
+
+	int members = uwsgi_reuseport_members();
 	struct uwsgi_socket *uwsgi_sock = uwsgi.sockets;
 	while (uwsgi_sock) {
-		if (uwsgi_sock->fd == -1)
-			goto nextsock;
-		event_queue_del_fd(queue, uwsgi_sock->fd, event_queue_read());
-nextsock:
+		socklen_t sock_addr_len = sizeof(union uwsgi_sockaddr);
+		if (!uwsgi_sock->bound || uwsgi_sock->fd < 0 || uwsgi_sock->fd == fd) goto next;
+		if (getsockname(uwsgi_sock->fd, (struct sockaddr *) &sock_usa, &sock_addr_len)) goto next;
+		if (sock_addr_len != addr_len || memcmp(&usa, &sock_usa, addr_len)) goto next;
+		if (!uwsgi_sock->fd_cores) {
+			uwsgi_sock->fd_cores = uwsgi_malloc(sizeof(int) * members);
+			uwsgi_sock->fd_cores[0] = uwsgi_sock->fd;
+			uwsgi_sock->fd_cores_cnt = 1;
+		}
+		if (uwsgi_sock->fd_cores_cnt >= members) return 0;
+		uwsgi_sock->fd_cores[uwsgi_sock->fd_cores_cnt++] = fd;
+		uwsgi_log("fd %d inherited as per-core listening socket of %s\n", fd, uwsgi_sock->name);
+		return 1;
+next:
+		uwsgi_sock = uwsgi_sock->next;
+	}
+	return 0;
+}
+
+static int uwsgi_reuseport_clone(int fd) {
+	// options applied by bind_to_tcp() to the original socket
+	static int options[][2] = {
+		{SOL_SOCKET, SO_KEEPALIVE},
+		{SOL_SOCKET, SO_SNDTIMEO},
+#ifdef __linux__
+		{IPPROTO_TCP, TCP_DEFER_ACCEPT},
+		{SOL_IP, IP_FREEBIND},
+#endif
+#ifdef TCP_FASTOPEN
+		{IPPROTO_TCP, TCP_FASTOPEN},
+#endif
+	};
+	union uwsgi_sockaddr usa;
+	socklen_t addr_len = sizeof(union uwsgi_sockaddr);
+	char value[64];
+	size_t i;
+
+	if (getsockname(fd, (struct sockaddr *) &usa, &addr_len)) {
+		uwsgi_error("uwsgi_reuseport_clone()/getsockname()");
+		return -1;
+	}
+
+	int new_fd = socket(usa.sa.sa_family, SOCK_STREAM, 0);
+	if (new_fd < 0) {
+		uwsgi_error("uwsgi_reuseport_clone()/socket()");
+		return -1;
+	}
+
+	int on = 1;
+	if (setsockopt(new_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(int)) || setsockopt(new_fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(int))) {
+		uwsgi_error("uwsgi_reuseport_clone()/setsockopt()");
+		goto error;
+	}
+
+	for(i=0;i<sizeof(options)/sizeof(options[0]);i++) {
+		socklen_t value_len = sizeof(value);
+		if (!getsockopt(fd, options[i][0], options[i][1], value, &value_len)) {
+			setsockopt(new_fd, options[i][0], options[i][1], value, value_len);
+		}
+	}
+
+	if (bind(new_fd, (struct sockaddr *) &usa, addr_len)) {
+		uwsgi_error("uwsgi_reuseport_clone()/bind()");
+		goto error;
+	}
+
+	if (listen(new_fd, uwsgi.listen_queue)) {
+		uwsgi_error("uwsgi_reuseport_clone()/listen()");
+		goto error;
+	}
+
+	// no FD_CLOEXEC: the socket (and its accept queue) must survive the re-exec on reload
+	uwsgi_socket_nb(new_fd);
+	return new_fd;
+
+error:
+	close(new_fd);
+	return -1;
+}
+
+#if defined(__linux__) && defined(SO_ATTACH_REUSEPORT_CBPF)
+#include <linux/filter.h>
+// the group member is chosen by the cpu that received the connection
+static void uwsgi_reuseport_cbpf(int fd, int members) {
+	struct sock_filter code[] = {
+		{BPF_LD | BPF_W | BPF_ABS, 0, 0, SKF_AD_OFF + SKF_AD_CPU},
+		{BPF_ALU | BPF_MOD | BPF_K, 0, 0, (uint32_t) members},
+		{BPF_RET | BPF_A, 0, 0, 0},
+	};
+	struct sock_fprog prog = {
+		.len = sizeof(code) / sizeof(code[0]),
+		.filter = code,
+	};
+	if (setsockopt(fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog))) {
+		uwsgi_error("SO_ATTACH_REUSEPORT_CBPF setsockopt()");
+	}
+}
+#endif
+
+// drop the per-core sockets (inherited ones included) of a socket that will not use them
+static void uwsgi_reuseport_release(struct uwsgi_socket *uwsgi_sock) {
+	int i;
+	if (!uwsgi_sock->fd_cores) return;
+	for(i=1;i<uwsgi_sock->fd_cores_cnt;i++) {
+		close(uwsgi_sock->fd_cores[i]);
+	}
+	free(uwsgi_sock->fd_cores);
+	uwsgi_sock->fd_cores = NULL;
+	uwsgi_sock->fd_cores_cnt = 0;
+}
+
+void uwsgi_setup_reuseport_sockets() {
+	int consumers = uwsgi_reuseport_consumers();
+	int members = uwsgi_reuseport_members();
+
+	struct uwsgi_socket *uwsgi_sock = uwsgi.sockets;
+	while (uwsgi_sock) {
+		int on = 0;
+		socklen_t on_len = sizeof(int);
+		if (members < 2) goto skip;
+		if (!uwsgi_sock->bound || uwsgi_sock->fd < 0 || uwsgi_sock->lazy || uwsgi_sock->shared) goto skip;
+		if (uwsgi_sock->family != AF_INET
+#ifdef AF_INET6
+			&& uwsgi_sock->family != AF_INET6
+#endif
+		) goto skip;
+		// inherited sockets could have been bound without SO_REUSEPORT
+		if (getsockopt(uwsgi_sock->fd, SOL_SOCKET, SO_REUSEPORT, &on, &on_len) || !on) {
+			uwsgi_log("socket %s has no SO_REUSEPORT flag, it will be shared by all of the cores\n", uwsgi_sock->name);
+			goto skip;
+		}
+
+		if (!uwsgi_sock->fd_cores) {
+			uwsgi_sock->fd_cores = uwsgi_malloc(sizeof(int) * members);
+			uwsgi_sock->fd_cores[0] = uwsgi_sock->fd;
+			uwsgi_sock->fd_cores_cnt = 1;
+		}
+		while(uwsgi_sock->fd_cores_cnt < members) {
+			int fd = uwsgi_reuseport_clone(uwsgi_sock->fd);
+			if (fd < 0) {
+				uwsgi_log("unable to create per-core listening socket for %s\n", uwsgi_sock->name);
+				exit(1);
+			}
+			uwsgi_sock->fd_cores[uwsgi_sock->fd_cores_cnt++] = fd;
+		}
+#if defined(__linux__) && defined(SO_ATTACH_REUSEPORT_CBPF)
+		if (uwsgi.accept_reuseport_cbpf) {
+			uwsgi_reuseport_cbpf(uwsgi_sock->fd, members);
+		}
+#endif
+		uwsgi_log("socket %s: %d per-core SO_REUSEPORT listening sockets for %d consumers\n", uwsgi_sock->name, members, consumers);
+		goto next;
+skip:
+		uwsgi_reuseport_release(uwsgi_sock);
+next:
+		uwsgi_sock = uwsgi_sock->next;
+	}
+}
+
+// the counterpart of uwsgi_add_sockets_to_queue()
+void uwsgi_del_sockets_from_queue(int queue, int async_id) {
+
+	struct uwsgi_socket *uwsgi_sock = uwsgi.sockets;
+	while (uwsgi_sock) {
+		if (uwsgi_sock->fd_threads && async_id > -1 && uwsgi_sock->fd_threads[async_id] > -1) {
+			event_queue_del_fd(queue, uwsgi_sock->fd_threads[async_id], event_queue_read());
+		}
+		else if (uwsgi_sock->fd > -1) {
+			event_queue_del_fd(queue, uwsgi_socket_core_fd(uwsgi_sock, async_id), event_queue_read());
+		}
 		uwsgi_sock = uwsgi_sock->next;
 	}
 
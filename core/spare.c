@@ -0,0 +1,258 @@
+#include <uwsgi.h>
+
+extern struct uwsgi_server uwsgi;
+
+void worker_wakeup();
+
+/*
+
+	warm spare workers (--spare-workers)
+
+	the master keeps N processes forked, with their apps already loaded (this is where
+	the time goes with --lazy-apps), parked before accepting. Each spare runs in a
+	scratch slot of the workers table (after the last real worker). When a worker has
+	to be respawned (max-requests, reload-on-rss, harakiri, cheaper...) the master hands
+	the worker id to a parked spare via a socketpair: the spare moves its apps, signal
+	handlers and rpc functions to the real slot and starts accepting immediately, while
+	the master forks a new spare in background.
+
+	Spares are recycled on workers reloads, so they always load the current code.
+
+*/
+
+// workers table entries (master + workers + spares)
+int uwsgi_spare_slots() {
+	return uwsgi.numproc + 1 + uwsgi.spare_workers;
+}
+
+static int spare_spawn(int slot) {
+	int sid = uwsgi.numproc + 1 + slot;
+	int fds[2];
+
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds)) {
+		uwsgi_error("spare_spawn()/socketpair()");
+		return 0;
+	}
+	// a reloaded master must not keep spares alive
+	fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+
+	uwsgi.workers[sid].parked = 0;
+	uwsgi.workers[sid].apps_cnt = uwsgi.workers[0].apps_cnt;
+
+	// like uwsgi_respawn_worker(), do not fork while the logger thread holds the lock
+	if (uwsgi.threaded_logger) {
+		pthread_mutex_lock(&uwsgi.threaded_logger_lock);
+	}
+
+	pid_t pid = uwsgi_fork(uwsgi.workers[sid].name);
+	if (pid == 0) {
+		int i;
+		close(fds[0]);
+		// only the master can talk to the spares
+		for (i = 0; i < uwsgi.spare_workers; i++) {
+			if (uwsgi.spares[i].fd > -1) {
+				close(uwsgi.spares[i].fd);
+				uwsgi.spares[i].fd = -1;
+			}
+		}
+		uwsgi.spare_fd = fds[1];
+		uwsgi.i_am_a_spare = 1;
+
+		signal(SIGWINCH, worker_wakeup);
+		signal(SIGTSTP, worker_wakeup);
+		uwsgi.mywid = sid;
+		uwsgi.mypid = getpid();
+		uwsgi.workers[sid].id = sid;
+		uwsgi.workers[sid].manage_next_request = 1;
+
+		for (i = 0; i < uwsgi.cores; i++) {
+			uwsgi.workers[sid].cores[i].in_request = 0;
+			memset(&uwsgi.workers[sid].cores[i].req, 0, sizeof(struct wsgi_request));
+		}
+		// drop the signals and rpc functions registered by the previous spare of the slot
+		memset(&uwsgi.shared->signal_table[sid * 256], 0, sizeof(struct uwsgi_signal_entry) * 256);
+		uwsgi.shared->rpc_count[sid] = 0;
+
+		// spares are always spawned by an already running master
+		for (i = 0; i < 256; i++) {
+			if (uwsgi.p[i]->master_fixup) {
+				uwsgi.p[i]->master_fixup(1);
+			}
+		}
+		return 1;
+	}
+
+	if (uwsgi.threaded_logger) {
+		pthread_mutex_unlock(&uwsgi.threaded_logger_lock);
+	}
+
+	close(fds[1]);
+	if (pid < 0) {
+		uwsgi_error("spare_spawn()/fork()");
+		close(fds[0]);
+		return 0;
+	}
+
+	uwsgi.spares[slot].pid = pid;
+	uwsgi.spares[slot].fd = fds[0];
+	uwsgi.workers[sid].pid = pid;
+	uwsgi_log("spawned uWSGI spare worker %d (pid: %d)\n", slot + 1, (int) pid);
+	return 0;
+}
+
+// run by the master on every cycle, returns 1 in the new spare
+int uwsgi_spares_check() {
+	int i;
+	if (!uwsgi.spare_workers) return 0;
+	if (uwsgi_instance_is_reloading || uwsgi_instance_is_dying || uwsgi.status.is_cheap || uwsgi.workers[0].suspended) return 0;
+	for (i = 0; i < uwsgi.spare_workers; i++) {
+		if (uwsgi.spares[i].pid > 0) continue;
+		// one spare per cycle, they have to load the apps like the workers
+		return spare_spawn(i);
+	}
+	return 0;
+}
+
+// called by the master in place of fork(), returns 1 if a spare took the worker slot
+int uwsgi_spare_adopt(int wid) {
+	int i;
+	if (!uwsgi.spare_workers) return 0;
+	for (i = 0; i < uwsgi.spare_workers; i++) {
+		int sid = uwsgi.numproc + 1 + i;
+		if (uwsgi.spares[i].pid <= 0 || uwsgi.spares[i].fd < 0 || !uwsgi.workers[sid].parked) continue;
+		uwsgi.workers[sid].parked = 0;
+		if (send(uwsgi.spares[i].fd, &wid, sizeof(int), MSG_NOSIGNAL) != sizeof(int)) {
+			uwsgi_error("uwsgi_spare_adopt()/send()");
+			// it will be reaped (and replaced) by the master
+			close(uwsgi.spares[i].fd);
+			uwsgi.spares[i].fd = -1;
+			continue;
+		}
+		close(uwsgi.spares[i].fd);
+		uwsgi.spares[i].fd = -1;
+
+		uwsgi.workers[wid].pid = uwsgi.spares[i].pid;
+		uwsgi.workers[wid].spare_respawns++;
+		uwsgi.workers[sid].pid = 0;
+		uwsgi.spares[i].pid = 0;
+		uwsgi_log("Respawned uWSGI worker %d (new pid: %d, from spare %d)\n", wid, (int) uwsgi.workers[wid].pid, i + 1);
+		return 1;
+	}
+	return 0;
+}
+
+// move what the spare has built in its scratch slot to the real one
+static void spare_become(int wid) {
+	int i;
+	int sid = uwsgi.mywid;
+
+	memcpy(uwsgi.workers[wid].apps, uwsgi.workers[sid].apps, sizeof(struct uwsgi_app) * uwsgi.max_apps);
+	uwsgi.workers[wid].apps_cnt = uwsgi.workers[sid].apps_cnt;
+	for (i = 0; i < uwsgi.cores; i++) {
+		memcpy(uwsgi.workers[wid].cores[i].ts, uwsgi.workers[sid].cores[i].ts, sizeof(void *) * uwsgi.max_apps);
+		uwsgi.workers[wid].cores[i].in_request = 0;
+		memset(&uwsgi.workers[wid].cores[i].req, 0, sizeof(struct wsgi_request));
+	}
+
+	uwsgi_lock(uwsgi.signal_table_lock);
+	for (i = 0; i < 256; i++) {
+		struct uwsgi_signal_entry *use = &uwsgi.shared->signal_table[(wid * 256) + i];
+		memcpy(use, &uwsgi.shared->signal_table[(sid * 256) + i], sizeof(struct uwsgi_signal_entry));
+		if (use->wid == sid) use->wid = wid;
+	}
+	uwsgi_unlock(uwsgi.signal_table_lock);
+
+	uwsgi_lock(uwsgi.rpc_table_lock);
+	memcpy(&uwsgi.rpc_table[wid * uwsgi.rpc_max], &uwsgi.rpc_table[sid * uwsgi.rpc_max], sizeof(struct uwsgi_rpc) * uwsgi.rpc_max);
+	uwsgi.shared->rpc_count[wid] = uwsgi.shared->rpc_count[sid];
+	uwsgi_unlock(uwsgi.rpc_table_lock);
+
+	uwsgi.workers[sid].apps_cnt = 0;
+
+	uwsgi.mywid = wid;
+	uwsgi.workers[wid].id = wid;
+	uwsgi.workers[wid].manage_next_request = 1;
+	uwsgi.wsgi_req = &uwsgi.workers[wid].cores[0].req;
+	uwsgi.i_am_a_spare = 0;
+	close(uwsgi.spare_fd);
+	uwsgi.spare_fd = -1;
+
+	uwsgi_fixup_fds(wid, 0, NULL);
+	uwsgi.my_signal_socket = uwsgi.workers[wid].signal_pipe[1];
+
+	if (uwsgi.auto_procname && !uwsgi.procname) {
+		uwsgi_set_processname(uwsgi.workers[wid].name);
+	}
+
+	// skipped by the spare as they depend on the worker id
+	uwsgi_map_sockets();
+	uwsgi_set_cpu_affinity();
+	// the apps have been loaded before knowing the node
+	if (uwsgi.numa) {
+		uwsgi_numa_migrate();
+	}
+}
+
+// called by the spare after loading the apps, returns when it becomes a worker
+void uwsgi_spare_park() {
+	int wid = 0;
+	uwsgi.workers[uwsgi.mywid].parked = 1;
+	for (;;) {
+		ssize_t rlen = read(uwsgi.spare_fd, &wid, sizeof(int));
+		if (rlen == sizeof(int)) break;
+		if (rlen < 0 && errno == EINTR) continue;
+		// recycled or the master is gone
+		exit(0);
+	}
+	if (wid < 1 || wid > uwsgi.numproc) {
+		uwsgi_log("[spare] invalid worker id received: %d\n", wid);
+		exit(1);
+	}
+	spare_become(wid);
+}
+
+// drop the current spares (their apps are outdated), the master will replace them
+void uwsgi_spares_recycle() {
+	int i;
+	for (i = 0; i < uwsgi.spare_workers; i++) {
+		uwsgi.workers[uwsgi.numproc + 1 + i].parked = 0;
+		if (uwsgi.spares[i].fd > -1) {
+			close(uwsgi.spares[i].fd);
+			uwsgi.spares[i].fd = -1;
+		}
+		if (uwsgi.spares[i].pid > 0) {
+			kill(uwsgi.spares[i].pid, SIGKILL);
+		}
+	}
+}
+
+// on shutdown/reload, spares are not waited like workers
+void uwsgi_spares_destroy() {
+	int i;
+	int waitpid_status;
+	uwsgi_spares_recycle();
+	for (i = 0; i < uwsgi.spare_workers; i++) {
+		if (uwsgi.spares[i].pid > 0) {
+			waitpid(uwsgi.spares[i].pid, &waitpid_status, 0);
+			uwsgi.spares[i].pid = 0;
+		}
+	}
+}
+
+int uwsgi_master_check_spares_death(int diedpid) {
+	int i;
+	for (i = 0; i < uwsgi.spare_workers; i++) {
+		if (uwsgi.spares[i].pid != diedpid) continue;
+		// recycled spares have no fd
+		if (uwsgi.spares[i].fd > -1) {
+			uwsgi_log("spare worker %d (pid: %d) died :( it will be respawned\n", i + 1, (int) diedpid);
+			close(uwsgi.spares[i].fd);
+			uwsgi.spares[i].fd = -1;
+		}
+		uwsgi.workers[uwsgi.numproc + 1 + i].parked = 0;
+		uwsgi.workers[uwsgi.numproc + 1 + i].pid = 0;
+		uwsgi.spares[i].pid = 0;
+		return -1;
+	}
+	return 0;
+}
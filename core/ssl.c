@@ -2,6 +2,10 @@
 #include <openssl/rand.h>
 #include <openssl/sha.h>
 #include <openssl/md5.h>
+#include <openssl/hmac.h>
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/core_names.h>
+#endif
 
 extern struct uwsgi_server uwsgi;
 /*
@@ -66,11 +70,13 @@ SSL_SESSION *uwsgi_ssl_session_get_cb(SSL *ssl, unsigned char *key, int keylen,
         char *value = uwsgi_cache_get2(uwsgi.ssl_sessions_cache, (char *)key, keylen, &valsize);
         if (!value) {
                 uwsgi_rwunlock(uwsgi.ssl_sessions_cache->lock);
+                if (uwsgi.ssl_sessions) __atomic_add_fetch(&uwsgi.ssl_sessions->cache_misses, 1, __ATOMIC_RELAXED);
                 if (uwsgi.ssl_verbose) {
                         uwsgi_log("[uwsgi-ssl] cache miss\n");
                 }
                 return NULL;
         }
+        if (uwsgi.ssl_sessions) __atomic_add_fetch(&uwsgi.ssl_sessions->cache_hits, 1, __ATOMIC_RELAXED);
 #if (OPENSSL_VERSION_NUMBER >= 0x0090800fL)
         SSL_SESSION *sess = d2i_SSL_SESSION(NULL, (const unsigned char **)&value, valsize);
 #else
@@ -90,6 +96,168 @@ void uwsgi_ssl_session_remove_cb(SSL_CTX *ctx, SSL_SESSION *sess) {
         uwsgi_rwunlock(uwsgi.ssl_sessions_cache->lock);
 }
 
+/*
+	managed session tickets
+
+	ticket keys are derived (HMAC-SHA256) from a secret and the current rotation period,
+	so every process (and every instance/reload using the same secret file) agrees
+	on them without further coordination.
+
+	Tickets encrypted with the key of the previous period are still accepted (and renewed).
+*/
+#ifdef SSL_CTRL_SET_TLSEXT_TICKET_KEY_CB
+struct uwsgi_ssl_ticket_key {
+	uint64_t period;
+	unsigned char name[16];
+	unsigned char aes_key[32];
+	unsigned char hmac_key[32];
+};
+
+static void uwsgi_ssl_ticket_key_derive(struct uwsgi_ssl_ticket_key *utk, uint64_t period) {
+	unsigned char buf[EVP_MAX_MD_SIZE];
+	unsigned int buf_len = 0;
+	char msg[5 + sizeof(uint64_t)];
+	memcpy(msg + 5, &period, sizeof(uint64_t));
+
+	memcpy(msg, "name:", 5);
+	HMAC(EVP_sha256(), uwsgi.ssl_sessions->secret, 32, (unsigned char *) msg, sizeof(msg), buf, &buf_len);
+	memcpy(utk->name, buf, 16);
+
+	memcpy(msg, "aes::", 5);
+	HMAC(EVP_sha256(), uwsgi.ssl_sessions->secret, 32, (unsigned char *) msg, sizeof(msg), buf, &buf_len);
+	memcpy(utk->aes_key, buf, 32);
+
+	memcpy(msg, "hmac:", 5);
+	HMAC(EVP_sha256(), uwsgi.ssl_sessions->secret, 32, (unsigned char *) msg, sizeof(msg), buf, &buf_len);
+	memcpy(utk->hmac_key, buf, 32);
+
+	utk->period = period;
+}
+
+// keys are cached per-process, index 0 is the current period, 1 the previous one
+static struct uwsgi_ssl_ticket_key uwsgi_ssl_ticket_keys[2];
+
+static struct uwsgi_ssl_ticket_key *uwsgi_ssl_ticket_key_get(int previous) {
+	uint64_t period = uwsgi_now() / uwsgi.ssl_tickets_rotate;
+	if (uwsgi_ssl_ticket_keys[0].period != period) {
+		if (uwsgi_ssl_ticket_keys[0].period + 1 == period) {
+			uwsgi_ssl_ticket_keys[1] = uwsgi_ssl_ticket_keys[0];
+		}
+		else {
+			uwsgi_ssl_ticket_key_derive(&uwsgi_ssl_ticket_keys[1], period - 1);
+		}
+		uwsgi_ssl_ticket_key_derive(&uwsgi_ssl_ticket_keys[0], period);
+	}
+	return &uwsgi_ssl_ticket_keys[previous ? 1 : 0];
+}
+
+/*
+	selects the key of the ticket and initializes the cipher (the hmac setup depends on the OpenSSL version).
+	Returns 1 (or 2 to ask for a new ticket) on success, 0 for unknown keys and -1 on error
+*/
+static int uwsgi_ssl_ticket_key_setup(unsigned char *key_name, unsigned char *iv, EVP_CIPHER_CTX *ectx, int enc, struct uwsgi_ssl_ticket_key **key) {
+	struct uwsgi_ssl_ticket_key *utk = uwsgi_ssl_ticket_key_get(0);
+	// new ticket
+	if (enc) {
+		if (RAND_bytes(iv, EVP_MAX_IV_LENGTH) != 1) return -1;
+		memcpy(key_name, utk->name, 16);
+		if (EVP_EncryptInit_ex(ectx, EVP_aes_256_cbc(), NULL, utk->aes_key, iv) != 1) return -1;
+		*key = utk;
+		return 1;
+	}
+
+	int ret = 1;
+	if (memcmp(key_name, utk->name, 16)) {
+		utk = uwsgi_ssl_ticket_key_get(1);
+		if (memcmp(key_name, utk->name, 16)) {
+			__atomic_add_fetch(&uwsgi.ssl_sessions->tickets_unknown, 1, __ATOMIC_RELAXED);
+			if (uwsgi.ssl_verbose) {
+				uwsgi_log("[uwsgi-ssl] unknown (or expired) session ticket key\n");
+			}
+			return 0;
+		}
+		// valid, but ask for a new ticket
+		__atomic_add_fetch(&uwsgi.ssl_sessions->tickets_renewed, 1, __ATOMIC_RELAXED);
+		ret = 2;
+	}
+
+	if (EVP_DecryptInit_ex(ectx, EVP_aes_256_cbc(), NULL, utk->aes_key, iv) != 1) return -1;
+	*key = utk;
+	return ret;
+}
+
+// the counters are shared by all of the processes
+static void uwsgi_ssl_ticket_key_account(int enc) {
+	__atomic_add_fetch(enc ? &uwsgi.ssl_sessions->tickets_issued : &uwsgi.ssl_sessions->tickets_resumed, 1, __ATOMIC_RELAXED);
+}
+
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+static int uwsgi_ssl_ticket_key_cb(SSL *ssl, unsigned char *key_name, unsigned char *iv, EVP_CIPHER_CTX *ectx, EVP_MAC_CTX *hctx, int enc) {
+	struct uwsgi_ssl_ticket_key *utk = NULL;
+	int ret = uwsgi_ssl_ticket_key_setup(key_name, iv, ectx, enc, &utk);
+	if (ret <= 0) return ret;
+
+	OSSL_PARAM params[3];
+	params[0] = OSSL_PARAM_construct_octet_string(OSSL_MAC_PARAM_KEY, utk->hmac_key, 32);
+	params[1] = OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST, "SHA256", 0);
+	params[2] = OSSL_PARAM_construct_end();
+	if (EVP_MAC_CTX_set_params(hctx, params) != 1) return -1;
+	uwsgi_ssl_ticket_key_account(enc);
+	return ret;
+}
+#else
+static int uwsgi_ssl_ticket_key_cb(SSL *ssl, unsigned char *key_name, unsigned char *iv, EVP_CIPHER_CTX *ectx, HMAC_CTX *hctx, int enc) {
+	struct uwsgi_ssl_ticket_key *utk = NULL;
+	int ret = uwsgi_ssl_ticket_key_setup(key_name, iv, ectx, enc, &utk);
+	if (ret <= 0) return ret;
+
+	if (HMAC_Init_ex(hctx, utk->hmac_key, 32, EVP_sha256(), NULL) != 1) return -1;
+	uwsgi_ssl_ticket_key_account(enc);
+	return ret;
+}
+#endif
+#endif
+
+// initialize the shared session resumption state (before forking)
+static void uwsgi_ssl_sessions_init() {
+	if (uwsgi.ssl_sessions) return;
+	uwsgi.ssl_sessions = uwsgi_calloc_shared(sizeof(struct uwsgi_ssl_sessions));
+	if (!uwsgi.ssl_tickets_rotate) return;
+
+	if (uwsgi.ssl_tickets_secret) {
+		size_t secret_len = 0;
+		char *secret = uwsgi_open_and_read(uwsgi.ssl_tickets_secret, &secret_len, 0, NULL);
+		if (secret_len < 16) {
+			uwsgi_log("[uwsgi-ssl] the session tickets secret %s is too short (at least 16 bytes are required)\n", uwsgi.ssl_tickets_secret);
+			exit(1);
+		}
+		SHA256((unsigned char *) secret, secret_len, (unsigned char *) uwsgi.ssl_sessions->secret);
+		free(secret);
+		return;
+	}
+
+	if (RAND_bytes((unsigned char *) uwsgi.ssl_sessions->secret, 32) != 1) {
+		uwsgi_log("[uwsgi-ssl] unable to generate the session tickets secret\n");
+		exit(1);
+	}
+}
+
+int uwsgi_ssl_stats(struct uwsgi_stats *us) {
+	if (!uwsgi.ssl_sessions) return 0;
+	if (uwsgi_stats_key(us, "ssl_sessions")) return -1;
+	if (uwsgi_stats_object_open(us)) return -1;
+	if (uwsgi_stats_keylong_comma(us, "tickets_rotate", (unsigned long long) uwsgi.ssl_tickets_rotate)) return -1;
+	if (uwsgi_stats_keylong_comma(us, "tickets_issued", (unsigned long long) uwsgi.ssl_sessions->tickets_issued)) return -1;
+	if (uwsgi_stats_keylong_comma(us, "tickets_resumed", (unsigned long long) uwsgi.ssl_sessions->tickets_resumed)) return -1;
+	if (uwsgi_stats_keylong_comma(us, "tickets_renewed", (unsigned long long) uwsgi.ssl_sessions->tickets_renewed)) return -1;
+	if (uwsgi_stats_keylong_comma(us, "tickets_unknown", (unsigned long long) uwsgi.ssl_sessions->tickets_unknown)) return -1;
+	if (uwsgi_stats_keylong_comma(us, "cache_hits", (unsigned long long) uwsgi.ssl_sessions->cache_hits)) return -1;
+	if (uwsgi_stats_keylong(us, "cache_misses", (unsigned long long) uwsgi.ssl_sessions->cache_misses)) return -1;
+	if (uwsgi_stats_object_close(us)) return -1;
+	if (uwsgi_stats_comma(us)) return -1;
+	return 0;
+}
+
 #ifdef SSL_CTRL_SET_TLSEXT_HOSTNAME
 static int uwsgi_sni_cb(SSL *ssl, int *ad, void *arg) {
         const char *servername = SSL_get_servername(ssl, TLSEXT_NAMETYPE_host_name);
@@ -386,7 +554,10 @@ SSL_CTX *uwsgi_ssl_new_server_context(char *name, char *crt, char *key, char *ci
                         SSL_SESS_CACHE_NO_AUTO_CLEAR);
 
 #ifdef SSL_OP_NO_TICKET
-                ssloptions |= SSL_OP_NO_TICKET;
+		// managed tickets can work together with the cache
+		if (!uwsgi.ssl_tickets_rotate) {
+                	ssloptions |= SSL_OP_NO_TICKET;
+		}
 #endif
 
                 // just for fun
@@ -398,8 +569,33 @@ SSL_CTX *uwsgi_ssl_new_server_context(char *name, char *crt, char *key, char *ci
                 SSL_CTX_sess_set_remove_cb(ctx, uwsgi_ssl_session_remove_cb);
         }
 
+        if (uwsgi.ssl_sessions_use_cache || uwsgi.ssl_tickets_rotate) {
+		uwsgi_ssl_sessions_init();
+	}
+
+	if (uwsgi.ssl_tickets_rotate) {
+#ifdef SSL_CTRL_SET_TLSEXT_TICKET_KEY_CB
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+		SSL_CTX_set_tlsext_ticket_key_evp_cb(ctx, uwsgi_ssl_ticket_key_cb);
+#else
+		SSL_CTX_set_tlsext_ticket_key_cb(ctx, uwsgi_ssl_ticket_key_cb);
+#endif
+#else
+		uwsgi_log("[uwsgi-ssl] session tickets are not supported by this OpenSSL build, ignoring them for context \"%s\"\n", name);
+#endif
+	}
+
         SSL_CTX_set_timeout(ctx, uwsgi.ssl_sessions_timeout);
 
+	// let the kernel encrypt/decrypt records after the handshake (OpenSSL skips it for unsupported ciphers)
+	if (uwsgi.ssl_ktls) {
+#ifdef SSL_OP_ENABLE_KTLS
+		ssloptions |= SSL_OP_ENABLE_KTLS;
+#else
+		uwsgi_log("[uwsgi-ssl] kTLS is not supported by this OpenSSL build, ignoring it for context \"%s\"\n", name);
+#endif
+	}
+
 	struct uwsgi_string_list *usl = NULL;
 	uwsgi_foreach(usl, uwsgi.ssl_options) {
 		ssloptions |= atoi(usl->value);
@@ -412,6 +608,21 @@ SSL_CTX *uwsgi_ssl_new_server_context(char *name, char *crt, char *key, char *ci
 }
 
 
+/*
+	returns 1 if the kernel is encrypting the data sent over the connection (kTLS),
+	in such a case the socket can be directly written (or spliced) with cleartext data
+*/
+int uwsgi_ssl_ktls_send(SSL *ssl) {
+#if defined(SSL_OP_ENABLE_KTLS) && defined(BIO_get_ktls_send)
+	if (!uwsgi.ssl_ktls) return 0;
+	BIO *wbio = SSL_get_wbio(ssl);
+	if (!wbio) return 0;
+	return BIO_get_ktls_send(wbio) ? 1 : 0;
+#else
+	return 0;
+#endif
+}
+
 char *uwsgi_rsa_sign(char *algo_key, char *message, size_t message_len, unsigned int *s_len) {
 
         // openssl could not be initialized
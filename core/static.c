@@ -2,20 +2,17 @@
 
 extern struct uwsgi_server uwsgi;
 
-int uwsgi_static_want_gzip(struct wsgi_request *wsgi_req, char *filename, size_t *filename_len, struct stat *st) {
-	// check for filename size
-	if (*filename_len + 4 > PATH_MAX) return 0;
-	// check for supported encodings
-	if (!uwsgi_contains_n(wsgi_req->encoding, wsgi_req->encoding_len, "gzip", 4) ) return 0;
+// check if the static-gzip rules apply to the file
+static int static_want_compression(char *filename, size_t filename_len) {
 
 	// check for 'all'
-	if (uwsgi.static_gzip_all) goto gzip;
+	if (uwsgi.static_gzip_all) return 1;
 
 	// check for dirs/prefix
 	struct uwsgi_string_list *usl = uwsgi.static_gzip_dir;
 	while(usl) {
-		if (!uwsgi_starts_with(filename, *filename_len, usl->value, usl->len)) {
-			goto gzip;
+		if (!uwsgi_starts_with(filename, filename_len, usl->value, usl->len)) {
+			return 1;
 		}
 		usl = usl->next;
 	} 
@@ -23,8 +20,8 @@ int uwsgi_static_want_gzip(struct wsgi_request *wsgi_req, char *filename, size_t
 	// check for ext/suffix
 	usl = uwsgi.static_gzip_ext;
         while(usl) {
-		if (!uwsgi_strncmp(filename + (*filename_len - usl->len), usl->len, usl->value, usl->len)) {
-			goto gzip;
+		if (!uwsgi_strncmp(filename + (filename_len - usl->len), usl->len, usl->value, usl->len)) {
+			return 1;
 		}
                 usl = usl->next;
         }
@@ -33,26 +30,409 @@ int uwsgi_static_want_gzip(struct wsgi_request *wsgi_req, char *filename, size_t
 	// check for regexp
 	struct uwsgi_regexp_list *url = uwsgi.static_gzip;
 	while(url) {
-		if (uwsgi_regexp_match(url->pattern, url->pattern_extra, filename, *filename_len) >= 0) {
-			goto gzip;
+		if (uwsgi_regexp_match(url->pattern, url->pattern_extra, filename, filename_len) >= 0) {
+			return 1;
 		}
 		url = url->next;
 	}
 #endif
 	return 0;
+}
+
+/*
+
+	static files content negotiation
+
+	encodings are tried in server preference order (br, zstd, gzip) among the ones accepted
+	by the client. A precompressed sibling (file.br, file.zst, file.gz) is always preferred,
+	otherwise (with --static-compress-store) the file is compressed on first hit and stored as
+	<store>/<dev>-<inode>-<mtime>-<size>.<ext>, so a new version of the file gets a new variant.
+
+	While a variant is being compressed (<variant>.lock exists) the other requests get the identity.
+	Only files up to --static-compress-inline-max-size are compressed in the request path, the
+	bigger ones are queued to a background thread of the worker (started on first use) and
+	served as identity until their variant is ready.
+	Every response of a negotiable file (encoded or not) carries Vary: Accept-Encoding.
+	The store is scanned at startup and whenever it is full: the least recently accessed variants
+	are removed until it is back to 3/4 of --static-compress-store-limit (or less, to make room
+	for the file to compress).
+
+*/
+
+// locks older than this are left by dead processes
+#define UWSGI_STATIC_COMPRESS_LOCK_TIMEOUT 60
+
+struct uwsgi_static_encoding {
+	char *name;
+	size_t name_len;
+	char *ext;
+	size_t ext_len;
+	struct uwsgi_buffer *(*compress)(char *, size_t);
+};
+
+static struct uwsgi_static_encoding static_encodings[] = {
+#ifdef UWSGI_BROTLI
+	{"br", 2, ".br", 3, uwsgi_brotli},
+#else
+	{"br", 2, ".br", 3, NULL},
+#endif
+#ifdef UWSGI_ZSTD
+	{"zstd", 4, ".zst", 4, uwsgi_zstd},
+#else
+	{"zstd", 4, ".zst", 4, NULL},
+#endif
+#ifdef UWSGI_ZLIB
+	{"gzip", 4, ".gz", 3, uwsgi_gzip},
+#else
+	{"gzip", 4, ".gz", 3, NULL},
+#endif
+	{NULL, 0, NULL, 0, NULL},
+};
+
+// check if the encoding is in Accept-Encoding (and not disabled with q=0)
+static int static_accept_encoding(char *ae, uint16_t ae_len, char *name, size_t name_len) {
+	size_t i, base = 0;
+	for(i=0;i<=ae_len;i++) {
+		if (i < ae_len && ae[i] != ',') continue;
+		char *token = ae + base;
+		size_t token_len = i - base;
+		base = i + 1;
+		while(token_len > 0 && (*token == ' ' || *token == '\t')) {
+			token++;
+			token_len--;
+		}
+		size_t j, q = 0;
+		for(j=0;j<token_len;j++) {
+			if (token[j] == ';') {
+				q = j + 1;
+				break;
+			}
+		}
+		size_t token_name_len = j;
+		while(token_name_len > 0 && (token[token_name_len-1] == ' ' || token[token_name_len-1] == '\t')) token_name_len--;
+		if (uwsgi_strnicmp(token, token_name_len, name, name_len)) continue;
+		if (!q) return 1;
+		while(q < token_len && (token[q] == ' ' || token[q] == '\t')) q++;
+		if (q + 2 <= token_len && (token[q] == 'q' || token[q] == 'Q') && token[q+1] == '=') {
+			char qvalue[8];
+			size_t qlen = token_len - (q + 2);
+			if (qlen > 7) qlen = 7;
+			memcpy(qvalue, token + q + 2, qlen);
+			qvalue[qlen] = 0;
+			return strtod(qvalue, NULL) > 0;
+		}
+		return 1;
+	}
+	return 0;
+}
+
+struct uwsgi_static_variant {
+	char *name;
+	time_t atime;
+	uint64_t size;
+};
+
+static int static_variant_cmp(const void *a, const void *b) {
+	const struct uwsgi_static_variant *va = a, *vb = b;
+	if (va->atime < vb->atime) return -1;
+	if (va->atime > vb->atime) return 1;
+	return 0;
+}
+
+// recompute the size of the store, removing the least recently used variants if it is bigger than limit
+void uwsgi_static_compress_store_scan(uint64_t limit, int startup) {
+	DIR *dir = opendir(uwsgi.static_compress_store);
+	if (!dir) {
+		uwsgi_error("uwsgi_static_compress_store_scan()/opendir()");
+		return;
+	}
+	int dfd = dirfd(dir);
+	struct uwsgi_static_variant *variants = NULL;
+	size_t i, n = 0, size = 0;
+	uint64_t total = 0;
+	struct dirent *de;
+	while ((de = readdir(dir)) != NULL) {
+		if (de->d_name[0] == '.') {
+			// temp files and locks left by a previous instance
+			if (startup && de->d_name[1] && strcmp(de->d_name, "..")) unlinkat(dfd, de->d_name, 0);
+			continue;
+		}
+		size_t len = strlen(de->d_name);
+		if (len > 5 && !memcmp(de->d_name + len - 5, ".lock", 5)) {
+			if (startup) unlinkat(dfd, de->d_name, 0);
+			continue;
+		}
+		struct stat st;
+		if (fstatat(dfd, de->d_name, &st, AT_SYMLINK_NOFOLLOW) || !S_ISREG(st.st_mode)) continue;
+		if (n >= size) {
+			size_t new_size = size ? size * 2 : 64;
+			struct uwsgi_static_variant *tmp = realloc(variants, sizeof(struct uwsgi_static_variant) * new_size);
+			if (!tmp) {
+				uwsgi_error("uwsgi_static_compress_store_scan()/realloc()");
+				break;
+			}
+			variants = tmp;
+			size = new_size;
+		}
+		variants[n].name = uwsgi_concat2(de->d_name, "");
+		variants[n].atime = st.st_atime;
+		variants[n].size = st.st_size;
+		total += st.st_size;
+		n++;
+	}
+
+	if (total > limit) {
+		qsort(variants, n, sizeof(struct uwsgi_static_variant), static_variant_cmp);
+		for(i=0;i<n && total > limit;i++) {
+			if (unlinkat(dfd, variants[i].name, 0)) continue;
+			total -= variants[i].size;
+		}
+	}
+
+	for(i=0;i<n;i++) free(variants[i].name);
+	if (variants) free(variants);
+	closedir(dir);
+	__atomic_store_n(uwsgi.static_compress_store_used, total, __ATOMIC_RELAXED);
+}
+
+// make room in the store for a file of the specified size (only one process at a time runs the eviction)
+static void static_compress_store_evict(uint64_t needed) {
+	char lock_path[PATH_MAX + 1];
+	int ret = snprintf(lock_path, PATH_MAX + 1, "%s/.evict.lock", uwsgi.static_compress_store);
+	if (ret <= 0 || ret > PATH_MAX) return;
+	int fd = open(lock_path, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, S_IRUSR | S_IWUSR);
+	if (fd < 0) {
+		struct stat st;
+		if (errno == EEXIST && !stat(lock_path, &st) && st.st_mtime + UWSGI_STATIC_COMPRESS_LOCK_TIMEOUT < uwsgi_now()) {
+			unlink(lock_path);
+		}
+		return;
+	}
+	close(fd);
+	uint64_t limit = (uwsgi.static_compress_store_limit / 4) * 3;
+	if (uwsgi.static_compress_store_limit - needed < limit) limit = uwsgi.static_compress_store_limit - needed;
+	uwsgi_static_compress_store_scan(limit, 0);
+	unlink(lock_path);
+}
+
+// write the whole buffer to a new temp file in the store, returns its fd
+static int static_compress_store_tmp(struct uwsgi_buffer *ub, char *tmp_path) {
+	int ret = snprintf(tmp_path, PATH_MAX + 1, "%s/.tmp-XXXXXX", uwsgi.static_compress_store);
+	if (ret <= 0 || ret > PATH_MAX) return -1;
+	int fd = mkstemp(tmp_path);
+	if (fd < 0) {
+		uwsgi_error("static_compress_store_tmp()/mkstemp()");
+		return -1;
+	}
+	size_t pos = 0;
+	while(pos < ub->pos) {
+		ssize_t wlen = write(fd, ub->buf + pos, ub->pos - pos);
+		if (wlen <= 0) {
+			if (wlen < 0 && errno == EINTR) continue;
+			uwsgi_error("static_compress_store_tmp()/write()");
+			close(fd);
+			unlink(tmp_path);
+			return -1;
+		}
+		pos += wlen;
+	}
+	return fd;
+}
+
+// compress the file to the variant, the lock is always released
+static int static_compress_store_run(char *filename, struct stat *st, struct uwsgi_static_encoding *use, char *path, char *lock_path) {
+	struct uwsgi_buffer *ub = NULL;
+	char *buf = NULL;
+	int ret = -1;
+
+	int fd = open(filename, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		uwsgi_error_open(filename);
+		goto end;
+	}
+	buf = uwsgi_malloc(st->st_size);
+	size_t pos = 0;
+	while(pos < (size_t) st->st_size) {
+		ssize_t rlen = read(fd, buf + pos, st->st_size - pos);
+		if (rlen < 0 && errno == EINTR) continue;
+		// the file has been truncated (or is unreadable), a new stat() will give a new variant
+		if (rlen <= 0) break;
+		pos += rlen;
+	}
+	close(fd);
+	if (pos != (size_t) st->st_size) goto end;
+
+	ub = use->compress(buf, st->st_size);
+	if (!ub) goto end;
+
+	// not worth it
+	if (ub->pos >= (size_t) st->st_size) goto end;
+
+	// write to a temp file and rename it, so the variant is never seen partially written
+	char tmp_path[PATH_MAX + 1];
+	fd = static_compress_store_tmp(ub, tmp_path);
+	if (fd < 0) goto end;
+	close(fd);
+	if (rename(tmp_path, path)) {
+		uwsgi_error("static_compress_store_run()/rename()");
+		unlink(tmp_path);
+		goto end;
+	}
+	__atomic_add_fetch(uwsgi.static_compress_store_used, ub->pos, __ATOMIC_RELAXED);
+	ret = 0;
+end:
+	if (buf) free(buf);
+	if (ub) uwsgi_buffer_destroy(ub);
+	unlink(lock_path);
+	return ret;
+}
+
+// a variant to compress in background
+struct uwsgi_static_compress_job {
+	char *filename;
+	char *path;
+	char *lock_path;
+	struct stat st;
+	struct uwsgi_static_encoding *use;
+};
+
+static struct uwsgi_thread *static_compressor;
+static pid_t static_compressor_pid;
+static pthread_mutex_t static_compressor_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void static_compress_store_loop(struct uwsgi_thread *ut) {
+	for(;;) {
+		int interesting_fd = -1;
+		int ret = event_queue_wait(ut->queue, -1, &interesting_fd);
+		if (ret <= 0 || interesting_fd != ut->pipe[1]) continue;
+		struct uwsgi_static_compress_job *job = NULL;
+		ssize_t len = read(ut->pipe[1], &job, sizeof(job));
+		if (len != sizeof(job)) {
+			if (len < 0 && (errno == EAGAIN || errno == EINTR)) continue;
+			uwsgi_error("static_compress_store_loop()/read()");
+			continue;
+		}
+		static_compress_store_run(job->filename, &job->st, job->use, job->path, job->lock_path);
+		free(job->filename);
+		free(job->path);
+		free(job->lock_path);
+		free(job);
+	}
+}
+
+// pass the variant to the compression thread of the worker
+static int static_compress_store_enqueue(char *filename, struct stat *st, struct uwsgi_static_encoding *use, char *path, char *lock_path) {
+	pthread_mutex_lock(&static_compressor_lock);
+	// the thread is not inherited by forked processes
+	if (!static_compressor || static_compressor_pid != uwsgi.mypid) {
+		static_compressor = uwsgi_thread_new(static_compress_store_loop);
+		static_compressor_pid = uwsgi.mypid;
+	}
+	struct uwsgi_thread *ut = static_compressor;
+	pthread_mutex_unlock(&static_compressor_lock);
+	if (!ut) return -1;
+
+	struct uwsgi_static_compress_job *job = uwsgi_calloc(sizeof(struct uwsgi_static_compress_job));
+	job->filename = uwsgi_str(filename);
+	job->path = uwsgi_str(path);
+	job->lock_path = uwsgi_str(lock_path);
+	memcpy(&job->st, st, sizeof(struct stat));
+	job->use = use;
+	// the queue is full, one of the next hits will try again
+	if (write(ut->pipe[0], &job, sizeof(job)) != sizeof(job)) {
+		free(job->filename);
+		free(job->path);
+		free(job->lock_path);
+		free(job);
+		return -1;
+	}
+	return 0;
+}
 
-gzip:
+static int static_compress_store_variant(char *filename, struct stat *st, struct uwsgi_static_encoding *use, char *path) {
+	int ret = snprintf(path, PATH_MAX + 1, "%s/%llu-%llu-%llu-%llu%s", uwsgi.static_compress_store,
+		(unsigned long long) st->st_dev, (unsigned long long) st->st_ino,
+		(unsigned long long) st->st_mtime, (unsigned long long) st->st_size, use->ext);
+	if (ret <= 0 || ret > PATH_MAX) return -1;
 
-	memcpy(filename + *filename_len, ".gz\0", 4);
-	*filename_len += 3;
-	
-	if (stat(filename, st)) {
-		*filename_len -= 3;
+	struct stat vst;
+	if (!stat(path, &vst)) return 0;
+
+	if ((uint64_t) st->st_size > uwsgi.static_compress_max_size || st->st_size == 0) return -1;
+	if (__atomic_load_n(uwsgi.static_compress_store_used, __ATOMIC_RELAXED) + st->st_size > uwsgi.static_compress_store_limit) {
+		// the file will be compressed by one of the next hits
+		if ((uint64_t) st->st_size < uwsgi.static_compress_store_limit) static_compress_store_evict(st->st_size);
+		return -1;
+	}
+
+	// only one request compresses the variant, the others serve the identity in the meantime
+	char lock_path[PATH_MAX + 6];
+	snprintf(lock_path, PATH_MAX + 6, "%s.lock", path);
+	int fd = open(lock_path, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, S_IRUSR | S_IWUSR);
+	if (fd < 0) {
+		// the next hit will try again
+		if (errno == EEXIST && !stat(lock_path, &vst) && vst.st_mtime + UWSGI_STATIC_COMPRESS_LOCK_TIMEOUT < uwsgi_now()) {
+			unlink(lock_path);
+		}
+		return -1;
+	}
+	close(fd);
+
+	if ((uint64_t) st->st_size <= uwsgi.static_compress_inline_max_size) {
+		return static_compress_store_run(filename, st, use, path, lock_path);
+	}
+
+	if (static_compress_store_enqueue(filename, st, use, path, lock_path)) {
+		unlink(lock_path);
+	}
+	return -1;
+}
+
+/*
+	returns the Content-Encoding to use (NULL for none), filename and st are updated with the variant.
+	vary is set when the file is negotiable, even if the identity is served
+*/
+char *uwsgi_static_want_encoding(struct wsgi_request *wsgi_req, char *filename, size_t *filename_len, struct stat *st, int *vary) {
+	struct uwsgi_static_encoding *use;
+
+	*vary = 0;
+	// check for filename size
+	if (*filename_len + 5 > PATH_MAX) return NULL;
+	if (!static_want_compression(filename, *filename_len)) return NULL;
+	*vary = 1;
+	if (!wsgi_req->encoding_len) return NULL;
+
+	// precompressed siblings
+	for(use=static_encodings;use->name;use++) {
+		if (!static_accept_encoding(wsgi_req->encoding, wsgi_req->encoding_len, use->name, use->name_len)) continue;
+		memcpy(filename + *filename_len, use->ext, use->ext_len + 1);
+		struct stat vst;
+		if (!stat(filename, &vst) && S_ISREG(vst.st_mode)) {
+			*filename_len += use->ext_len;
+			memcpy(st, &vst, sizeof(struct stat));
+			return use->name;
+		}
 		filename[*filename_len] = 0;
-		return 0;
 	}
-	
-	return 1;
+
+	if (!uwsgi.static_compress_store) return NULL;
+
+	// compressed on first hit
+	for(use=static_encodings;use->name;use++) {
+		if (!use->compress) continue;
+		if (!static_accept_encoding(wsgi_req->encoding, wsgi_req->encoding_len, use->name, use->name_len)) continue;
+		char path[PATH_MAX + 1];
+		if (static_compress_store_variant(filename, st, use, path)) continue;
+		struct stat vst;
+		if (stat(path, &vst)) continue;
+		size_t path_len = strlen(path);
+		memcpy(filename, path, path_len + 1);
+		*filename_len = path_len;
+		memcpy(st, &vst, sizeof(struct stat));
+		return use->name;
+	}
+
+	return NULL;
 }
 
 int uwsgi_http_date(time_t t, char *dst) {
@@ -439,16 +819,323 @@ static int uwsgi_static_stat(struct wsgi_request *wsgi_req, char *filename, size
 	return -1;
 }
 
-int uwsgi_real_file_serve(struct wsgi_request *wsgi_req, char *real_filename, size_t real_filename_len, struct stat *st) {
+/*
+
+	static files open cache (--static-open-cache)
+
+	every worker keeps a direct-mapped table of the most recently served files, keyed by the
+	requested path. An entry holds the realpath, the stat, an opened fd and the precomputed
+	headers, so a hit costs no filesystem syscalls besides sendfile(). Entries are revalidated
+	after --static-open-cache-ttl seconds.
+
+*/
+
+static void static_open_cache_free(struct uwsgi_static_file *usf) {
+	if (usf->fd > -1) close(usf->fd);
+	free(usf->key);
+	free(usf->real_filename);
+	free(usf);
+}
+
+// lock_static must be held
+static void static_open_cache_evict(struct uwsgi_static_file *usf) {
+	usf->evicted = 1;
+	if (!usf->refs) static_open_cache_free(usf);
+}
+
+static struct uwsgi_static_file *static_open_cache_get(struct wsgi_request *wsgi_req, char *key, size_t key_len) {
+	struct uwsgi_static_file *usf = NULL;
+	time_t now = wsgi_req->start_of_request / 1000000;
+
+	if (uwsgi.threads > 1)
+		pthread_mutex_lock(&uwsgi.lock_static);
+
+	if (uwsgi.static_open_cache_table) {
+		uint32_t slot = djb33x_hash(key, key_len) % uwsgi.static_open_cache;
+		usf = uwsgi.static_open_cache_table[slot];
+		if (usf && !uwsgi_strncmp(usf->key, usf->key_len, key, key_len)) {
+			if (usf->expires > now) {
+				usf->refs++;
+			}
+			else {
+				uwsgi.static_open_cache_table[slot] = NULL;
+				static_open_cache_evict(usf);
+				usf = NULL;
+			}
+		}
+		else {
+			usf = NULL;
+		}
+	}
+
+	if (uwsgi.threads > 1)
+		pthread_mutex_unlock(&uwsgi.lock_static);
+
+	return usf;
+}
+
+static struct uwsgi_static_file *static_open_cache_add(struct wsgi_request *wsgi_req, char *key, size_t key_len, char *real_filename, size_t real_filename_len, struct stat *st, struct uwsgi_string_list *index) {
+	int fd = -1;
+	// the fd is shared by requests (and threads): the sendfile implementations never use its offset
+	if (uwsgi.file_serve_mode == 0) {
+		fd = open(real_filename, O_RDONLY | O_CLOEXEC);
+		if (fd < 0) return NULL;
+	}
+
+	struct uwsgi_static_file *usf = uwsgi_calloc(sizeof(struct uwsgi_static_file));
+	usf->key = uwsgi_concat2n(key, key_len, "", 0);
+	usf->key_len = key_len;
+	usf->real_filename = uwsgi_concat2n(real_filename, real_filename_len, "", 0);
+	usf->real_filename_len = real_filename_len;
+	usf->index = index;
+	usf->fd = fd;
+	memcpy(&usf->st, st, sizeof(struct stat));
+	usf->mime_type = uwsgi_get_mime_type(real_filename, real_filename_len, &usf->mime_type_len);
+	usf->last_modified_len = uwsgi_http_date(st->st_mtime, usf->last_modified);
+	usf->expires = (wsgi_req->start_of_request / 1000000) + uwsgi.static_open_cache_ttl;
+	usf->refs = 1;
+
+	if (uwsgi.threads > 1)
+		pthread_mutex_lock(&uwsgi.lock_static);
+
+	if (!uwsgi.static_open_cache_table) {
+		uwsgi.static_open_cache_table = uwsgi_calloc(sizeof(struct uwsgi_static_file *) * uwsgi.static_open_cache);
+	}
+	uint32_t slot = djb33x_hash(key, key_len) % uwsgi.static_open_cache;
+	if (uwsgi.static_open_cache_table[slot]) {
+		static_open_cache_evict(uwsgi.static_open_cache_table[slot]);
+	}
+	uwsgi.static_open_cache_table[slot] = usf;
+
+	if (uwsgi.threads > 1)
+		pthread_mutex_unlock(&uwsgi.lock_static);
+
+	return usf;
+}
+
+static void static_open_cache_release(struct uwsgi_static_file *usf) {
+	if (!usf) return;
+
+	if (uwsgi.threads > 1)
+		pthread_mutex_lock(&uwsgi.lock_static);
+
+	usf->refs--;
+	if (usf->evicted && !usf->refs) static_open_cache_free(usf);
+
+	if (uwsgi.threads > 1)
+		pthread_mutex_unlock(&uwsgi.lock_static);
+}
+
+/*
+
+	Range requests (RFC 7233)
+
+	ranges are resolved against the size of the served representation, multiple ranges
+	are sent as multipart/byteranges: the parts headers are built in a single buffer
+	and every part is a sendfile segment (a whole offload task when offloading is available)
+
+*/
+
+#define UWSGI_STATIC_MAX_RANGES 16
+
+struct uwsgi_static_range {
+	uint64_t from;
+	uint64_t len;
+};
+
+static int static_range_num(char *buf, size_t len, uint64_t *n) {
+	size_t i;
+	// avoid overflows
+	if (len == 0 || len > 19) return -1;
+	*n = 0;
+	for(i=0;i<len;i++) {
+		if (buf[i] < '0' || buf[i] > '9') return -1;
+		*n = (*n * 10) + (buf[i] - '0');
+	}
+	return 0;
+}
+
+/*
+	returns the number of satisfiable ranges, 0 if the header has to be ignored
+	(invalid, too many or overlapping ranges) and -1 if no range is satisfiable
+*/
+static int static_parse_ranges(char *buf, size_t len, uint64_t size, struct uwsgi_static_range *ranges) {
+	int n = 0, specs = 0, j;
+	size_t i = 6;
+
+	if (len < 6 || strncasecmp(buf, "bytes=", 6)) return 0;
+
+	while(i < len) {
+		if (buf[i] == ',' || buf[i] == ' ' || buf[i] == '\t') {
+			i++;
+			continue;
+		}
+		size_t start = i;
+		while(i < len && buf[i] != ',') i++;
+		size_t end = i;
+		while(end > start && (buf[end-1] == ' ' || buf[end-1] == '\t')) end--;
+
+		if (++specs > UWSGI_STATIC_MAX_RANGES) return 0;
+
+		size_t first_len = 0;
+		while(start + first_len < end && buf[start + first_len] != '-') first_len++;
+		if (start + first_len == end) return 0;
+		char *last_ptr = buf + start + first_len + 1;
+		size_t last_len = end - (start + first_len + 1);
+
+		uint64_t first = 0, last = 0;
+		// suffix range
+		if (first_len == 0) {
+			if (static_range_num(last_ptr, last_len, &last)) return 0;
+			if (last == 0 || size == 0) continue;
+			first = last >= size ? 0 : size - last;
+			last = size - 1;
+		}
+		else {
+			if (static_range_num(buf + start, first_len, &first)) return 0;
+			if (last_len > 0) {
+				if (static_range_num(last_ptr, last_len, &last)) return 0;
+				if (last < first) return 0;
+			}
+			if (first >= size) continue;
+			if (last_len == 0 || last >= size) last = size - 1;
+		}
+
+		// overlapping ranges are not worth the multipart overhead
+		for(j=0;j<n;j++) {
+			if (first < ranges[j].from + ranges[j].len && ranges[j].from <= last) return 0;
+		}
+		ranges[n].from = first;
+		ranges[n].len = (last - first) + 1;
+		n++;
+	}
+
+	if (!specs) return 0;
+	if (!n) return -1;
+	return n;
+}
+
+// the ranges are honoured only if the representation is still the one specified by If-Range
+static int static_if_range(struct wsgi_request *wsgi_req, struct stat *st) {
+	uint16_t len = 0;
+	char *value = uwsgi_get_var(wsgi_req, "HTTP_IF_RANGE", 13, &len);
+	if (!value) return 1;
+	// entity tags are never generated by the static file server
+	if (len == 0 || value[0] == '"' || (len > 1 && value[0] == 'W' && value[1] == '/')) return 0;
+	return parse_http_date(value, len) == st->st_mtime;
+}
+
+static int static_content_range(char *buf, size_t buf_len, uint64_t from, uint64_t len, uint64_t size) {
+	int ret = snprintf(buf, buf_len, "bytes %llu-%llu/%llu", (unsigned long long) from, (unsigned long long) (from + len - 1), (unsigned long long) size);
+	if (ret <= 0 || ret >= (int) buf_len) return -1;
+	return ret;
+}
+
+// build the multipart/byteranges parts headers (in ub) and the sendfile segments (in segments)
+static int static_multipart_ranges(struct uwsgi_static_range *ranges, int n, char *boundary, char *mime_type, size_t mime_type_len, uint64_t size, struct uwsgi_buffer *ub, struct uwsgi_buffer *segments) {
+	char content_range[6 + (sizeof(UMAX64_STR) * 3) + 4];
+	int i;
+	for(i=0;i<=n;i++) {
+		struct uwsgi_sendfile_segment uss;
+		memset(&uss, 0, sizeof(struct uwsgi_sendfile_segment));
+		uss.header_pos = ub->pos;
+		if (i > 0) {
+			if (uwsgi_buffer_append(ub, "\r\n", 2)) return -1;
+		}
+		if (uwsgi_buffer_append(ub, "--", 2)) return -1;
+		if (uwsgi_buffer_append(ub, boundary, strlen(boundary))) return -1;
+		// the closing delimiter
+		if (i == n) {
+			if (uwsgi_buffer_append(ub, "--\r\n", 4)) return -1;
+		}
+		else {
+			if (uwsgi_buffer_append(ub, "\r\n", 2)) return -1;
+			if (mime_type && mime_type_len > 0) {
+				if (uwsgi_buffer_append(ub, "Content-Type: ", 14)) return -1;
+				if (uwsgi_buffer_append(ub, mime_type, mime_type_len)) return -1;
+				if (uwsgi_buffer_append(ub, "\r\n", 2)) return -1;
+			}
+			int cr_len = static_content_range(content_range, sizeof(content_range), ranges[i].from, ranges[i].len, size);
+			if (cr_len < 0) return -1;
+			if (uwsgi_buffer_append(ub, "Content-Range: ", 15)) return -1;
+			if (uwsgi_buffer_append(ub, content_range, cr_len)) return -1;
+			if (uwsgi_buffer_append(ub, "\r\n\r\n", 4)) return -1;
+			uss.pos = ranges[i].from;
+			uss.len = ranges[i].len;
+		}
+		uss.header_len = ub->pos - uss.header_pos;
+		if (uwsgi_buffer_append(segments, (char *) &uss, sizeof(struct uwsgi_sendfile_segment))) return -1;
+	}
+	return 0;
+}
+
+// send the parts (the fd is closed if can_close is set)
+static int static_send_multipart(struct wsgi_request *wsgi_req, int fd, int can_close, struct uwsgi_buffer *ub, struct uwsgi_buffer *segments) {
+	struct uwsgi_sendfile_segment *uss = (struct uwsgi_sendfile_segment *) segments->buf;
+	size_t i, n = segments->pos / sizeof(struct uwsgi_sendfile_segment);
+
+	if (wsgi_req->socket->can_offload && !wsgi_req->write_errors && !wsgi_req->ignore_body) {
+		if (uwsgi_response_write_headers_do(wsgi_req)) goto error;
+		if (!can_close) {
+			fd = dup(fd);
+			if (fd < 0) {
+				uwsgi_req_error("static_send_multipart()/dup()");
+				return -1;
+			}
+			can_close = 1;
+		}
+		size_t total = ub->pos;
+		for(i=0;i<n;i++) total += uss[i].len;
+		// on success the offload task takes the ownership of fd and buffers
+		if (!uwsgi_offload_request_sendfile_segments_do(wsgi_req, fd, ub, segments)) {
+			wsgi_req->via = UWSGI_VIA_OFFLOAD;
+			wsgi_req->response_size += total;
+			return 0;
+		}
+		wsgi_req->write_errors++;
+		goto error;
+	}
+
+	// every proto_sendfile hook (ssl and the read()/write() fallback too) reads at the segment position,
+	// never at the file offset, so segments can be sent in any order even on a shared fd
+	for(i=0;i<n;i++) {
+		if (uwsgi_response_write_body_do(wsgi_req, ub->buf + uss[i].header_pos, uss[i].header_len)) goto error;
+		if (uss[i].len > 0) {
+			if (uwsgi_response_sendfile_do_can_close(wsgi_req, fd, uss[i].pos, uss[i].len, 0)) goto error;
+		}
+	}
+	if (can_close) close(fd);
+	uwsgi_buffer_destroy(ub);
+	uwsgi_buffer_destroy(segments);
+	return 0;
+
+error:
+	if (can_close) close(fd);
+	uwsgi_buffer_destroy(ub);
+	uwsgi_buffer_destroy(segments);
+	return -1;
+}
+
+static int real_file_serve(struct wsgi_request *wsgi_req, char *real_filename, size_t real_filename_len, struct stat *st, struct uwsgi_static_file *usf) {
 
 	size_t mime_type_size = 0;
 	char http_last_modified[49];
-	int use_gzip = 0;
-
-	char *mime_type = uwsgi_get_mime_type(real_filename, real_filename_len, &mime_type_size);
+	char *last_modified = http_last_modified;
+	int last_modified_len = 0;
+	char *encoding = NULL;
+	int vary = 0;
+	char *mime_type = NULL;
+
+	if (usf) {
+		mime_type = usf->mime_type;
+		mime_type_size = usf->mime_type_len;
+	}
+	else {
+		mime_type = uwsgi_get_mime_type(real_filename, real_filename_len, &mime_type_size);
+	}
 
-	// here we need to choose if we want the gzip variant;
-	if (uwsgi_static_want_gzip(wsgi_req, real_filename, &real_filename_len, st)) use_gzip = 1;
+	// here we need to choose if we want a compressed variant;
+	encoding = uwsgi_static_want_encoding(wsgi_req, real_filename, &real_filename_len, st, &vary);
 
 	if (wsgi_req->if_modified_since_len) {
 		time_t ims = parse_http_date(wsgi_req->if_modified_since, wsgi_req->if_modified_since_len);
@@ -466,25 +1153,29 @@ int uwsgi_real_file_serve(struct wsgi_request *wsgi_req, char *real_filename, si
 	wsgi_req->do_not_account_avg_rt = 1;
 
 	size_t fsize = st->st_size;
-        if (wsgi_req->range_to) {
-        	fsize = wsgi_req->range_to - wsgi_req->range_from;
-                if (fsize > (size_t)st->st_size) {
-                	fsize = st->st_size;
-                }
-        }
-	else {
-        	// reset in case of inconsistent size
-        	if (wsgi_req->range_from > fsize) {
-        		wsgi_req->range_from = 0;
-        		fsize = 0;
-        	}
-		else {
-			fsize -= wsgi_req->range_from;
-		}
+	struct uwsgi_static_range ranges[UWSGI_STATIC_MAX_RANGES];
+	int nranges = 0;
+	char boundary[17];
+	struct uwsgi_buffer *parts = NULL;
+	struct uwsgi_buffer *segments = NULL;
+
+	// with X-Sendfile/X-Accel-Redirect ranges are managed by the webserver
+	if (wsgi_req->http_range_len > 0 && !uwsgi.file_serve_mode && static_if_range(wsgi_req, st)) {
+		nranges = static_parse_ranges(wsgi_req->http_range, wsgi_req->http_range_len, st->st_size, ranges);
+	}
+
+	if (nranges < 0) {
+		char content_range[7 + sizeof(UMAX64_STR) + 1];
+		int cr_len = snprintf(content_range, sizeof(content_range), "bytes */%llu", (unsigned long long) st->st_size);
+		if (cr_len <= 0 || cr_len >= (int) sizeof(content_range)) return -1;
+		if (uwsgi_response_prepare_headers(wsgi_req, "416 Range Not Satisfiable", 25)) return -1;
+		if (uwsgi_response_add_header(wsgi_req, "Content-Range", 13, content_range, cr_len)) return -1;
+		if (uwsgi_response_add_content_length(wsgi_req, 0)) return -1;
+		return uwsgi_response_write_headers_do(wsgi_req);
 	}
 
 	// HTTP status
-	if (fsize > 0 && (wsgi_req->range_from || wsgi_req->range_to)) {
+	if (nranges > 0) {
 		if (uwsgi_response_prepare_headers(wsgi_req, "206 Partial Content", 19)) return -1;
 	}
 	else {
@@ -497,12 +1188,24 @@ int uwsgi_real_file_serve(struct wsgi_request *wsgi_req, char *real_filename, si
 	uwsgi_add_expires_uri(wsgi_req, st);
 #endif
 
-	if (use_gzip) {
-		if (uwsgi_response_add_header(wsgi_req, "Content-Encoding", 16, "gzip", 4)) return -1;
+	if (encoding) {
+		if (uwsgi_response_add_header(wsgi_req, "Content-Encoding", 16, encoding, strlen(encoding))) return -1;
+	}
+	if (vary) {
+		if (uwsgi_response_add_header(wsgi_req, "Vary", 4, "Accept-Encoding", 15)) return -1;
 	}
 
-	// Content-Type (if available)
-	if (mime_type_size > 0 && mime_type) {
+	// Content-Type (if available), multiple ranges have it in every part
+	if (nranges > 1) {
+		snprintf(boundary, sizeof(boundary), "%08x%08x", (unsigned int) uwsgi_micros(), (unsigned int) rand());
+		char content_type[sizeof("multipart/byteranges; boundary=") + sizeof(boundary)];
+		int ct_len = snprintf(content_type, sizeof(content_type), "multipart/byteranges; boundary=%s", boundary);
+		if (uwsgi_response_add_content_type(wsgi_req, content_type, ct_len)) return -1;
+		if (mime_type_size > 0 && mime_type) {
+			uwsgi_add_expires_type(wsgi_req, mime_type, mime_type_size, st);
+		}
+	}
+	else if (mime_type_size > 0 && mime_type) {
 		if (uwsgi_response_add_content_type(wsgi_req, mime_type, mime_type_size)) return -1;
 		// check for content-type related headers
 		uwsgi_add_expires_type(wsgi_req, mime_type, mime_type_size, st);
@@ -511,47 +1214,100 @@ int uwsgi_real_file_serve(struct wsgi_request *wsgi_req, char *real_filename, si
 	// increase static requests counter
 	uwsgi.workers[uwsgi.mywid].cores[wsgi_req->async_id].static_requests++;
 
+	// the cached entry refers to the uncompressed file
+	if (usf && !encoding) {
+		last_modified = usf->last_modified;
+		last_modified_len = usf->last_modified_len;
+	}
+	else {
+		last_modified_len = uwsgi_http_date(st->st_mtime, http_last_modified);
+	}
+
 	// nginx
 	if (uwsgi.file_serve_mode == 1) {
 		if (uwsgi_response_add_header(wsgi_req, "X-Accel-Redirect", 16, real_filename, real_filename_len)) return -1;
 		// this is the final header (\r\n added)
-		int size = uwsgi_http_date(st->st_mtime, http_last_modified);
-		if (uwsgi_response_add_header(wsgi_req, "Last-Modified", 13, http_last_modified, size)) return -1;
+		if (uwsgi_response_add_header(wsgi_req, "Last-Modified", 13, last_modified, last_modified_len)) return -1;
 	}
 	// apache
 	else if (uwsgi.file_serve_mode == 2) {
 		if (uwsgi_response_add_header(wsgi_req, "X-Sendfile", 10, real_filename, real_filename_len)) return -1;
 		// this is the final header (\r\n added)
-		int size = uwsgi_http_date(st->st_mtime, http_last_modified);
-		if (uwsgi_response_add_header(wsgi_req, "Last-Modified", 13, http_last_modified, size)) return -1;
+		if (uwsgi_response_add_header(wsgi_req, "Last-Modified", 13, last_modified, last_modified_len)) return -1;
 	}
 	// raw
 	else {
-		// set Content-Length (to fsize NOT st->st_size)
-		if (uwsgi_response_add_content_length(wsgi_req, fsize)) return -1;
-		if (fsize > 0 && (wsgi_req->range_from || wsgi_req->range_to)) {
-			// here use the original size !!!
-			if (uwsgi_response_add_content_range(wsgi_req, wsgi_req->range_from, wsgi_req->range_to, st->st_size)) return -1;
+		if (uwsgi.honour_range) {
+			if (uwsgi_response_add_header(wsgi_req, "Accept-Ranges", 13, "bytes", 5)) return -1;
 		}
-		int size = uwsgi_http_date(st->st_mtime, http_last_modified);
-		if (uwsgi_response_add_header(wsgi_req, "Last-Modified", 13, http_last_modified, size)) return -1;
+		if (nranges == 1) {
+			char content_range[6 + (sizeof(UMAX64_STR) * 3) + 4];
+			int cr_len = static_content_range(content_range, sizeof(content_range), ranges[0].from, ranges[0].len, st->st_size);
+			if (cr_len < 0) return -1;
+			if (uwsgi_response_add_header(wsgi_req, "Content-Range", 13, content_range, cr_len)) return -1;
+			fsize = ranges[0].len;
+		}
+		else if (nranges > 1) {
+			parts = uwsgi_buffer_new(uwsgi.page_size);
+			segments = uwsgi_buffer_new(sizeof(struct uwsgi_sendfile_segment) * (nranges + 1));
+			if (static_multipart_ranges(ranges, nranges, boundary, mime_type, mime_type_size, st->st_size, parts, segments)) {
+				uwsgi_buffer_destroy(parts);
+				uwsgi_buffer_destroy(segments);
+				return -1;
+			}
+			int i;
+			fsize = parts->pos;
+			for(i=0;i<nranges;i++) fsize += ranges[i].len;
+		}
+		// set Content-Length (to fsize NOT st->st_size)
+		if (uwsgi_response_add_content_length(wsgi_req, fsize)) goto error;
+		if (uwsgi_response_add_header(wsgi_req, "Last-Modified", 13, last_modified, last_modified_len)) goto error;
 
 		// if it is a HEAD request just skip transfer
 		if (!uwsgi_strncmp(wsgi_req->method, wsgi_req->method_len, "HEAD", 4)) {
+			if (parts) uwsgi_buffer_destroy(parts);
+			if (segments) uwsgi_buffer_destroy(segments);
 			wsgi_req->status = 200;
 			return 0;
 		}
 
+		size_t from = nranges == 1 ? ranges[0].from : 0;
 		// Ok, the file must be transferred from uWSGI
 		// offloading will be automatically managed
-		int fd = open(real_filename, O_RDONLY);
-		if (fd < 0) return -1;
-		// fd will be closed in the following function
-		uwsgi_response_sendfile_do(wsgi_req, fd, wsgi_req->range_from, fsize);
+		if (usf && !encoding && usf->fd > -1) {
+			// the cached fd is never closed here (it is dup()'ed for offloading)
+			if (parts) {
+				// buffers are consumed
+				static_send_multipart(wsgi_req, usf->fd, 0, parts, segments);
+			}
+			else {
+				uwsgi_response_sendfile_do_can_close(wsgi_req, usf->fd, from, fsize, 0);
+			}
+		}
+		else {
+			int fd = open(real_filename, O_RDONLY);
+			if (fd < 0) goto error;
+			// fd will be closed in the following function
+			if (parts) {
+				static_send_multipart(wsgi_req, fd, 1, parts, segments);
+			}
+			else {
+				uwsgi_response_sendfile_do(wsgi_req, fd, from, fsize);
+			}
+		}
 	}
 
 	wsgi_req->status = 200;
 	return 0;
+
+error:
+	if (parts) uwsgi_buffer_destroy(parts);
+	if (segments) uwsgi_buffer_destroy(segments);
+	return -1;
+}
+
+int uwsgi_real_file_serve(struct wsgi_request *wsgi_req, char *real_filename, size_t real_filename_len, struct stat *st) {
+	return real_file_serve(wsgi_req, real_filename, real_filename_len, st, NULL);
 }
 
 
@@ -578,6 +1334,18 @@ int uwsgi_file_serve(struct wsgi_request *wsgi_req, char *document_root, uint16_
 	uwsgi_log("[uwsgi-fileserve] checking for %s\n", filename);
 #endif
 
+	struct uwsgi_static_file *usf = NULL;
+	if (uwsgi.static_open_cache > 0) {
+		usf = static_open_cache_get(wsgi_req, filename, filename_len);
+		if (usf) {
+			memcpy(real_filename, usf->real_filename, usf->real_filename_len + 1);
+			real_filename_len = usf->real_filename_len;
+			memcpy(&st, &usf->st, sizeof(struct stat));
+			index = usf->index;
+			goto found;
+		}
+	}
+
 	if (uwsgi.static_cache_paths) {
 		uwsgi_rlock(uwsgi.static_cache_paths->lock);
 		uint64_t item_len;
@@ -608,8 +1376,7 @@ int uwsgi_file_serve(struct wsgi_request *wsgi_req, char *document_root, uint16_
 	}
 
 found:
-	free(filename);
-
+	// cached entries are checked too, the same path could be requested with another docroot
 	if (uwsgi_starts_with(real_filename, real_filename_len, document_root, document_root_len)) {
 		struct uwsgi_string_list *safe = uwsgi.static_safe;
 		while(safe) {
@@ -619,47 +1386,61 @@ found:
 			safe = safe->next;
 		}
 		uwsgi_log("[uwsgi-fileserve] security error: %s is not under %.*s or a safe path\n", real_filename, document_root_len, document_root);
+		free(filename);
+		static_open_cache_release(usf);
 		return -1;
 	}
 
 safe:
 
-	if (!uwsgi_static_stat(wsgi_req, real_filename, &real_filename_len, &st, &index)) {
+	if (!usf) {
+		if (uwsgi_static_stat(wsgi_req, real_filename, &real_filename_len, &st, &index)) {
+			free(filename);
+			return -1;
+		}
+		if (uwsgi.static_open_cache > 0) {
+			usf = static_open_cache_add(wsgi_req, filename, filename_len, real_filename, real_filename_len, &st, index);
+		}
+	}
+	free(filename);
 
-		if (index) {
-			// if we are here the PATH_INFO need to be changed
-			if (uwsgi_req_append_path_info_with_index(wsgi_req, index->value, index->len)) {
-                        	return -1;
-                        }
+	int ret = -1;
+
+	if (index) {
+		// if we are here the PATH_INFO need to be changed
+		if (uwsgi_req_append_path_info_with_index(wsgi_req, index->value, index->len)) {
+			goto end;
 		}
+	}
 
-		// skip methods other than GET and HEAD
-        	if (uwsgi_strncmp(wsgi_req->method, wsgi_req->method_len, "GET", 3) && uwsgi_strncmp(wsgi_req->method, wsgi_req->method_len, "HEAD", 4)) {
-			return -1;
-        	}
-
-		// check for skippable ext
-		struct uwsgi_string_list *sse = uwsgi.static_skip_ext;
-		while (sse) {
-			if (real_filename_len >= sse->len) {
-				if (!uwsgi_strncmp(real_filename + (real_filename_len - sse->len), sse->len, sse->value, sse->len)) {
-					return -1;
-				}
+	// skip methods other than GET and HEAD
+	if (uwsgi_strncmp(wsgi_req->method, wsgi_req->method_len, "GET", 3) && uwsgi_strncmp(wsgi_req->method, wsgi_req->method_len, "HEAD", 4)) {
+		goto end;
+	}
+
+	// check for skippable ext
+	struct uwsgi_string_list *sse = uwsgi.static_skip_ext;
+	while (sse) {
+		if (real_filename_len >= sse->len) {
+			if (!uwsgi_strncmp(real_filename + (real_filename_len - sse->len), sse->len, sse->value, sse->len)) {
+				goto end;
 			}
-			sse = sse->next;
 		}
+		sse = sse->next;
+	}
 
 #ifdef UWSGI_ROUTING
-		// before sending the file, we need to check if some rule applies
-		if (!wsgi_req->is_routing && uwsgi_apply_routes_do(uwsgi.routes, wsgi_req, NULL, 0) == UWSGI_ROUTE_BREAK) {
-			return 0;
-		}
-		wsgi_req->routes_applied = 1;
-#endif
-
-		return uwsgi_real_file_serve(wsgi_req, real_filename, real_filename_len, &st);
+	// before sending the file, we need to check if some rule applies
+	if (!wsgi_req->is_routing && uwsgi_apply_routes_do(uwsgi.routes, wsgi_req, NULL, 0) == UWSGI_ROUTE_BREAK) {
+		ret = 0;
+		goto end;
 	}
+	wsgi_req->routes_applied = 1;
+#endif
 
-	return -1;
+	ret = real_file_serve(wsgi_req, real_filename, real_filename_len, &st, usf);
+end:
+	static_open_cache_release(usf);
+	return ret;
 
 }
@@ -705,6 +705,76 @@ static int subscription_is_safe(struct uwsgi_subscribe_req *usr) {
         }
 	return 0;
 }
+
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+#define EVP_PKEY_up_ref(x) CRYPTO_add(&(x)->references, 1, CRYPTO_LOCK_EVP_PKEY)
+#endif
+
+/*
+	public keys cache
+
+	slots are destroyed when their last node goes away (and packets for unknown keys
+	never get one), so the public keys are cached by subscription key and reloaded only
+	when their file changes, instead of parsing the PEM file again for every new slot.
+	The cache holds a reference, every slot gets its own.
+*/
+struct uwsgi_subscription_pubkey {
+	char *key;
+	uint16_t keylen;
+	dev_t dev;
+	ino_t ino;
+	time_t mtime;
+	EVP_PKEY *pkey;
+	struct uwsgi_subscription_pubkey *next;
+};
+
+static struct uwsgi_subscription_pubkey *subscription_pubkeys;
+
+static EVP_PKEY *subscription_get_pubkey(struct uwsgi_subscribe_req *usr) {
+	struct stat st;
+	char *keyfile = uwsgi_sanitize_cert_filename(uwsgi.subscriptions_sign_check_dir, usr->key, usr->keylen);
+	if (stat(keyfile, &st)) {
+		free(keyfile);
+		return NULL;
+	}
+
+	struct uwsgi_subscription_pubkey *usp = subscription_pubkeys;
+	while(usp) {
+		if (!uwsgi_strncmp(usp->key, usp->keylen, usr->key, usr->keylen)) break;
+		usp = usp->next;
+	}
+
+	if (usp && usp->dev == st.st_dev && usp->ino == st.st_ino && usp->mtime == st.st_mtime) {
+		free(keyfile);
+		EVP_PKEY_up_ref(usp->pkey);
+		return usp->pkey;
+	}
+
+	FILE *kf = fopen(keyfile, "r");
+	free(keyfile);
+	if (!kf) return NULL;
+	EVP_PKEY *pkey = PEM_read_PUBKEY(kf, NULL, NULL, NULL);
+	fclose(kf);
+	if (!pkey) return NULL;
+
+	if (!usp) {
+		usp = uwsgi_calloc(sizeof(struct uwsgi_subscription_pubkey));
+		usp->key = uwsgi_concat2n(usr->key, usr->keylen, "", 0);
+		usp->keylen = usr->keylen;
+		usp->next = subscription_pubkeys;
+		subscription_pubkeys = usp;
+	}
+	else {
+		EVP_PKEY_free(usp->pkey);
+	}
+	usp->dev = st.st_dev;
+	usp->ino = st.st_ino;
+	usp->mtime = st.st_mtime;
+	usp->pkey = pkey;
+	EVP_PKEY_up_ref(pkey);
+	return pkey;
+}
+
 static int subscription_new_sign_ctx(struct uwsgi_subscribe_slot *slot, struct uwsgi_subscribe_req *usr) {
 	if (subscription_is_safe(usr)) return 1;
 
@@ -716,12 +786,7 @@ static int subscription_new_sign_ctx(struct uwsgi_subscribe_slot *slot, struct u
 		return 0;
         }
 
-	char *keyfile = uwsgi_sanitize_cert_filename(uwsgi.subscriptions_sign_check_dir, usr->key, usr->keylen);
-	FILE *kf = fopen(keyfile, "r");
-	free(keyfile);
-	if (!kf) return 0;
-	slot->sign_public_key = PEM_read_PUBKEY(kf, NULL, NULL, NULL);
-	fclose(kf);
+	slot->sign_public_key = subscription_get_pubkey(usr);
 	if (!slot->sign_public_key) {
         	uwsgi_log("unable to load public key for %.*s\n", usr->keylen, usr->key);
 		return 0;
@@ -768,7 +833,6 @@ int uwsgi_subscription_sign_check(struct uwsgi_subscribe_slot *slot, struct uwsg
 		return 0;
 	}
 
-
 	return 1;
 }
 #endif
@@ -12,26 +12,120 @@
 
 	Transformations (if required) could completely swallow already set headers
 
+	The body flows through the chain as a list of iovecs (wsgi_req->transformed_iov, slot 0
+	is reserved for the response headers). Transformations flagged with "can_iov" work directly
+	on the list (framing ones only prepend/append their vectors, without copying the payload),
+	the others receive the vectors merged in their chunk buffer (buffering ones flagged with
+	"can_iov" can still output a list of vectors at the end of the request). Vectors refer to memory owned by
+	the writer or by the transformations, and are valid until the next round.
+
 */
 
 extern struct uwsgi_server uwsgi;
 
+static int transformation_iov_grow(struct wsgi_request *wsgi_req) {
+	// one more vector + the headers slot
+	if (wsgi_req->transformed_iov_cnt + 2 <= wsgi_req->transformed_iov_size) return 0;
+	size_t new_size = wsgi_req->transformed_iov_size ? wsgi_req->transformed_iov_size * 2 : 8;
+	struct iovec *iov = realloc(wsgi_req->transformed_iov, sizeof(struct iovec) * new_size);
+	if (!iov) {
+		uwsgi_error("transformation_iov_grow()/realloc()");
+		return -1;
+	}
+	wsgi_req->transformed_iov = iov;
+	wsgi_req->transformed_iov_size = new_size;
+	return 0;
+}
+
+void uwsgi_transformation_iov_reset(struct wsgi_request *wsgi_req) {
+	wsgi_req->transformed_iov_cnt = 0;
+}
+
+int uwsgi_transformation_iov_append(struct wsgi_request *wsgi_req, char *buf, size_t len) {
+	if (len == 0) return 0;
+	if (transformation_iov_grow(wsgi_req)) return -1;
+	struct iovec *iov = &wsgi_req->transformed_iov[1 + wsgi_req->transformed_iov_cnt];
+	iov->iov_base = buf;
+	iov->iov_len = len;
+	wsgi_req->transformed_iov_cnt++;
+	return 0;
+}
+
+int uwsgi_transformation_iov_prepend(struct wsgi_request *wsgi_req, char *buf, size_t len) {
+	if (len == 0) return 0;
+	if (transformation_iov_grow(wsgi_req)) return -1;
+	memmove(&wsgi_req->transformed_iov[2], &wsgi_req->transformed_iov[1], sizeof(struct iovec) * wsgi_req->transformed_iov_cnt);
+	wsgi_req->transformed_iov[1].iov_base = buf;
+	wsgi_req->transformed_iov[1].iov_len = len;
+	wsgi_req->transformed_iov_cnt++;
+	return 0;
+}
+
+struct iovec *uwsgi_transformation_iov(struct wsgi_request *wsgi_req, size_t *cnt) {
+	*cnt = wsgi_req->transformed_iov_cnt;
+	if (!wsgi_req->transformed_iov) return NULL;
+	return &wsgi_req->transformed_iov[1];
+}
+
+size_t uwsgi_transformation_iov_len(struct wsgi_request *wsgi_req) {
+	size_t i, len = 0;
+	for(i=0;i<wsgi_req->transformed_iov_cnt;i++) {
+		len += wsgi_req->transformed_iov[1 + i].iov_len;
+	}
+	return len;
+}
+
+// merge the vectors in the chunk buffer of a transformation
+static int transformation_iov_merge(struct wsgi_request *wsgi_req, struct uwsgi_transformation *ut) {
+	size_t i;
+	for(i=0;i<wsgi_req->transformed_iov_cnt;i++) {
+		struct iovec *iov = &wsgi_req->transformed_iov[1 + i];
+		if (uwsgi_buffer_append(ut->chunk, iov->iov_base, iov->iov_len)) return -1;
+	}
+	return 0;
+}
+
+// expose the result of the chain to the writer
+static void transformation_iov_done(struct wsgi_request *wsgi_req) {
+	if (wsgi_req->transformed_iov_cnt == 1) {
+		wsgi_req->transformed_chunk = wsgi_req->transformed_iov[1].iov_base;
+		wsgi_req->transformed_chunk_len = wsgi_req->transformed_iov[1].iov_len;
+	}
+	else if (wsgi_req->transformed_iov_cnt > 1) {
+		// the writer will use writev()
+		wsgi_req->transformed_chunk = NULL;
+		wsgi_req->transformed_chunk_len = uwsgi_transformation_iov_len(wsgi_req);
+	}
+}
+
 // -1 error, 0 = no buffer, send the body, 1 = buffer
 int uwsgi_apply_transformations(struct wsgi_request *wsgi_req, char *buf, size_t len) {
 	wsgi_req->transformed_chunk = NULL;
 	wsgi_req->transformed_chunk_len = 0;
 	struct uwsgi_transformation *ut = wsgi_req->transformations;
-	char *t_buf = buf;
-	size_t t_len = len;
 	uint8_t flushed = 0;
+
+	uwsgi_transformation_iov_reset(wsgi_req);
+	if (uwsgi_transformation_iov_append(wsgi_req, buf, len)) return -1;
+
 	while(ut) {
+		// skip final transformations before appending data
+		if (ut->is_final) goto next;
+
+		if (ut->can_iov && ut->can_stream) {
+			ut->round++;
+			if (ut->func(wsgi_req, ut)) {
+				return -1;
+			}
+			if (ut->flushed) flushed = 1;
+			goto next;
+		}
+
 		// allocate the buffer (if needed)
 		if (!ut->chunk) {
-			ut->chunk = uwsgi_buffer_new(t_len);
+			ut->chunk = uwsgi_buffer_new(uwsgi_transformation_iov_len(wsgi_req));
 		}
-		// skip final transformations before appending data
-		if (ut->is_final) goto next;
-		if (uwsgi_buffer_append(ut->chunk, t_buf, t_len)) {
+		if (transformation_iov_merge(wsgi_req, ut)) {
 			return -1;
 		}
 
@@ -45,8 +139,8 @@ int uwsgi_apply_transformations(struct wsgi_request *wsgi_req, char *buf, size_t
 
 		if (ut->flushed) flushed = 1;
 
-		t_buf = ut->chunk->buf;
-		t_len = ut->chunk->pos;
+		uwsgi_transformation_iov_reset(wsgi_req);
+		if (uwsgi_transformation_iov_append(wsgi_req, ut->chunk->buf, ut->chunk->pos)) return -1;
 		// we reset the buffer, so we do not waste memory
 		ut->chunk->pos = 0;
 next:
@@ -56,8 +150,7 @@ next:
 	// if we are here we can tell the writer to send the body to the client
 	// no buffering please
 	if (!flushed) {
-		wsgi_req->transformed_chunk = t_buf;
-		wsgi_req->transformed_chunk_len = t_len;
+		transformation_iov_done(wsgi_req);
 	}
 	return 0;
 
@@ -72,10 +165,11 @@ int uwsgi_apply_final_transformations(struct wsgi_request *wsgi_req) {
 	struct uwsgi_transformation *ut = wsgi_req->transformations;
 	wsgi_req->transformed_chunk = NULL;
         wsgi_req->transformed_chunk_len = 0;
-	char *t_buf = NULL;
-	size_t t_len = 0;
 	uint8_t flushed = 0;
 	int found_nostream = 0;
+
+	uwsgi_transformation_iov_reset(wsgi_req);
+
 	while(ut) {
 		if (!found_nostream) {
 			if (!ut->can_stream) {
@@ -83,14 +177,27 @@ int uwsgi_apply_final_transformations(struct wsgi_request *wsgi_req) {
 			}
 			else {
 				// stop the chain if no chunk is available
-				if (!ut->chunk) return 0;
-				t_buf = ut->chunk->buf;
-                		t_len = ut->chunk->pos;
+				if (!ut->chunk && !ut->round) return 0;
+				uwsgi_transformation_iov_reset(wsgi_req);
+				// vectors based transformations have nothing left
+				if (ut->chunk && !ut->can_iov) {
+					if (uwsgi_transformation_iov_append(wsgi_req, ut->chunk->buf, ut->chunk->pos)) return -1;
+				}
 				goto next;
 			}
 		}
 
+		if (ut->can_iov && ut->can_stream) {
+			ut->round++;
+			if (ut->func(wsgi_req, ut)) {
+				return -1;
+			}
+			if (ut->flushed) flushed = 1;
+			goto next;
+		}
+
 		if (!ut->chunk) {
+			size_t t_len = uwsgi_transformation_iov_len(wsgi_req);
 			if (t_len > 0) {
 				ut->chunk = uwsgi_buffer_new(t_len);
 			}
@@ -99,10 +206,8 @@ int uwsgi_apply_final_transformations(struct wsgi_request *wsgi_req) {
 			}
 		}
 		
-		if (t_len > 0) {
-			if (uwsgi_buffer_append(ut->chunk, t_buf, t_len)) {
-				return -1;
-                	}
+		if (transformation_iov_merge(wsgi_req, ut)) {
+			return -1;
 		}
 		
 		// run the transformation
@@ -113,16 +218,18 @@ int uwsgi_apply_final_transformations(struct wsgi_request *wsgi_req) {
 
 		if (ut->flushed) flushed = 1;
 
-		t_buf = ut->chunk->buf;
-		t_len = ut->chunk->pos;
+		// buffering transformations flagged with "can_iov" set their output vectors by themselves
+		if (!ut->can_iov) {
+			uwsgi_transformation_iov_reset(wsgi_req);
+			if (uwsgi_transformation_iov_append(wsgi_req, ut->chunk->buf, ut->chunk->pos)) return -1;
+		}
 next:
 		ut = ut->next;
 	}
 
 	// if we are here, all of the transformations are applied
 	if (!flushed) {
-		wsgi_req->transformed_chunk = t_buf;
-        	wsgi_req->transformed_chunk_len = t_len;
+		transformation_iov_done(wsgi_req);
 	}
         return 0;
 }
@@ -140,9 +247,18 @@ void uwsgi_free_transformations(struct wsgi_request *wsgi_req) {
 		if (current_ut->fd > -1) {
 			close(current_ut->fd);
 		}
+		if (current_ut->destroy) {
+			current_ut->destroy(wsgi_req, current_ut);
+		}
 		ut = ut->next;
 		free(current_ut);
 	}
+	if (wsgi_req->transformed_iov) {
+		free(wsgi_req->transformed_iov);
+		wsgi_req->transformed_iov = NULL;
+		wsgi_req->transformed_iov_size = 0;
+		wsgi_req->transformed_iov_cnt = 0;
+	}
 }
 
 struct uwsgi_transformation *uwsgi_add_transformation(struct wsgi_request *wsgi_req, int (*func)(struct wsgi_request *, struct uwsgi_transformation *), void *data) {
@@ -166,3 +282,56 @@ struct uwsgi_transformation *uwsgi_add_transformation(struct wsgi_request *wsgi_
 
 	return ut;
 }
+
+/*
+
+	compressors contexts are pooled per-core: a core manages a single request at time,
+	so the idle context of a core can be reused (reset) without locking
+
+*/
+struct uwsgi_compressor_ctx *uwsgi_compressor_get(struct wsgi_request *wsgi_req, struct uwsgi_compressor *uc) {
+	struct uwsgi_compressor_ctx *ucc = NULL;
+	if (!uc->pool) {
+		struct uwsgi_compressor_ctx **pool = uwsgi_calloc(sizeof(struct uwsgi_compressor_ctx *) * uwsgi.cores);
+		// another thread could have already allocated it
+		if (!__sync_bool_compare_and_swap(&uc->pool, NULL, pool)) {
+			free(pool);
+		}
+	}
+
+	ucc = uc->pool[wsgi_req->async_id];
+	if (ucc) {
+		uc->pool[wsgi_req->async_id] = NULL;
+		if (!uc->reset(ucc->state)) {
+			ucc->out->pos = 0;
+			return ucc;
+		}
+		uc->destroy(ucc->state);
+		uwsgi_buffer_destroy(ucc->out);
+		free(ucc);
+	}
+
+	void *state = uc->create();
+	if (!state) return NULL;
+	ucc = uwsgi_malloc(sizeof(struct uwsgi_compressor_ctx));
+	ucc->compressor = uc;
+	ucc->state = state;
+	ucc->out = uwsgi_buffer_new(uwsgi.page_size);
+	return ucc;
+}
+
+void uwsgi_compressor_put(struct wsgi_request *wsgi_req, struct uwsgi_compressor_ctx *ucc) {
+	struct uwsgi_compressor *uc = ucc->compressor;
+	if (!uc->pool[wsgi_req->async_id]) {
+		// do not keep huge buffers around
+		if (ucc->out->len > 1024 * 1024) {
+			uwsgi_buffer_destroy(ucc->out);
+			ucc->out = uwsgi_buffer_new(uwsgi.page_size);
+		}
+		uc->pool[wsgi_req->async_id] = ucc;
+		return;
+	}
+	uc->destroy(ucc->state);
+	uwsgi_buffer_destroy(ucc->out);
+	free(ucc);
+}
@@ -1,5 +1,8 @@
 #include <uwsgi.h>
 
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
 
 extern struct uwsgi_server uwsgi;
 
@@ -41,31 +44,42 @@ int check_hex(char *str, int len) {
 
 }
 
-// increase worker harakiri
-void inc_harakiri(struct wsgi_request *wsgi_req, int sec) {
+// without the master, harakiri is managed by SIGALRM
+static void harakiri_alarm(int msecs) {
+	struct itimerval itv;
+	memset(&itv, 0, sizeof(struct itimerval));
+	itv.it_value.tv_sec = msecs / 1000;
+	itv.it_value.tv_usec = (msecs % 1000) * 1000;
+	if (setitimer(ITIMER_REAL, &itv, NULL)) {
+		uwsgi_error("harakiri_alarm()/setitimer()");
+	}
+}
+
+// increase worker harakiri (msecs)
+void inc_harakiri(struct wsgi_request *wsgi_req, int msecs) {
 	if (uwsgi.master_process) {
-		uwsgi.workers[uwsgi.mywid].cores[wsgi_req->async_id].harakiri += sec;
+		uwsgi.workers[uwsgi.mywid].cores[wsgi_req->async_id].harakiri += msecs;
 	}
 	else {
-		alarm(uwsgi.harakiri_options.workers + sec);
+		harakiri_alarm(uwsgi.harakiri_options.workers + msecs);
 	}
 }
 
-// set worker harakiri
-void set_harakiri(struct wsgi_request *wsgi_req, int sec) {
+// set worker harakiri (msecs)
+void set_harakiri(struct wsgi_request *wsgi_req, int msecs) {
 	if (!wsgi_req) return;
-	if (sec == 0) {
+	if (msecs == 0) {
 		uwsgi.workers[uwsgi.mywid].cores[wsgi_req->async_id].harakiri = 0;
 	}
 	else {
-		uwsgi.workers[uwsgi.mywid].cores[wsgi_req->async_id].harakiri = uwsgi_now() + sec;
+		uwsgi.workers[uwsgi.mywid].cores[wsgi_req->async_id].harakiri = uwsgi_millis() + msecs;
 	}
 	if (!uwsgi.master_process) {
-		alarm(sec);
+		harakiri_alarm(msecs);
 	}
 }
 
-// set user harakiri
+// set user harakiri (this is exposed to apps, so it is still in seconds)
 void set_user_harakiri(struct wsgi_request *wsgi_req, int sec) {
 	if (!uwsgi.master_process) {
 		uwsgi_log("!!! unable to set user harakiri without the master process !!!\n");
@@ -85,42 +99,43 @@ void set_user_harakiri(struct wsgi_request *wsgi_req, int sec) {
 		}
 	}
 	else {
+		uint64_t deadline = uwsgi_millis() + ((uint64_t) sec * 1000);
 		if (uwsgi.muleid > 0) {
-			uwsgi.mules[uwsgi.muleid - 1].user_harakiri = uwsgi_now() + sec;
+			uwsgi.mules[uwsgi.muleid - 1].user_harakiri = deadline;
 		}
 		else if (uwsgi.i_am_a_spooler) {
 			struct uwsgi_spooler *uspool = uwsgi.i_am_a_spooler;
-			uspool->user_harakiri = uwsgi_now() + sec;
+			uspool->user_harakiri = deadline;
 		}
 		else if (wsgi_req) {
-			uwsgi.workers[uwsgi.mywid].cores[wsgi_req->async_id].user_harakiri = uwsgi_now() + sec;
+			uwsgi.workers[uwsgi.mywid].cores[wsgi_req->async_id].user_harakiri = deadline;
 		}
 	}
 }
 
-// set mule harakiri
-void set_mule_harakiri(int sec) {
-	if (sec == 0) {
+// set mule harakiri (msecs)
+void set_mule_harakiri(int msecs) {
+	if (msecs == 0) {
 		uwsgi.mules[uwsgi.muleid - 1].harakiri = 0;
 	}
 	else {
-		uwsgi.mules[uwsgi.muleid - 1].harakiri = uwsgi_now() + sec;
+		uwsgi.mules[uwsgi.muleid - 1].harakiri = uwsgi_millis() + msecs;
 	}
 	if (!uwsgi.master_process) {
-		alarm(sec);
+		harakiri_alarm(msecs);
 	}
 }
 
-// set spooler harakiri
-void set_spooler_harakiri(int sec) {
-	if (sec == 0) {
+// set spooler harakiri (msecs)
+void set_spooler_harakiri(int msecs) {
+	if (msecs == 0) {
 		uwsgi.i_am_a_spooler->harakiri = 0;
 	}
 	else {
-		uwsgi.i_am_a_spooler->harakiri = uwsgi_now() + sec;
+		uwsgi.i_am_a_spooler->harakiri = uwsgi_millis() + msecs;
 	}
 	if (!uwsgi.master_process) {
-		alarm(sec);
+		harakiri_alarm(msecs);
 	}
 }
 
@@ -1025,6 +1040,57 @@ static void close_and_free_request(struct wsgi_request *wsgi_req) {
 
 }
 
+/*
+	--request-accounting
+
+	the cpu time of the thread (and its system part) and the bytes in use in the malloc heap
+	are sampled at the start and at the end of each request. The heap is process-wide and
+	in async modes the thread runs other requests too, so in those cases the values are
+	an approximation.
+*/
+static void uwsgi_request_accounting_sample(uint64_t *cpu, uint64_t *sys, int64_t *heap) {
+#if defined(CLOCK_THREAD_CPUTIME_ID)
+	struct timespec ts;
+	if (!clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts)) {
+		*cpu = (ts.tv_sec * 1000000) + (ts.tv_nsec / 1000);
+	}
+#endif
+#if defined(RUSAGE_THREAD)
+	struct rusage ru;
+	if (!getrusage(RUSAGE_THREAD, &ru)) {
+		*sys = (ru.ru_stime.tv_sec * 1000000) + ru.ru_stime.tv_usec;
+	}
+#endif
+#if defined(__GLIBC__) && defined(__GLIBC_PREREQ)
+#if __GLIBC_PREREQ(2, 33)
+	struct mallinfo2 mi = mallinfo2();
+	*heap = mi.uordblks + mi.hblkhd;
+#endif
+#endif
+}
+
+static void uwsgi_request_accounting_start(struct wsgi_request *wsgi_req) {
+	if (!uwsgi.logging_options.request_accounting) return;
+	uwsgi_request_accounting_sample(&wsgi_req->cpu_us, &wsgi_req->sys_us, &wsgi_req->alloc);
+}
+
+static void uwsgi_request_accounting_end(struct wsgi_request *wsgi_req) {
+	if (!uwsgi.logging_options.request_accounting) return;
+	uint64_t cpu = 0, sys = 0;
+	int64_t heap = 0;
+	uwsgi_request_accounting_sample(&cpu, &sys, &heap);
+	wsgi_req->cpu_us = cpu > wsgi_req->cpu_us ? cpu - wsgi_req->cpu_us : 0;
+	wsgi_req->sys_us = sys > wsgi_req->sys_us ? sys - wsgi_req->sys_us : 0;
+	wsgi_req->alloc = heap - wsgi_req->alloc;
+
+	if (wsgi_req->app_id >= 0 && wsgi_req->app_id < uwsgi.workers[uwsgi.mywid].apps_cnt) {
+		struct uwsgi_app *ua = &uwsgi.workers[uwsgi.mywid].apps[wsgi_req->app_id];
+		ua->cpu_us += wsgi_req->cpu_us;
+		ua->sys_us += wsgi_req->sys_us;
+		ua->alloc += wsgi_req->alloc;
+	}
+}
+
 // destroy a request
 void uwsgi_destroy_request(struct wsgi_request *wsgi_req) {
 
@@ -1056,7 +1122,10 @@ void uwsgi_close_request(struct wsgi_request *wsgi_req) {
 	// apply transformations
 	if (wsgi_req->transformations) {
 		if (uwsgi_apply_final_transformations(wsgi_req) == 0) {
-			if (wsgi_req->transformed_chunk && wsgi_req->transformed_chunk_len > 0) {
+			if (wsgi_req->transformed_iov_cnt > 1) {
+				uwsgi_response_writev_transformed_do(wsgi_req);
+			}
+			else if (wsgi_req->transformed_chunk && wsgi_req->transformed_chunk_len > 0) {
 				uwsgi_response_write_body_do(wsgi_req, wsgi_req->transformed_chunk, wsgi_req->transformed_chunk_len);
 			}
 		}
@@ -1074,6 +1143,8 @@ void uwsgi_close_request(struct wsgi_request *wsgi_req) {
 	uint64_t end_of_request = uwsgi_micros();
 	wsgi_req->end_of_request = end_of_request;
 
+	uwsgi_request_accounting_end(wsgi_req);
+
 	if (!wsgi_req->do_not_account_avg_rt) {
 		tmp_rt = wsgi_req->end_of_request - wsgi_req->start_of_request;
 		uwsgi.workers[uwsgi.mywid].running_time += tmp_rt;
@@ -1374,6 +1445,7 @@ int wsgi_req_async_recv(struct wsgi_request *wsgi_req) {
 
 	wsgi_req->start_of_request = uwsgi_micros();
 	wsgi_req->start_of_request_in_sec = wsgi_req->start_of_request / 1000000;
+	uwsgi_request_accounting_start(wsgi_req);
 
 	if (!wsgi_req->do_not_add_to_async_queue) {
 		if (event_queue_add_fd_read(uwsgi.async_queue, wsgi_req->fd) < 0)
@@ -1398,6 +1470,7 @@ int wsgi_req_recv(int queue, struct wsgi_request *wsgi_req) {
 
 	wsgi_req->start_of_request = uwsgi_micros();
 	wsgi_req->start_of_request_in_sec = wsgi_req->start_of_request / 1000000;
+	uwsgi_request_accounting_start(wsgi_req);
 
 	// edge triggered sockets get the whole request during accept() phase
 	if (!wsgi_req->socket->edge_trigger) {
@@ -1514,10 +1587,17 @@ int wsgi_req_accept(int queue, struct wsgi_request *wsgi_req) {
 		uwsgi_sock = uwsgi.sockets;
 	}
 
-	ret = event_queue_wait(queue, timeout, &interesting_fd);
-	if (ret < 0) {
-		thunder_unlock;
-		return -1;
+	// connections already accepted by a previous batch do not need to wait for events
+	interesting_fd = uwsgi_accepted_fd(wsgi_req);
+	if (interesting_fd > -1) {
+		ret = 1;
+	}
+	else {
+		ret = event_queue_wait(queue, timeout, &interesting_fd);
+		if (ret < 0) {
+			thunder_unlock;
+			return -1;
+		}
 	}
 
 	// check for heartbeat
@@ -1547,7 +1627,7 @@ int wsgi_req_accept(int queue, struct wsgi_request *wsgi_req) {
 
 
 	while (uwsgi_sock) {
-		if (interesting_fd == uwsgi_sock->fd || (uwsgi_sock->retry && uwsgi_sock->retry[wsgi_req->async_id]) || (uwsgi_sock->fd_threads && interesting_fd == uwsgi_sock->fd_threads[wsgi_req->async_id])) {
+		if (interesting_fd == uwsgi_sock->fd || (uwsgi_sock->fd_cores && interesting_fd == uwsgi_socket_core_fd(uwsgi_sock, wsgi_req->async_id)) || (uwsgi_sock->retry && uwsgi_sock->retry[wsgi_req->async_id]) || (uwsgi_sock->fd_threads && interesting_fd == uwsgi_sock->fd_threads[wsgi_req->async_id])) {
 			wsgi_req->socket = uwsgi_sock;
 			wsgi_req->fd = wsgi_req->socket->proto_accept(wsgi_req, interesting_fd);
 			thunder_unlock;
@@ -3615,6 +3695,11 @@ void uwsgi_set_cpu_affinity() {
 	char buf[4096];
 	int ret;
 	int pos = 0;
+	// NUMA placement applies --cpu-affinity inside the node
+	if (uwsgi.numa) {
+		uwsgi_numa_worker();
+		return;
+	}
 	if (uwsgi.cpu_affinity) {
 		int base_cpu = (uwsgi.mywid - 1) * uwsgi.cpu_affinity;
 		if (base_cpu >= uwsgi.cpus) {
@@ -3907,7 +3992,7 @@ int uwsgi_send_http_stats(int fd) {
 
 	char buf[4096];
 
-	int ret = uwsgi_waitfd(fd, uwsgi.socket_timeout);
+	int ret = uwsgi_waitfd_event_ms(fd, uwsgi.socket_timeout_ms, POLLIN);
 	if (ret <= 0)
 		return -1;
 
@@ -78,13 +78,13 @@ static struct uwsgi_option uwsgi_base_options[] = {
 	{"processes", required_argument, 'p', "spawn the specified number of workers/processes", uwsgi_opt_set_int, &uwsgi.numproc, 0},
 	{"workers", required_argument, 'p', "spawn the specified number of workers/processes", uwsgi_opt_set_int, &uwsgi.numproc, 0},
 	{"thunder-lock", no_argument, 0, "serialize accept() usage (if possible)", uwsgi_opt_true, &uwsgi.use_thunder_lock, 0},
-	{"harakiri", required_argument, 't', "set harakiri timeout", uwsgi_opt_set_int, &uwsgi.harakiri_options.workers, 0},
+	{"harakiri", required_argument, 't', "set harakiri timeout (seconds, or milliseconds with the ms suffix)", uwsgi_opt_set_msecs, &uwsgi.harakiri_options.workers, 0},
 	{"harakiri-verbose", no_argument, 0, "enable verbose mode for harakiri", uwsgi_opt_true, &uwsgi.harakiri_verbose, 0},
 	{"harakiri-no-arh", no_argument, 0, "do not enable harakiri during after-request-hook", uwsgi_opt_true, &uwsgi.harakiri_no_arh, 0},
 	{"no-harakiri-arh", no_argument, 0, "do not enable harakiri during after-request-hook", uwsgi_opt_true, &uwsgi.harakiri_no_arh, 0},
 	{"no-harakiri-after-req-hook", no_argument, 0, "do not enable harakiri during after-request-hook", uwsgi_opt_true, &uwsgi.harakiri_no_arh, 0},
 	{"backtrace-depth", required_argument, 0, "set backtrace depth", uwsgi_opt_set_int, &uwsgi.backtrace_depth, 0},
-	{"mule-harakiri", required_argument, 0, "set harakiri timeout for mule tasks", uwsgi_opt_set_int, &uwsgi.harakiri_options.mules, 0},
+	{"mule-harakiri", required_argument, 0, "set harakiri timeout for mule tasks (seconds, or milliseconds with the ms suffix)", uwsgi_opt_set_msecs, &uwsgi.harakiri_options.mules, 0},
 #ifdef UWSGI_XML
 	{"xmlconfig", required_argument, 'x', "load config from xml file", uwsgi_opt_load_xml, NULL, UWSGI_OPT_IMMEDIATE},
 	{"xml", required_argument, 'x', "load config from xml file", uwsgi_opt_load_xml, NULL, UWSGI_OPT_IMMEDIATE},
@@ -176,6 +176,7 @@ static struct uwsgi_option uwsgi_base_options[] = {
 	{"max-apps", required_argument, 0, "set the maximum number of per-worker applications", uwsgi_opt_set_int, &uwsgi.max_apps, 0},
 	{"buffer-size", required_argument, 'b', "set internal buffer size", uwsgi_opt_set_64bit, &uwsgi.buffer_size, 0},
 	{"memory-report", no_argument, 'm', "enable memory report", uwsgi_opt_true, &uwsgi.logging_options.memory_report, 0},
+	{"request-accounting", no_argument, 0, "account cpu time and heap allocations of each request (logvars cpu_us, sys_us and alloc)", uwsgi_opt_true, &uwsgi.logging_options.request_accounting, 0},
 	{"profiler", required_argument, 0, "enable the specified profiler", uwsgi_opt_set_str, &uwsgi.profiler, 0},
 	{"cgi-mode", no_argument, 'c', "force CGI-mode for plugins supporting it", uwsgi_opt_true, &uwsgi.cgi_mode, 0},
 	{"abstract-socket", no_argument, 'a', "force UNIX socket in abstract mode (Linux only)", uwsgi_opt_true, &uwsgi.abstract_socket, 0},
@@ -232,6 +233,7 @@ static struct uwsgi_option uwsgi_base_options[] = {
 	{"emperor-use-clone", required_argument, 0, "use clone() instead of fork() passing the specified unshare() flags", uwsgi_opt_set_unshare, &uwsgi.emperor_clone, 0},
 #endif
 	{"emperor-use-fork-server", required_argument, 0, "connect to the specified fork server instead of using plain fork() for new vassals", uwsgi_opt_set_str, &uwsgi.emperor_use_fork_server, 0},
+	{"emperor-zygote", required_argument, 0, "spawn a fork server (named zygote) loading the specified config, vassals using it as fork server skip exec and plugins loading (syntax: <name> <config>)", uwsgi_opt_add_string_list, &uwsgi.emperor_zygotes, 0},
 	{"vassal-fork-base", required_argument, 0, "use plain fork() for the specified vassal (instead of a fork-server)", uwsgi_opt_add_string_list, &uwsgi.vassal_fork_base, 0},
 	{"emperor-subreaper", no_argument, 0, "force the Emperor to be a sub-reaper (if supported)", uwsgi_opt_true, &uwsgi.emperor_subreaper, 0},
 #ifdef UWSGI_CAP
@@ -279,7 +281,7 @@ static struct uwsgi_option uwsgi_base_options[] = {
 	{"min-worker-lifetime", required_argument, 0, "number of seconds worker must run before being reloaded (default is 60)", uwsgi_opt_set_64bit, &uwsgi.min_worker_lifetime, 0},
 	{"max-worker-lifetime", required_argument, 0, "reload workers after the specified amount of seconds (default is disabled)", uwsgi_opt_set_64bit, &uwsgi.max_worker_lifetime, 0},
 
-	{"socket-timeout", required_argument, 'z', "set internal sockets timeout", uwsgi_opt_set_int, &uwsgi.socket_timeout, 0},
+	{"socket-timeout", required_argument, 'z', "set internal sockets timeout (seconds, or milliseconds with the ms suffix)", uwsgi_opt_set_msecs, &uwsgi.socket_timeout_ms, 0},
 	{"no-fd-passing", no_argument, 0, "disable file descriptor passing", uwsgi_opt_true, &uwsgi.no_fd_passing, 0},
 	{"locks", required_argument, 0, "create the specified number of shared locks", uwsgi_opt_set_int, &uwsgi.locks, 0},
 	{"lock-engine", required_argument, 0, "set the lock engine", uwsgi_opt_set_str, &uwsgi.lock_engine, 0},
@@ -323,7 +325,7 @@ static struct uwsgi_option uwsgi_base_options[] = {
 	{"spooler-processes", required_argument, 0, "set the number of processes for spoolers", uwsgi_opt_set_int, &uwsgi.spooler_numproc, UWSGI_OPT_IMMEDIATE},
 	{"spooler-quiet", no_argument, 0, "do not be verbose with spooler tasks", uwsgi_opt_true, &uwsgi.spooler_quiet, 0},
 	{"spooler-max-tasks", required_argument, 0, "set the maximum number of tasks to run before recycling a spooler", uwsgi_opt_set_int, &uwsgi.spooler_max_tasks, 0},
-	{"spooler-harakiri", required_argument, 0, "set harakiri timeout for spooler tasks", uwsgi_opt_set_int, &uwsgi.harakiri_options.spoolers, 0},
+	{"spooler-harakiri", required_argument, 0, "set harakiri timeout for spooler tasks (seconds, or milliseconds with the ms suffix)", uwsgi_opt_set_msecs, &uwsgi.harakiri_options.spoolers, 0},
 	{"spooler-frequency", required_argument, 0, "set spooler frequency", uwsgi_opt_set_int, &uwsgi.spooler_frequency, 0},
 	{"spooler-freq", required_argument, 0, "set spooler frequency", uwsgi_opt_set_int, &uwsgi.spooler_frequency, 0},
 
@@ -577,6 +579,7 @@ static struct uwsgi_option uwsgi_base_options[] = {
 	{"no-orphans", no_argument, 0, "automatically kill workers if master dies (can be dangerous for availability)", uwsgi_opt_true, &uwsgi.no_orphans, 0},
 	{"prio", required_argument, 0, "set processes/threads priority", uwsgi_opt_set_rawint, &uwsgi.prio, 0},
 	{"cpu-affinity", required_argument, 0, "set cpu affinity", uwsgi_opt_set_int, &uwsgi.cpu_affinity, 0},
+	{"numa", no_argument, 0, "spread workers across NUMA nodes, pinning them to the cpus and the memory of their node", uwsgi_opt_true, &uwsgi.numa, 0},
 	{"post-buffering", required_argument, 0, "enable post buffering", uwsgi_opt_set_64bit, &uwsgi.post_buffering, 0},
 	{"post-buffering-bufsize", required_argument, 0, "set buffer size for read() in post buffering mode", uwsgi_opt_set_64bit, &uwsgi.post_buffering_bufsize, 0},
 	{"body-read-warning", required_argument, 0, "set the amount of allowed memory allocation (in megabytes) for request body before starting printing a warning", uwsgi_opt_set_64bit, &uwsgi.body_read_warning, 0},
@@ -672,11 +675,14 @@ static struct uwsgi_option uwsgi_base_options[] = {
 	{"ssl-session-use-cache", optional_argument, 0, "use uWSGI cache for ssl sessions storage", uwsgi_opt_set_str, &uwsgi.ssl_sessions_use_cache, UWSGI_OPT_MASTER},
 	{"ssl-sessions-timeout", required_argument, 0, "set SSL sessions timeout (default: 300 seconds)", uwsgi_opt_set_int, &uwsgi.ssl_sessions_timeout, 0},
 	{"ssl-session-timeout", required_argument, 0, "set SSL sessions timeout (default: 300 seconds)", uwsgi_opt_set_int, &uwsgi.ssl_sessions_timeout, 0},
+	{"ssl-tickets-rotate", required_argument, 0, "enable managed SSL session tickets shared by all of the processes, rotating keys every N seconds", uwsgi_opt_set_int, &uwsgi.ssl_tickets_rotate, 0},
+	{"ssl-tickets-secret", required_argument, 0, "derive SSL session ticket keys from the specified file (allows resumption across reloads and instances)", uwsgi_opt_set_str, &uwsgi.ssl_tickets_secret, 0},
 	{"sni", required_argument, 0, "add an SNI-governed SSL context", uwsgi_opt_sni, NULL, 0},
 	{"sni-dir", required_argument, 0, "check for cert/key/client_ca file in the specified directory and create a sni/ssl context on demand", uwsgi_opt_set_str, &uwsgi.sni_dir, 0},
 	{"sni-dir-ciphers", required_argument, 0, "set ssl ciphers for sni-dir option", uwsgi_opt_set_str, &uwsgi.sni_dir_ciphers, 0},
 	{"ssl-enable3", no_argument, 0, "enable SSLv3 (insecure)", uwsgi_opt_true, &uwsgi.sslv3, 0},
 	{"ssl-option", no_argument, 0, "set a raw ssl option (numeric value)", uwsgi_opt_add_string_list, &uwsgi.ssl_options, 0},
+	{"ssl-enable-ktls", no_argument, 0, "enable kernel TLS offload for SSL contexts (requires Linux and OpenSSL 3, falls back to userspace for unsupported ciphers)", uwsgi_opt_true, &uwsgi.ssl_ktls, 0},
 #ifdef UWSGI_PCRE
 	{"sni-regexp", required_argument, 0, "add an SNI-governed SSL context (the key is a regexp)", uwsgi_opt_sni, NULL, 0},
 #endif
@@ -777,6 +783,7 @@ static struct uwsgi_option uwsgi_base_options[] = {
 	{"chdir2", required_argument, 0, "chdir to specified directory after apps loading", uwsgi_opt_set_str, &uwsgi.chdir2, 0},
 	{"lazy", no_argument, 0, "set lazy mode (load apps in workers instead of master)", uwsgi_opt_true, &uwsgi.lazy, 0},
 	{"lazy-apps", no_argument, 0, "load apps in each worker instead of the master", uwsgi_opt_true, &uwsgi.lazy_apps, 0},
+	{"spare-workers", required_argument, 0, "keep the specified number of pre-forked workers (with apps loaded) ready to replace the respawned ones", uwsgi_opt_set_int, &uwsgi.spare_workers, UWSGI_OPT_MASTER},
 	{"cheap", no_argument, 0, "set cheap mode (spawn workers only after the first request)", uwsgi_opt_true, &uwsgi.status.is_cheap, UWSGI_OPT_MASTER},
 	{"cheaper", required_argument, 0, "set cheaper mode (adaptive process spawning)", uwsgi_opt_set_int, &uwsgi.cheaper_count, UWSGI_OPT_MASTER | UWSGI_OPT_CHEAPER},
 	{"cheaper-initial", required_argument, 0, "set the initial number of processes to spawn in cheaper mode", uwsgi_opt_set_int, &uwsgi.cheaper_initial, UWSGI_OPT_MASTER | UWSGI_OPT_CHEAPER},
@@ -903,6 +910,8 @@ static struct uwsgi_option uwsgi_base_options[] = {
 	{"static-safe", required_argument, 0, "skip security checks if the file is under the specified path", uwsgi_opt_add_string_list, &uwsgi.static_safe, UWSGI_OPT_MIME},
 	{"static-cache-paths", required_argument, 0, "put resolved paths in the uWSGI cache for the specified amount of seconds", uwsgi_opt_set_int, &uwsgi.use_static_cache_paths, UWSGI_OPT_MIME|UWSGI_OPT_MASTER},
 	{"static-cache-paths-name", required_argument, 0, "use the specified cache for static paths", uwsgi_opt_set_str, &uwsgi.static_cache_paths_name, UWSGI_OPT_MIME|UWSGI_OPT_MASTER},
+	{"static-open-cache", required_argument, 0, "keep the specified number of static files opened (with their stat and headers) in every worker", uwsgi_opt_set_int, &uwsgi.static_open_cache, UWSGI_OPT_MIME},
+	{"static-open-cache-ttl", required_argument, 0, "revalidate static files open cache items after the specified amount of seconds (default 10)", uwsgi_opt_set_int, &uwsgi.static_open_cache_ttl, UWSGI_OPT_MIME},
 #ifdef __APPLE__
 	{"mimefile", required_argument, 0, "set mime types file path (default /etc/apache2/mime.types)", uwsgi_opt_add_string_list, &uwsgi.mime_file, UWSGI_OPT_MIME},
 	{"mime-file", required_argument, 0, "set mime types file path (default /etc/apache2/mime.types)", uwsgi_opt_add_string_list, &uwsgi.mime_file, UWSGI_OPT_MIME},
@@ -930,6 +939,10 @@ static struct uwsgi_option uwsgi_base_options[] = {
 	{"static-gzip-prefix", required_argument, 0, "check for a gzip version of all requested static files in the specified dir/prefix", uwsgi_opt_add_string_list, &uwsgi.static_gzip_dir, UWSGI_OPT_MIME},
 	{"static-gzip-ext", required_argument, 0, "check for a gzip version of all requested static files with the specified ext/suffix", uwsgi_opt_add_string_list, &uwsgi.static_gzip_ext, UWSGI_OPT_MIME},
 	{"static-gzip-suffix", required_argument, 0, "check for a gzip version of all requested static files with the specified ext/suffix", uwsgi_opt_add_string_list, &uwsgi.static_gzip_ext, UWSGI_OPT_MIME},
+	{"static-compress-store", required_argument, 0, "compress static files matching the static-gzip rules on first hit (br, zstd or gzip) storing them in the specified directory", uwsgi_opt_set_str, &uwsgi.static_compress_store, UWSGI_OPT_MIME},
+	{"static-compress-store-limit", required_argument, 0, "set the max size (in megabytes) of the static compression store (default 256)", uwsgi_opt_set_megabytes, &uwsgi.static_compress_store_limit, UWSGI_OPT_MIME},
+	{"static-compress-max-size", required_argument, 0, "do not compress on the fly static files bigger than the specified size in megabytes (default 8)", uwsgi_opt_set_megabytes, &uwsgi.static_compress_max_size, UWSGI_OPT_MIME},
+	{"static-compress-inline-max-size", required_argument, 0, "compress on first hit in the request path only static files up to the specified size in bytes (default 65536), bigger ones are compressed in background", uwsgi_opt_set_64bit, &uwsgi.static_compress_inline_max_size, UWSGI_OPT_MIME},
 
 	{"honour-range", no_argument, 0, "enable support for the HTTP Range header", uwsgi_opt_true, &uwsgi.honour_range, 0},
 
@@ -964,6 +977,16 @@ static struct uwsgi_option uwsgi_base_options[] = {
 #endif
 	{"enable-proxy-protocol", no_argument, 0, "enable PROXY1 protocol support (only for http parsers)", uwsgi_opt_true, &uwsgi.enable_proxy_protocol, 0},
 	{"reuse-port", no_argument, 0, "enable REUSE_PORT flag on socket (BSD only)", uwsgi_opt_true, &uwsgi.reuse_port, 0},
+	{"accept-reuseport", no_argument, 0, "give every worker (or every thread in multithreaded mode) its own SO_REUSEPORT listening socket", uwsgi_opt_true, &uwsgi.accept_reuseport, UWSGI_OPT_MASTER},
+	{"accept-reuseport-cbpf", no_argument, 0, "steer connections to per-core listening sockets by the cpu that received them", uwsgi_opt_true, &uwsgi.accept_reuseport_cbpf, UWSGI_OPT_MASTER},
+	{"thread-scheduler", no_argument, 0, "use an acceptor thread and work-stealing per-thread queues in multithreaded workers", uwsgi_opt_true, &uwsgi.thread_sched, 0},
+	{"thread-scheduler-queue", required_argument, 0, "max number of accepted connections waiting in a worker with --thread-scheduler (default: the number of threads)", uwsgi_opt_set_int, &uwsgi.thread_sched_queue, 0},
+#ifdef UWSGI_PCRE
+	{"thread-scheduler-priority", required_argument, 0, "requests whose first bytes match the regexp jump the queue with --thread-scheduler", uwsgi_opt_add_regexp_list, &uwsgi.thread_sched_priority, 0},
+#endif
+	{"accept-batch", required_argument, 0, "accept up to the specified number of connections per wakeup (default loop only)", uwsgi_opt_set_int, &uwsgi.accept_batch, 0},
+	{"listen-shed", required_argument, 0, "reject with a 503 the connections waiting in the listen queue more than the specified time while overloaded (seconds, or milliseconds with the ms suffix)", uwsgi_opt_set_msecs, &uwsgi.listen_shed, 0},
+	{"listen-shed-interval", required_argument, 0, "how long the listen queue delay can stay over the --listen-shed target before the instance is considered overloaded (default 100ms)", uwsgi_opt_set_msecs, &uwsgi.listen_shed_interval, 0},
 	{"tcp-fast-open", required_argument, 0, "enable TCP_FASTOPEN flag on TCP sockets with the specified qlen value", uwsgi_opt_set_int, &uwsgi.tcp_fast_open, 0},
 	{"tcp-fastopen", required_argument, 0, "enable TCP_FASTOPEN flag on TCP sockets with the specified qlen value", uwsgi_opt_set_int, &uwsgi.tcp_fast_open, 0},
 	{"tcp-fast-open-client", no_argument, 0, "use sendto(..., MSG_FASTOPEN, ...) instead of connect() if supported", uwsgi_opt_true, &uwsgi.tcp_fast_open_client, 0},
@@ -1236,10 +1259,16 @@ void gracefully_kill(int signum) {
 
 	uwsgi_log("Gracefully killing worker %d (pid: %d)...\n", uwsgi.mywid, uwsgi.mypid);
 	uwsgi.workers[uwsgi.mywid].manage_next_request = 0;
+	// the threads drain the --thread-scheduler queues and leave their loops by themselves
+	if (uwsgi.thread_sched) {
+		uwsgi_sched_wakeup();
+		return;
+	}
 	if (uwsgi.threads > 1) {
 		struct wsgi_request *wsgi_req = current_wsgi_req();
 		wait_for_threads();
 		if (!uwsgi.workers[uwsgi.mywid].cores[wsgi_req->async_id].in_request) {
+			uwsgi_accepted_close();
 			exit(UWSGI_RELOAD_CODE);
 		}
 		return;
@@ -1252,6 +1281,7 @@ void gracefully_kill(int signum) {
 	}
 
 	if (!uwsgi.workers[uwsgi.mywid].cores[0].in_request) {
+		uwsgi_accepted_close();
 		exit(UWSGI_RELOAD_CODE);
 	}
 }
@@ -1266,11 +1296,19 @@ void end_me(int signum) {
 
 void simple_goodbye_cruel_world() {
 
+	if (uwsgi.thread_sched && !uwsgi_instance_is_dying) {
+		// the worker exits once the queued connections have been served
+		uwsgi.workers[uwsgi.mywid].manage_next_request = 0;
+		uwsgi_sched_wakeup();
+		return;
+	}
+
 	if (uwsgi.threads > 1 && !uwsgi_instance_is_dying) {
 		wait_for_threads();
 	}
 
 	uwsgi.workers[uwsgi.mywid].manage_next_request = 0;
+	uwsgi_accepted_close();
 	uwsgi_log("...The work of process %d is done. Seeya!\n", getpid());
 	exit(0);
 }
@@ -1347,6 +1385,7 @@ void grace_them_all(int signum) {
 	int i;
 
 	if (uwsgi.lazy) {
+		uwsgi_spares_recycle();
 		for (i = 1; i <= uwsgi.numproc; i++) {
 			if (uwsgi.workers[i].pid > 0) {
 				uwsgi_curse(i, SIGHUP);
@@ -1493,7 +1532,7 @@ void what_i_am_doing() {
 #else
 				ctime_r((const time_t *) &wsgi_req->start_of_request_in_sec, ctime_storage);
 #endif
-				if (uwsgi.harakiri_options.workers > 0 && uwsgi.workers[uwsgi.mywid].cores[wsgi_req->async_id].harakiri < uwsgi_now()) {
+				if (uwsgi.harakiri_options.workers > 0 && uwsgi.workers[uwsgi.mywid].cores[wsgi_req->async_id].harakiri < uwsgi_millis()) {
 					uwsgi_log("HARAKIRI: --- uWSGI worker %d core %d (pid: %d) WAS managing request %.*s since %.*s ---\n", (int) uwsgi.mywid, i, (int) uwsgi.mypid, wsgi_req->uri_len, wsgi_req->uri, 24, ctime_storage);
 				}
 				else {
@@ -1510,14 +1549,14 @@ void what_i_am_doing() {
 #else
 			ctime_r((const time_t *) &wsgi_req->start_of_request_in_sec, ctime_storage);
 #endif
-			if (uwsgi.harakiri_options.workers > 0 && uwsgi.workers[uwsgi.mywid].cores[wsgi_req->async_id].harakiri < uwsgi_now()) {
+			if (uwsgi.harakiri_options.workers > 0 && uwsgi.workers[uwsgi.mywid].cores[wsgi_req->async_id].harakiri < uwsgi_millis()) {
 				uwsgi_log("HARAKIRI: --- uWSGI worker %d (pid: %d) WAS managing request %.*s since %.*s ---\n", (int) uwsgi.mywid, (int) uwsgi.mypid, wsgi_req->uri_len, wsgi_req->uri, 24, ctime_storage);
 			}
 			else {
 				uwsgi_log("SIGUSR2: --- uWSGI worker %d (pid: %d) is managing request %.*s since %.*s ---\n", (int) uwsgi.mywid, (int) uwsgi.mypid, wsgi_req->uri_len, wsgi_req->uri, 24, ctime_storage);
 			}
 		}
-		else if (uwsgi.harakiri_options.workers > 0 && uwsgi.workers[uwsgi.mywid].cores[wsgi_req->async_id].harakiri < uwsgi_now() && uwsgi.workers[uwsgi.mywid].sig) {
+		else if (uwsgi.harakiri_options.workers > 0 && uwsgi.workers[uwsgi.mywid].cores[wsgi_req->async_id].harakiri < uwsgi_millis() && uwsgi.workers[uwsgi.mywid].sig) {
 			uwsgi_log("HARAKIRI: --- uWSGI worker %d (pid: %d) WAS handling signal %d ---\n", (int) uwsgi.mywid, (int) uwsgi.mypid, uwsgi.workers[uwsgi.mywid].signum);
 		}
 	}
@@ -2759,6 +2798,9 @@ int uwsgi_start(void *v_argv) {
 	// allocate rpc structures
         uwsgi_rpc_init();
 
+	// discover NUMA nodes before allocating shared memory
+	uwsgi_numa_setup();
+
 	// initialize sharedareas
 	uwsgi_sharedareas_init();
 
@@ -2796,6 +2838,16 @@ int uwsgi_start(void *v_argv) {
 		}
         }
 
+	if (uwsgi.static_compress_store) {
+		if (!uwsgi_is_dir(uwsgi.static_compress_store) && mkdir(uwsgi.static_compress_store, S_IRWXU)) {
+			uwsgi_error("mkdir()");
+			uwsgi_log("unable to create the static compression store %s\n", uwsgi.static_compress_store);
+			exit(1);
+		}
+		uwsgi.static_compress_store_used = uwsgi_calloc_shared(sizeof(uint64_t));
+		uwsgi_static_compress_store_scan(uwsgi.static_compress_store_limit, 1);
+	}
+
         // initialize the alarm subsystem
         uwsgi_alarms_init();
 
@@ -2835,6 +2887,10 @@ int uwsgi_start(void *v_argv) {
 		// put listening socket in non-blocking state and set the protocol
 		uwsgi_set_sockets_protocols();
 
+		if (uwsgi.accept_reuseport) {
+			uwsgi_setup_reuseport_sockets();
+		}
+
 	}
 
 
@@ -3316,11 +3372,14 @@ int uwsgi_run() {
 #endif
 
 
-	// eventually maps (or disable) sockets for the  worker
-	uwsgi_map_sockets();
+	// spares do not know their worker id yet
+	if (!uwsgi.i_am_a_spare) {
+		// eventually maps (or disable) sockets for the  worker
+		uwsgi_map_sockets();
 
-	// eventually set cpu affinity poilicies (OS-dependent)
-	uwsgi_set_cpu_affinity();
+		// eventually set cpu affinity poilicies (OS-dependent)
+		uwsgi_set_cpu_affinity();
+	}
 
 	if (uwsgi.worker_exec) {
 		char *w_argv[2];
@@ -3415,6 +3474,11 @@ void uwsgi_worker_run() {
 		uwsgi_init_all_apps();
 	}
 
+	// wait here (with the apps loaded) for a worker slot
+	if (uwsgi.i_am_a_spare) {
+		uwsgi_spare_park();
+	}
+
 	// some apps could be mounted only on specific workers
 	uwsgi_init_worker_mount_apps();
 
@@ -3977,6 +4041,36 @@ void uwsgi_opt_set_int(char *opt, char *value, void *key) {
 	}
 }
 
+/*
+	timeouts are stored in milliseconds, a plain number is still a number of seconds
+	while the "ms" suffix allows sub-second values (eg. 250ms, 1500ms, 3s)
+*/
+void uwsgi_opt_set_msecs(char *opt, char *value, void *key) {
+	int *ptr = (int *) key;
+	if (!value) {
+		*ptr = 1000;
+		return;
+	}
+
+	char *end = NULL;
+	long n = strtol(value, &end, 10);
+	if (end == value || n < 0 || n > INT_MAX) goto error;
+	if (!strcmp(end, "ms")) {
+		*ptr = n;
+	}
+	else if (!*end || !strcmp(end, "s")) {
+		if (n > INT_MAX / 1000) goto error;
+		*ptr = n * 1000;
+	}
+	else {
+		goto error;
+	}
+	return;
+error:
+	uwsgi_log("invalid value for option \"%s\": must be a number of seconds or milliseconds (eg. 30 or 250ms)\n", opt);
+	exit(1);
+}
+
 void uwsgi_opt_uid(char *opt, char *value, void *key) {
 	uid_t uid = 0;
 	if (is_a_number(value)) uid = atoi(value);
@@ -264,19 +264,17 @@ int uwsgi_response_write_headers_do(struct wsgi_request *wsgi_req) {
 /*
 	private function for highly optimized writes (1 single syscall for headers and body)
 */
-static int uwsgi_response_writev_headers_and_body_do(struct wsgi_request *wsgi_req, char *buf, size_t len) {
+// iov[0] is reserved for the headers, len is the size of the body
+static int uwsgi_response_writev_headers_and_iov_do(struct wsgi_request *wsgi_req, struct iovec *iov, size_t iov_len, size_t len) {
 
-	struct iovec iov[2];
+	char *buf = NULL;
 
         int ret = uwsgi_response_write_headers_do0(wsgi_req);
         if (ret != UWSGI_AGAIN) return ret;
 
 	iov[0].iov_base = wsgi_req->headers->buf;
 	iov[0].iov_len = wsgi_req->headers->pos;
-	iov[1].iov_base = buf;
-	iov[1].iov_len = len;
 
-	size_t iov_len = 2;
         for(;;) {
                 errno = 0;
 		// no need to use writev if a single iovec remains
@@ -355,6 +353,28 @@ fallback:
 
 }
 
+static int uwsgi_response_writev_headers_and_body_do(struct wsgi_request *wsgi_req, char *buf, size_t len) {
+	struct iovec iov[2];
+	iov[1].iov_base = buf;
+	iov[1].iov_len = len;
+	return uwsgi_response_writev_headers_and_iov_do(wsgi_req, iov, 2, len);
+}
+
+// write the vectors produced by the transformations chain (headers included, if possible)
+int uwsgi_response_writev_transformed_do(struct wsgi_request *wsgi_req) {
+	int ret;
+	if (!wsgi_req->headers_sent && wsgi_req->socket->proto_writev && wsgi_req->headers) {
+		ret = uwsgi_response_writev_headers_and_iov_do(wsgi_req, wsgi_req->transformed_iov, wsgi_req->transformed_iov_cnt + 1, wsgi_req->transformed_chunk_len);
+	}
+	else {
+		// transformed_chunk_len is set, so the vectors will not be transformed again
+		ret = uwsgi_response_writev_body_do(wsgi_req, wsgi_req->transformed_iov + 1, wsgi_req->transformed_iov_cnt);
+	}
+	wsgi_req->transformed_chunk = NULL;
+	wsgi_req->transformed_chunk_len = 0;
+	return ret;
+}
+
 // this is the function called by all request plugins to send chunks to the client
 int uwsgi_response_write_body_do(struct wsgi_request *wsgi_req, char *buf, size_t len) {
 
@@ -380,6 +400,9 @@ int uwsgi_response_write_body_do(struct wsgi_request *wsgi_req, char *buf, size_
 	if (wsgi_req->transformed_chunk_len == 0 && wsgi_req->transformations) {
 		int t_ret = uwsgi_apply_transformations(wsgi_req, buf, len);
 		if (t_ret == 0) {
+			if (wsgi_req->transformed_iov_cnt > 1) {
+				return uwsgi_response_writev_transformed_do(wsgi_req);
+			}
 			buf = wsgi_req->transformed_chunk;
 			len = wsgi_req->transformed_chunk_len;
 			// reset transformation
@@ -462,32 +485,15 @@ int uwsgi_response_writev_body_do(struct wsgi_request *wsgi_req, struct iovec *i
 #endif
 
 	size_t i;
-	int buffering = 0;
-	// transformations apply to every vector
-	for(i=0;i<len;i++) {	
-        	// if the transformation chain returns 1, we are in buffering mode
-        	if (wsgi_req->transformed_chunk_len == 0 && wsgi_req->transformations) {
-                	int t_ret = uwsgi_apply_transformations(wsgi_req, iov[i].iov_base, iov[i].iov_len);
-                	if (t_ret == 0) {
-                        	iov[i].iov_base = wsgi_req->transformed_chunk;
-                        	iov[i].iov_len = wsgi_req->transformed_chunk_len;
-                        	// reset transformation
-                        	wsgi_req->transformed_chunk = NULL;
-                        	wsgi_req->transformed_chunk_len = 0;
-                        	goto write;
-                	}
-                	if (t_ret == 1) {
-				buffering = 1;
-				continue;
-                	}
-                	wsgi_req->write_errors++;
-                	return -1;
+	// transformations apply to every vector (they could produce vectors on their own)
+	if (wsgi_req->transformed_chunk_len == 0 && wsgi_req->transformations) {
+		for(i=0;i<len;i++) {
+			int ret = uwsgi_response_write_body_do(wsgi_req, iov[i].iov_base, iov[i].iov_len);
+			if (ret) return ret;
 		}
-        }
-
-	if (buffering) return UWSGI_OK;
+		return UWSGI_OK;
+	}
 
-write:
         // send headers if not already sent
         if (!wsgi_req->headers_sent) {
                 int ret = uwsgi_response_write_headers_do(wsgi_req);
@@ -608,7 +614,7 @@ sendfile:
 			if (can_close) close(fd);
 			return UWSGI_OK;
 		}
-		len = st.st_size;
+		len = st.st_size - pos;
 	}
 
 	if (wsgi_req->socket->can_offload) {
@@ -624,7 +630,7 @@ sendfile:
 			fd = tmp_fd;
 			can_close = 1;
 		}
-       		if (!uwsgi_offload_request_sendfile_do(wsgi_req, fd, len)) {
+       		if (!uwsgi_offload_request_sendfile_range_do(wsgi_req, fd, pos, len)) {
                 	wsgi_req->via = UWSGI_VIA_OFFLOAD;
 			wsgi_req->response_size += len;
                         return 0;
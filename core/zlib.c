@@ -170,3 +170,94 @@ void uwsgi_crc32(uint32_t *ctx, char *buf, size_t len) {
 		*ctx = crc32(*ctx, (const Bytef *) buf, len);
 	}
 }
+
+/*
+
+	gzip streaming compressor (used by the pooled transformations)
+
+	the z_stream is deflateReset() on reuse, its ~256k state is allocated only once
+
+*/
+struct uwsgi_gzip_state {
+	z_stream z;
+	uint32_t crc32;
+	uint32_t len;
+	uint8_t started;
+};
+
+static void *gzip_state_create() {
+	struct uwsgi_gzip_state *ugs = uwsgi_calloc(sizeof(struct uwsgi_gzip_state));
+	if (uwsgi_deflate_init(&ugs->z, NULL, 0)) {
+		free(ugs);
+		return NULL;
+	}
+	uwsgi_crc32(&ugs->crc32, NULL, 0);
+	return ugs;
+}
+
+static int gzip_state_reset(void *state) {
+	struct uwsgi_gzip_state *ugs = (struct uwsgi_gzip_state *) state;
+	if (deflateReset(&ugs->z) != Z_OK) return -1;
+	ugs->crc32 = 0;
+	uwsgi_crc32(&ugs->crc32, NULL, 0);
+	ugs->len = 0;
+	ugs->started = 0;
+	return 0;
+}
+
+static int gzip_state_compress(void *state, char *buf, size_t len, struct uwsgi_buffer *ub, int final) {
+	struct uwsgi_gzip_state *ugs = (struct uwsgi_gzip_state *) state;
+	int flush = final ? Z_FINISH : Z_SYNC_FLUSH;
+
+	if (!ugs->started) {
+		if (uwsgi_buffer_append(ub, gzheader, 10)) return -1;
+		ugs->started = 1;
+	}
+
+	if (len > 0) {
+		uwsgi_crc32(&ugs->crc32, buf, len);
+		// the gzip trailer stores the size modulo 2^32
+		ugs->len += len;
+	}
+
+	ugs->z.next_in = (Bytef *) buf;
+	ugs->z.avail_in = len;
+
+	for (;;) {
+		// deflateBound() is for a whole stream, add room for the flush markers
+		if (uwsgi_buffer_ensure(ub, deflateBound(&ugs->z, ugs->z.avail_in) + 16)) return -1;
+		size_t avail = ub->len - ub->pos;
+		ugs->z.next_out = (Bytef *) ub->buf + ub->pos;
+		ugs->z.avail_out = avail;
+		int ret = deflate(&ugs->z, flush);
+		if (ret != Z_OK && ret != Z_BUF_ERROR && ret != Z_STREAM_END) return -1;
+		ub->pos += avail - ugs->z.avail_out;
+		if (final) {
+			if (ret == Z_STREAM_END) break;
+		}
+		else if (ugs->z.avail_out > 0) {
+			break;
+		}
+	}
+
+	if (final) {
+		if (uwsgi_buffer_u32le(ub, ugs->crc32)) return -1;
+		if (uwsgi_buffer_u32le(ub, ugs->len)) return -1;
+	}
+	return 0;
+}
+
+static void gzip_state_destroy(void *state) {
+	struct uwsgi_gzip_state *ugs = (struct uwsgi_gzip_state *) state;
+	deflateEnd(&ugs->z);
+	free(ugs);
+}
+
+struct uwsgi_compressor uwsgi_compressor_gzip = {
+	.name = "gzip",
+	.name_len = 4,
+	.create = gzip_state_create,
+	.reset = gzip_state_reset,
+	.compress = gzip_state_compress,
+	.destroy = gzip_state_destroy,
+};
@@ -0,0 +1,61 @@
+#include <uwsgi.h>
+#include <zstd.h>
+
+extern struct uwsgi_server uwsgi;
+
+// one-shot zstd compression (used for static files variants)
+struct uwsgi_buffer *uwsgi_zstd(char *buf, size_t len) {
+	size_t dlen = ZSTD_compressBound(len);
+	struct uwsgi_buffer *ub = uwsgi_buffer_new(dlen);
+	size_t ret = ZSTD_compress(ub->buf, dlen, buf, len, ZSTD_CLEVEL_DEFAULT);
+	if (ZSTD_isError(ret)) {
+		uwsgi_buffer_destroy(ub);
+		return NULL;
+	}
+	ub->pos = ret;
+	return ub;
+}
+
+/*
+
+	zstd streaming compressor (used by the pooled transformations)
+
+	the context is reset (keeping its tables) on reuse
+
+*/
+static void *zstd_state_create() {
+	return ZSTD_createCCtx();
+}
+
+static int zstd_state_reset(void *state) {
+	if (ZSTD_isError(ZSTD_CCtx_reset((ZSTD_CCtx *) state, ZSTD_reset_session_only))) return -1;
+	return 0;
+}
+
+static int zstd_state_compress(void *state, char *buf, size_t len, struct uwsgi_buffer *ub, int final) {
+	ZSTD_EndDirective mode = final ? ZSTD_e_end : ZSTD_e_flush;
+	ZSTD_inBuffer in = { buf, len, 0 };
+
+	for (;;) {
+		if (uwsgi_buffer_ensure(ub, ZSTD_compressBound(in.size - in.pos) + 16)) return -1;
+		ZSTD_outBuffer out = { ub->buf + ub->pos, ub->len - ub->pos, 0 };
+		size_t remaining = ZSTD_compressStream2((ZSTD_CCtx *) state, &out, &in, mode);
+		if (ZSTD_isError(remaining)) return -1;
+		ub->pos += out.pos;
+		if (remaining == 0 && in.pos == in.size) break;
+	}
+	return 0;
+}
+
+static void zstd_state_destroy(void *state) {
+	ZSTD_freeCCtx((ZSTD_CCtx *) state);
+}
+
+struct uwsgi_compressor uwsgi_compressor_zstd = {
+	.name = "zstd",
+	.name_len = 4,
+	.create = zstd_state_create,
+	.reset = zstd_state_reset,
+	.compress = zstd_state_compress,
+	.destroy = zstd_state_destroy,
+};
@@ -28,8 +28,8 @@ static void uwsgi_opt_setup_asyncio(char *opt, char *value, void *null) {
 
 	// set async mode
 	uwsgi_opt_set_int(opt, value, &uwsgi.async);
-	if (uwsgi.socket_timeout < 30) {
-		uwsgi.socket_timeout = 30;
+	if (uwsgi.socket_timeout_ms < 30000) {
+		uwsgi.socket_timeout_ms = 30000;
 	}
 	// set loop engine
 	uwsgi.loop = "asyncio";
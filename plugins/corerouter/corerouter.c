@@ -40,6 +40,8 @@ struct corerouter_peer *uwsgi_cr_peer_add(struct corerouter_session *cs) {
 	peers = uwsgi_calloc(sizeof(struct corerouter_peer));
 	peers->session = cs;
 	peers->fd = -1;
+	peers->pipe[0] = -1;
+	peers->pipe[1] = -1;
 	// create input buffer
 	size_t bufsize = cs->corerouter->buffer_size;
 	if (!bufsize) bufsize = uwsgi.page_size;
@@ -125,10 +127,84 @@ int uwsgi_cr_peer_del(struct corerouter_peer *peer) {
 		uwsgi_buffer_destroy(peer->out);
 	}
 
+	if (peer->pipe[0] != -1) {
+		close(peer->pipe[0]);
+		close(peer->pipe[1]);
+	}
+
 	free(peer);
 	return 0;
 }
 
+/*
+	request deadline
+
+	when a budget is configured, the absolute deadline (epoch milliseconds) of a request
+	arrived at 'start' is passed to the backend as the UWSGI_DEADLINE var, so workers
+	can drop requests that expired while queued
+*/
+int uwsgi_cr_add_deadline(struct uwsgi_corerouter *ucr, uint64_t start, struct uwsgi_buffer *ub) {
+	if (ucr->deadline <= 0) return 0;
+	return uwsgi_buffer_append_keynum(ub, "UWSGI_DEADLINE", 14, start + ucr->deadline);
+}
+
+/*
+	splice() relay
+
+	data read from a peer is moved to its pipe and from there to the destination socket,
+	so it never crosses userspace. Only plain sockets can be spliced, routers needing to
+	inspect data must continue using buffers.
+
+	returns 0 if the peer cannot use splice (non-linux systems or no pipe available)
+*/
+int uwsgi_cr_splice_setup(struct corerouter_peer *peer) {
+#if defined(__linux__) && defined(SPLICE_F_MOVE)
+	if (peer->pipe[0] != -1) return 1;
+	if (pipe2(peer->pipe, O_NONBLOCK|O_CLOEXEC)) {
+		uwsgi_cr_error(peer, "uwsgi_cr_splice_setup()/pipe2()");
+		peer->pipe[0] = -1;
+		peer->pipe[1] = -1;
+		return 0;
+	}
+#ifdef F_SETPIPE_SZ
+	// try to honour the configured buffer size (64k is the default pipe capacity)
+	if (peer->session->corerouter->buffer_size > 65536) {
+		fcntl(peer->pipe[1], F_SETPIPE_SZ, peer->session->corerouter->buffer_size);
+	}
+#endif
+	peer->pipe_len = 0;
+	return 1;
+#else
+	return 0;
+#endif
+}
+
+// move data from the peer socket to its pipe
+ssize_t uwsgi_cr_splice_read(struct corerouter_peer *peer) {
+#if defined(__linux__) && defined(SPLICE_F_MOVE)
+	size_t bufsize = peer->session->corerouter->buffer_size;
+	if (bufsize < 65536) bufsize = 65536;
+	ssize_t len = splice(peer->fd, NULL, peer->pipe[1], NULL, bufsize, SPLICE_F_MOVE|SPLICE_F_NONBLOCK);
+	if (len > 0) peer->pipe_len += len;
+	return len;
+#else
+	errno = ENOSYS;
+	return -1;
+#endif
+}
+
+// move data from the pipe of the src peer to the peer socket
+ssize_t uwsgi_cr_splice_write(struct corerouter_peer *peer, struct corerouter_peer *src) {
+#if defined(__linux__) && defined(SPLICE_F_MOVE)
+	ssize_t len = splice(src->pipe[0], NULL, peer->fd, NULL, src->pipe_len, SPLICE_F_MOVE|SPLICE_F_NONBLOCK);
+	if (len > 0) src->pipe_len -= len;
+	return len;
+#else
+	errno = ENOSYS;
+	return -1;
+#endif
+}
+
 void uwsgi_opt_corerouter(char *opt, char *value, void *cr) {
 	struct uwsgi_corerouter *ucr = (struct uwsgi_corerouter *) cr;
         uwsgi_new_gateway_socket(value, ucr->name);
@@ -409,6 +485,10 @@ void corerouter_close_peer(struct uwsgi_corerouter *ucr, struct corerouter_peer
 	}
 
 end:
+	if (peer != cs->main_peer && cs->peer_close) {
+		cs->peer_close(peer);
+	}
+
 	if (uwsgi_cr_peer_del(peer) < 0) return;
 
 	if (peer == cs->main_peer) {
@@ -460,15 +540,15 @@ struct uwsgi_rb_timer *corerouter_reset_timeout(struct uwsgi_corerouter *ucr, st
 	return cr_add_timeout(ucr, peer);
 }
 
-struct uwsgi_rb_timer *corerouter_reset_timeout_fast(struct uwsgi_corerouter *ucr, struct corerouter_peer *peer, time_t now) {
+struct uwsgi_rb_timer *corerouter_reset_timeout_fast(struct uwsgi_corerouter *ucr, struct corerouter_peer *peer, uint64_t now) {
         cr_del_timeout(ucr, peer);
         return cr_add_timeout_fast(ucr, peer, now);
 }
 
 
-static void corerouter_expire_timeouts(struct uwsgi_corerouter *ucr, time_t now) {
+static void corerouter_expire_timeouts(struct uwsgi_corerouter *ucr, uint64_t now) {
 
-	uint64_t current = (uint64_t) now;
+	uint64_t current = now;
 	struct uwsgi_rb_timer *urbt;
 	struct corerouter_peer *peer;
 
@@ -603,6 +683,8 @@ struct corerouter_session *corerouter_alloc_session(struct uwsgi_corerouter *ucr
 
 	peer->fd = new_connection;
 	peer->session = cs;
+	peer->pipe[0] = -1;
+	peer->pipe[1] = -1;
 
 	// map corerouter and socket
 	cs->corerouter = ucr;
@@ -679,7 +761,7 @@ void uwsgi_corerouter_loop(int id, void *data) {
 
 
 	if (!ucr->socket_timeout)
-		ucr->socket_timeout = 60;
+		ucr->socket_timeout = 60 * 1000;
 
 	if (!ucr->static_node_gracetime)
 		ucr->static_node_gracetime = 30;
@@ -728,7 +810,8 @@ void uwsgi_corerouter_loop(int id, void *data) {
 
 	int nevents;
 
-	time_t delta;
+	// milliseconds
+	int64_t delta;
 
 	struct uwsgi_rb_timer *min_timeout;
 
@@ -778,7 +861,8 @@ void uwsgi_corerouter_loop(int id, void *data) {
 
 	for (;;) {
 
-		time_t now = uwsgi_now();
+		// timeouts and harakiri are in milliseconds
+		uint64_t now = uwsgi_millis();
 
 		// set timeouts and harakiri
 		min_timeout = uwsgi_min_rb_timer(ucr->timeouts, NULL);
@@ -786,7 +870,7 @@ void uwsgi_corerouter_loop(int id, void *data) {
 			delta = -1;
 		}
 		else {
-			delta = min_timeout->value - now;
+			delta = (int64_t) min_timeout->value - (int64_t) now;
 			if (delta <= 0) {
 				corerouter_expire_timeouts(ucr, now);
 				delta = 0;
@@ -798,9 +882,9 @@ void uwsgi_corerouter_loop(int id, void *data) {
 		}
 
 		// wait for events
-		nevents = event_queue_wait_multi(ucr->queue, delta, events, ucr->nevents);
+		nevents = event_queue_wait_multi_ms(ucr->queue, delta, events, ucr->nevents);
 
-		now = uwsgi_now();
+		now = uwsgi_millis();
 
 		if (uwsgi.master_process && ucr->harakiri > 0) {
 			ushared->gateways_harakiri[id] = now + ucr->harakiri;
@@ -1018,6 +1102,10 @@ void corerouter_send_stats(struct uwsgi_corerouter *ucr) {
 
         if (uwsgi_stats_keylong_comma(us, "active_sessions", (unsigned long long) ucr->active_sessions)) goto end0;
 
+#ifdef UWSGI_SSL
+	if (uwsgi_ssl_stats(us)) goto end0;
+#endif
+
 	if (uwsgi_stats_key(us , ucr->short_name)) goto end0;
         if (uwsgi_stats_list_open(us)) goto end0;
 
@@ -3,7 +3,8 @@
 #define COREROUTER_STATUS_RECV_HDR 2
 #define COREROUTER_STATUS_RESPONSE 3
 
-#define cr_add_timeout(u, x) uwsgi_add_rb_timer(u->timeouts, uwsgi_now()+x->current_timeout, x)
+// timeouts are in milliseconds
+#define cr_add_timeout(u, x) uwsgi_add_rb_timer(u->timeouts, uwsgi_millis()+x->current_timeout, x)
 #define cr_add_timeout_fast(u, x, t) uwsgi_add_rb_timer(u->timeouts, t+x->current_timeout, x)
 #define cr_del_timeout(u, x) uwsgi_del_rb_timer(u->timeouts, x->timeout); free(x->timeout);
 
@@ -35,6 +36,24 @@
 
 #define cr_write_complete(peer) peer->out_pos == peer->out->pos
 
+#define cr_splice_read(peer, f) uwsgi_cr_splice_read(peer);\
+	if (len < 0) {\
+		cr_try_again;\
+		uwsgi_cr_error(peer, f);\
+		return -1;\
+	}\
+	if (peer != peer->session->main_peer && peer->un) peer->un->tx+=len;
+
+#define cr_splice_write(peer, src, f) uwsgi_cr_splice_write(peer, src);\
+	if (len < 0) {\
+		cr_try_again;\
+		uwsgi_cr_error(peer, f);\
+		return -1;\
+	}\
+	if (peer != peer->session->main_peer && peer->un) peer->un->rx+=len;
+
+#define cr_splice_complete(src) src->pipe_len == 0
+
 #define cr_write_complete_buf(peer, buf) buf##_pos == buf->pos
 
 #define cr_connect(peer, f) peer->fd = uwsgi_connectn(peer->instance_address, peer->instance_address_len, 0, 1);\
@@ -170,9 +189,18 @@ struct corerouter_peer {
 
 	// stream id (could have various use)
 	uint32_t sid;
+	// flow control window of the stream (for multiplexing protocols)
+	int64_t window;
+	// chunked response decoding (for multiplexing protocols): parser state,
+	// bytes left in the current chunk and decoded bytes at the head of "in"
+	int chunked;
+	uint64_t chunk_size;
+	size_t body_pos;
 
 	// internal parser status
 	int r_parser_status;
+	// the client has ended its side of the stream (for multiplexing protocols)
+	int remote_closed;
 
 	// can retry ?
 	int can_retry;
@@ -189,6 +217,7 @@ struct corerouter_peer {
 	struct corerouter_peer *prev;
 	struct corerouter_peer *next;
 
+	// milliseconds
 	int current_timeout;
 
 	ssize_t (*flush)(struct corerouter_peer *);
@@ -199,6 +228,10 @@ struct corerouter_peer {
 
 	int is_buffering;
 	int buffering_fd;
+
+	// splice() relay: pipe holding data read from this peer (and how much)
+	int pipe[2];
+	size_t pipe_len;
 };
 
 struct uwsgi_corerouter {
@@ -253,6 +286,7 @@ struct uwsgi_corerouter {
 
         struct uwsgi_string_list *fallback;
 
+        // milliseconds
         int socket_timeout;
 
         uint8_t code_string_modifier1;
@@ -265,6 +299,7 @@ struct uwsgi_corerouter {
         int i_am_cheap;
 
         int tolerance;
+        // milliseconds
         int harakiri;
 
         struct corerouter_peer **cr_table;
@@ -281,6 +316,11 @@ struct uwsgi_corerouter {
 
 	size_t buffer_size;
 	int fallback_on_no_key;
+
+	int splice;
+
+	// milliseconds (request budget exported as UWSGI_DEADLINE)
+	int deadline;
 };
 
 // a session is started when a client connect to the router
@@ -300,6 +340,8 @@ struct corerouter_session {
 
 	void (*close)(struct corerouter_session *);
 	int (*retry)(struct corerouter_peer *);
+	// called before destroying a backend peer (multiplexing protocols have to notify the client)
+	void (*peer_close)(struct corerouter_peer *);
 
 	// leave the main peer alive
 	int can_keepalive;
@@ -323,6 +365,9 @@ struct corerouter_session {
 
 	// use 11 bytes to be snprintf friendly
 	char client_port[11];
+
+	// arrival of the current request (milliseconds)
+	uint64_t request_start;
 };
 
 void uwsgi_opt_corerouter(char *, char *, void *);
@@ -364,3 +409,8 @@ struct corerouter_peer *uwsgi_cr_peer_add(struct corerouter_session *);
 struct corerouter_peer *uwsgi_cr_peer_find_by_sid(struct corerouter_session *, uint32_t);
 void corerouter_close_peer(struct uwsgi_corerouter *, struct corerouter_peer *);
 struct uwsgi_rb_timer *corerouter_reset_timeout(struct uwsgi_corerouter *, struct corerouter_peer *);
+
+int uwsgi_cr_splice_setup(struct corerouter_peer *);
+int uwsgi_cr_add_deadline(struct uwsgi_corerouter *, uint64_t, struct uwsgi_buffer *);
+ssize_t uwsgi_cr_splice_read(struct corerouter_peer *);
+ssize_t uwsgi_cr_splice_write(struct corerouter_peer *, struct corerouter_peer *);
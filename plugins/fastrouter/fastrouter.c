@@ -43,14 +43,14 @@ static struct uwsgi_option fastrouter_options[] = {
 	{"fastrouter-subscription-server", required_argument, 0, "run the fastrouter subscription server on the specified address", uwsgi_opt_corerouter_ss, &ufr, 0},
 	{"fastrouter-subscription-slot", required_argument, 0, "*** deprecated ***", uwsgi_opt_deprecated, (void *) "useless thanks to the new implementation", 0},
 
-	{"fastrouter-timeout", required_argument, 0, "set fastrouter timeout", uwsgi_opt_set_int, &ufr.cr.socket_timeout, 0},
+	{"fastrouter-timeout", required_argument, 0, "set fastrouter timeout", uwsgi_opt_set_msecs, &ufr.cr.socket_timeout, 0},
 	{"fastrouter-post-buffering", required_argument, 0, "enable fastrouter post buffering", uwsgi_opt_set_64bit, &ufr.cr.post_buffering, 0},
 	{"fastrouter-post-buffering-dir", required_argument, 0, "put fastrouter buffered files to the specified directory (noop, use TMPDIR env)", uwsgi_opt_set_str, &ufr.cr.pb_base_dir, 0},
 
 	{"fastrouter-stats", required_argument, 0, "run the fastrouter stats server", uwsgi_opt_set_str, &ufr.cr.stats_server, 0},
 	{"fastrouter-stats-server", required_argument, 0, "run the fastrouter stats server", uwsgi_opt_set_str, &ufr.cr.stats_server, 0},
 	{"fastrouter-ss", required_argument, 0, "run the fastrouter stats server", uwsgi_opt_set_str, &ufr.cr.stats_server, 0},
-	{"fastrouter-harakiri", required_argument, 0, "enable fastrouter harakiri", uwsgi_opt_set_int, &ufr.cr.harakiri, 0},
+	{"fastrouter-harakiri", required_argument, 0, "enable fastrouter harakiri", uwsgi_opt_set_msecs, &ufr.cr.harakiri, 0},
 
 	{"fastrouter-uid", required_argument, 0, "drop fastrouter privileges to the specified uid", uwsgi_opt_uid, &ufr.cr.uid, 0 },
         {"fastrouter-gid", required_argument, 0, "drop fastrouter privileges to the specified gid", uwsgi_opt_gid, &ufr.cr.gid, 0 },
@@ -58,6 +58,7 @@ static struct uwsgi_option fastrouter_options[] = {
 	{"fastrouter-resubscribe-bind", required_argument, 0, "bind to the specified address when re-subscribing", uwsgi_opt_set_str, &ufr.cr.resubscribe_bind, 0},
 
 	{"fastrouter-buffer-size", required_argument, 0, "set internal buffer size (default: page size)", uwsgi_opt_set_64bit, &ufr.cr.buffer_size, 0},
+	{"fastrouter-splice", no_argument, 0, "use splice() to move request body and response between peers without copying them in userspace (Linux only)", uwsgi_opt_true, &ufr.cr.splice, 0},
 	{"fastrouter-fallback-on-no-key", no_argument, 0, "move to fallback node even if a subscription key is not found", uwsgi_opt_true, &ufr.cr.fallback_on_no_key, 0},
 
 	{"fastrouter-force-key", required_argument, 0, "skip uwsgi parsing and directly set a key", uwsgi_opt_set_str, &ufr.force_key, 0},
@@ -133,8 +134,28 @@ static ssize_t fr_instance_write_body(struct corerouter_peer *peer) {
 }
 
 
+// splice client body to the instance
+static ssize_t fr_instance_splice_body(struct corerouter_peer *peer) {
+	struct corerouter_peer *main_peer = peer->session->main_peer;
+	ssize_t len = cr_splice_write(peer, main_peer, "fr_instance_splice_body()");
+	if (!len) return 0;
+
+	if (cr_splice_complete(main_peer)) {
+		cr_reset_hooks(peer);
+	}
+
+	return len;
+}
+
 // read client body
 static ssize_t fr_read_body(struct corerouter_peer *main_peer) {
+	if (ufr.cr.splice && uwsgi_cr_splice_setup(main_peer)) {
+		ssize_t len = cr_splice_read(main_peer, "fr_read_body()/splice()");
+		if (!len) return 0;
+		cr_write_to_backend(main_peer->session->peers, fr_instance_splice_body);
+		return len;
+	}
+
 	ssize_t len = cr_read(main_peer, "fr_read_body()");
         if (!len) return 0;
 
@@ -161,8 +182,28 @@ static ssize_t fr_write(struct corerouter_peer *main_peer) {
         return len;
 }
 
+// splice the instance response to the client
+static ssize_t fr_splice_write(struct corerouter_peer *main_peer) {
+	struct corerouter_peer *peer = main_peer->session->peers;
+	ssize_t len = cr_splice_write(main_peer, peer, "fr_splice_write()");
+	if (!len) return 0;
+
+	if (cr_splice_complete(peer)) {
+		cr_reset_hooks(main_peer);
+	}
+
+	return len;
+}
+
 // data from instance
 static ssize_t fr_instance_read(struct corerouter_peer *peer) {
+	if (ufr.cr.splice && uwsgi_cr_splice_setup(peer)) {
+		ssize_t len = cr_splice_read(peer, "fr_instance_read()/splice()");
+		if (!len) return 0;
+		cr_write_to_main(peer, fr_splice_write);
+		return len;
+	}
+
 	ssize_t len = cr_read(peer, "fr_instance_read()");
         if (!len) return 0;
 
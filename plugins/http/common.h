@@ -12,6 +12,34 @@ extern struct uwsgi_server uwsgi;
 #endif
 #endif
 
+#ifdef UWSGI_SSL
+#ifdef TLSEXT_TYPE_application_layer_protocol_negotiation
+#define UWSGI_HTTP2_ALPN
+#endif
+#endif
+
+#define UWSGI_HTTP2_PREFACE "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n"
+#define UWSGI_HTTP2_PREFACE_LEN 24
+
+// HPACK dynamic table (the size is the one announced by default in SETTINGS_HEADER_TABLE_SIZE)
+#define UWSGI_HPACK_TABLE_SIZE 4096
+// each entry takes at least 32 bytes
+#define UWSGI_HPACK_ENTRIES (UWSGI_HPACK_TABLE_SIZE / 32)
+
+struct uwsgi_hpack_entry {
+	char *buf;
+	uint16_t name_len;
+	uint16_t value_len;
+};
+
+struct uwsgi_hpack_table {
+	struct uwsgi_hpack_entry entries[UWSGI_HPACK_ENTRIES];
+	uint32_t newest;
+	uint32_t count;
+	size_t size;
+	size_t max_size;
+};
+
 struct uwsgi_http {
 
         struct uwsgi_corerouter cr;
@@ -23,6 +51,7 @@ struct uwsgi_http {
 
         int raw_body;
         int keepalive;
+        int keepalive_timeout;
         int auto_chunked;
         int auto_gzip;
 
@@ -51,6 +80,9 @@ struct uwsgi_http {
 
 	int proto_http;
 
+	int h2c;
+	int http2_max_streams;
+
 }; 
 
 struct http_session {
@@ -119,6 +151,32 @@ struct http_session {
         ssize_t (*spdy_hook)(struct corerouter_peer *);
 #endif
 
+	int http2;
+	int http2_initialized;
+	int http2_phase;
+	uint32_t http2_need;
+
+	uint8_t http2_frame_type;
+	uint8_t http2_frame_flags;
+	uint32_t http2_frame_length;
+	uint32_t http2_stream_id;
+
+	uint32_t http2_last_stream_id;
+	int http2_goaway;
+
+	// flow control (connection send window and initial window of new streams)
+	int64_t http2_window;
+	int64_t http2_initial_window;
+	uint32_t http2_max_frame_size;
+
+	// header block being collected (HEADERS + CONTINUATION)
+	struct uwsgi_buffer *http2_headers;
+	uint32_t http2_headers_stream_id;
+	uint8_t http2_headers_flags;
+
+	struct uwsgi_hpack_table *http2_hpack;
+	struct uwsgi_buffer *http2_out;
+
 #ifdef UWSGI_ZLIB
 	int can_gzip;
 	int has_gzip;
@@ -182,10 +240,25 @@ ssize_t spdy_parse(struct corerouter_peer *);
 void spdy_window_update(char *, uint32_t, uint32_t);
 #endif
 
+#ifdef UWSGI_HTTP2_ALPN
+int uwsgi_http2_alpn(SSL *, const unsigned char **, unsigned char *, const unsigned char *, unsigned int, void *);
+#endif
+ssize_t http2_parse(struct corerouter_peer *);
+ssize_t hr_instance_read_to_http2(struct corerouter_peer *);
+void http2_session_close(struct http_session *);
+
+struct uwsgi_hpack_table *hpack_table_new(void);
+void hpack_table_destroy(struct uwsgi_hpack_table *);
+int hpack_decode(struct uwsgi_hpack_table *, char *, size_t, void (*)(char *, uint16_t, char *, uint16_t, void *), void *);
+int hpack_encode_integer(struct uwsgi_buffer *, uint8_t, uint8_t, uint64_t);
+int hpack_encode_status(struct uwsgi_buffer *, char *);
+int hpack_encode_header(struct uwsgi_buffer *, char *, uint16_t, char *, uint16_t);
+
 ssize_t hs_http_manage(struct corerouter_peer *, ssize_t);
 
 ssize_t hr_instance_connected(struct corerouter_peer *);
 ssize_t hr_instance_write(struct corerouter_peer *);
+ssize_t hr_write(struct corerouter_peer *);
 
 ssize_t hr_instance_read_response(struct corerouter_peer *);
 ssize_t hr_read_body(struct corerouter_peer *);
@@ -193,5 +266,6 @@ ssize_t hr_write_body(struct corerouter_peer *);
 
 void hr_session_close(struct corerouter_session *);
 ssize_t http_parse(struct corerouter_peer *);
+void http_set_timeout(struct corerouter_peer *, int);
 
 int http_response_parse(struct http_session *, struct uwsgi_buffer *, size_t);
@@ -0,0 +1,300 @@
+/*
+
+   uWSGI HPACK (RFC 7541) encoder/decoder for the HTTP/2 router
+
+	the decoder fully implements the dynamic table and huffman strings,
+	the encoder only emits literals without indexing (they do not require
+	any state on our side and are always valid)
+
+*/
+
+#include "common.h"
+
+#include "hpack.h"
+
+// huffman decoding tree, children > 0 are nodes, children < 0 are -(symbol+1)
+static int16_t hpack_huffman_tree[256][2];
+static int hpack_huffman_ready = 0;
+
+static void hpack_huffman_init() {
+	int i, nodes = 1;
+	for(i=0;i<257;i++) {
+		int node = 0;
+		int j;
+		for(j=hpack_huffman_lengths[i]-1;j>=0;j--) {
+			int bit = (hpack_huffman_codes[i] >> j) & 1;
+			if (j == 0) {
+				hpack_huffman_tree[node][bit] = -(i+1);
+				break;
+			}
+			if (!hpack_huffman_tree[node][bit]) {
+				hpack_huffman_tree[node][bit] = nodes++;
+			}
+			node = hpack_huffman_tree[node][bit];
+		}
+	}
+	hpack_huffman_ready = 1;
+}
+
+static int hpack_huffman_decode(struct uwsgi_buffer *ub, uint8_t *buf, size_t len) {
+	size_t i;
+	int node = 0;
+	// padding must be shorter than 8 bits and made of ones (the EOS prefix)
+	int pad_bits = 0;
+	int pad_ones = 1;
+
+	if (!hpack_huffman_ready) hpack_huffman_init();
+
+	for(i=0;i<len;i++) {
+		int j;
+		for(j=7;j>=0;j--) {
+			int bit = (buf[i] >> j) & 1;
+			int next = hpack_huffman_tree[node][bit];
+			pad_bits++;
+			if (!bit) pad_ones = 0;
+			if (next < 0) {
+				// EOS is not allowed in the string
+				if (next == -257) return -1;
+				if (uwsgi_buffer_u8(ub, (uint8_t) (-next - 1))) return -1;
+				node = 0;
+				pad_bits = 0;
+				pad_ones = 1;
+				continue;
+			}
+			if (!next) return -1;
+			node = next;
+		}
+	}
+
+	if (pad_bits > 7 || !pad_ones) return -1;
+	return 0;
+}
+
+static int hpack_integer(uint8_t **ptr, uint8_t *watermark, uint8_t prefix, uint64_t *n) {
+	uint8_t mask = (1 << prefix) - 1;
+	if (*ptr >= watermark) return -1;
+	uint64_t value = **ptr & mask;
+	(*ptr)++;
+	if (value < mask) {
+		*n = value;
+		return 0;
+	}
+
+	int shift = 0;
+	while(*ptr < watermark) {
+		uint8_t b = **ptr;
+		(*ptr)++;
+		value += (uint64_t) (b & 0x7f) << shift;
+		if (!(b & 0x80)) {
+			*n = value;
+			return 0;
+		}
+		shift += 7;
+		// do not allow integers bigger than 32 bits
+		if (shift > 28) return -1;
+	}
+	return -1;
+}
+
+// decode a string literal at the end of the buffer (its offset and size are returned)
+static int hpack_string(uint8_t **ptr, uint8_t *watermark, struct uwsgi_buffer *ub, size_t *pos, uint16_t *len) {
+	if (*ptr >= watermark) return -1;
+	int huffman = **ptr & 0x80;
+	uint64_t s_len = 0;
+	if (hpack_integer(ptr, watermark, 7, &s_len)) return -1;
+	if (s_len > (uint64_t) (watermark - *ptr)) return -1;
+
+	*pos = ub->pos;
+	if (huffman) {
+		if (hpack_huffman_decode(ub, *ptr, s_len)) return -1;
+	}
+	else {
+		if (uwsgi_buffer_append(ub, (char *) *ptr, s_len)) return -1;
+	}
+	*ptr += s_len;
+
+	if (ub->pos - *pos > 0xffff) return -1;
+	*len = ub->pos - *pos;
+	return 0;
+}
+
+struct uwsgi_hpack_table *hpack_table_new() {
+	struct uwsgi_hpack_table *table = uwsgi_calloc(sizeof(struct uwsgi_hpack_table));
+	table->max_size = UWSGI_HPACK_TABLE_SIZE;
+	return table;
+}
+
+// remove the oldest entries until the table (plus the new item) fits
+static void hpack_table_evict(struct uwsgi_hpack_table *table, size_t needed) {
+	while(table->count > 0 && table->size + needed > table->max_size) {
+		uint32_t oldest = (table->newest + UWSGI_HPACK_ENTRIES - (table->count - 1)) % UWSGI_HPACK_ENTRIES;
+		struct uwsgi_hpack_entry *entry = &table->entries[oldest];
+		table->size -= entry->name_len + entry->value_len + 32;
+		free(entry->buf);
+		entry->buf = NULL;
+		table->count--;
+	}
+}
+
+void hpack_table_destroy(struct uwsgi_hpack_table *table) {
+	table->max_size = 0;
+	hpack_table_evict(table, 0);
+	free(table);
+}
+
+static void hpack_table_add(struct uwsgi_hpack_table *table, char *name, uint16_t name_len, char *value, uint16_t value_len) {
+	size_t needed = name_len + value_len + 32;
+	hpack_table_evict(table, needed);
+	// an entry bigger than the whole table simply empties it
+	if (needed > table->max_size) return;
+
+	table->newest = (table->newest + 1) % UWSGI_HPACK_ENTRIES;
+	struct uwsgi_hpack_entry *entry = &table->entries[table->newest];
+	entry->buf = uwsgi_concat2n(name, name_len, value, value_len);
+	entry->name_len = name_len;
+	entry->value_len = value_len;
+	table->size += needed;
+	table->count++;
+}
+
+static int hpack_table_get(struct uwsgi_hpack_table *table, uint64_t index, char **name, uint16_t *name_len, char **value, uint16_t *value_len) {
+	if (index == 0) return -1;
+	if (index <= UWSGI_HPACK_STATIC_ENTRIES) {
+		struct uwsgi_hpack_static_entry *entry = &hpack_static_table[index];
+		*name = entry->name;
+		*name_len = entry->name_len;
+		*value = entry->value;
+		*value_len = entry->value_len;
+		return 0;
+	}
+
+	index -= UWSGI_HPACK_STATIC_ENTRIES + 1;
+	if (index >= table->count) return -1;
+	struct uwsgi_hpack_entry *entry = &table->entries[(table->newest + UWSGI_HPACK_ENTRIES - index) % UWSGI_HPACK_ENTRIES];
+	*name = entry->buf;
+	*name_len = entry->name_len;
+	*value = entry->buf + entry->name_len;
+	*value_len = entry->value_len;
+	return 0;
+}
+
+/*
+
+	decode a whole header block calling the hook for each header,
+	the hook cannot stop the parsing (the dynamic table must be kept in sync),
+	so any error must be tracked in the data pointer.
+
+*/
+int hpack_decode(struct uwsgi_hpack_table *table, char *buf, size_t len, void (*hook)(char *, uint16_t, char *, uint16_t, void *), void *data) {
+	uint8_t *ptr = (uint8_t *) buf;
+	uint8_t *watermark = ptr + len;
+	// used for huffman decoding and for copies of table entries
+	struct uwsgi_buffer *ub = uwsgi_buffer_new(uwsgi.page_size);
+
+	while(ptr < watermark) {
+		uint8_t c = *ptr;
+		uint64_t index = 0;
+		char *name, *value;
+		uint16_t name_len, value_len;
+		size_t name_pos, value_pos;
+
+		ub->pos = 0;
+
+		// indexed header field
+		if (c & 0x80) {
+			if (hpack_integer(&ptr, watermark, 7, &index)) goto error;
+			if (hpack_table_get(table, index, &name, &name_len, &value, &value_len)) goto error;
+			hook(name, name_len, value, value_len, data);
+			continue;
+		}
+
+		// dynamic table size update
+		if ((c & 0xe0) == 0x20) {
+			if (hpack_integer(&ptr, watermark, 5, &index)) goto error;
+			if (index > UWSGI_HPACK_TABLE_SIZE) goto error;
+			table->max_size = index;
+			hpack_table_evict(table, 0);
+			continue;
+		}
+
+		// literal with incremental indexing (6 bits prefix) or without indexing/never indexed (4 bits prefix)
+		int incremental = (c & 0xc0) == 0x40;
+		if (hpack_integer(&ptr, watermark, incremental ? 6 : 4, &index)) goto error;
+
+		if (index) {
+			// copy the name, adding the new entry could evict it
+			if (hpack_table_get(table, index, &name, &name_len, &value, &value_len)) goto error;
+			name_pos = 0;
+			if (uwsgi_buffer_append(ub, name, name_len)) goto error;
+		}
+		else {
+			if (hpack_string(&ptr, watermark, ub, &name_pos, &name_len)) goto error;
+		}
+
+		if (hpack_string(&ptr, watermark, ub, &value_pos, &value_len)) goto error;
+
+		name = ub->buf + name_pos;
+		value = ub->buf + value_pos;
+
+		if (incremental) {
+			hpack_table_add(table, name, name_len, value, value_len);
+		}
+
+		hook(name, name_len, value, value_len, data);
+	}
+
+	uwsgi_buffer_destroy(ub);
+	return 0;
+
+error:
+	uwsgi_buffer_destroy(ub);
+	return -1;
+}
+
+int hpack_encode_integer(struct uwsgi_buffer *ub, uint8_t flags, uint8_t prefix, uint64_t n) {
+	uint8_t mask = (1 << prefix) - 1;
+	if (n < mask) {
+		return uwsgi_buffer_u8(ub, flags | n);
+	}
+
+	if (uwsgi_buffer_u8(ub, flags | mask)) return -1;
+	n -= mask;
+	while(n >= 128) {
+		if (uwsgi_buffer_u8(ub, (n & 0x7f) | 0x80)) return -1;
+		n >>= 7;
+	}
+	return uwsgi_buffer_u8(ub, n);
+}
+
+static int hpack_encode_string(struct uwsgi_buffer *ub, char *buf, size_t len) {
+	if (hpack_encode_integer(ub, 0, 7, len)) return -1;
+	return uwsgi_buffer_append(ub, buf, len);
+}
+
+// the status is always 3 digits
+int hpack_encode_status(struct uwsgi_buffer *ub, char *status) {
+	uint64_t i;
+	// 200, 204, 206, 304, 400, 404, 500 are in the static table
+	for(i=8;i<=14;i++) {
+		if (!memcmp(hpack_static_table[i].value, status, 3)) {
+			return hpack_encode_integer(ub, 0x80, 7, i);
+		}
+	}
+	if (hpack_encode_integer(ub, 0, 4, 8)) return -1;
+	return hpack_encode_string(ub, status, 3);
+}
+
+// literal header field without indexing (the name must be lowercase)
+int hpack_encode_header(struct uwsgi_buffer *ub, char *name, uint16_t name_len, char *value, uint16_t value_len) {
+	uint64_t i;
+	for(i=15;i<=UWSGI_HPACK_STATIC_ENTRIES;i++) {
+		if (!uwsgi_strncmp(hpack_static_table[i].name, hpack_static_table[i].name_len, name, name_len)) {
+			if (hpack_encode_integer(ub, 0, 4, i)) return -1;
+			return hpack_encode_string(ub, value, value_len);
+		}
+	}
+
+	if (uwsgi_buffer_u8(ub, 0)) return -1;
+	if (hpack_encode_string(ub, name, name_len)) return -1;
+	return hpack_encode_string(ub, value, value_len);
+}
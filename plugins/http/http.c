@@ -8,12 +8,22 @@
 
 struct uwsgi_http uhttp;
 
+// a bare --http-keepalive only enables it, a value sets the idle timeout too
+static void uwsgi_opt_http_keepalive(char *opt, char *value, void *none) {
+	if (!value) {
+		uhttp.keepalive = 1;
+		return;
+	}
+	uwsgi_opt_set_msecs(opt, value, &uhttp.keepalive_timeout);
+	uhttp.keepalive = uhttp.keepalive_timeout > 0;
+}
+
 struct uwsgi_option http_options[] = {
 	{"http", required_argument, 0, "add an http router/server on the specified address", uwsgi_opt_corerouter, &uhttp, 0},
 	{"httprouter", required_argument, 0, "add an http router/server on the specified address", uwsgi_opt_corerouter, &uhttp, 0},
 #ifdef UWSGI_SSL
 	{"https", required_argument, 0, "add an https router/server on the specified address with specified certificate and key", uwsgi_opt_https, &uhttp, 0},
-	{"https2", required_argument, 0, "add an https/spdy router/server using keyval options", uwsgi_opt_https2, &uhttp, 0},
+	{"https2", required_argument, 0, "add an https/spdy/http2 router/server using keyval options", uwsgi_opt_https2, &uhttp, 0},
 	{"https-export-cert", no_argument, 0, "export uwsgi variable HTTPS_CC containing the raw client certificate", uwsgi_opt_true, &uhttp.https_export_cert, 0},
 	{"https-session-context", required_argument, 0, "set the session id context to the specified value", uwsgi_opt_set_str, &uhttp.https_session_context, 0},
 	{"http-to-https", required_argument, 0, "add an http router/server on the specified address and redirect all of the requests to https", uwsgi_opt_http_to_https, &uhttp, 0},
@@ -31,9 +41,9 @@ struct uwsgi_option http_options[] = {
 	{"http-use-base", required_argument, 0, "use the specified base for mapping requests to unix sockets", uwsgi_opt_corerouter_use_base, &uhttp, 0},
 	{"http-events", required_argument, 0, "set the number of concurrent http async events", uwsgi_opt_set_int, &uhttp.cr.nevents, 0},
 	{"http-subscription-server", required_argument, 0, "enable the subscription server", uwsgi_opt_corerouter_ss, &uhttp, 0},
-	{"http-timeout", required_argument, 0, "set internal http socket timeout", uwsgi_opt_set_int, &uhttp.cr.socket_timeout, 0},
+	{"http-timeout", required_argument, 0, "set internal http socket timeout", uwsgi_opt_set_msecs, &uhttp.cr.socket_timeout, 0},
 	{"http-manage-expect", optional_argument, 0, "manage the Expect HTTP request header (optionally checking for Content-Length)", uwsgi_opt_set_64bit, &uhttp.manage_expect, 0},
-	{"http-keepalive", optional_argument, 0, "HTTP 1.1 keepalive support (non-pipelined) requests", uwsgi_opt_set_int, &uhttp.keepalive, 0},
+	{"http-keepalive", optional_argument, 0, "HTTP 1.1 keepalive support (non-pipelined) requests, optionally setting the idle timeout (seconds, or milliseconds with the ms suffix)", uwsgi_opt_http_keepalive, NULL, 0},
 	{"http-auto-chunked", no_argument, 0, "automatically transform output to chunked encoding during HTTP 1.1 keepalive (if needed)", uwsgi_opt_true, &uhttp.auto_chunked, 0},
 #ifdef UWSGI_ZLIB
 	{"http-auto-gzip", no_argument, 0, "automatically gzip content if uWSGI-Encoding header is set to gzip, but content size (Content-Length/Transfer-Encoding) and Content-Encoding are not specified", uwsgi_opt_true, &uhttp.auto_gzip, 0},
@@ -53,7 +63,7 @@ struct uwsgi_option http_options[] = {
 	{"http-stats", required_argument, 0, "run the http router stats server", uwsgi_opt_set_str, &uhttp.cr.stats_server, 0},
 	{"http-stats-server", required_argument, 0, "run the http router stats server", uwsgi_opt_set_str, &uhttp.cr.stats_server, 0},
 	{"http-ss", required_argument, 0, "run the http router stats server", uwsgi_opt_set_str, &uhttp.cr.stats_server, 0},
-	{"http-harakiri", required_argument, 0, "enable http router harakiri", uwsgi_opt_set_int, &uhttp.cr.harakiri, 0},
+	{"http-harakiri", required_argument, 0, "enable http router harakiri", uwsgi_opt_set_msecs, &uhttp.cr.harakiri, 0},
 	{"http-stud-prefix", required_argument, 0, "expect a stud prefix (1byte family + 4/16 bytes address) on connections from the specified address", uwsgi_opt_add_addr_list, &uhttp.stud_prefix, 0},
 	{"http-uid", required_argument, 0, "drop http router privileges to the specified uid", uwsgi_opt_uid, &uhttp.cr.uid, 0 },
 	{"http-gid", required_argument, 0, "drop http router privileges to the specified gid", uwsgi_opt_gid, &uhttp.cr.gid, 0 },
@@ -61,8 +71,9 @@ struct uwsgi_option http_options[] = {
 	{"http-buffer-size", required_argument, 0, "set internal buffer size (default: page size)", uwsgi_opt_set_64bit, &uhttp.cr.buffer_size, 0},
 
 	{"http-server-name-as-http-host", required_argument, 0, "force SERVER_NAME to HTTP_HOST", uwsgi_opt_true, &uhttp.server_name_as_http_host, 0},
-	{"http-headers-timeout", required_argument, 0, "set internal http socket timeout for headers", uwsgi_opt_set_int, &uhttp.headers_timeout, 0},
-	{"http-connect-timeout", required_argument, 0, "set internal http socket timeout for backend connections", uwsgi_opt_set_int, &uhttp.connect_timeout, 0},
+	{"http-deadline", required_argument, 0, "pass the deadline (arrival + budget) of each request to the backend as UWSGI_DEADLINE", uwsgi_opt_set_msecs, &uhttp.cr.deadline, 0},
+	{"http-headers-timeout", required_argument, 0, "set internal http socket timeout for headers", uwsgi_opt_set_msecs, &uhttp.headers_timeout, 0},
+	{"http-connect-timeout", required_argument, 0, "set internal http socket timeout for backend connections", uwsgi_opt_set_msecs, &uhttp.connect_timeout, 0},
 
 	{"http-manage-source", no_argument, 0, "manage the SOURCE HTTP method placing the session in raw mode", uwsgi_opt_true, &uhttp.manage_source, 0},
 	{"http-enable-proxy-protocol", optional_argument, 0, "manage PROXY protocol requests", uwsgi_opt_true, &uhttp.enable_proxy_protocol, 0},
@@ -70,6 +81,9 @@ struct uwsgi_option http_options[] = {
 	{"http-backend-http", no_argument, 0, "use plain http protocol instead of uwsgi for backend nodes", uwsgi_opt_true, &uhttp.proto_http, 0},
 
 	{"http-manage-rtsp", no_argument, 0, "manage RTSP sessions", uwsgi_opt_true, &uhttp.manage_rtsp, 0},
+
+	{"http-h2c", no_argument, 0, "accept HTTP/2 connections with prior knowledge (h2c) on plain http sockets", uwsgi_opt_true, &uhttp.h2c, 0},
+	{"http-http2-max-streams", required_argument, 0, "set the max number of concurrent HTTP/2 streams per connection (default 100)", uwsgi_opt_set_int, &uhttp.http2_max_streams, 0},
 	{0, 0, 0, 0, 0, 0, 0},
 };
 
@@ -105,7 +119,7 @@ static int rebuild_key_for_mountpoint(struct http_session *hr, struct corerouter
 	return 0;
 }
 
-static void http_set_timeout(struct corerouter_peer *peer, int timeout) {
+void http_set_timeout(struct corerouter_peer *peer, int timeout) {
 	if (peer->current_timeout == timeout) return;
 	peer->current_timeout = timeout;
 	peer->timeout = corerouter_reset_timeout(peer->session->corerouter, peer);
@@ -716,6 +730,9 @@ int http_headers_parse(struct corerouter_peer *peer, int skip) {
 	// UWSGI_ROUTER
 	if (uwsgi_buffer_append_keyval(out, "UWSGI_ROUTER", 12, "http", 4)) return -1;
 
+	// UWSGI_DEADLINE
+	if (uwsgi_cr_add_deadline(&uhttp.cr, hr->session.request_start, out)) return -1;
+
 	// stud HTTPS
 	if (hr->stud_prefix_pos > 0) {
 		if (uwsgi_buffer_append_keyval(out, "HTTPS", 5, "on", 2)) return -1;
@@ -908,7 +925,9 @@ ssize_t hr_instance_write(struct corerouter_peer *peer) {
 			return spdy_parse(peer->session->main_peer);
 		}
 #endif
-		
+		if (((struct http_session *) peer->session)->http2) {
+			return http2_parse(peer->session->main_peer);
+		}
         }
 
         return len;
@@ -935,6 +954,9 @@ ssize_t hr_write(struct corerouter_peer *main_peer) {
 			return len;
 		}
                 cr_reset_hooks(main_peer);
+		if (((struct http_session *) main_peer->session)->http2) {
+			return http2_parse(main_peer);
+		}
         }
 
         return len;
@@ -1005,12 +1027,15 @@ ssize_t hr_instance_read(struct corerouter_peer *peer) {
 		if (hr->session.can_keepalive) {
 			peer->session->main_peer->disabled = 0;
 			hr->rnrn = 0;
+			// the next request starts with its first bytes
+			hr->session.request_start = 0;
 #ifdef UWSGI_ZLIB
 			hr->can_gzip = 0;
 			hr->has_gzip = 0;
 #endif
-			if (uhttp.keepalive > 1) {
-				http_set_timeout(peer->session->main_peer, uhttp.keepalive);
+			// a bare --http-keepalive keeps the socket timeout
+			if (uhttp.keepalive_timeout) {
+				http_set_timeout(peer->session->main_peer, uhttp.keepalive_timeout);
 			}
 		}
 #ifdef UWSGI_ZLIB
@@ -1105,6 +1130,26 @@ ssize_t http_parse(struct corerouter_peer *main_peer) {
 	struct corerouter_session *cs = main_peer->session;
 	struct http_session *hr = (struct http_session *) cs;
 
+	if (hr->http2) {
+		return http2_parse(main_peer);
+	}
+
+	// HTTP/2 with prior knowledge
+	if (uhttp.h2c && hr->rnrn == 0) {
+		size_t preface_len = UMIN(main_peer->in->pos, UWSGI_HTTP2_PREFACE_LEN);
+		if (!memcmp(main_peer->in->buf, UWSGI_HTTP2_PREFACE, preface_len)) {
+			// wait for the whole preface
+			if (preface_len < UWSGI_HTTP2_PREFACE_LEN) return 1;
+			hr->http2 = 1;
+			return http2_parse(main_peer);
+		}
+	}
+
+	// the deadline is measured from the first bytes of the request, not from accept() or the TLS handshake
+	if (!cs->request_start) {
+		cs->request_start = uwsgi_millis();
+	}
+
 	// is it http body ?
 	if (hr->rnrn == 4) {
 		// something bad happened in keepalive mode...
@@ -1295,6 +1340,10 @@ void hr_session_close(struct corerouter_session *cs) {
 		uwsgi_buffer_destroy(hr->last_chunked);
 	}
 
+	if (hr->http2) {
+		http2_session_close(hr);
+	}
+
 #ifdef UWSGI_ZLIB
 	if (hr->z.next_in) {
 		deflateEnd(&hr->z);
@@ -1419,6 +1468,8 @@ void http_setup() {
 
 int http_init() {
 
+	if (!uhttp.http2_max_streams) uhttp.http2_max_streams = 100;
+
 	uhttp.cr.session_size = sizeof(struct http_session);
 	uhttp.cr.alloc_session = http_alloc_session;
 	if (uhttp.cr.has_sockets && !uwsgi_corerouter_has_backends(&uhttp.cr)) {
@@ -0,0 +1,1053 @@
+/*
+
+   uWSGI HTTP/2 router
+
+	each stream is mapped to a corerouter peer (the stream id is the peer sid),
+	so a single client connection can be multiplexed to multiple backends.
+
+	The connection is negotiated via ALPN (--https2 with http2=1) or with prior
+	knowledge on plain sockets (--http-h2c).
+
+	Requests are translated to uwsgi packets, responses are parsed
+	back to HEADERS + DATA frames honouring the client flow control windows.
+
+	Request bodies without content-length are buffered (up to UWSGI_HTTP2_MAX_BUFFERED_BODY)
+	until the end of the stream, as the backend needs to know where they end. Chunked
+	responses are decoded. A backend failure only resets its stream, the connection survives.
+
+*/
+
+#include "common.h"
+
+extern struct uwsgi_http uhttp;
+
+#define UWSGI_HTTP2_PHASE_PREFACE 0
+#define UWSGI_HTTP2_PHASE_HEADER 1
+#define UWSGI_HTTP2_PHASE_PAYLOAD 2
+
+#define UWSGI_HTTP2_DATA 0x0
+#define UWSGI_HTTP2_HEADERS 0x1
+#define UWSGI_HTTP2_PRIORITY 0x2
+#define UWSGI_HTTP2_RST_STREAM 0x3
+#define UWSGI_HTTP2_SETTINGS 0x4
+#define UWSGI_HTTP2_PUSH_PROMISE 0x5
+#define UWSGI_HTTP2_PING 0x6
+#define UWSGI_HTTP2_GOAWAY 0x7
+#define UWSGI_HTTP2_WINDOW_UPDATE 0x8
+#define UWSGI_HTTP2_CONTINUATION 0x9
+
+#define UWSGI_HTTP2_FLAG_END_STREAM 0x1
+#define UWSGI_HTTP2_FLAG_ACK 0x1
+#define UWSGI_HTTP2_FLAG_END_HEADERS 0x4
+#define UWSGI_HTTP2_FLAG_PADDED 0x8
+#define UWSGI_HTTP2_FLAG_PRIORITY 0x20
+
+#define UWSGI_HTTP2_PROTOCOL_ERROR 0x1
+#define UWSGI_HTTP2_INTERNAL_ERROR 0x2
+#define UWSGI_HTTP2_FLOW_CONTROL_ERROR 0x3
+#define UWSGI_HTTP2_STREAM_CLOSED_ERROR 0x5
+#define UWSGI_HTTP2_FRAME_SIZE_ERROR 0x6
+#define UWSGI_HTTP2_REFUSED_STREAM 0x7
+#define UWSGI_HTTP2_COMPRESSION_ERROR 0x9
+#define UWSGI_HTTP2_HTTP_1_1_REQUIRED 0xd
+
+#define UWSGI_HTTP2_SETTINGS_MAX_CONCURRENT_STREAMS 0x3
+#define UWSGI_HTTP2_SETTINGS_INITIAL_WINDOW_SIZE 0x4
+#define UWSGI_HTTP2_SETTINGS_MAX_FRAME_SIZE 0x5
+
+#define UWSGI_HTTP2_DEFAULT_WINDOW 65535
+#define UWSGI_HTTP2_MAX_WINDOW 0x7fffffff
+#define UWSGI_HTTP2_DEFAULT_FRAME_SIZE 16384
+#define UWSGI_HTTP2_MAX_FRAME_SIZE 16777215
+
+#define UWSGI_HTTP2_MAX_BUFFERED_BODY (1024 * 1024)
+
+// streams status (peer->r_parser_status)
+#define UWSGI_HTTP2_STREAM_HEADERS 0
+#define UWSGI_HTTP2_STREAM_BUFFERING 1
+#define UWSGI_HTTP2_STREAM_BODY 4
+#define UWSGI_HTTP2_STREAM_CLOSED 5
+
+// chunked responses decoder (peer->chunked)
+#define UWSGI_HTTP2_CHUNK_SIZE 1
+#define UWSGI_HTTP2_CHUNK_DATA 2
+#define UWSGI_HTTP2_CHUNK_CRLF 3
+#define UWSGI_HTTP2_CHUNK_TRAILERS 4
+#define UWSGI_HTTP2_CHUNK_DONE 5
+
+// used while decoding the request headers of a new stream
+struct http2_request {
+	struct corerouter_peer *peer;
+	struct uwsgi_buffer *cookies;
+	int has_method;
+	int has_path;
+	int has_authority;
+	int has_content_length;
+	int broken;
+};
+
+static int http2_frame(struct uwsgi_buffer *ub, uint32_t len, uint8_t type, uint8_t flags, uint32_t stream_id) {
+	if (uwsgi_buffer_u24be(ub, len)) return -1;
+	if (uwsgi_buffer_u8(ub, type)) return -1;
+	if (uwsgi_buffer_u8(ub, flags)) return -1;
+	return uwsgi_buffer_u32be(ub, stream_id & 0x7fffffff);
+}
+
+static int http2_window_update(struct uwsgi_buffer *ub, uint32_t stream_id, uint32_t increment) {
+	if (http2_frame(ub, 4, UWSGI_HTTP2_WINDOW_UPDATE, 0, stream_id)) return -1;
+	return uwsgi_buffer_u32be(ub, increment & 0x7fffffff);
+}
+
+static int http2_rst_stream(struct http_session *hr, uint32_t stream_id, uint32_t error) {
+	if (http2_frame(hr->http2_out, 4, UWSGI_HTTP2_RST_STREAM, 0, stream_id)) return -1;
+	return uwsgi_buffer_u32be(hr->http2_out, error);
+}
+
+// send the output buffer to the client
+static ssize_t http2_flush(struct http_session *hr) {
+	struct corerouter_peer *main_peer = hr->session.main_peer;
+	if (hr->http2_out->pos == 0) return 1;
+	main_peer->out = hr->http2_out;
+	main_peer->out_pos = 0;
+	cr_write_to_main(main_peer, hr->func_write);
+	return 1;
+}
+
+// connection error: send GOAWAY and close the connection as soon as it is written
+static ssize_t http2_goaway(struct http_session *hr, uint32_t error) {
+	if (http2_frame(hr->http2_out, 8, UWSGI_HTTP2_GOAWAY, 0, 0)) return -1;
+	if (uwsgi_buffer_u32be(hr->http2_out, hr->http2_last_stream_id)) return -1;
+	if (uwsgi_buffer_u32be(hr->http2_out, error)) return -1;
+	hr->http2_goaway = 1;
+	hr->session.wait_full_write = 1;
+	return http2_flush(hr);
+}
+
+// generate a HEADERS frame (split in CONTINUATION frames if needed)
+static int http2_headers_frames(struct http_session *hr, uint32_t stream_id, struct uwsgi_buffer *block, uint8_t flags) {
+	size_t pos = 0;
+	uint8_t type = UWSGI_HTTP2_HEADERS;
+	for(;;) {
+		size_t chunk = UMIN(block->pos - pos, hr->http2_max_frame_size);
+		uint8_t f = type == UWSGI_HTTP2_HEADERS ? flags : 0;
+		if (pos + chunk == block->pos) f |= UWSGI_HTTP2_FLAG_END_HEADERS;
+		if (http2_frame(hr->http2_out, chunk, type, f, stream_id)) return -1;
+		if (uwsgi_buffer_append(hr->http2_out, block->buf + pos, chunk)) return -1;
+		pos += chunk;
+		if (pos == block->pos) break;
+		type = UWSGI_HTTP2_CONTINUATION;
+	}
+	return 0;
+}
+
+// a response without body (used for backend errors)
+static int http2_reply_status(struct http_session *hr, uint32_t stream_id, char *status) {
+	struct uwsgi_buffer *block = uwsgi_buffer_new(64);
+	if (hpack_encode_status(block, status)) goto error;
+	if (hpack_encode_header(block, "content-length", 14, "0", 1)) goto error;
+	if (http2_headers_frames(hr, stream_id, block, UWSGI_HTTP2_FLAG_END_STREAM)) goto error;
+	uwsgi_buffer_destroy(block);
+	return 0;
+error:
+	uwsgi_buffer_destroy(block);
+	return -1;
+}
+
+// the body bytes ready to be sent (chunked responses are decoded in place)
+static size_t http2_body_ready(struct corerouter_peer *peer) {
+	if (peer->chunked) return peer->body_pos;
+	return peer->in->pos;
+}
+
+/*
+	send as much of the backend response body as the flow control windows allow,
+	when a window is exhausted the backend is no more read until a WINDOW_UPDATE arrives
+*/
+
+static int http2_send_data(struct http_session *hr, struct corerouter_peer *peer) {
+	size_t avail = http2_body_ready(peer);
+	while(avail > 0) {
+		int64_t window = UMIN(hr->http2_window, peer->window);
+		if (window <= 0) break;
+		size_t chunk = UMIN((size_t) window, avail);
+		chunk = UMIN(chunk, hr->http2_max_frame_size);
+		if (http2_frame(hr->http2_out, chunk, UWSGI_HTTP2_DATA, 0, peer->sid)) return -1;
+		if (uwsgi_buffer_append(hr->http2_out, peer->in->buf, chunk)) return -1;
+		if (uwsgi_buffer_decapitate(peer->in, chunk)) return -1;
+		if (peer->chunked) peer->body_pos -= chunk;
+		hr->http2_window -= chunk;
+		peer->window -= chunk;
+		avail -= chunk;
+	}
+
+	// the last chunk has been sent, the backend connection will be closed by the next read
+	if (peer->chunked == UWSGI_HTTP2_CHUNK_DONE && avail == 0 && peer->r_parser_status == UWSGI_HTTP2_STREAM_BODY) {
+		if (http2_frame(hr->http2_out, 0, UWSGI_HTTP2_DATA, UWSGI_HTTP2_FLAG_END_STREAM, peer->sid)) return -1;
+		peer->r_parser_status = UWSGI_HTTP2_STREAM_CLOSED;
+	}
+
+	if (avail > 0) {
+		peer->last_hook_read = NULL;
+		return uwsgi_cr_set_hooks(peer, NULL, NULL);
+	}
+	peer->last_hook_read = hr_instance_read_to_http2;
+	return 0;
+}
+
+// resume streams blocked by flow control
+static int http2_resume_streams(struct http_session *hr) {
+	struct corerouter_peer *peer = hr->session.peers;
+	while(peer) {
+		if (peer->r_parser_status == UWSGI_HTTP2_STREAM_BODY && http2_body_ready(peer) > 0) {
+			if (http2_send_data(hr, peer)) return -1;
+		}
+		peer = peer->next;
+	}
+	return 0;
+}
+
+static int http2_hop_by_hop(char *name, size_t len) {
+	if (!uwsgi_strncmp(name, len, "connection", 10)) return 1;
+	if (!uwsgi_strncmp(name, len, "keep-alive", 10)) return 1;
+	if (!uwsgi_strncmp(name, len, "proxy-connection", 16)) return 1;
+	if (!uwsgi_strncmp(name, len, "transfer-encoding", 17)) return 1;
+	if (!uwsgi_strncmp(name, len, "upgrade", 7)) return 1;
+	return 0;
+}
+
+/*
+	parse the HTTP/1.x response of the backend and translate it to a HEADERS frame.
+
+	returns 1 if more data is needed
+*/
+static int http2_response_headers(struct http_session *hr, struct corerouter_peer *peer) {
+	struct uwsgi_buffer *ub = peer->in;
+	size_t i, headers_size = 0;
+	for(i=3;i<ub->pos;i++) {
+		if (!memcmp(ub->buf + i - 3, "\r\n\r\n", 4)) {
+			headers_size = i + 1;
+			break;
+		}
+	}
+	if (!headers_size) return 1;
+
+	char *ptr = ub->buf;
+	char *watermark = ub->buf + headers_size - 2;
+
+	// status line
+	char *status = memchr(ptr, ' ', watermark - ptr);
+	if (!status || watermark - status < 4) return -1;
+	status++;
+	ptr = memchr(status, '\n', watermark - status);
+	if (!ptr) return -1;
+	ptr++;
+
+	struct uwsgi_buffer *block = uwsgi_buffer_new(uwsgi.page_size);
+	if (hpack_encode_status(block, status)) goto error;
+
+	while(ptr < watermark) {
+		char *eol = memchr(ptr, '\n', watermark - ptr);
+		if (!eol) goto error;
+		size_t line_len = eol - ptr;
+		if (line_len > 0 && ptr[line_len-1] == '\r') line_len--;
+		char *colon = memchr(ptr, ':', line_len);
+		if (!colon || colon == ptr) goto error;
+		size_t name_len = colon - ptr;
+		char *value = colon + 1;
+		char *value_end = ptr + line_len;
+		while(value < value_end && (*value == ' ' || *value == '\t')) value++;
+		if (name_len > 0xffff || value_end - value > 0xffff) goto error;
+		// header names must be lowercase
+		for(i=0;i<name_len;i++) {
+			ptr[i] = tolower((int) ptr[i]);
+		}
+		if (!uwsgi_strncmp(ptr, name_len, "transfer-encoding", 17)) {
+			if (uwsgi_contains_n(value, value_end - value, "chunked", 7)) {
+				peer->chunked = UWSGI_HTTP2_CHUNK_SIZE;
+				peer->chunk_size = 0;
+				peer->body_pos = 0;
+			}
+		}
+		else if (!http2_hop_by_hop(ptr, name_len)) {
+			if (hpack_encode_header(block, ptr, name_len, value, value_end - value)) goto error;
+		}
+		ptr = eol + 1;
+	}
+
+	if (http2_headers_frames(hr, peer->sid, block, 0)) goto error;
+	uwsgi_buffer_destroy(block);
+
+	// what remains is the body
+	if (uwsgi_buffer_decapitate(ub, headers_size)) return -1;
+	peer->r_parser_status = UWSGI_HTTP2_STREAM_BODY;
+	return 0;
+
+error:
+	uwsgi_buffer_destroy(block);
+	return -1;
+}
+
+/*
+	decode the chunked body in place: the decoded bytes are moved to the head of the buffer
+	(peer->body_pos), followed by what has still to be parsed
+*/
+static int http2_dechunk(struct corerouter_peer *peer) {
+	struct uwsgi_buffer *ub = peer->in;
+	size_t src = peer->body_pos;
+	size_t dst = peer->body_pos;
+
+	while(src < ub->pos) {
+		char *nl = NULL;
+		size_t n;
+		if (peer->chunked == UWSGI_HTTP2_CHUNK_DATA) {
+			n = UMIN(peer->chunk_size, ub->pos - src);
+			memmove(ub->buf + dst, ub->buf + src, n);
+			dst += n;
+			src += n;
+			peer->chunk_size -= n;
+			if (peer->chunk_size == 0) peer->chunked = UWSGI_HTTP2_CHUNK_CRLF;
+			continue;
+		}
+		if (peer->chunked == UWSGI_HTTP2_CHUNK_DONE) {
+			src = ub->pos;
+			break;
+		}
+		// all of the other states are lines
+		nl = memchr(ub->buf + src, '\n', ub->pos - src);
+		if (!nl) {
+			// do not allow unbound lines
+			if (ub->pos - src > 4096) return -1;
+			break;
+		}
+		n = (nl - (ub->buf + src)) + 1;
+		if (peer->chunked == UWSGI_HTTP2_CHUNK_SIZE) {
+			size_t i;
+			uint64_t size = 0;
+			int digits = 0;
+			for(i=0;i<n;i++) {
+				int c = tolower((int) ub->buf[src + i]);
+				if (c >= '0' && c <= '9') size = (size << 4) | (c - '0');
+				else if (c >= 'a' && c <= 'f') size = (size << 4) | (c - 'a' + 10);
+				else break;
+				// 15 hex digits are more than enough
+				if (++digits > 15) return -1;
+			}
+			if (!digits) return -1;
+			peer->chunk_size = size;
+			peer->chunked = size ? UWSGI_HTTP2_CHUNK_DATA : UWSGI_HTTP2_CHUNK_TRAILERS;
+		}
+		else if (peer->chunked == UWSGI_HTTP2_CHUNK_CRLF) {
+			if (n > 2 || (n == 2 && ub->buf[src] != '\r')) return -1;
+			peer->chunked = UWSGI_HTTP2_CHUNK_SIZE;
+		}
+		// trailers are discarded, the empty line ends the body
+		else if (n == 1 || (n == 2 && ub->buf[src] == '\r')) {
+			peer->chunked = UWSGI_HTTP2_CHUNK_DONE;
+		}
+		src += n;
+	}
+
+	memmove(ub->buf + dst, ub->buf + src, ub->pos - src);
+	ub->pos = dst + (ub->pos - src);
+	peer->body_pos = dst;
+	return 0;
+}
+
+// data from the backend
+ssize_t hr_instance_read_to_http2(struct corerouter_peer *peer) {
+	struct http_session *hr = (struct http_session *) peer->session;
+	if (uwsgi_buffer_ensure(peer->in, uwsgi.page_size)) return -1;
+	ssize_t len = cr_read(peer, "hr_instance_read_to_http2()");
+	if (!len) {
+		// the stream has already been completed
+		if (peer->r_parser_status == UWSGI_HTTP2_STREAM_CLOSED) return 0;
+		// the backend closed the connection without a valid (or complete) response,
+		// the client is notified by http2_peer_close()
+		if (peer->r_parser_status != UWSGI_HTTP2_STREAM_BODY || peer->chunked) return -1;
+		if (http2_frame(hr->http2_out, 0, UWSGI_HTTP2_DATA, UWSGI_HTTP2_FLAG_END_STREAM, peer->sid)) return -1;
+		peer->r_parser_status = UWSGI_HTTP2_STREAM_CLOSED;
+		if (http2_flush(hr) < 0) return -1;
+		// close the stream, the session survives as it is in keepalive mode
+		return 0;
+	}
+
+	// garbage after the end of the response
+	if (peer->r_parser_status == UWSGI_HTTP2_STREAM_CLOSED) {
+		peer->in->pos = 0;
+		return 1;
+	}
+
+	if (peer->r_parser_status != UWSGI_HTTP2_STREAM_BODY) {
+		int ret = http2_response_headers(hr, peer);
+		if (ret < 0) return -1;
+		if (ret > 0) return 1;
+	}
+
+	if (peer->chunked && http2_dechunk(peer)) return -1;
+
+	if (http2_send_data(hr, peer)) return -1;
+	return http2_flush(hr);
+}
+
+static int http2_add_var(struct http2_request *h2r, char *key, uint16_t keylen, char *val, uint16_t vallen) {
+	if (uwsgi_buffer_append_keyval(h2r->peer->out, key, keylen, val, vallen)) {
+		h2r->broken = 1;
+		return -1;
+	}
+	return 0;
+}
+
+static void http2_set_key(struct corerouter_peer *peer, char *value, uint16_t value_len) {
+	if (value_len > 0xff) return;
+	memcpy(peer->key, value, value_len);
+	peer->key_len = value_len;
+}
+
+// translate an HTTP/2 header to a uwsgi var
+static void http2_add_header(char *name, uint16_t name_len, char *value, uint16_t value_len, void *data) {
+	struct http2_request *h2r = (struct http2_request *) data;
+	struct corerouter_peer *peer = h2r->peer;
+	uint16_t i;
+
+	if (h2r->broken) return;
+
+	if (name_len > 0 && name[0] == ':') {
+		if (!uwsgi_strncmp(name, name_len, ":method", 7)) {
+			h2r->has_method = 1;
+			http2_add_var(h2r, "REQUEST_METHOD", 14, value, value_len);
+		}
+		else if (!uwsgi_strncmp(name, name_len, ":path", 5)) {
+			h2r->has_path = 1;
+			if (http2_add_var(h2r, "REQUEST_URI", 11, value, value_len)) return;
+			uint16_t path_info_len = value_len;
+			char *query_string = memchr(value, '?', value_len);
+			if (query_string) {
+				path_info_len = query_string - value;
+				query_string++;
+				if (http2_add_var(h2r, "QUERY_STRING", 12, query_string, value_len - (path_info_len + 1))) return;
+			}
+			else {
+				if (http2_add_var(h2r, "QUERY_STRING", 12, "", 0)) return;
+			}
+			// PATH_INFO must be url-decoded !!!
+			char *path_info = uwsgi_malloc(path_info_len + 1);
+			http_url_decode(value, &path_info_len, path_info);
+			http2_add_var(h2r, "PATH_INFO", 9, path_info, path_info_len);
+			free(path_info);
+		}
+		else if (!uwsgi_strncmp(name, name_len, ":authority", 10)) {
+			h2r->has_authority = 1;
+			if (http2_add_var(h2r, "HTTP_HOST", 9, value, value_len)) return;
+			http2_set_key(peer, value, value_len);
+		}
+		else if (!uwsgi_strncmp(name, name_len, ":scheme", 7)) {
+			http2_add_var(h2r, "UWSGI_SCHEME", 12, value, value_len);
+		}
+		else {
+			// unknown pseudo headers are a protocol error
+			h2r->broken = 1;
+		}
+		return;
+	}
+
+	// multiple cookie headers must be joined (RFC 7540 8.1.2.5)
+	if (!uwsgi_strncmp(name, name_len, "cookie", 6)) {
+		if (!h2r->cookies) {
+			h2r->cookies = uwsgi_buffer_new(value_len + 2);
+		}
+		else if (uwsgi_buffer_append(h2r->cookies, "; ", 2)) {
+			h2r->broken = 1;
+			return;
+		}
+		if (uwsgi_buffer_append(h2r->cookies, value, value_len)) h2r->broken = 1;
+		return;
+	}
+
+	if (!uwsgi_strncmp(name, name_len, "content-length", 14)) {
+		h2r->has_content_length = 1;
+		http2_add_var(h2r, "CONTENT_LENGTH", 14, value, value_len);
+		return;
+	}
+
+	if (!uwsgi_strncmp(name, name_len, "content-type", 12)) {
+		http2_add_var(h2r, "CONTENT_TYPE", 12, value, value_len);
+		return;
+	}
+
+	// :authority takes precedence (and pseudo headers come first)
+	if (!uwsgi_strncmp(name, name_len, "host", 4)) {
+		if (h2r->has_authority) return;
+		http2_set_key(peer, value, value_len);
+	}
+
+	char key[5 + 0xff];
+	if (name_len > 0xff) {
+		h2r->broken = 1;
+		return;
+	}
+	memcpy(key, "HTTP_", 5);
+	for(i=0;i<name_len;i++) {
+		if (name[i] == '-') {
+			key[5+i] = '_';
+		}
+		else {
+			key[5+i] = toupper((int) name[i]);
+		}
+	}
+	http2_add_var(h2r, key, 5 + name_len, value, value_len);
+}
+
+static void http2_discard_header(char *name, uint16_t name_len, char *value, uint16_t value_len, void *data) {
+}
+
+static int http2_request_vars(struct http_session *hr, struct corerouter_peer *peer) {
+	struct uwsgi_buffer *out = peer->out;
+
+	if (uwsgi_buffer_append_keyval(out, "SERVER_PROTOCOL", 15, "HTTP/2.0", 8)) return -1;
+	if (uwsgi_buffer_append_keyval(out, "SCRIPT_NAME", 11, "", 0)) return -1;
+	if (!uhttp.server_name_as_http_host && uwsgi_buffer_append_keyval(out, "SERVER_NAME", 11, uwsgi.hostname, uwsgi.hostname_len)) return -1;
+	memcpy(peer->key, uwsgi.hostname, uwsgi.hostname_len);
+	peer->key_len = uwsgi.hostname_len;
+	if (uwsgi_buffer_append_keyval(out, "SERVER_PORT", 11, hr->port, hr->port_len)) return -1;
+	if (uwsgi_buffer_append_keyval(out, "UWSGI_ROUTER", 12, "http", 4)) return -1;
+	// streams are multiplexed, the header block has just been completed
+	if (uwsgi_cr_add_deadline(&uhttp.cr, uwsgi_millis(), out)) return -1;
+	if (uwsgi_buffer_append_keyval(out, "HTTP2", 5, "on", 2)) return -1;
+	if (uwsgi_buffer_append_keynum(out, "HTTP2.stream", 12, peer->sid)) return -1;
+
+#ifdef UWSGI_SSL
+	if (hr_https_add_vars(hr, peer, out)) return -1;
+#endif
+
+	if (hr->proxy_src) {
+		if (uwsgi_buffer_append_keyval(out, "REMOTE_ADDR", 11, hr->proxy_src, hr->proxy_src_len)) return -1;
+		if (hr->proxy_src_port) {
+			if (uwsgi_buffer_append_keyval(out, "REMOTE_PORT", 11, hr->proxy_src_port, hr->proxy_src_port_len)) return -1;
+		}
+	}
+	else {
+		if (uwsgi_buffer_append_keyval(out, "REMOTE_ADDR", 11, hr->session.client_address, strlen(hr->session.client_address))) return -1;
+		if (uwsgi_buffer_append_keyval(out, "REMOTE_PORT", 11, hr->session.client_port, strlen(hr->session.client_port))) return -1;
+	}
+
+	struct uwsgi_string_list *hv = uhttp.http_vars;
+	while (hv) {
+		char *equal = strchr(hv->value, '=');
+		if (equal) {
+			if (uwsgi_buffer_append_keyval(out, hv->value, equal - hv->value, equal + 1, strlen(equal + 1))) return -1;
+		}
+		hv = hv->next;
+	}
+
+	return 0;
+}
+
+// refuse a stream we already allocated a peer for
+static ssize_t http2_refuse_stream(struct http_session *hr, struct corerouter_peer *peer, uint32_t error) {
+	uint32_t stream_id = peer->sid;
+	peer->r_parser_status = UWSGI_HTTP2_STREAM_CLOSED;
+	corerouter_close_peer(hr->session.corerouter, peer);
+	if (http2_rst_stream(hr, stream_id, error)) return -1;
+	return 0;
+}
+
+static int http2_connect(struct corerouter_peer *peer) {
+	cr_connect(peer, hr_instance_connected);
+	return 0;
+}
+
+// send the request to the backend
+static ssize_t http2_start_stream(struct http_session *hr, struct corerouter_peer *peer) {
+	int buffered = peer->r_parser_status == UWSGI_HTTP2_STREAM_BUFFERING;
+	if (buffered) {
+		if (uwsgi_buffer_append_keynum(peer->out, "CONTENT_LENGTH", 14, peer->in->pos)) return -1;
+	}
+
+	if (uhttp.modifier1)
+		peer->modifier1 = uhttp.modifier1;
+	if (uhttp.modifier2)
+		peer->modifier2 = uhttp.modifier2;
+	if (uwsgi_buffer_set_uh(peer->out, peer->modifier1, peer->modifier2)) return -1;
+	// from now on the buffer is used for the request body
+	peer->out->limit = 0;
+
+	if (buffered) {
+		if (uwsgi_buffer_append(peer->out, peer->in->buf, peer->in->pos)) return -1;
+		peer->in->pos = 0;
+		peer->in->limit = UMAX16;
+		peer->r_parser_status = UWSGI_HTTP2_STREAM_HEADERS;
+	}
+
+	peer->last_hook_read = hr_instance_read_to_http2;
+	peer->can_retry = 1;
+	if (http2_connect(peer)) {
+		// only this stream fails
+		uint32_t stream_id = peer->sid;
+		peer->can_retry = 0;
+		peer->r_parser_status = UWSGI_HTTP2_STREAM_CLOSED;
+		corerouter_close_peer(hr->session.corerouter, peer);
+		if (http2_reply_status(hr, stream_id, "502")) return -1;
+		return 0;
+	}
+	return 1;
+}
+
+/*
+	a stream peer is going to be destroyed: if its response has not been completed (backend
+	errors and timeouts) the client is notified and the parser (that could be waiting for the
+	backend) is resumed. A stream failure never closes the whole connection.
+*/
+static void http2_peer_close(struct corerouter_peer *peer) {
+	struct http_session *hr = (struct http_session *) peer->session;
+	struct corerouter_peer *main_peer = hr->session.main_peer;
+	int ret = 0;
+
+	if (peer->r_parser_status == UWSGI_HTTP2_STREAM_CLOSED) return;
+
+	if (!hr->http2_goaway) hr->session.can_keepalive = 1;
+
+	if (peer->r_parser_status == UWSGI_HTTP2_STREAM_HEADERS) {
+		ret = http2_reply_status(hr, peer->sid, "502");
+	}
+	else if (peer->r_parser_status == UWSGI_HTTP2_STREAM_BUFFERING) {
+		ret = http2_reply_status(hr, peer->sid, "408");
+	}
+	else {
+		ret = http2_rst_stream(hr, peer->sid, UWSGI_HTTP2_INTERNAL_ERROR);
+	}
+	peer->r_parser_status = UWSGI_HTTP2_STREAM_CLOSED;
+	if (ret || !main_peer) return;
+
+	// a write is already in progress, the frames will be sent with it
+	if (main_peer->hook_write) return;
+	main_peer->out = hr->http2_out;
+	main_peer->out_pos = 0;
+	if (uwsgi_cr_set_hooks(main_peer, NULL, hr->func_write)) return;
+	struct corerouter_peer *peers = hr->session.peers;
+	while(peers) {
+		if (peers != peer) uwsgi_cr_set_hooks(peers, NULL, NULL);
+		peers = peers->next;
+	}
+}
+
+// a full header block has been received, start a new stream
+static ssize_t http2_manage_request(struct http_session *hr, uint32_t stream_id) {
+	struct uwsgi_corerouter *ucr = hr->session.corerouter;
+	struct uwsgi_buffer *block = hr->http2_headers;
+
+	// not a new stream, the block is decoded only to keep the HPACK state in sync
+	if (stream_id <= hr->http2_last_stream_id || hr->http2_goaway) {
+		if (hpack_decode(hr->http2_hpack, block->buf, block->pos, http2_discard_header, NULL)) {
+			return http2_goaway(hr, UWSGI_HTTP2_COMPRESSION_ERROR);
+		}
+		// new streams are ignored after GOAWAY
+		if (stream_id > hr->http2_last_stream_id) return 0;
+		struct corerouter_peer *peer = uwsgi_cr_peer_find_by_sid(&hr->session, stream_id);
+		// the stream is gone or the client has already ended it
+		if (!peer) {
+			if (http2_rst_stream(hr, stream_id, UWSGI_HTTP2_STREAM_CLOSED_ERROR)) return -1;
+			return 0;
+		}
+		if (peer->remote_closed) {
+			return http2_refuse_stream(hr, peer, UWSGI_HTTP2_STREAM_CLOSED_ERROR);
+		}
+		// the only valid HEADERS on an open stream are the trailers, and they must end it
+		if (!(hr->http2_headers_flags & UWSGI_HTTP2_FLAG_END_STREAM)) {
+			return http2_refuse_stream(hr, peer, UWSGI_HTTP2_PROTOCOL_ERROR);
+		}
+		peer->remote_closed = 1;
+		// trailers end a buffered body
+		if (peer->r_parser_status == UWSGI_HTTP2_STREAM_BUFFERING) {
+			return http2_start_stream(hr, peer);
+		}
+		return 0;
+	}
+
+	hr->http2_last_stream_id = stream_id;
+
+	int streams = 0;
+	struct corerouter_peer *stream = hr->session.peers;
+	while(stream) {
+		streams++;
+		stream = stream->next;
+	}
+
+	if (streams >= uhttp.http2_max_streams) {
+		if (hpack_decode(hr->http2_hpack, block->buf, block->pos, http2_discard_header, NULL)) {
+			return http2_goaway(hr, UWSGI_HTTP2_COMPRESSION_ERROR);
+		}
+		if (http2_rst_stream(hr, stream_id, UWSGI_HTTP2_REFUSED_STREAM)) return -1;
+		return 0;
+	}
+
+	struct corerouter_peer *new_peer = uwsgi_cr_peer_add(&hr->session);
+	new_peer->last_hook_read = hr_instance_read_to_http2;
+	new_peer->sid = stream_id;
+	new_peer->remote_closed = (hr->http2_headers_flags & UWSGI_HTTP2_FLAG_END_STREAM) ? 1 : 0;
+	new_peer->window = hr->http2_initial_window;
+	new_peer->in->limit = UMAX16;
+	new_peer->out = uwsgi_buffer_new(uwsgi.page_size);
+	new_peer->out->limit = UMAX16;
+	// this will avoid the buffer being destroyed on the first instance write
+	new_peer->out_need_free = 2;
+	// leave space for uwsgi header
+	new_peer->out->pos = 4;
+
+	if (http2_request_vars(hr, new_peer)) return -1;
+
+	struct http2_request h2r;
+	memset(&h2r, 0, sizeof(struct http2_request));
+	h2r.peer = new_peer;
+	int ret = hpack_decode(hr->http2_hpack, block->buf, block->pos, http2_add_header, &h2r);
+	if (h2r.cookies) {
+		if (!h2r.broken && uwsgi_buffer_append_keyval(new_peer->out, "HTTP_COOKIE", 11, h2r.cookies->buf, h2r.cookies->pos)) h2r.broken = 1;
+		uwsgi_buffer_destroy(h2r.cookies);
+	}
+	// the HPACK state could be out of sync, the whole connection is gone
+	if (ret) {
+		new_peer->r_parser_status = UWSGI_HTTP2_STREAM_CLOSED;
+		corerouter_close_peer(ucr, new_peer);
+		return http2_goaway(hr, UWSGI_HTTP2_COMPRESSION_ERROR);
+	}
+
+	if (h2r.broken || !h2r.has_method || !h2r.has_path) {
+		return http2_refuse_stream(hr, new_peer, UWSGI_HTTP2_PROTOCOL_ERROR);
+	}
+
+	if (ucr->mapper(ucr, new_peer)) return -1;
+
+	if (new_peer->instance_address_len == 0) {
+		return http2_refuse_stream(hr, new_peer, UWSGI_HTTP2_REFUSED_STREAM);
+	}
+
+	// backends speaking plain HTTP are not supported, ask the client to retry with HTTP/1.1
+	if (new_peer->proto == 'h' || uhttp.proto_http) {
+		return http2_refuse_stream(hr, new_peer, UWSGI_HTTP2_HTTP_1_1_REQUIRED);
+	}
+
+	// the backend needs to know where the body ends
+	if (!(hr->http2_headers_flags & UWSGI_HTTP2_FLAG_END_STREAM) && !h2r.has_content_length) {
+		new_peer->r_parser_status = UWSGI_HTTP2_STREAM_BUFFERING;
+		new_peer->in->limit = UWSGI_HTTP2_MAX_BUFFERED_BODY;
+		// not connected yet, the hooks must not be restored
+		new_peer->last_hook_read = NULL;
+		return 0;
+	}
+
+	return http2_start_stream(hr, new_peer);
+}
+
+static ssize_t http2_manage_headers(struct http_session *hr) {
+	char *payload = hr->session.main_peer->in->buf;
+	uint32_t len = hr->http2_frame_length;
+
+	// client initiated streams are odd
+	if (!(hr->http2_stream_id & 1)) return http2_goaway(hr, UWSGI_HTTP2_PROTOCOL_ERROR);
+
+	if (hr->http2_frame_flags & UWSGI_HTTP2_FLAG_PADDED) {
+		if (len < 1) return http2_goaway(hr, UWSGI_HTTP2_PROTOCOL_ERROR);
+		uint8_t pad = payload[0];
+		if (pad >= len) return http2_goaway(hr, UWSGI_HTTP2_PROTOCOL_ERROR);
+		payload++;
+		len -= 1 + pad;
+	}
+
+	// we do not manage priorities
+	if (hr->http2_frame_flags & UWSGI_HTTP2_FLAG_PRIORITY) {
+		if (len < 5) return http2_goaway(hr, UWSGI_HTTP2_PROTOCOL_ERROR);
+		payload += 5;
+		len -= 5;
+	}
+
+	if (!hr->http2_headers) {
+		hr->http2_headers = uwsgi_buffer_new(uwsgi.page_size);
+		hr->http2_headers->limit = UMAX16;
+	}
+	hr->http2_headers->pos = 0;
+	if (uwsgi_buffer_append(hr->http2_headers, payload, len)) return -1;
+	hr->http2_headers_flags = hr->http2_frame_flags;
+
+	if (!(hr->http2_frame_flags & UWSGI_HTTP2_FLAG_END_HEADERS)) {
+		hr->http2_headers_stream_id = hr->http2_stream_id;
+		return 0;
+	}
+
+	return http2_manage_request(hr, hr->http2_stream_id);
+}
+
+static ssize_t http2_manage_continuation(struct http_session *hr) {
+	if (!hr->http2_headers_stream_id) return http2_goaway(hr, UWSGI_HTTP2_PROTOCOL_ERROR);
+	if (uwsgi_buffer_append(hr->http2_headers, hr->session.main_peer->in->buf, hr->http2_frame_length)) return -1;
+	if (!(hr->http2_frame_flags & UWSGI_HTTP2_FLAG_END_HEADERS)) return 0;
+	hr->http2_headers_stream_id = 0;
+	return http2_manage_request(hr, hr->http2_stream_id);
+}
+
+// request body, forwarded as is to the backend
+static ssize_t http2_manage_data(struct http_session *hr) {
+	char *payload = hr->session.main_peer->in->buf;
+	uint32_t len = hr->http2_frame_length;
+
+	if (!hr->http2_stream_id) return http2_goaway(hr, UWSGI_HTTP2_PROTOCOL_ERROR);
+
+	if (hr->http2_frame_flags & UWSGI_HTTP2_FLAG_PADDED) {
+		if (len < 1) return http2_goaway(hr, UWSGI_HTTP2_PROTOCOL_ERROR);
+		uint8_t pad = payload[0];
+		if (pad >= len) return http2_goaway(hr, UWSGI_HTTP2_PROTOCOL_ERROR);
+		payload++;
+		len -= 1 + pad;
+	}
+
+	struct corerouter_peer *peer = uwsgi_cr_peer_find_by_sid(&hr->session, hr->http2_stream_id);
+
+	// the body is consumed only when written to the backend, so we can immediately give back the window
+	if (hr->http2_frame_length > 0) {
+		if (http2_window_update(hr->http2_out, 0, hr->http2_frame_length)) return -1;
+		if (peer && !(hr->http2_frame_flags & UWSGI_HTTP2_FLAG_END_STREAM)) {
+			if (http2_window_update(hr->http2_out, peer->sid, hr->http2_frame_length)) return -1;
+		}
+	}
+
+	// the stream has been closed or reset, discard data
+	if (!peer) return 0;
+
+	if (hr->http2_frame_flags & UWSGI_HTTP2_FLAG_END_STREAM) {
+		peer->remote_closed = 1;
+	}
+
+	if (peer->r_parser_status == UWSGI_HTTP2_STREAM_BUFFERING) {
+		if (peer->in->pos + len > UWSGI_HTTP2_MAX_BUFFERED_BODY) {
+			uint32_t stream_id = peer->sid;
+			peer->r_parser_status = UWSGI_HTTP2_STREAM_CLOSED;
+			corerouter_close_peer(hr->session.corerouter, peer);
+			if (http2_reply_status(hr, stream_id, "413")) return -1;
+			return 0;
+		}
+		if (uwsgi_buffer_append(peer->in, payload, len)) return -1;
+		if (hr->http2_frame_flags & UWSGI_HTTP2_FLAG_END_STREAM) {
+			return http2_start_stream(hr, peer);
+		}
+		return 0;
+	}
+
+	if (len == 0) return 0;
+
+	peer->out->pos = 0;
+	peer->out_pos = 0;
+	if (uwsgi_buffer_append(peer->out, payload, len)) return -1;
+	cr_write_to_backend(peer, hr_instance_write);
+	return 1;
+}
+
+static ssize_t http2_manage_settings(struct http_session *hr) {
+	uint8_t *buf = (uint8_t *) hr->session.main_peer->in->buf;
+	uint32_t i;
+
+	if (hr->http2_stream_id) return http2_goaway(hr, UWSGI_HTTP2_PROTOCOL_ERROR);
+
+	if (hr->http2_frame_flags & UWSGI_HTTP2_FLAG_ACK) {
+		if (hr->http2_frame_length) return http2_goaway(hr, UWSGI_HTTP2_FRAME_SIZE_ERROR);
+		return 0;
+	}
+
+	if (hr->http2_frame_length % 6) return http2_goaway(hr, UWSGI_HTTP2_FRAME_SIZE_ERROR);
+
+	for(i=0;i<hr->http2_frame_length;i+=6) {
+		uint16_t id = uwsgi_be16((char *) buf + i);
+		uint32_t value = uwsgi_be32((char *) buf + i + 2);
+		if (id == UWSGI_HTTP2_SETTINGS_INITIAL_WINDOW_SIZE) {
+			if (value > UWSGI_HTTP2_MAX_WINDOW) return http2_goaway(hr, UWSGI_HTTP2_FLOW_CONTROL_ERROR);
+			// the difference is applied to all of the open streams
+			int64_t delta = (int64_t) value - hr->http2_initial_window;
+			struct corerouter_peer *peer = hr->session.peers;
+			while(peer) {
+				peer->window += delta;
+				if (peer->window > UWSGI_HTTP2_MAX_WINDOW) return http2_goaway(hr, UWSGI_HTTP2_FLOW_CONTROL_ERROR);
+				peer = peer->next;
+			}
+			hr->http2_initial_window = value;
+		}
+		else if (id == UWSGI_HTTP2_SETTINGS_MAX_FRAME_SIZE) {
+			if (value < UWSGI_HTTP2_DEFAULT_FRAME_SIZE || value > UWSGI_HTTP2_MAX_FRAME_SIZE) return http2_goaway(hr, UWSGI_HTTP2_PROTOCOL_ERROR);
+			hr->http2_max_frame_size = value;
+		}
+	}
+
+	if (http2_frame(hr->http2_out, 0, UWSGI_HTTP2_SETTINGS, UWSGI_HTTP2_FLAG_ACK, 0)) return -1;
+	if (http2_resume_streams(hr)) return -1;
+	return 0;
+}
+
+static ssize_t http2_manage_window_update(struct http_session *hr) {
+	if (hr->http2_frame_length != 4) return http2_goaway(hr, UWSGI_HTTP2_FRAME_SIZE_ERROR);
+	uint32_t increment = uwsgi_be32(hr->session.main_peer->in->buf) & 0x7fffffff;
+	if (!increment) return http2_goaway(hr, UWSGI_HTTP2_PROTOCOL_ERROR);
+
+	if (!hr->http2_stream_id) {
+		hr->http2_window += increment;
+		if (hr->http2_window > UWSGI_HTTP2_MAX_WINDOW) return http2_goaway(hr, UWSGI_HTTP2_FLOW_CONTROL_ERROR);
+	}
+	else {
+		struct corerouter_peer *peer = uwsgi_cr_peer_find_by_sid(&hr->session, hr->http2_stream_id);
+		if (!peer) return 0;
+		peer->window += increment;
+	}
+
+	if (http2_resume_streams(hr)) return -1;
+	return 0;
+}
+
+static ssize_t http2_manage_ping(struct http_session *hr) {
+	if (hr->http2_frame_length != 8) return http2_goaway(hr, UWSGI_HTTP2_FRAME_SIZE_ERROR);
+	if (hr->http2_frame_flags & UWSGI_HTTP2_FLAG_ACK) return 0;
+	if (http2_frame(hr->http2_out, 8, UWSGI_HTTP2_PING, UWSGI_HTTP2_FLAG_ACK, 0)) return -1;
+	if (uwsgi_buffer_append(hr->http2_out, hr->session.main_peer->in->buf, 8)) return -1;
+	return 0;
+}
+
+static ssize_t http2_manage_rst_stream(struct http_session *hr) {
+	if (hr->http2_frame_length != 4) return http2_goaway(hr, UWSGI_HTTP2_FRAME_SIZE_ERROR);
+	struct corerouter_peer *peer = uwsgi_cr_peer_find_by_sid(&hr->session, hr->http2_stream_id);
+	if (peer) {
+		peer->r_parser_status = UWSGI_HTTP2_STREAM_CLOSED;
+		corerouter_close_peer(hr->session.corerouter, peer);
+	}
+	return 0;
+}
+
+/*
+	returns -1 on error, 0 to go on with the next frame and 1 if i/o has been
+	scheduled (the parser will be resumed by the write hooks)
+*/
+static ssize_t http2_manage_frame(struct http_session *hr) {
+	switch(hr->http2_frame_type) {
+		case UWSGI_HTTP2_DATA:
+			return http2_manage_data(hr);
+		case UWSGI_HTTP2_HEADERS:
+			return http2_manage_headers(hr);
+		case UWSGI_HTTP2_CONTINUATION:
+			return http2_manage_continuation(hr);
+		case UWSGI_HTTP2_SETTINGS:
+			return http2_manage_settings(hr);
+		case UWSGI_HTTP2_WINDOW_UPDATE:
+			return http2_manage_window_update(hr);
+		case UWSGI_HTTP2_PING:
+			return http2_manage_ping(hr);
+		case UWSGI_HTTP2_RST_STREAM:
+			return http2_manage_rst_stream(hr);
+		case UWSGI_HTTP2_GOAWAY:
+			// no more streams, the client will close the connection
+			hr->http2_goaway = 1;
+			return 0;
+		case UWSGI_HTTP2_PUSH_PROMISE:
+			return http2_goaway(hr, UWSGI_HTTP2_PROTOCOL_ERROR);
+		// PRIORITY and unknown frames are ignored
+		default:
+			return 0;
+	}
+}
+
+static int http2_init(struct http_session *hr) {
+	hr->http2_out = uwsgi_buffer_new(uwsgi.page_size);
+	hr->http2_hpack = hpack_table_new();
+	hr->http2_window = UWSGI_HTTP2_DEFAULT_WINDOW;
+	hr->http2_initial_window = UWSGI_HTTP2_DEFAULT_WINDOW;
+	hr->http2_max_frame_size = UWSGI_HTTP2_DEFAULT_FRAME_SIZE;
+	hr->http2_phase = UWSGI_HTTP2_PHASE_PREFACE;
+	hr->http2_need = UWSGI_HTTP2_PREFACE_LEN;
+	// closing a stream must not close the whole connection
+	hr->session.can_keepalive = 1;
+	hr->session.peer_close = http2_peer_close;
+	hr->http2_initialized = 1;
+
+	// our SETTINGS frame is the first thing to send
+	if (http2_frame(hr->http2_out, 6, UWSGI_HTTP2_SETTINGS, 0, 0)) return -1;
+	if (uwsgi_buffer_u16be(hr->http2_out, UWSGI_HTTP2_SETTINGS_MAX_CONCURRENT_STREAMS)) return -1;
+	if (uwsgi_buffer_u32be(hr->http2_out, uhttp.http2_max_streams)) return -1;
+	return 0;
+}
+
+/*
+
+	read frames from the client
+
+	the parser runs until a frame requires i/o with a backend (a new stream or a DATA frame),
+	the write hooks will call it again once the backend has been served.
+
+*/
+ssize_t http2_parse(struct corerouter_peer *main_peer) {
+	struct http_session *hr = (struct http_session *) main_peer->session;
+
+	if (!hr->http2_initialized) {
+		if (http2_init(hr)) return -1;
+	}
+
+	// a GOAWAY is waiting to be sent, ignore everything else
+	if (hr->session.wait_full_write) return 1;
+
+	for(;;) {
+		size_t len = main_peer->in->pos;
+		uint8_t *buf = (uint8_t *) main_peer->in->buf;
+		if (len < hr->http2_need) break;
+		switch(hr->http2_phase) {
+			case UWSGI_HTTP2_PHASE_PREFACE:
+				if (memcmp(buf, UWSGI_HTTP2_PREFACE, UWSGI_HTTP2_PREFACE_LEN)) return -1;
+				if (uwsgi_buffer_decapitate(main_peer->in, UWSGI_HTTP2_PREFACE_LEN)) return -1;
+				hr->http2_phase = UWSGI_HTTP2_PHASE_HEADER;
+				hr->http2_need = 9;
+				continue;
+			case UWSGI_HTTP2_PHASE_HEADER:
+				hr->http2_frame_length = (buf[0] << 16) | (buf[1] << 8) | buf[2];
+				hr->http2_frame_type = buf[3];
+				hr->http2_frame_flags = buf[4];
+				hr->http2_stream_id = uwsgi_be32((char *) buf + 5) & 0x7fffffff;
+				if (uwsgi_buffer_decapitate(main_peer->in, 9)) return -1;
+				// we never announce a bigger SETTINGS_MAX_FRAME_SIZE
+				if (hr->http2_frame_length > UWSGI_HTTP2_DEFAULT_FRAME_SIZE) {
+					return http2_goaway(hr, UWSGI_HTTP2_FRAME_SIZE_ERROR);
+				}
+				// header blocks cannot be interleaved with other frames
+				if (hr->http2_headers_stream_id && (hr->http2_frame_type != UWSGI_HTTP2_CONTINUATION || hr->http2_stream_id != hr->http2_headers_stream_id)) {
+					return http2_goaway(hr, UWSGI_HTTP2_PROTOCOL_ERROR);
+				}
+				hr->http2_phase = UWSGI_HTTP2_PHASE_PAYLOAD;
+				hr->http2_need = hr->http2_frame_length;
+				continue;
+			case UWSGI_HTTP2_PHASE_PAYLOAD:
+				{
+				ssize_t ret = http2_manage_frame(hr);
+				if (ret < 0) return -1;
+				hr->http2_phase = UWSGI_HTTP2_PHASE_HEADER;
+				hr->http2_need = 9;
+				if (uwsgi_buffer_decapitate(main_peer->in, hr->http2_frame_length)) return -1;
+				if (ret > 0) return 1;
+				}
+				continue;
+			default:
+				return -1;
+		}
+	}
+
+	return http2_flush(hr);
+}
+
+void http2_session_close(struct http_session *hr) {
+	if (hr->http2_out) {
+		uwsgi_buffer_destroy(hr->http2_out);
+	}
+	if (hr->http2_headers) {
+		uwsgi_buffer_destroy(hr->http2_headers);
+	}
+	if (hr->http2_hpack) {
+		hpack_table_destroy(hr->http2_hpack);
+	}
+}
+
+#ifdef UWSGI_HTTP2_ALPN
+int uwsgi_http2_alpn(SSL *ssl, const unsigned char **out, unsigned char *outlen, const unsigned char *in, unsigned int inlen, void *arg) {
+	if (SSL_select_next_proto((unsigned char **) out, outlen, (const unsigned char *) "\x02h2\x08http/1.1", 12, in, inlen) != OPENSSL_NPN_NEGOTIATED) {
+		return SSL_TLSEXT_ERR_NOACK;
+	}
+	return SSL_TLSEXT_ERR_OK;
+}
+#endif
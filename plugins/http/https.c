@@ -69,6 +69,7 @@ void uwsgi_opt_https2(char *opt, char *value, void *cr) {
 	char *s2_ciphers = NULL;
 	char *s2_clientca = NULL;
 	char *s2_spdy = NULL;
+	char *s2_http2 = NULL;
 
 	if (uwsgi_kvlist_parse(value, strlen(value), ',', '=',
                         "addr", &s2_addr,
@@ -79,6 +80,7 @@ void uwsgi_opt_https2(char *opt, char *value, void *cr) {
                         "clientca", &s2_clientca,
                         "client_ca", &s2_clientca,
                         "spdy", &s2_spdy,
+                        "http2", &s2_http2,
                 	NULL)) {
 		uwsgi_log("error parsing --https2 option\n");
 		exit(1);
@@ -130,6 +132,13 @@ void uwsgi_opt_https2(char *opt, char *value, void *cr) {
         	SSL_CTX_set_next_protos_advertised_cb(ugs->ctx, uwsgi_spdy_npn, NULL);
 	}
 #endif
+	if (s2_http2) {
+#ifdef UWSGI_HTTP2_ALPN
+		SSL_CTX_set_alpn_select_cb(ugs->ctx, uwsgi_http2_alpn, NULL);
+#else
+		uwsgi_log("[uwsgi-http] ALPN is not supported by your OpenSSL version, HTTP/2 will not be negotiated\n");
+#endif
+	}
         // set the ssl mode
         ugs->mode = UWSGI_HTTP_SSL;
 
@@ -281,6 +290,7 @@ ssize_t hr_ssl_write(struct corerouter_peer *main_peer) {
                         	return 0;
                 	}
 			if (main_peer->session->connect_peer_after_write) {
+				http_set_timeout(main_peer->session->connect_peer_after_write, uhttp.connect_timeout);
                         	cr_connect(main_peer->session->connect_peer_after_write, hr_instance_connected);
                         	main_peer->session->connect_peer_after_write = NULL;
                         	return ret;
@@ -291,6 +301,9 @@ ssize_t hr_ssl_write(struct corerouter_peer *main_peer) {
 				return spdy_parse(main_peer);
 			}
 #endif
+			if (hr->http2) {
+				return http2_parse(main_peer);
+			}
                 }
                 return ret;
         }
@@ -349,6 +362,21 @@ ssize_t hr_ssl_read(struct corerouter_peer *main_peer) {
                         //uwsgi_log("RUNNING THE SPDY PARSER FOR %d bytes\n", main_peer->in->pos);
                         return spdy_parse(main_peer);
                 }
+#endif
+		// the handshake is done, if the kernel is encrypting records we can write cleartext directly to the socket
+		if (uwsgi.ssl_ktls && hr->func_write == hr_ssl_write && uwsgi_ssl_ktls_send(hr->ssl)) {
+			hr->func_write = hr_write;
+		}
+#ifdef UWSGI_HTTP2_ALPN
+		// check if h2 has been negotiated via ALPN
+		if (!hr->http2 && hr->rnrn == 0) {
+			const unsigned char *proto = NULL;
+			unsigned int proto_len = 0;
+			SSL_get0_alpn_selected(hr->ssl, &proto, &proto_len);
+			if (proto_len == 2 && !memcmp(proto, "h2", 2)) {
+				hr->http2 = 1;
+			}
+		}
 #endif
                 return http_parse(main_peer);
         }
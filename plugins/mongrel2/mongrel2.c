@@ -537,7 +537,7 @@ int uwsgi_proto_zeromq_sendfile(struct wsgi_request *wsgi_req, int fd, size_t po
 
 	size_t chunk_size = UMIN( len - wsgi_req->write_pos, UWSGI_MONGREL2_MAX_MSGSIZE);
 	char *tmp_buf = uwsgi_malloc(chunk_size);
-	ssize_t rlen = read(fd, tmp_buf, chunk_size);
+	ssize_t rlen = pread(fd, tmp_buf, chunk_size, pos + wsgi_req->write_pos);
 	if (rlen <= 0) {
 		free(tmp_buf);
 		return -1;
@@ -2259,6 +2259,16 @@ PyObject *py_uwsgi_request_id(PyObject * self, PyObject * args) {
 	return PyLong_FromUnsignedLongLong(uwsgi.workers[uwsgi.mywid].cores[wsgi_req->async_id].requests);
 }
 
+PyObject *py_uwsgi_deadline_left(PyObject * self, PyObject * args) {
+	struct wsgi_request *wsgi_req = py_current_wsgi_req();
+	int64_t left = uwsgi_request_deadline_left(wsgi_req);
+	if (left < 0) {
+		Py_INCREF(Py_None);
+		return Py_None;
+	}
+	return PyLong_FromLongLong(left);
+}
+
 PyObject *py_uwsgi_worker_id(PyObject * self, PyObject * args) {
 	return PyInt_FromLong(uwsgi.mywid);
 }
@@ -2458,6 +2468,7 @@ static PyMethodDef uwsgi_advanced_methods[] = {
 	{"masterpid", py_uwsgi_masterpid, METH_VARARGS, ""},
 	{"total_requests", py_uwsgi_total_requests, METH_VARARGS, ""},
 	{"request_id", py_uwsgi_request_id, METH_VARARGS, ""},
+	{"deadline_left", py_uwsgi_deadline_left, METH_VARARGS, ""},
 	{"worker_id", py_uwsgi_worker_id, METH_VARARGS, ""},
 	{"mule_id", py_uwsgi_mule_id, METH_VARARGS, ""},
 	{"log", py_uwsgi_log, METH_VARARGS, ""},
@@ -47,16 +47,17 @@ static struct uwsgi_option rawrouter_options[] = {
 	{"rawrouter-subscription-server", required_argument, 0, "run the rawrouter subscription server on the spcified address", uwsgi_opt_corerouter_ss, &urr, 0},
 	{"rawrouter-subscription-slot", required_argument, 0, "*** deprecated ***", uwsgi_opt_deprecated, (void *) "useless thanks to the new implementation", 0},
 
-	{"rawrouter-timeout", required_argument, 0, "set rawrouter timeout", uwsgi_opt_set_int, &urr.cr.socket_timeout, 0},
+	{"rawrouter-timeout", required_argument, 0, "set rawrouter timeout", uwsgi_opt_set_msecs, &urr.cr.socket_timeout, 0},
 
 	{"rawrouter-stats", required_argument, 0, "run the rawrouter stats server", uwsgi_opt_set_str, &urr.cr.stats_server, 0},
 	{"rawrouter-stats-server", required_argument, 0, "run the rawrouter stats server", uwsgi_opt_set_str, &urr.cr.stats_server, 0},
 	{"rawrouter-ss", required_argument, 0, "run the rawrouter stats server", uwsgi_opt_set_str, &urr.cr.stats_server, 0},
-	{"rawrouter-harakiri", required_argument, 0, "enable rawrouter harakiri", uwsgi_opt_set_int, &urr.cr.harakiri, 0},
+	{"rawrouter-harakiri", required_argument, 0, "enable rawrouter harakiri", uwsgi_opt_set_msecs, &urr.cr.harakiri, 0},
 
 	{"rawrouter-xclient", no_argument, 0, "use the xclient protocol to pass the client addres", uwsgi_opt_true, &urr.xclient, 0},
 
 	{"rawrouter-buffer-size", required_argument, 0, "set internal buffer size (default: page size)", uwsgi_opt_set_64bit, &urr.cr.buffer_size, 0},
+	{"rawrouter-splice", no_argument, 0, "use splice() to move data between peers without copying it in userspace (Linux only)", uwsgi_opt_true, &urr.cr.splice, 0},
 
 	{0, 0, 0, 0, 0, 0, 0},
 };
@@ -93,8 +94,41 @@ static ssize_t rr_write(struct corerouter_peer *main_peer) {
 	return len;
 }
 
+// splice to backend
+static ssize_t rr_instance_splice_write(struct corerouter_peer *peer) {
+	struct corerouter_peer *main_peer = peer->session->main_peer;
+	ssize_t len = cr_splice_write(peer, main_peer, "rr_instance_splice_write()");
+	if (!len) return 0;
+
+	if (cr_splice_complete(main_peer)) {
+		cr_reset_hooks(peer);
+	}
+
+	return len;
+}
+
+// splice to client
+static ssize_t rr_splice_write(struct corerouter_peer *main_peer) {
+	struct corerouter_peer *peer = main_peer->session->peers;
+	ssize_t len = cr_splice_write(main_peer, peer, "rr_splice_write()");
+	if (!len) return 0;
+
+	if (cr_splice_complete(peer)) {
+		cr_reset_hooks(main_peer);
+	}
+
+	return len;
+}
+
 // read from backend
 static ssize_t rr_instance_read(struct corerouter_peer *peer) {
+	if (urr.cr.splice && uwsgi_cr_splice_setup(peer)) {
+		ssize_t len = cr_splice_read(peer, "rr_instance_read()/splice()");
+		if (!len) return 0;
+		cr_write_to_main(peer, rr_splice_write);
+		return len;
+	}
+
 	ssize_t len = cr_read(peer, "rr_instance_read()");
 	if (!len) return 0;
 
@@ -179,6 +213,13 @@ static ssize_t rr_instance_connected(struct corerouter_peer *peer) {
 
 // read from client
 static ssize_t rr_read(struct corerouter_peer *main_peer) {
+	if (urr.cr.splice && uwsgi_cr_splice_setup(main_peer)) {
+		ssize_t len = cr_splice_read(main_peer, "rr_read()/splice()");
+		if (!len) return 0;
+		cr_write_to_backend(main_peer->session->peers, rr_instance_splice_write);
+		return len;
+	}
+
 	ssize_t len = cr_read(main_peer, "rr_read()");
 	if (!len) return 0;
 
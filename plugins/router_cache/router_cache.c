@@ -172,12 +172,30 @@ static int uwsgi_routing_func_cache(struct wsgi_request *wsgi_req, struct uwsgi_
 
 	uint64_t valsize = 0;
 	uint64_t expires = 0;
-	char *value = uwsgi_cache_magic_get(ub->buf, ub->pos, &valsize, &expires, urcc->name);
-	if (urcc->mime && value) {
+	char *value = NULL;
+	struct uwsgi_cache_lease ucl;
+	int leased = 0;
+	// local items can be streamed by the offload threads directly from the cache memory
+	if (uwsgi.offload_threads > 0 && wsgi_req->socket->can_offload && !ur->custom && !urcc->no_offload) {
+		int ret = uwsgi_cache_lease(ub->buf, ub->pos, urcc->name, &ucl);
+		if (ret < 0) {
+			uwsgi_buffer_destroy(ub);
+			return UWSGI_ROUTE_NEXT;
+		}
+		if (ret == 0) {
+			leased = 1;
+			valsize = ucl.valsize;
+			expires = ucl.expires;
+		}
+	}
+	if (!leased) {
+		value = uwsgi_cache_magic_get(ub->buf, ub->pos, &valsize, &expires, urcc->name);
+	}
+	if (urcc->mime && (value || leased)) {
 		mime_type = uwsgi_get_mime_type(ub->buf, ub->pos, &mime_type_len);	
 	}
 	uwsgi_buffer_destroy(ub);
-	if (value) {
+	if (value || leased) {
 		if (uwsgi_response_prepare_headers(wsgi_req, "200 OK", 6)) goto error;
 		if (mime_type) {
                         uwsgi_response_add_content_type(wsgi_req, mime_type, mime_type_len);
@@ -194,7 +212,20 @@ static int uwsgi_routing_func_cache(struct wsgi_request *wsgi_req, struct uwsgi_
 		if (!urcc->no_cl) {
 			if (uwsgi_response_add_content_length(wsgi_req, valsize)) goto error;
 		}
-		if (wsgi_req->socket->can_offload && !ur->custom && !urcc->no_offload) {
+		if (leased) {
+			// the offload thread only sends the body
+			if (uwsgi_response_write_headers_do(wsgi_req) < 0) goto error;
+			if (!uwsgi_offload_request_cache_do(wsgi_req, &ucl)) {
+				wsgi_req->via = UWSGI_VIA_OFFLOAD;
+				wsgi_req->response_size += valsize;
+				return UWSGI_ROUTE_BREAK;
+			}
+			value = uwsgi_cache_lease_get(&ucl);
+			// the item changed in the meantime, headers are already there
+			if (!value) return UWSGI_ROUTE_BREAK;
+		}
+		else if (wsgi_req->socket->can_offload && !ur->custom && !urcc->no_offload) {
+			if (uwsgi_response_write_headers_do(wsgi_req) < 0) goto error;
                 	if (!uwsgi_offload_request_memory_do(wsgi_req, value, valsize)) {
                         	wsgi_req->via = UWSGI_VIA_OFFLOAD;
                         	return UWSGI_ROUTE_BREAK;
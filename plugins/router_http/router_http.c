@@ -99,6 +99,187 @@ end:
 
 }
 
+/*
+	http11:addr=<upstream>[,host=<host>][,uri=<uri>][,delheader=<name>][,setheader=<name>: <value>][,addheader=<name>: <value>]
+
+	the request (body included) is sent to the upstream server by an offload thread, using
+	HTTP/1.1 when the client speaks it. The response headers are edited before being forwarded
+	(header keys can be repeated).
+
+	The offload thread does not read from the client, so the body is read in memory before
+	the hand-off. Bodies bigger than UWSGI_ROUTER_HTTP11_MAX_BODY (and every request when offload
+	threads are not available) are streamed by the worker with a blocking proxy instead: the
+	header edits are applied by the response headers api.
+*/
+
+#define UWSGI_ROUTER_HTTP11_MAX_BODY (1024 * 1024)
+
+struct uwsgi_router_http11_conf {
+	char *addr;
+	size_t addr_len;
+	char *host;
+	size_t host_len;
+	char *uri;
+	size_t uri_len;
+	struct uwsgi_string_list *remove;
+	struct uwsgi_string_list *replace;
+	struct uwsgi_string_list *add;
+};
+
+// the blocking proxy passes the response headers to uwsgi_response_add_header()
+static void uwsgi_router_http11_edit_headers(struct wsgi_request *wsgi_req, struct uwsgi_router_http11_conf *urhc) {
+	struct uwsgi_string_list *usl = urhc->remove;
+	while(usl) {
+		uwsgi_remove_header(wsgi_req, usl->value, usl->custom);
+		usl = usl->next;
+	}
+	usl = urhc->replace;
+	while(usl) {
+		uwsgi_remove_header(wsgi_req, usl->value, usl->custom);
+		uwsgi_additional_header_add(wsgi_req, usl->value, usl->len);
+		usl = usl->next;
+	}
+	usl = urhc->add;
+	while(usl) {
+		uwsgi_additional_header_add(wsgi_req, usl->value, usl->len);
+		usl = usl->next;
+	}
+}
+
+static int uwsgi_routing_func_http11(struct wsgi_request *wsgi_req, struct uwsgi_route *ur) {
+
+	struct uwsgi_router_http11_conf *urhc = (struct uwsgi_router_http11_conf *) ur->data2;
+	struct uwsgi_buffer *ub = NULL, *ub_host = NULL, *ub_url = NULL;
+
+	wsgi_req->via = UWSGI_VIA_ROUTE;
+
+	char **subject = (char **) (((char *)(wsgi_req))+ur->subject);
+	uint16_t *subject_len = (uint16_t *)  (((char *)(wsgi_req))+ur->subject_len);
+
+	struct uwsgi_buffer *ub_addr = uwsgi_routing_translate(wsgi_req, ur, *subject, *subject_len, urhc->addr, urhc->addr_len);
+	if (!ub_addr) return UWSGI_ROUTE_BREAK;
+
+	if (urhc->host) {
+		ub_host = uwsgi_routing_translate(wsgi_req, ur, *subject, *subject_len, urhc->host, urhc->host_len);
+		if (!ub_host) goto end;
+	}
+
+	if (urhc->uri) {
+		ub_url = uwsgi_routing_translate(wsgi_req, ur, *subject, *subject_len, urhc->uri, urhc->uri_len);
+		if (!ub_url) goto end;
+	}
+
+	if (!uwsgi_strncmp(wsgi_req->protocol, wsgi_req->protocol_len, "HTTP/1.1", 8)) {
+		ub = uwsgi_to_http11(wsgi_req, ub_host ? ub_host->buf : NULL, ub_host ? ub_host->pos : 0, ub_url ? ub_url->buf : NULL, ub_url ? ub_url->pos : 0);
+	}
+	else {
+		ub = uwsgi_to_http(wsgi_req, ub_host ? ub_host->buf : NULL, ub_host ? ub_host->pos : 0, ub_url ? ub_url->buf : NULL, ub_url ? ub_url->pos : 0);
+	}
+
+	if (!ub) {
+		uwsgi_log("unable to generate http request for %s\n", ub_addr->buf);
+		goto end;
+	}
+
+	if (wsgi_req->socket->can_offload && uwsgi.offload_threads > 0 && wsgi_req->post_cl <= UWSGI_ROUTER_HTTP11_MAX_BODY) {
+		// the offload thread does not read from the client, so the body goes with the request
+		for(;;) {
+			ssize_t rlen = 0;
+			char *chunk = uwsgi_request_body_read(wsgi_req, 32768, &rlen);
+			if (chunk == uwsgi.empty) break;
+			if (!chunk || rlen <= 0) goto end;
+			if (uwsgi_buffer_append(ub, chunk, rlen)) goto end;
+		}
+
+		if (!uwsgi_offload_request_http_do(wsgi_req, ub_addr->buf, ub, urhc->remove, urhc->replace, urhc->add)) {
+			wsgi_req->via = UWSGI_VIA_OFFLOAD;
+			wsgi_req->status = 202;
+			// the buffer is now owned by the offload thread
+			ub = NULL;
+			goto end;
+		}
+		// the body has been consumed
+		uwsgi_log("unable to offload http request for %s\n", ub_addr->buf);
+		goto end;
+	}
+
+	// append remaining body...
+	if (wsgi_req->proto_parser_remains > 0) {
+		if (uwsgi_buffer_append(ub, wsgi_req->proto_parser_remains_buf, wsgi_req->proto_parser_remains)) goto end;
+		wsgi_req->post_pos += wsgi_req->proto_parser_remains;
+		wsgi_req->proto_parser_remains = 0;
+	}
+
+	uwsgi_router_http11_edit_headers(wsgi_req, urhc);
+
+	if (uwsgi_proxy_nb(wsgi_req, ub_addr->buf, ub, wsgi_req->post_cl - wsgi_req->post_pos, uwsgi.socket_timeout)) {
+		uwsgi_log("error routing request to http server %s\n", ub_addr->buf);
+	}
+
+end:
+	if (ub) uwsgi_buffer_destroy(ub);
+	if (ub_host) uwsgi_buffer_destroy(ub_host);
+	if (ub_url) uwsgi_buffer_destroy(ub_url);
+	uwsgi_buffer_destroy(ub_addr);
+	return UWSGI_ROUTE_BREAK;
+}
+
+static void uwsgi_router_http11_header(struct uwsgi_string_list **list, char *value) {
+	struct uwsgi_string_list *usl = uwsgi_string_new_list(list, value);
+	char *colon = strchr(value, ':');
+	usl->custom = colon ? (uint64_t) (colon - value) : usl->len;
+}
+
+static int uwsgi_router_http11(struct uwsgi_route *ur, char *args) {
+
+	ur->func = uwsgi_routing_func_http11;
+	struct uwsgi_router_http11_conf *urhc = uwsgi_calloc(sizeof(struct uwsgi_router_http11_conf));
+
+	// keys can be repeated, so uwsgi_kvlist_parse() is not an option
+	char *argv_list = uwsgi_str(args);
+	char *p, *ctx = NULL;
+	uwsgi_foreach_token(argv_list, ",", p, ctx) {
+		char *equal = strchr(p, '=');
+		if (!equal) goto error;
+		*equal = 0;
+		char *value = equal + 1;
+		if (!strcmp(p, "addr")) {
+			urhc->addr = value;
+		}
+		else if (!strcmp(p, "host")) {
+			urhc->host = value;
+		}
+		else if (!strcmp(p, "uri")) {
+			urhc->uri = value;
+		}
+		else if (!strcmp(p, "delheader")) {
+			uwsgi_router_http11_header(&urhc->remove, value);
+		}
+		else if (!strcmp(p, "setheader")) {
+			if (!strchr(value, ':')) goto error;
+			uwsgi_router_http11_header(&urhc->replace, value);
+		}
+		else if (!strcmp(p, "addheader")) {
+			if (!strchr(value, ':')) goto error;
+			uwsgi_router_http11_header(&urhc->add, value);
+		}
+		else {
+			goto error;
+		}
+	}
+
+	if (!urhc->addr) goto error;
+	urhc->addr_len = strlen(urhc->addr);
+	if (urhc->host) urhc->host_len = strlen(urhc->host);
+	if (urhc->uri) urhc->uri_len = strlen(urhc->uri);
+
+	ur->data2 = urhc;
+	return 0;
+error:
+	uwsgi_log("invalid http11 route syntax: %s\n", args);
+	return -1;
+}
+
 static int uwsgi_router_http(struct uwsgi_route *ur, char *args) {
 
 	ur->func = uwsgi_routing_func_http;
@@ -146,6 +327,7 @@ static void router_http_register(void) {
 
 	uwsgi_register_router("http", uwsgi_router_http);
 	uwsgi_register_router("httpdumb", uwsgi_router_httpdumb);
+	uwsgi_register_router("http11", uwsgi_router_http11);
 	uwsgi_register_router("proxyhttp", uwsgi_router_proxyhttp);
 	uwsgi_register_router("httpconnect", uwsgi_router_http_connect);
 	uwsgi_register_router("proxyhttpconnect", uwsgi_router_proxyhttp_connect);
@@ -8,6 +8,16 @@ extern struct uwsgi_server uwsgi;
 
 	uWSGI server side includes implementation
 
+	the "esi" mode (--ssi-esi for modifier1 19 requests, or the "esi" routing action) compiles
+	the template once (the list of literals and commands is cached per-worker, and rebuilt when the
+	file changes), starts all of the fragments supporting it (remote rpc) before writing anything,
+	and streams the page in order, flushing every ready part before waiting for a pending fragment.
+	Fragments are started in two rounds: all of the non-blocking connects are issued first, then
+	every request is sent, so the connections are established in parallel.
+	Waits go through the wait hooks, so async cores keep running during the fetches.
+
+	The templates cache is an LRU list bounded by --ssi-esi-templates.
+
 */
 
 
@@ -22,11 +32,58 @@ struct uwsgi_ssi_cmd {
 	char *name;
 	size_t name_len;
 	struct uwsgi_buffer *(*func)(struct wsgi_request *, struct uwsgi_ssi_arg *, int);
+	// parallel fetch (esi mode): start returns a connecting fd (or -1 to use func), send issues
+	// the request on it (returning -1 and closing it on error), finish collects the result
+	int (*start)(struct wsgi_request *, struct uwsgi_ssi_arg *, int);
+	int (*send)(struct wsgi_request *, int, struct uwsgi_ssi_arg *, int);
+	struct uwsgi_buffer *(*finish)(struct wsgi_request *, int);
 	struct uwsgi_ssi_cmd *next;
 };
 
 struct uwsgi_ssi_cmd *uwsgi_ssi_commands = NULL;
 
+// a compiled template is a list of literals and commands (both pointing to the template body)
+struct uwsgi_ssi_node {
+	char *buf;
+	size_t len;
+	struct uwsgi_ssi_cmd *cmd;
+	struct uwsgi_ssi_arg argv[UWSGI_SSI_MAX_ARGS];
+	int argc;
+	struct uwsgi_ssi_node *next;
+};
+
+struct uwsgi_ssi_template {
+	char *filename;
+	uint32_t hash;
+	dev_t dev;
+	ino_t ino;
+	time_t mtime;
+	off_t size;
+	struct uwsgi_buffer *body;
+	struct uwsgi_ssi_node *nodes;
+	int nodes_cnt;
+	uint64_t refs;
+	int evicted;
+	struct uwsgi_ssi_template *prev;
+	struct uwsgi_ssi_template *next;
+};
+
+static struct uwsgi_ssi {
+	int esi;
+	int templates_max;
+	// most recently used first
+	struct uwsgi_ssi_template *templates;
+	struct uwsgi_ssi_template *templates_tail;
+	int templates_cnt;
+	pthread_mutex_t lock;
+} ussi;
+
+static struct uwsgi_option uwsgi_ssi_options[] = {
+	{"ssi-esi", no_argument, 0, "serve modifier1 19 requests with cached templates and parallel fragments fetching", uwsgi_opt_true, &ussi.esi, 0},
+	{"ssi-esi-templates", required_argument, 0, "set the maximum number of compiled templates cached by each worker (default 64)", uwsgi_opt_set_int, &ussi.templates_max, 0},
+	UWSGI_END_OF_OPTIONS
+};
+
 static struct uwsgi_ssi_cmd* uwsgi_ssi_get_cmd(char *name, size_t name_len) {
 	struct uwsgi_ssi_cmd *usc = uwsgi_ssi_commands;
 	while(usc) {
@@ -124,11 +181,14 @@ static int uwsgi_ssi_parse_args(struct wsgi_request *wsgi_req, char *buf, size_t
 	return 0;
 }
 
-static struct uwsgi_buffer *uwsgi_ssi_parse_command(struct wsgi_request *wsgi_req, char *buf, size_t len) {
+// fill the command and the arguments of a node, -1 if the command is invalid or unknown
+static int uwsgi_ssi_compile_command(struct wsgi_request *wsgi_req, char *buf, size_t len, struct uwsgi_ssi_node *node) {
 
 	// storage for arguments
-	struct uwsgi_ssi_arg argv[UWSGI_SSI_MAX_ARGS];
-	int argc = 0;
+	struct uwsgi_ssi_arg *argv = node->argv;
+	int *argc = &node->argc;
+	*argc = 0;
+	if (len == 0) return -1;
 
 	// first remove white spaces from the begin and the end
 	char *cmd = buf;
@@ -167,10 +227,10 @@ static struct uwsgi_buffer *uwsgi_ssi_parse_command(struct wsgi_request *wsgi_re
 		ssi_cmd_len++;
 	}
 
-	struct uwsgi_ssi_cmd *usc = uwsgi_ssi_get_cmd(ssi_cmd, ssi_cmd_len);
-	if (!usc) return NULL ;
+	node->cmd = uwsgi_ssi_get_cmd(ssi_cmd, ssi_cmd_len);
+	if (!node->cmd) return -1;
 
-	if (!found) goto run;
+	if (!found) return 0;
 
 	// now split the args
 	char *cmd_args = cmd + ssi_cmd_len + 1;
@@ -186,12 +246,18 @@ static struct uwsgi_buffer *uwsgi_ssi_parse_command(struct wsgi_request *wsgi_re
 		}
 	}
 
-	if (uwsgi_ssi_parse_args(wsgi_req, cmd_args, cmd_args_len, argv, &argc)) {
-		return NULL;
+	if (uwsgi_ssi_parse_args(wsgi_req, cmd_args, cmd_args_len, argv, argc)) {
+		return -1;
 	}
 
-run:
-	return usc->func(wsgi_req, argv, argc);
+	return 0;
+}
+
+static struct uwsgi_buffer *uwsgi_ssi_parse_command(struct wsgi_request *wsgi_req, char *buf, size_t len) {
+	struct uwsgi_ssi_node node;
+	memset(&node, 0, sizeof(struct uwsgi_ssi_node));
+	if (uwsgi_ssi_compile_command(wsgi_req, buf, len, &node)) return NULL;
+	return node.cmd->func(wsgi_req, node.argv, node.argc);
 }
 
 static struct uwsgi_buffer *uwsgi_ssi_parse(struct wsgi_request *wsgi_req, char *buf, size_t len) {
@@ -302,6 +368,223 @@ error:
 	return NULL;
 }
 
+// split a template in literals and commands (unterminated commands are dropped)
+static struct uwsgi_ssi_node *uwsgi_ssi_compile(struct wsgi_request *wsgi_req, char *buf, size_t len, int *nodes_cnt) {
+	struct uwsgi_ssi_node *nodes = NULL, *last = NULL, *node;
+	char *ptr = buf;
+	size_t remains = len;
+	*nodes_cnt = 0;
+
+	while(remains > 0) {
+		char *cmd = memmem(ptr, remains, "<!--#", 5);
+		char *cmd_end = NULL;
+		if (cmd) {
+			cmd_end = memmem(cmd + 5, remains - ((cmd + 5) - ptr), "-->", 3);
+		}
+		size_t literal_len = cmd ? (size_t) (cmd - ptr) : remains;
+		if (literal_len > 0) {
+			node = uwsgi_calloc(sizeof(struct uwsgi_ssi_node));
+			node->buf = ptr;
+			node->len = literal_len;
+			if (last) last->next = node; else nodes = node;
+			last = node;
+			*nodes_cnt = *nodes_cnt + 1;
+		}
+		if (!cmd || !cmd_end) break;
+
+		node = uwsgi_calloc(sizeof(struct uwsgi_ssi_node));
+		if (uwsgi_ssi_compile_command(wsgi_req, cmd + 5, cmd_end - (cmd + 5), node)) {
+			free(node);
+		}
+		else {
+			if (last) last->next = node; else nodes = node;
+			last = node;
+			*nodes_cnt = *nodes_cnt + 1;
+		}
+		remains -= (cmd_end + 3) - ptr;
+		ptr = cmd_end + 3;
+	}
+
+	return nodes;
+}
+
+static void uwsgi_ssi_template_free(struct uwsgi_ssi_template *ust) {
+	struct uwsgi_ssi_node *node = ust->nodes;
+	while(node) {
+		struct uwsgi_ssi_node *next = node->next;
+		free(node);
+		node = next;
+	}
+	uwsgi_buffer_destroy(ust->body);
+	free(ust->filename);
+	free(ust);
+}
+
+// the lock must be held
+static void uwsgi_ssi_template_unlink(struct uwsgi_ssi_template *ust) {
+	if (ust->prev) ust->prev->next = ust->next; else ussi.templates = ust->next;
+	if (ust->next) ust->next->prev = ust->prev; else ussi.templates_tail = ust->prev;
+	ust->prev = NULL;
+	ust->next = NULL;
+	ussi.templates_cnt--;
+}
+
+// the lock must be held
+static void uwsgi_ssi_template_link(struct uwsgi_ssi_template *ust) {
+	ust->prev = NULL;
+	ust->next = ussi.templates;
+	if (ussi.templates) ussi.templates->prev = ust; else ussi.templates_tail = ust;
+	ussi.templates = ust;
+	ussi.templates_cnt++;
+}
+
+// remove a template from the cache, it will be freed by its last user (the lock must be held)
+static void uwsgi_ssi_template_evict(struct uwsgi_ssi_template *ust) {
+	uwsgi_ssi_template_unlink(ust);
+	ust->evicted = 1;
+	if (!ust->refs) uwsgi_ssi_template_free(ust);
+}
+
+// get a compiled template from the worker cache (it is recompiled when the file changes)
+static struct uwsgi_ssi_template *uwsgi_ssi_template_get(struct wsgi_request *wsgi_req, char *filename) {
+	struct stat st;
+	if (stat(filename, &st)) return NULL;
+
+	uint32_t hash = djb33x_hash(filename, strlen(filename));
+
+	pthread_mutex_lock(&ussi.lock);
+	struct uwsgi_ssi_template *ust = ussi.templates;
+	while(ust) {
+		if (ust->hash == hash && !strcmp(ust->filename, filename)) {
+			if (ust->dev == st.st_dev && ust->ino == st.st_ino && ust->mtime == st.st_mtime && ust->size == st.st_size) {
+				ust->refs++;
+				if (ust != ussi.templates) {
+					uwsgi_ssi_template_unlink(ust);
+					uwsgi_ssi_template_link(ust);
+				}
+				pthread_mutex_unlock(&ussi.lock);
+				return ust;
+			}
+			// outdated
+			uwsgi_ssi_template_evict(ust);
+			break;
+		}
+		ust = ust->next;
+	}
+	pthread_mutex_unlock(&ussi.lock);
+
+	// read and compile without holding the lock
+	struct uwsgi_buffer *body = uwsgi_buffer_from_file(filename);
+	if (!body) return NULL;
+
+	ust = uwsgi_calloc(sizeof(struct uwsgi_ssi_template));
+	ust->filename = uwsgi_str(filename);
+	ust->hash = hash;
+	ust->dev = st.st_dev;
+	ust->ino = st.st_ino;
+	ust->mtime = st.st_mtime;
+	ust->size = st.st_size;
+	ust->body = body;
+	ust->nodes = uwsgi_ssi_compile(wsgi_req, body->buf, body->pos, &ust->nodes_cnt);
+	ust->refs = 1;
+
+	pthread_mutex_lock(&ussi.lock);
+	// another core could have compiled it in the meantime
+	struct uwsgi_ssi_template *old = ussi.templates;
+	while(old) {
+		if (old->hash == hash && !strcmp(old->filename, filename)) {
+			uwsgi_ssi_template_evict(old);
+			break;
+		}
+		old = old->next;
+	}
+	uwsgi_ssi_template_link(ust);
+	while(ussi.templates_cnt > ussi.templates_max && ussi.templates_tail != ust) {
+		uwsgi_ssi_template_evict(ussi.templates_tail);
+	}
+	pthread_mutex_unlock(&ussi.lock);
+	return ust;
+}
+
+static void uwsgi_ssi_template_put(struct uwsgi_ssi_template *ust) {
+	pthread_mutex_lock(&ussi.lock);
+	ust->refs--;
+	if (ust->evicted && !ust->refs) uwsgi_ssi_template_free(ust);
+	pthread_mutex_unlock(&ussi.lock);
+}
+
+static int uwsgi_ssi_esi_append(struct uwsgi_buffer *ub, struct uwsgi_buffer *ub_cmd) {
+	if (!ub_cmd) return 0;
+	int ret = uwsgi_buffer_append(ub, ub_cmd->buf, ub_cmd->pos);
+	uwsgi_buffer_destroy(ub_cmd);
+	return ret;
+}
+
+/*
+	start all of the parallel fragments, then stream the page in order:
+	the buffered output is flushed every time we have to wait for a fragment
+*/
+static void uwsgi_ssi_esi(struct wsgi_request *wsgi_req, char *filename) {
+	struct uwsgi_ssi_template *ust = uwsgi_ssi_template_get(wsgi_req, filename);
+	if (!ust) {
+		uwsgi_404(wsgi_req);
+		return;
+	}
+
+	struct uwsgi_buffer *ub = NULL;
+	struct uwsgi_ssi_node *node;
+	int i;
+	// -1 (run the synchronous func), -2 (failed) or a pending fd
+	int *fds = uwsgi_malloc(sizeof(int) * (ust->nodes_cnt + 1));
+	for(i=0,node=ust->nodes;node;node=node->next,i++) {
+		fds[i] = -1;
+		if (node->cmd && node->cmd->start) {
+			fds[i] = node->cmd->start(wsgi_req, node->argv, node->argc);
+		}
+	}
+	// the connections are in progress, now wait for them (in order) and send the requests
+	for(i=0,node=ust->nodes;node;node=node->next,i++) {
+		if (fds[i] < 0) continue;
+		if (node->cmd->send(wsgi_req, fds[i], node->argv, node->argc)) {
+			fds[i] = -2;
+		}
+	}
+
+	if (uwsgi_response_prepare_headers(wsgi_req, "200 OK", 6)) goto end;
+	if (uwsgi_response_add_content_type(wsgi_req, "text/html", 9)) goto end;
+
+	ub = uwsgi_buffer_new(uwsgi.page_size);
+	for(i=0,node=ust->nodes;node;node=node->next,i++) {
+		if (!node->cmd) {
+			if (uwsgi_buffer_append(ub, node->buf, node->len)) goto end;
+			continue;
+		}
+		if (fds[i] == -2) continue;
+		if (fds[i] == -1) {
+			if (uwsgi_ssi_esi_append(ub, node->cmd->func(wsgi_req, node->argv, node->argc))) goto end;
+			continue;
+		}
+		if (ub->pos > 0) {
+			if (uwsgi_response_write_body_do(wsgi_req, ub->buf, ub->pos)) goto end;
+			ub->pos = 0;
+		}
+		int fd = fds[i];
+		fds[i] = -1;
+		if (uwsgi_ssi_esi_append(ub, node->cmd->finish(wsgi_req, fd))) goto end;
+	}
+
+	uwsgi_response_write_body_do(wsgi_req, ub->buf, ub->pos);
+
+end:
+	// close the fragments left behind by a broken response
+	for(i=0;i<ust->nodes_cnt;i++) {
+		if (fds[i] > -1) close(fds[i]);
+	}
+	free(fds);
+	if (ub) uwsgi_buffer_destroy(ub);
+	uwsgi_ssi_template_put(ust);
+}
+
 static int uwsgi_ssi_request(struct wsgi_request *wsgi_req) {
 	struct uwsgi_buffer *ub = NULL;
 
@@ -326,6 +609,12 @@ static int uwsgi_ssi_request(struct wsgi_request *wsgi_req) {
 		return UWSGI_OK;
 	}
 
+	if (ussi.esi) {
+		uwsgi_ssi_esi(wsgi_req, real_filename);
+		free(real_filename);
+		return UWSGI_OK;
+	}
+
 	struct uwsgi_buffer *ub_ssi = uwsgi_buffer_from_file(real_filename);
 	free(real_filename);
 	if (!ub_ssi) {
@@ -461,6 +750,95 @@ static struct uwsgi_buffer *ssi_cmd_cache(struct wsgi_request *wsgi_req, struct
 }
 
 
+// rpc command (uWSGI specific), <!--#rpc func="hello" node="127.0.0.1:3031" arg="foo" arg="bar" -->
+static int ssi_rpc_args(struct uwsgi_ssi_arg *argv, int argc, char **func, char **node, char **rargv, uint16_t *rargvs, uint8_t *rargc) {
+	size_t func_len = 0, node_len = 0;
+	char *f = uwsgi_ssi_get_arg(argv, argc, "func", 4, &func_len);
+	if (!f || func_len == 0) return -1;
+	char *n = uwsgi_ssi_get_arg(argv, argc, "node", 4, &node_len);
+
+	int i;
+	*rargc = 0;
+	for(i=0;i<argc;i++) {
+		if (uwsgi_strncmp(argv[i].key, argv[i].key_len, "arg", 3)) continue;
+		rargv[*rargc] = argv[i].value;
+		rargvs[*rargc] = argv[i].val_len;
+		*rargc = *rargc + 1;
+	}
+
+	*func = uwsgi_concat2n(f, func_len, "", 0);
+	*node = NULL;
+	if (n && node_len) {
+		*node = uwsgi_concat2n(n, node_len, "", 0);
+	}
+	return 0;
+}
+
+static struct uwsgi_buffer *ssi_rpc_buffer(char *value, uint64_t rlen) {
+	if (!value) return NULL;
+	struct uwsgi_buffer *ub = uwsgi_buffer_new(rlen);
+	if (uwsgi_buffer_append(ub, value, rlen)) {
+		uwsgi_buffer_destroy(ub);
+		ub = NULL;
+	}
+	free(value);
+	return ub;
+}
+
+static struct uwsgi_buffer *ssi_cmd_rpc(struct wsgi_request *wsgi_req, struct uwsgi_ssi_arg *argv, int argc) {
+	char *func = NULL, *node = NULL;
+	char *rargv[UWSGI_SSI_MAX_ARGS];
+	uint16_t rargvs[UWSGI_SSI_MAX_ARGS];
+	uint8_t rargc = 0;
+	if (ssi_rpc_args(argv, argc, &func, &node, rargv, rargvs, &rargc)) return NULL;
+
+	uint64_t rlen = 0;
+	char *value = uwsgi_do_rpc(node, func, rargc, rargv, rargvs, &rlen);
+	free(func);
+	if (node) free(node);
+	return ssi_rpc_buffer(value, rlen);
+}
+
+// remote calls start connecting immediately, local ones run in order
+static int ssi_cmd_rpc_start(struct wsgi_request *wsgi_req, struct uwsgi_ssi_arg *argv, int argc) {
+	char *func = NULL, *node = NULL;
+	char *rargv[UWSGI_SSI_MAX_ARGS];
+	uint16_t rargvs[UWSGI_SSI_MAX_ARGS];
+	uint8_t rargc = 0;
+	if (ssi_rpc_args(argv, argc, &func, &node, rargv, rargvs, &rargc)) return -2;
+
+	int fd = -1;
+	if (node) {
+		fd = uwsgi_connect(node, 0, 1);
+		if (fd < 0) fd = -2;
+		free(node);
+	}
+	free(func);
+	return fd;
+}
+
+static int ssi_cmd_rpc_send(struct wsgi_request *wsgi_req, int fd, struct uwsgi_ssi_arg *argv, int argc) {
+	char *func = NULL, *node = NULL;
+	char *rargv[UWSGI_SSI_MAX_ARGS];
+	uint16_t rargvs[UWSGI_SSI_MAX_ARGS];
+	uint8_t rargc = 0;
+	if (ssi_rpc_args(argv, argc, &func, &node, rargv, rargvs, &rargc)) {
+		close(fd);
+		return -1;
+	}
+	if (node) free(node);
+	int ret = uwsgi_rpc_remote_send(fd, func, rargc, rargv, rargvs);
+	free(func);
+	return ret < 0 ? -1 : 0;
+}
+
+static struct uwsgi_buffer *ssi_cmd_rpc_finish(struct wsgi_request *wsgi_req, int fd) {
+	uint64_t rlen = 0;
+	char *value = uwsgi_rpc_remote_finish(fd, &rlen);
+	return ssi_rpc_buffer(value, rlen);
+}
+
+
 static int uwsgi_routing_func_ssi(struct wsgi_request *wsgi_req, struct uwsgi_route *ur){
 
 	struct uwsgi_buffer *ub = NULL;
@@ -499,17 +877,45 @@ static int uwsgi_router_ssi(struct uwsgi_route *ur, char *args) {
 }
 
 
+static int uwsgi_routing_func_esi(struct wsgi_request *wsgi_req, struct uwsgi_route *ur){
+
+        char **subject = (char **) (((char *)(wsgi_req))+ur->subject);
+        uint16_t *subject_len = (uint16_t *) (((char *)(wsgi_req))+ur->subject_len);
+
+        struct uwsgi_buffer *ub_filename = uwsgi_routing_translate(wsgi_req, ur, *subject, *subject_len, ur->data, ur->data_len);
+        if (!ub_filename) return UWSGI_ROUTE_BREAK;
+
+	uwsgi_ssi_esi(wsgi_req, ub_filename->buf);
+	uwsgi_buffer_destroy(ub_filename);
+        return UWSGI_ROUTE_BREAK;
+}
+
+static int uwsgi_router_esi(struct uwsgi_route *ur, char *args) {
+        ur->func = uwsgi_routing_func_esi;
+        ur->data = args;
+        ur->data_len = strlen(args);
+        return 0;
+}
+
+
 static int uwsgi_ssi_init() {
 	uwsgi_register_ssi_command("echo", ssi_cmd_echo);
 	uwsgi_register_ssi_command("printenv", ssi_cmd_printenv);
 	uwsgi_register_ssi_command("include", ssi_cmd_include);
 	uwsgi_register_ssi_command("cache", ssi_cmd_cache);
+	struct uwsgi_ssi_cmd *usc = uwsgi_register_ssi_command("rpc", ssi_cmd_rpc);
+	usc->start = ssi_cmd_rpc_start;
+	usc->send = ssi_cmd_rpc_send;
+	usc->finish = ssi_cmd_rpc_finish;
+	pthread_mutex_init(&ussi.lock, NULL);
+	if (ussi.templates_max <= 0) ussi.templates_max = 64;
 	return 0;
 }
 
 
 static void uwsgi_ssi_register_router() {
 	uwsgi_register_router("ssi", uwsgi_router_ssi);
+	uwsgi_register_router("esi", uwsgi_router_esi);
 }
 
 static void uwsgi_ssi_log(struct wsgi_request *wsgi_req) {
@@ -519,6 +925,7 @@ static void uwsgi_ssi_log(struct wsgi_request *wsgi_req) {
 struct uwsgi_plugin ssi_plugin = {
 	.name = "ssi",
 	.modifier1 = 19,
+	.options = uwsgi_ssi_options,
 	.init = uwsgi_ssi_init,
 	.request = uwsgi_ssi_request,
 	.after_request = uwsgi_ssi_log,
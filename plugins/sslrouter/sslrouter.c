@@ -23,6 +23,8 @@ static struct uwsgi_sslrouter {
 struct sslrouter_session {
 	struct corerouter_session session;
 	SSL *ssl;
+	// the kernel is encrypting records sent to the client
+	int ktls;
 };
 
 static void uwsgi_opt_sslrouter(char *opt, char *value, void *cr) {
@@ -145,12 +147,12 @@ static struct uwsgi_option sslrouter_options[] = {
 	{"sslrouter-cheap", no_argument, 0, "run the sslrouter in cheap mode", uwsgi_opt_true, &usr.cr.cheap, 0},
 	{"sslrouter-subscription-server", required_argument, 0, "run the sslrouter subscription server on the spcified address", uwsgi_opt_corerouter_ss, &usr, 0},
 
-	{"sslrouter-timeout", required_argument, 0, "set sslrouter timeout", uwsgi_opt_set_int, &usr.cr.socket_timeout, 0},
+	{"sslrouter-timeout", required_argument, 0, "set sslrouter timeout", uwsgi_opt_set_msecs, &usr.cr.socket_timeout, 0},
 
 	{"sslrouter-stats", required_argument, 0, "run the sslrouter stats server", uwsgi_opt_set_str, &usr.cr.stats_server, 0},
 	{"sslrouter-stats-server", required_argument, 0, "run the sslrouter stats server", uwsgi_opt_set_str, &usr.cr.stats_server, 0},
 	{"sslrouter-ss", required_argument, 0, "run the sslrouter stats server", uwsgi_opt_set_str, &usr.cr.stats_server, 0},
-	{"sslrouter-harakiri", required_argument, 0, "enable sslrouter harakiri", uwsgi_opt_set_int, &usr.cr.harakiri, 0},
+	{"sslrouter-harakiri", required_argument, 0, "enable sslrouter harakiri", uwsgi_opt_set_msecs, &usr.cr.harakiri, 0},
 
 #ifdef SSL_CTRL_SET_TLSEXT_HOSTNAME
 	{"sslrouter-sni", no_argument, 0, "use SNI to route requests", uwsgi_opt_true, &usr.sni, 0},
@@ -178,8 +180,29 @@ static ssize_t sr_instance_write(struct corerouter_peer *peer) {
 	return len;
 }
 
+// splice backend data to the kTLS client socket
+static ssize_t sr_splice_write(struct corerouter_peer *main_peer) {
+	struct corerouter_peer *peer = main_peer->session->peers;
+	ssize_t len = cr_splice_write(main_peer, peer, "sr_splice_write()");
+	if (!len) return 0;
+
+	if (cr_splice_complete(peer)) {
+		cr_reset_hooks(main_peer);
+	}
+
+	return len;
+}
+
 // read from backend
 static ssize_t sr_instance_read(struct corerouter_peer *peer) {
+	struct sslrouter_session *sr = (struct sslrouter_session *) peer->session;
+	if (sr->ktls && uwsgi_cr_splice_setup(peer)) {
+		ssize_t len = cr_splice_read(peer, "sr_instance_read()/splice()");
+		if (!len) return 0;
+		cr_write_to_main(peer, sr_splice_write);
+		return len;
+	}
+
 	ssize_t len = cr_read(peer, "sr_instance_read()");
 	if (!len) return 0;
 
@@ -283,6 +306,8 @@ static ssize_t sr_read(struct corerouter_peer *main_peer) {
                         main_peer->in->pos += ret2;
                 }
 		if (!main_peer->session->peers) {
+			// the handshake is done, check if the kernel took over the encryption
+			sr->ktls = uwsgi_ssl_ktls_send(sr->ssl);
 			// add a new peer
         		struct corerouter_peer *peer = uwsgi_cr_peer_add(cs);
         		// set default peer hook
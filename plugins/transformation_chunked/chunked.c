@@ -6,6 +6,8 @@
 
 	transfer-encoding is added to the headers
 
+	the streaming part only wraps the chain vectors with the chunk framing (no copy of the body)
+
 */
 
 static int transform_chunked(struct wsgi_request *wsgi_req, struct uwsgi_transformation *ut) {
@@ -21,9 +23,17 @@ static int transform_chunked(struct wsgi_request *wsgi_req, struct uwsgi_transfo
         	uwsgi_response_add_header(wsgi_req, "Transfer-Encoding", 17, "chunked", 7);
 	}
 
-	if (ub->pos > 0) {
-		if (uwsgi_buffer_insert_chunked(ub, 0, ub->pos)) return -1;
-		if (uwsgi_buffer_append(ub, "\r\n", 2)) return -1;
+	size_t len = uwsgi_transformation_iov_len(wsgi_req);
+	if (len > 0) {
+		// the chunk buffer only holds the size line
+		if (!ub) {
+			ub = uwsgi_buffer_new(sizeof(UMAX64_STR) + 2);
+			ut->chunk = ub;
+		}
+		ub->pos = 0;
+		if (uwsgi_buffer_append_chunked(ub, len)) return -1;
+		if (uwsgi_transformation_iov_prepend(wsgi_req, ub->buf, ub->pos)) return -1;
+		if (uwsgi_transformation_iov_append(wsgi_req, "\r\n", 2)) return -1;
 	}
 
 	return 0;
@@ -32,6 +42,7 @@ static int transform_chunked(struct wsgi_request *wsgi_req, struct uwsgi_transfo
 static int uwsgi_routing_func_chunked(struct wsgi_request *wsgi_req, struct uwsgi_route *ur) {
 	struct uwsgi_transformation *ut = uwsgi_add_transformation(wsgi_req, transform_chunked, NULL);
 	ut->can_stream = 1;
+	ut->can_iov = 1;
 	// add a "final" transformation to add the trailing chunk
 	ut = uwsgi_add_transformation(wsgi_req, transform_chunked, NULL);
 	ut->is_final = 1;
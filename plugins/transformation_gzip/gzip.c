@@ -8,68 +8,129 @@
 
 	remember to fix the content_length (or use chunked encoding) !!!
 
-*/
+	the same transformation is used for brotli ("br" action) and zstd ("zstd" action) when
+	uWSGI is built with their libraries.
 
-struct uwsgi_transformation_gzip {
-	z_stream z;
-	uint32_t crc32;
-	size_t len;
-	uint8_t header;
-};
+	compressors are taken from a per-core pool (they are reset instead of being initialized
+	for each response) and they read the chain vectors and write to their own output buffer,
+	so after the first responses no memory is allocated and the body is never copied.
 
-extern char gzheader[];
+*/
 
-static int transform_gzip(struct wsgi_request *wsgi_req, struct uwsgi_transformation *ut) {
-	struct uwsgi_transformation_gzip *utgz = (struct uwsgi_transformation_gzip *) ut->data;
+static void compress_swap(struct uwsgi_buffer *ub, struct uwsgi_buffer *out) {
+	char *buf = ub->buf;
+	size_t len = ub->len;
+	ub->buf = out->buf;
+	ub->len = out->len;
+	ub->pos = out->pos;
+	out->buf = buf;
+	out->len = len;
+	out->pos = 0;
+}
+
+static int transform_compress(struct wsgi_request *wsgi_req, struct uwsgi_transformation *ut) {
+	struct uwsgi_compressor_ctx *ucc = (struct uwsgi_compressor_ctx *) ut->data;
+	struct uwsgi_compressor *uc = ucc->compressor;
 	struct uwsgi_buffer *ub = ut->chunk;
 
+	ucc->out->pos = 0;
+
 	if (ut->is_final) {
-		if (uwsgi_gzip_fix(&utgz->z, utgz->crc32, ub, utgz->len)) {
-			free(utgz);
+		if (uc->compress(ucc->state, NULL, 0, ucc->out, 1)) {
 			return -1;
 		}
-		free(utgz);
-		return 0;
+		// the chunk could already hold the last compressed round (when a buffering transformation precedes us)
+		if (ub->pos == 0) {
+			compress_swap(ub, ucc->out);
+			return 0;
+		}
+		return uwsgi_buffer_append(ub, ucc->out->buf, ucc->out->pos);
 	}
 
-	size_t dlen = 0;
-	char *gzipped = uwsgi_gzip_chunk(&utgz->z, &utgz->crc32, ub->buf, ub->pos, &dlen);
-	if (!gzipped) return -1;
-	utgz->len += ub->pos;
-	uwsgi_buffer_map(ub, gzipped, dlen);
-	if (!utgz->header) {
+	if (ut->round == 1) {
 		// do not check for errors !!!
-        	uwsgi_response_add_header(wsgi_req, "Content-Encoding", 16, "gzip", 4);
-		utgz->header = 1;
-		if (uwsgi_buffer_insert(ub, 0, gzheader, 10)) {
-			return -1;
+		uwsgi_response_add_header(wsgi_req, "Content-Encoding", 16, uc->name, uc->name_len);
+	}
+
+	// the chain vectors are compressed in place (they are merged only when more than one)
+	size_t i, cnt = 0;
+	struct iovec *iov = uwsgi_transformation_iov(wsgi_req, &cnt);
+	char *buf = NULL;
+	size_t len = 0;
+	if (cnt == 1) {
+		buf = iov[0].iov_base;
+		len = iov[0].iov_len;
+	}
+	else if (cnt > 1) {
+		if (!ub) {
+			ub = uwsgi_buffer_new(uwsgi_transformation_iov_len(wsgi_req));
+			ut->chunk = ub;
 		}
+		ub->pos = 0;
+		for(i=0;i<cnt;i++) {
+			if (uwsgi_buffer_append(ub, iov[i].iov_base, iov[i].iov_len)) return -1;
+		}
+		buf = ub->buf;
+		len = ub->pos;
 	}
 
-	return 0;
+	if (uc->compress(ucc->state, buf, len, ucc->out, 0)) {
+		return -1;
+	}
+	// the output buffer is reused only in the next round
+	uwsgi_transformation_iov_reset(wsgi_req);
+	return uwsgi_transformation_iov_append(wsgi_req, ucc->out->buf, ucc->out->pos);
 }
 
-static int uwsgi_routing_func_gzip(struct wsgi_request *wsgi_req, struct uwsgi_route *ur) {
-	struct uwsgi_transformation_gzip *utgz = uwsgi_calloc(sizeof(struct uwsgi_transformation_gzip));
-	if (uwsgi_gzip_prepare(&utgz->z, NULL, 0, &utgz->crc32)) {
-		free(utgz);
-		return UWSGI_ROUTE_BREAK;
-	}
-	struct uwsgi_transformation *ut = uwsgi_add_transformation(wsgi_req, transform_gzip, utgz);
+// give back the compressor to the pool (even if the response has been interrupted)
+static void transform_compress_destroy(struct wsgi_request *wsgi_req, struct uwsgi_transformation *ut) {
+	uwsgi_compressor_put(wsgi_req, (struct uwsgi_compressor_ctx *) ut->data);
+}
+
+static int uwsgi_routing_func_compress(struct wsgi_request *wsgi_req, struct uwsgi_route *ur) {
+	struct uwsgi_compressor_ctx *ucc = uwsgi_compressor_get(wsgi_req, (struct uwsgi_compressor *) ur->data);
+	if (!ucc) return UWSGI_ROUTE_BREAK;
+	struct uwsgi_transformation *ut = uwsgi_add_transformation(wsgi_req, transform_compress, ucc);
 	ut->can_stream = 1;
-	// this is the trasformation clearing the memory
-	ut = uwsgi_add_transformation(wsgi_req, transform_gzip, utgz);
-        ut->is_final = 1;
+	ut->can_iov = 1;
+	// this is the trasformation releasing the compressor
+	ut = uwsgi_add_transformation(wsgi_req, transform_compress, ucc);
+	ut->is_final = 1;
+	ut->destroy = transform_compress_destroy;
 	return UWSGI_ROUTE_NEXT;
 }
 
 static int uwsgi_router_gzip(struct uwsgi_route *ur, char *args) {
-	ur->func = uwsgi_routing_func_gzip;
+	ur->func = uwsgi_routing_func_compress;
+	ur->data = &uwsgi_compressor_gzip;
 	return 0;
 }
 
+#ifdef UWSGI_BROTLI
+static int uwsgi_router_brotli(struct uwsgi_route *ur, char *args) {
+	ur->func = uwsgi_routing_func_compress;
+	ur->data = &uwsgi_compressor_brotli;
+	return 0;
+}
+#endif
+
+#ifdef UWSGI_ZSTD
+static int uwsgi_router_zstd(struct uwsgi_route *ur, char *args) {
+	ur->func = uwsgi_routing_func_compress;
+	ur->data = &uwsgi_compressor_zstd;
+	return 0;
+}
+#endif
+
 static void router_gzip_register(void) {
 	uwsgi_register_router("gzip", uwsgi_router_gzip);
+#ifdef UWSGI_BROTLI
+	uwsgi_register_router("br", uwsgi_router_brotli);
+	uwsgi_register_router("brotli", uwsgi_router_brotli);
+#endif
+#ifdef UWSGI_ZSTD
+	uwsgi_register_router("zstd", uwsgi_router_zstd);
+#endif
 }
 
 struct uwsgi_plugin transformation_gzip_plugin = {
@@ -2,23 +2,317 @@
 
 #ifdef UWSGI_ROUTING
 
+extern struct uwsgi_server uwsgi;
+
+/*
+
+	templates are compiled in a list of literal spans and slots ($N regexp groups, ${VAR} and
+	${route_var[arg]}) and cached per-route and per-core (so no locking is needed), keyed by the
+	hash of the body. Rendering only resolves the slots and passes the spans and the values
+	to the writer as vectors.
+
+	The body is the only template source available, so the cache only pays off when the
+	responses are static files or otherwise repeat. After UWSGI_TEMPLATE_MAX_MISSES consecutive
+	misses (dynamic bodies) the core stops hashing and copying them for the next
+	UWSGI_TEMPLATE_BYPASS responses, and compiles them for the current response only,
+	like the bodies bigger than UWSGI_TEMPLATE_MAX_SIZE.
+
+*/
+
+#define UWSGI_TEMPLATE_CACHE 8
+#define UWSGI_TEMPLATE_MAX_SIZE (32 * 1024)
+#define UWSGI_TEMPLATE_MAX_MISSES 16
+#define UWSGI_TEMPLATE_BYPASS 256
+
+#define UWSGI_TEMPLATE_LITERAL 0
+#define UWSGI_TEMPLATE_GROUP 1
+#define UWSGI_TEMPLATE_VAR 2
+#define UWSGI_TEMPLATE_ROUTE_VAR 3
+
+struct uwsgi_template_op {
+	uint8_t type;
+	// the literal, the "$N" group (or a trailing "$"), the var name or the route var argument
+	char *buf;
+	size_t len;
+	struct uwsgi_route_var *urv;
+};
+
+struct uwsgi_template {
+	uint32_t hash;
+	char *body;
+	size_t len;
+	struct uwsgi_template_op *ops;
+	size_t ops_cnt;
+	uint64_t used;
+};
+
+struct uwsgi_template_cache {
+	struct uwsgi_template *templates[UWSGI_TEMPLATE_CACHE];
+	uint64_t clock;
+	// consecutive misses and responses left before trying the cache again
+	int misses;
+	int bypass;
+};
+
+static int template_add_op(struct uwsgi_template_op **ops, size_t *ops_cnt, size_t *ops_size, uint8_t type, char *buf, size_t len, struct uwsgi_route_var *urv) {
+	// merge contiguous literals
+	if (type == UWSGI_TEMPLATE_LITERAL && *ops_cnt > 0) {
+		struct uwsgi_template_op *last = &(*ops)[*ops_cnt - 1];
+		if (last->type == UWSGI_TEMPLATE_LITERAL && last->buf + last->len == buf) {
+			last->len += len;
+			return 0;
+		}
+	}
+	if (*ops_cnt >= *ops_size) {
+		size_t new_size = *ops_size ? *ops_size * 2 : 16;
+		struct uwsgi_template_op *tmp = realloc(*ops, sizeof(struct uwsgi_template_op) * new_size);
+		if (!tmp) {
+			uwsgi_error("template_add_op()/realloc()");
+			return -1;
+		}
+		*ops = tmp;
+		*ops_size = new_size;
+	}
+	struct uwsgi_template_op *op = &(*ops)[*ops_cnt];
+	op->type = type;
+	op->buf = buf;
+	op->len = len;
+	op->urv = urv;
+	*ops_cnt = *ops_cnt + 1;
+	return 0;
+}
+
+// the same syntax of uwsgi_routing_translate() (the ops point to the body)
+static struct uwsgi_template_op *template_compile(char *buf, size_t len, size_t *ops_cnt) {
+	struct uwsgi_template_op *ops = NULL;
+	size_t ops_size = 0;
+	size_t i = 0;
+	*ops_cnt = 0;
+
+	while(i < len) {
+		if (buf[i] != '$') {
+			if (template_add_op(&ops, ops_cnt, &ops_size, UWSGI_TEMPLATE_LITERAL, buf + i, 1, NULL)) goto error;
+			i++;
+			continue;
+		}
+		// a trailing dollar is a group too (it is dropped when the regexp is applied)
+		if (i + 1 >= len) {
+			if (template_add_op(&ops, ops_cnt, &ops_size, UWSGI_TEMPLATE_GROUP, buf + i, 1, NULL)) goto error;
+			break;
+		}
+		if (isdigit((int) buf[i+1])) {
+			if (template_add_op(&ops, ops_cnt, &ops_size, UWSGI_TEMPLATE_GROUP, buf + i, 2, NULL)) goto error;
+			i += 2;
+			continue;
+		}
+		if (buf[i+1] == '{') {
+			char *key = buf + i + 2;
+			char *end = memchr(key, '}', len - (i + 2));
+			// unterminated, keep it as is
+			if (!end) {
+				if (template_add_op(&ops, ops_cnt, &ops_size, UWSGI_TEMPLATE_LITERAL, buf + i, len - i, NULL)) goto error;
+				break;
+			}
+			size_t keylen = end - key;
+			char *bracket = memchr(key, '[', keylen);
+			struct uwsgi_route_var *urv = NULL;
+			if (bracket && keylen > 0 && key[keylen-1] == ']') {
+				urv = uwsgi_get_route_var(key, bracket - key);
+			}
+			if (urv) {
+				if (template_add_op(&ops, ops_cnt, &ops_size, UWSGI_TEMPLATE_ROUTE_VAR, bracket + 1, keylen - (urv->name_len+2), urv)) goto error;
+			}
+			else {
+				if (template_add_op(&ops, ops_cnt, &ops_size, UWSGI_TEMPLATE_VAR, key, keylen, NULL)) goto error;
+			}
+			i = (end - buf) + 1;
+			continue;
+		}
+		// "$" followed by anything else is a literal
+		if (template_add_op(&ops, ops_cnt, &ops_size, UWSGI_TEMPLATE_LITERAL, buf + i, 2, NULL)) goto error;
+		i += 2;
+	}
+
+	return ops;
+
+error:
+	if (ops) free(ops);
+	*ops_cnt = 0;
+	return NULL;
+}
+
+static void template_free(struct uwsgi_template *t) {
+	if (t->ops) free(t->ops);
+	free(t->body);
+	free(t);
+}
+
+/*
+	get the compiled template of the body from the cache of the core (compile it if needed),
+	*tp is left NULL when the cache is bypassed
+*/
+static int template_get(struct wsgi_request *wsgi_req, struct uwsgi_route *ur, char *buf, size_t len, struct uwsgi_template **tp) {
+	if (!ur->data) {
+		struct uwsgi_template_cache *caches = uwsgi_calloc(sizeof(struct uwsgi_template_cache) * uwsgi.cores);
+		// another thread could have already allocated it
+		if (!__sync_bool_compare_and_swap(&ur->data, NULL, caches)) {
+			free(caches);
+		}
+	}
+
+	struct uwsgi_template_cache *utc = &((struct uwsgi_template_cache *) ur->data)[wsgi_req->async_id];
+	if (utc->bypass > 0) {
+		utc->bypass--;
+		return 0;
+	}
+
+	uint32_t hash = djb33x_hash(buf, len);
+	int i, slot = 0;
+	utc->clock++;
+
+	for(i=0;i<UWSGI_TEMPLATE_CACHE;i++) {
+		struct uwsgi_template *t = utc->templates[i];
+		if (!t) {
+			slot = i;
+			break;
+		}
+		if (t->hash == hash && t->len == len && !memcmp(t->body, buf, len)) {
+			t->used = utc->clock;
+			utc->misses = 0;
+			*tp = t;
+			return 0;
+		}
+		// least recently used
+		if (utc->templates[slot] && t->used < utc->templates[slot]->used) {
+			slot = i;
+		}
+	}
+
+	// the bodies do not repeat, stop caching them for a while
+	if (++utc->misses > UWSGI_TEMPLATE_MAX_MISSES) {
+		utc->misses = 0;
+		utc->bypass = UWSGI_TEMPLATE_BYPASS;
+		return 0;
+	}
+
+	struct uwsgi_template *t = uwsgi_calloc(sizeof(struct uwsgi_template));
+	t->hash = hash;
+	t->len = len;
+	t->body = uwsgi_malloc(len + 1);
+	memcpy(t->body, buf, len);
+	t->ops = template_compile(t->body, len, &t->ops_cnt);
+	if (len > 0 && !t->ops) {
+		template_free(t);
+		return -1;
+	}
+	t->used = utc->clock;
+
+	if (utc->templates[slot]) template_free(utc->templates[slot]);
+	utc->templates[slot] = t;
+	*tp = t;
+	return 0;
+}
+
+static int template_render(struct wsgi_request *wsgi_req, struct uwsgi_transformation *ut, struct uwsgi_route *ur, struct uwsgi_template_op *ops, size_t ops_cnt) {
+	// the regexp groups (like uwsgi_routing_translate() does)
+	char *src = NULL;
+	int *ovector = ur->ovector[wsgi_req->async_id];
+	int n = ur->ovn[wsgi_req->async_id];
+	if (ur->condition_ub[wsgi_req->async_id] && n > 0) {
+		src = ur->condition_ub[wsgi_req->async_id]->buf;
+	}
+	else {
+		char **subject = (char **) (((char *)(wsgi_req))+ur->subject);
+		src = *subject;
+	}
+
+	// values allocated by the route vars are copied here (their vectors are fixed at the end)
+	if (ut->ub) ut->ub->pos = 0;
+
+	uwsgi_transformation_iov_reset(wsgi_req);
+
+	size_t i;
+	for(i=0;i<ops_cnt;i++) {
+		struct uwsgi_template_op *op = &ops[i];
+		uint16_t vallen = 0;
+		char *value = NULL;
+		switch(op->type) {
+			case UWSGI_TEMPLATE_LITERAL:
+				if (uwsgi_transformation_iov_append(wsgi_req, op->buf, op->len)) return -1;
+				break;
+			case UWSGI_TEMPLATE_GROUP:
+				if (!src) {
+					if (uwsgi_transformation_iov_append(wsgi_req, op->buf, op->len)) return -1;
+				}
+				else if (op->len == 2) {
+					int pos = op->buf[1] - 48;
+					if (ovector && pos <= n) {
+						pos = pos * 2;
+						if (ovector[pos] > -1 && uwsgi_transformation_iov_append(wsgi_req, src + ovector[pos], ovector[pos + 1] - ovector[pos])) return -1;
+					}
+				}
+				break;
+			case UWSGI_TEMPLATE_VAR:
+				value = uwsgi_get_var(wsgi_req, op->buf, op->len, &vallen);
+				if (value && uwsgi_transformation_iov_append(wsgi_req, value, vallen)) return -1;
+				break;
+			case UWSGI_TEMPLATE_ROUTE_VAR:
+				value = op->urv->func(wsgi_req, op->buf, op->len, &vallen);
+				if (!value) break;
+				if (!op->urv->need_free) {
+					if (uwsgi_transformation_iov_append(wsgi_req, value, vallen)) return -1;
+					break;
+				}
+				if (!ut->ub) ut->ub = uwsgi_buffer_new(uwsgi.page_size);
+				if (uwsgi_buffer_append(ut->ub, value, vallen)) {
+					free(value);
+					return -1;
+				}
+				free(value);
+				if (uwsgi_transformation_iov_append(wsgi_req, NULL, vallen)) return -1;
+				break;
+			default:
+				break;
+		}
+	}
+
+	if (ut->ub && ut->ub->pos > 0) {
+		size_t cnt = 0, pos = 0;
+		struct iovec *iov = uwsgi_transformation_iov(wsgi_req, &cnt);
+		for(i=0;i<cnt;i++) {
+			if (iov[i].iov_base) continue;
+			iov[i].iov_base = ut->ub->buf + pos;
+			pos += iov[i].iov_len;
+		}
+	}
+	return 0;
+}
+
 // apply templating
 static int transform_template(struct wsgi_request *wsgi_req, struct uwsgi_transformation *ut) {
 
 	struct uwsgi_route *ur = (struct uwsgi_route *) ut->data;
+	char *buf = ut->chunk->buf;
+	size_t len = ut->chunk->pos;
 
-	char **subject = (char **) (((char *)(wsgi_req))+ur->subject);
-        uint16_t *subject_len = (uint16_t *)  (((char *)(wsgi_req))+ur->subject_len);
+	if (len <= UWSGI_TEMPLATE_MAX_SIZE) {
+		struct uwsgi_template *t = NULL;
+		if (template_get(wsgi_req, ur, buf, len, &t)) return -1;
+		if (t) return template_render(wsgi_req, ut, ur, t->ops, t->ops_cnt);
+	}
 
-        struct uwsgi_buffer *ub = uwsgi_routing_translate(wsgi_req, ur, *subject, *subject_len, ut->chunk->buf, ut->chunk->pos);
-        if (!ub) return -1;
-        uwsgi_buffer_map(ut->chunk, ub->buf, ub->pos);
-        ub->buf = NULL;
-        uwsgi_buffer_destroy(ub);
-        return 0;
+	// the vectors will point to the chunk, it is not modified until the end of the request
+	size_t ops_cnt = 0;
+	struct uwsgi_template_op *ops = template_compile(buf, len, &ops_cnt);
+	if (!ops) return -1;
+	int ret = template_render(wsgi_req, ut, ur, ops, ops_cnt);
+	free(ops);
+	return ret;
 }
+
 static int uwsgi_router_template_func(struct wsgi_request *wsgi_req, struct uwsgi_route *route) {
-        uwsgi_add_transformation(wsgi_req, transform_template, route);
+        struct uwsgi_transformation *ut = uwsgi_add_transformation(wsgi_req, transform_template, route);
+        ut->can_iov = 1;
         return UWSGI_ROUTE_NEXT;
 }
 static int uwsgi_router_template(struct uwsgi_route *ur, char *arg) {
@@ -94,20 +94,169 @@ uint64_t proto_base_add_uwsgi_var(struct wsgi_request * wsgi_req, char *key, uin
 }
 
 
-int uwsgi_proto_base_accept(struct wsgi_request *wsgi_req, int fd) {
-
-	wsgi_req->c_len = sizeof(struct sockaddr_un);
+static int uwsgi_proto_base_accept_fd(int fd, struct sockaddr_un *addr, socklen_t *addr_len) {
 #if defined(__linux__) && defined(SOCK_NONBLOCK) && !defined(OBSOLETE_LINUX_KERNEL)
-        return accept4(fd, (struct sockaddr *) &wsgi_req->c_addr, (socklen_t *) & wsgi_req->c_len, SOCK_NONBLOCK);
+        return accept4(fd, (struct sockaddr *) addr, addr_len, SOCK_NONBLOCK);
 #elif defined(__linux__)
-	int client_fd = accept(fd, (struct sockaddr *) &wsgi_req->c_addr, (socklen_t *) & wsgi_req->c_len);
+	int client_fd = accept(fd, (struct sockaddr *) addr, addr_len);
 	if (client_fd >= 0) {
 		uwsgi_socket_nb(client_fd);
 	}
 	return client_fd;
 #else
-	return accept(fd, (struct sockaddr *) &wsgi_req->c_addr, (socklen_t *) & wsgi_req->c_len);
+	return accept(fd, (struct sockaddr *) addr, addr_len);
+#endif
+}
+
+static char uwsgi_reject_response[] = "HTTP/1.0 503 Service Unavailable\r\nContent-Type: text/plain\r\nContent-Length: 0\r\nRetry-After: 1\r\nConnection: close\r\n\r\n";
+
+// only protocols answering with a raw http status line can receive the pre-rendered response
+static int uwsgi_reject_can_respond(struct uwsgi_socket *uwsgi_sock) {
+#ifdef UWSGI_SSL
+	if (uwsgi_sock->ssl_ctx) return 0;
 #endif
+	char *proto = uwsgi_sock->proto_name ? uwsgi_sock->proto_name : uwsgi.protocol;
+	if (!proto) return 1;
+	if (!strcmp(proto, "uwsgi") || !strcmp(proto, "http") || !strcmp(proto, "http11") || !strcmp(proto, "scgi")) return 1;
+	return 0;
+}
+
+// close a connection that will not be served, answering 503 when the protocol allows it
+static void uwsgi_proto_base_reject(struct uwsgi_socket *uwsgi_sock, int fd) {
+	if (uwsgi_reject_can_respond(uwsgi_sock)) {
+		// consume the request (if already there) to avoid the close() generating a RST
+		char buf[4096];
+		while(recv(fd, buf, 4096, MSG_DONTWAIT) == 4096);
+		if (write(fd, uwsgi_reject_response, sizeof(uwsgi_reject_response) - 1) < 0) {
+			// the client is already gone
+		}
+	}
+	close(fd);
+}
+
+// returns the server socket with connections already accepted by the core (or -1)
+int uwsgi_accepted_fd(struct wsgi_request *wsgi_req) {
+	if (!uwsgi.accepted || wsgi_req->async_id < 0 || wsgi_req->async_id >= uwsgi.cores) return -1;
+	struct uwsgi_accepted *ua = &uwsgi.accepted[wsgi_req->async_id];
+	if (ua->pos < ua->count) return ua->server_fd;
+	return -1;
+}
+
+/*
+	drain up to --accept-batch connections from the server socket in one go,
+	the following calls return them without touching the socket
+	(wsgi_req_accept() does not wait for events while they are available)
+*/
+static int uwsgi_proto_base_accept_batch(struct wsgi_request *wsgi_req, int fd) {
+	struct uwsgi_accepted *ua = &uwsgi.accepted[wsgi_req->async_id];
+
+	if (ua->pos >= ua->count) {
+		ua->pos = 0;
+		ua->count = 0;
+		ua->server_fd = fd;
+		ua->socket = wsgi_req->socket;
+		// a worker going away only takes the connection it has been woken up for
+		while(ua->count < uwsgi.accept_batch && (ua->count == 0 || uwsgi.workers[uwsgi.mywid].manage_next_request)) {
+			ua->addrs_len[ua->count] = sizeof(struct sockaddr_un);
+			int client_fd = uwsgi_proto_base_accept_fd(fd, &ua->addrs[ua->count], &ua->addrs_len[ua->count]);
+			if (client_fd < 0) {
+				// the error (generally EAGAIN) is reported only if nothing has been accepted
+				if (ua->count == 0) return -1;
+				break;
+			}
+			ua->fds[ua->count] = client_fd;
+			ua->count++;
+		}
+	}
+
+	memcpy(&wsgi_req->c_addr, &ua->addrs[ua->pos], ua->addrs_len[ua->pos]);
+	wsgi_req->c_len = ua->addrs_len[ua->pos];
+	return ua->fds[ua->pos++];
+}
+
+/*
+	called by a worker exiting without going back to its loop (max-requests, reload...),
+	the connections still waiting in the batches are closed without a RST.
+	The other threads must be already stopped.
+*/
+void uwsgi_accepted_close() {
+	if (!uwsgi.accepted) return;
+	int i;
+	for(i=0;i<uwsgi.cores;i++) {
+		struct uwsgi_accepted *ua = &uwsgi.accepted[i];
+		while(ua->pos < ua->count) {
+			uwsgi_proto_base_reject(ua->socket, ua->fds[ua->pos++]);
+		}
+	}
+}
+
+#if defined(__linux__) && defined(TCP_INFO)
+
+/*
+	CoDel-like load shedding (--listen-shed)
+
+	nothing has been sent on a just accepted tcp connection, so tcpi_last_data_sent
+	is the time it spent in the listen queue since the handshake.
+	The first connection over the target starts the interval, any connection below the target
+	ends it. If the delay stays over the target for a whole --listen-shed-interval the
+	instance is overloaded and every connection waiting more than the target is rejected
+	(the client has likely given up or is going to) without reaching the app.
+
+	The state is shared by the threads of the worker, so it is updated atomically.
+*/
+static int uwsgi_listen_shed(struct wsgi_request *wsgi_req, int fd) {
+	if (wsgi_req->socket->family == AF_UNIX) return 0;
+
+	struct tcp_info ti;
+	socklen_t ti_len = sizeof(struct tcp_info);
+	if (getsockopt(fd, IPPROTO_TCP, TCP_INFO, &ti, &ti_len)) return 0;
+
+	uint64_t delay = ti.tcpi_last_data_sent;
+	if (delay <= (uint64_t) uwsgi.listen_shed) {
+		if (__atomic_load_n(&uwsgi.listen_shed_above, __ATOMIC_RELAXED)) {
+			__atomic_store_n(&uwsgi.listen_shed_above, 0, __ATOMIC_RELAXED);
+		}
+		return 0;
+	}
+
+	uint64_t now = uwsgi_millis();
+	uint64_t above = __atomic_load_n(&uwsgi.listen_shed_above, __ATOMIC_RELAXED);
+	if (!above) {
+		// only the first thread starts the interval
+		__atomic_compare_exchange_n(&uwsgi.listen_shed_above, &above, now, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+		return 0;
+	}
+	if (now - above < (uint64_t) uwsgi.listen_shed_interval) return 0;
+
+	uwsgi_proto_base_reject(wsgi_req->socket, fd);
+	uwsgi.workers[uwsgi.mywid].shed++;
+	return 1;
+}
+#endif
+
+static int uwsgi_proto_base_accept_do(struct wsgi_request *wsgi_req, int fd) {
+
+	if (uwsgi.accepted && wsgi_req->async_id >= 0 && wsgi_req->async_id < uwsgi.cores) {
+		struct uwsgi_accepted *ua = &uwsgi.accepted[wsgi_req->async_id];
+		if (ua->pos >= ua->count || ua->server_fd == fd) {
+			return uwsgi_proto_base_accept_batch(wsgi_req, fd);
+		}
+	}
+
+	wsgi_req->c_len = sizeof(struct sockaddr_un);
+	return uwsgi_proto_base_accept_fd(fd, &wsgi_req->c_addr, (socklen_t *) & wsgi_req->c_len);
+}
+
+int uwsgi_proto_base_accept(struct wsgi_request *wsgi_req, int fd) {
+	int client_fd = uwsgi_proto_base_accept_do(wsgi_req, fd);
+#if defined(__linux__) && defined(TCP_INFO)
+	// a shed connection is reported like a spurious wakeup, the caller will simply wait for the next one
+	if (client_fd >= 0 && uwsgi.listen_shed > 0 && uwsgi_listen_shed(wsgi_req, client_fd)) {
+		errno = EAGAIN;
+		return -1;
+	}
+#endif
+	return client_fd;
 }
 
 void uwsgi_proto_base_close(struct wsgi_request *wsgi_req) {
@@ -315,7 +464,8 @@ int uwsgi_proto_base_sendfile(struct wsgi_request * wsgi_req, int fd, size_t pos
 int uwsgi_proto_ssl_sendfile(struct wsgi_request *wsgi_req, int fd, size_t pos, size_t len) {
 	char buf[32768];
 
-	ssize_t rlen = read(fd, buf, UMIN(len, 32768));
+	// read at the requested position, the file offset could be shared (open cache) or meaningless (ranges)
+	ssize_t rlen = pread(fd, buf, UMIN(len - wsgi_req->write_pos, 32768), pos + wsgi_req->write_pos);
 	if (rlen <= 0) return -1;
 
 	for(;;) {
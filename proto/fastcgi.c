@@ -288,7 +288,7 @@ void uwsgi_proto_fastcgi_close(struct wsgi_request *wsgi_req) {
 			ssize_t rlen = uwsgi_proto_fastcgi_read_body(wsgi_req, buf, 4096);
 			if (rlen < 0) {
 				if (uwsgi_is_again()) {
-					int ret = uwsgi.wait_read_hook(wsgi_req->fd, uwsgi.socket_timeout);
+					int ret = uwsgi_wait_read_ms(wsgi_req->fd, uwsgi.socket_timeout_ms);
 					if (ret <= 0) goto end;
 					continue;
 				}
@@ -579,7 +579,7 @@ clear:
 }
 
 
-struct uwsgi_buffer *uwsgi_to_http(struct wsgi_request *wsgi_req, char *host, uint16_t host_len, char *uri, uint16_t uri_len) {
+static struct uwsgi_buffer *uwsgi_to_http_proto(struct wsgi_request *wsgi_req, char *host, uint16_t host_len, char *uri, uint16_t uri_len, char *proto, size_t proto_len) {
 
         struct uwsgi_buffer *ub = uwsgi_buffer_new(4096);
 
@@ -593,8 +593,9 @@ struct uwsgi_buffer *uwsgi_to_http(struct wsgi_request *wsgi_req, char *host, ui
         	if (uwsgi_buffer_append(ub, wsgi_req->uri, wsgi_req->uri_len)) goto clear;
 	}
 
-	// force HTTP/1.0
-        if (uwsgi_buffer_append(ub, " HTTP/1.0\r\n", 11)) goto clear;
+        if (uwsgi_buffer_append(ub, " ", 1)) goto clear;
+        if (uwsgi_buffer_append(ub, proto, proto_len)) goto clear;
+        if (uwsgi_buffer_append(ub, "\r\n", 2)) goto clear;
 
         int i;
 	char *x_forwarded_for = NULL;
@@ -673,6 +674,16 @@ clear:
         return NULL;
 }
 
+// force HTTP/1.0
+struct uwsgi_buffer *uwsgi_to_http(struct wsgi_request *wsgi_req, char *host, uint16_t host_len, char *uri, uint16_t uri_len) {
+	return uwsgi_to_http_proto(wsgi_req, host, host_len, uri, uri_len, "HTTP/1.0", 8);
+}
+
+// HTTP/1.1 request (still with Connection: close), the response could be chunked
+struct uwsgi_buffer *uwsgi_to_http11(struct wsgi_request *wsgi_req, char *host, uint16_t host_len, char *uri, uint16_t uri_len) {
+	return uwsgi_to_http_proto(wsgi_req, host, host_len, uri, uri_len, "HTTP/1.1", 8);
+}
+
 int uwsgi_is_full_http(struct uwsgi_buffer *ub) {
 	size_t i;
 	int status = 0;
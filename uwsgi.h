@@ -40,7 +40,7 @@ extern "C" {
 
 #define wsgi_req_time ((wsgi_req->end_of_request-wsgi_req->start_of_request)/1000)
 
-#define thunder_lock if (!uwsgi.is_et) {\
+#define thunder_lock if (!uwsgi.is_et && !uwsgi.accept_reuseport) {\
                         if (uwsgi.use_thunder_lock) {\
                                 uwsgi_lock(uwsgi.the_thunder_lock);\
                         }\
@@ -49,7 +49,7 @@ extern "C" {
                         }\
                     }
 
-#define thunder_unlock if (!uwsgi.is_et) {\
+#define thunder_unlock if (!uwsgi.is_et && !uwsgi.accept_reuseport) {\
                         if (uwsgi.use_thunder_lock) {\
                                 uwsgi_unlock(uwsgi.the_thunder_lock);\
                         }\
@@ -433,8 +433,8 @@ struct uwsgi_lock_ops {
 #define uwsgi_wlock(x) uwsgi.lock_ops.wlock(x)
 #define uwsgi_rwunlock(x) uwsgi.lock_ops.rwunlock(x)
 
-#define uwsgi_wait_read_req(x) uwsgi.wait_read_hook(x->fd, uwsgi.socket_timeout) ; x->switches++
-#define uwsgi_wait_write_req(x) uwsgi.wait_write_hook(x->fd, uwsgi.socket_timeout) ; x->switches++
+#define uwsgi_wait_read_req(x) uwsgi_wait_read_ms(x->fd, uwsgi.socket_timeout_ms) ; x->switches++
+#define uwsgi_wait_write_req(x) uwsgi_wait_write_ms(x->fd, uwsgi.socket_timeout_ms) ; x->switches++
 
 #ifdef UWSGI_PCRE
 #include <pcre.h>
@@ -841,6 +841,57 @@ struct uwsgi_cache {
 	int lazy_expire;
 	uint64_t sweep_on_full;
 	int clear_on_full;
+
+	// per-node replicas (numa=1), indexed by node, the first one is the cache itself
+	struct uwsgi_cache **numa_replicas;
+	// set on replicas, they are skipped by name lookups
+	int numa_replica;
+	int numa_node;
+
+	// per-item generation, bumped on every set/update/delete (used by leases)
+	uint64_t *generations;
+};
+
+// a reference to a cache item valid until the item is changed or removed
+struct uwsgi_cache_lease {
+	struct uwsgi_cache *cache;
+	uint64_t index;
+	uint64_t generation;
+	uint64_t valsize;
+	uint64_t expires;
+};
+
+struct uwsgi_numa_node {
+	int id;
+	int cpus_cnt;
+	int *cpus;
+};
+
+// an entry of the static files open cache (--static-open-cache)
+struct uwsgi_static_file {
+	char *key;
+	size_t key_len;
+	char *real_filename;
+	size_t real_filename_len;
+	struct uwsgi_string_list *index;
+	// -1 if the file has to be opened for every request
+	int fd;
+	struct stat st;
+	char *mime_type;
+	size_t mime_type_len;
+	char last_modified[31];
+	int last_modified_len;
+	time_t expires;
+	// requests using the entry, it is freed only when evicted and unused
+	int refs;
+	int evicted;
+};
+
+// a pre-forked worker waiting for a slot (managed by the master)
+struct uwsgi_spare {
+	pid_t pid;
+	// the master side of the socketpair used to hand over the worker id
+	int fd;
 };
 
 struct uwsgi_option {
@@ -973,6 +1024,10 @@ struct uwsgi_socket {
 	// this is a special map for having socket->thread mapping
 	int *fd_threads;
 
+	// per-core listening sockets (--accept-reuseport)
+	int *fd_cores;
+	int fd_cores_cnt;
+
 	// generally used by zeromq handlers
 	char uuid[37];
 	void *pub;
@@ -1000,6 +1055,17 @@ struct uwsgi_socket {
 
 };
 
+// connections accepted in advance by a core (--accept-batch)
+struct uwsgi_accepted {
+	int server_fd;
+	struct uwsgi_socket *socket;
+	int pos;
+	int count;
+	int *fds;
+	struct sockaddr_un *addrs;
+	socklen_t *addrs_len;
+};
+
 struct uwsgi_protocol {
         char *name;
         void (*func)(struct uwsgi_socket *);
@@ -1127,6 +1193,11 @@ struct uwsgi_app {
 	time_t startup_time;
 
 	uint64_t avg_response_time;
+
+	// --request-accounting totals (microseconds and bytes)
+	uint64_t cpu_us;
+	uint64_t sys_us;
+	int64_t alloc;
 };
 
 struct uwsgi_spooler {
@@ -1136,8 +1207,9 @@ struct uwsgi_spooler {
 	uint64_t respawned;
 	uint64_t tasks;
 	struct uwsgi_lock_item *lock;
-	time_t harakiri;
-	time_t user_harakiri;
+	// deadlines in milliseconds
+	uint64_t harakiri;
+	uint64_t user_harakiri;
 
 	int mode;
 
@@ -1321,15 +1393,40 @@ struct uwsgi_transformation {
 	uint8_t can_stream;
 	uint8_t is_final;
 	uint8_t flushed;
+	// the transformation works on the chain vectors instead of the chunk buffer
+	uint8_t can_iov;
 	void *data;
 	uint64_t round;
 	int fd;
 	struct uwsgi_buffer *ub;
 	uint64_t len;
 	uint64_t custom64;
+	// called when the transformations of the request are freed
+	void (*destroy)(struct wsgi_request *, struct uwsgi_transformation *);
 	struct uwsgi_transformation *next;
 };
 
+// streaming compressors (gzip, br, zstd) shared by the compressing transformations
+struct uwsgi_compressor {
+	// the Content-Encoding value
+	char *name;
+	size_t name_len;
+	void *(*create)(void);
+	// prepare an already used state for a new stream
+	int (*reset)(void *);
+	// compress the data appending the output to the buffer, finish the stream when the last arg is set
+	int (*compress)(void *, char *, size_t, struct uwsgi_buffer *, int);
+	void (*destroy)(void *);
+	// idle contexts, one per core (allocated by the workers)
+	struct uwsgi_compressor_ctx **pool;
+};
+
+struct uwsgi_compressor_ctx {
+	struct uwsgi_compressor *compressor;
+	void *state;
+	struct uwsgi_buffer *out;
+};
+
 struct wsgi_request {
 	int fd;
 	struct uwsgi_header *uh;
@@ -1352,6 +1449,14 @@ struct wsgi_request {
 	uint64_t start_of_request_in_sec;
 	uint64_t end_of_request;
 
+	// absolute deadline in epoch milliseconds (from UWSGI_DEADLINE), 0 if none
+	uint64_t deadline;
+
+	// --request-accounting (thread cpu time, system time and heap usage)
+	uint64_t cpu_us;
+	uint64_t sys_us;
+	int64_t alloc;
+
 	char *uri;
 	uint16_t uri_len;
 	char *remote_addr;
@@ -1495,8 +1600,9 @@ struct wsgi_request {
 	// when set, do not send warnings about bad behaviours
 	int post_warning;
 
-	size_t range_from;
-	size_t range_to;
+	// the raw Range header (single and multiple ranges are resolved by the static file server)
+	char *http_range;
+	uint16_t http_range_len;
 
 	// current socket mapped to request
 	struct uwsgi_socket *socket;
@@ -1576,6 +1682,10 @@ struct wsgi_request {
 	struct uwsgi_transformation *transformations;
 	char *transformed_chunk;
 	size_t transformed_chunk_len;
+	// the body flowing in the transformations chain (slot 0 is reserved for headers)
+	struct iovec *transformed_iov;
+	size_t transformed_iov_cnt;
+	size_t transformed_iov_size;
 
 	int is_raw;
 
@@ -1680,6 +1790,7 @@ struct uwsgi_metric;
 struct uwsgi_logging_options {
 	int enabled;
 	int memory_report;
+	int request_accounting;
 	int zero;
 	int _4xx;
 	int _5xx;
@@ -1690,6 +1801,7 @@ struct uwsgi_logging_options {
 	int log_x_forwarded_for;
 };
 
+// all of the values are in milliseconds
 struct uwsgi_harakiri_options {
 	int workers;
 	int spoolers;
@@ -1733,6 +1845,8 @@ struct uwsgi_server {
 	struct uwsgi_logging_options logging_options;
 	struct uwsgi_harakiri_options harakiri_options;
 	int socket_timeout;
+	// the --socket-timeout value in milliseconds (socket_timeout is rounded up to seconds)
+	int socket_timeout_ms;
 	int reaper;
 	int cgi_mode;
 	uint64_t max_requests;
@@ -1809,6 +1923,26 @@ struct uwsgi_server {
 	uint64_t master_cycles;
 
 	int reuse_port;
+	int accept_reuseport;
+	int accept_reuseport_cbpf;
+	int accept_batch;
+	struct uwsgi_accepted *accepted;
+	// milliseconds
+	int listen_shed;
+	int listen_shed_interval;
+	// when the listen queue delay went over the target (0 if it is below)
+	uint64_t listen_shed_above;
+	// work-stealing scheduler for multithreaded workers
+	int thread_sched;
+	int thread_sched_queue;
+#ifdef UWSGI_PCRE
+	struct uwsgi_regexp_list *thread_sched_priority;
+#endif
+	// pre-forked workers with apps already loaded
+	int spare_workers;
+	struct uwsgi_spare *spares;
+	int i_am_a_spare;
+	int spare_fd;
 	int tcp_fast_open;
 	int tcp_fast_open_client;
 
@@ -1913,6 +2047,13 @@ struct uwsgi_server {
 	// set cpu affinity
 	int cpu_affinity;
 
+	// NUMA placement
+	int numa;
+	struct uwsgi_numa_node *numa_nodes;
+	int numa_nodes_cnt;
+	// node index of the current process (-1 if not bound)
+	int numa_node;
+
 	int reload_mercy;
 	int worker_reload_mercy;
 	// map reloads to death
@@ -2242,6 +2383,10 @@ struct uwsgi_server {
 	int use_static_cache_paths;
 	char *static_cache_paths_name;
 	struct uwsgi_cache *static_cache_paths;
+	// per-worker open files cache
+	int static_open_cache;
+	int static_open_cache_ttl;
+	struct uwsgi_static_file **static_open_cache_table;
 	int cache_expire_freq;
 	int cache_report_freed_items;
 	int cache_no_expire;
@@ -2273,11 +2418,20 @@ struct uwsgi_server {
 	struct uwsgi_regexp_list *static_gzip;
 #endif
 
+	// on-the-fly compressed static variants
+	char *static_compress_store;
+	uint64_t static_compress_store_limit;
+	uint64_t static_compress_max_size;
+	uint64_t static_compress_inline_max_size;
+	uint64_t *static_compress_store_used;
+
 	struct uwsgi_offload_engine *offload_engines;
 	struct uwsgi_offload_engine *offload_engine_sendfile;
 	struct uwsgi_offload_engine *offload_engine_transfer;
 	struct uwsgi_offload_engine *offload_engine_memory;
 	struct uwsgi_offload_engine *offload_engine_pipe;
+	struct uwsgi_offload_engine *offload_engine_cache;
+	struct uwsgi_offload_engine *offload_engine_http;
 	int offload_threads;
 	int offload_threads_events;
 	struct uwsgi_thread **offload_thread;
@@ -2665,9 +2819,13 @@ struct uwsgi_server {
 #ifdef UWSGI_SSL
 	int ssl_initialized;
 	int ssl_verbose;
+	int ssl_ktls;
 	char *ssl_sessions_use_cache;
 	int ssl_sessions_timeout;
 	struct uwsgi_cache *ssl_sessions_cache;
+	int ssl_tickets_rotate;
+	char *ssl_tickets_secret;
+	struct uwsgi_ssl_sessions *ssl_sessions;
 	char *ssl_tmp_dir;
 #ifdef UWSGI_PCRE
 	struct uwsgi_regexp_list *sni_regexp;
@@ -2767,6 +2925,7 @@ struct uwsgi_server {
 	int new_argc;
 	char **new_argv;
 	char *emperor_use_fork_server;
+	struct uwsgi_string_list *emperor_zygotes;
 	struct uwsgi_string_list *vassal_fork_base;
 	struct uwsgi_string_list *emperor_collect_attributes;
 	char *emperor_fork_server_attr;
@@ -2901,7 +3060,8 @@ struct uwsgi_shared {
 	// gateways
 	struct uwsgi_gateway gateways[MAX_GATEWAYS];
 	int gateways_cnt;
-	time_t gateways_harakiri[MAX_GATEWAYS];
+	// deadlines in milliseconds
+	uint64_t gateways_harakiri[MAX_GATEWAYS];
 
 	uint64_t routed_signals;
 	uint64_t unrouted_signals;
@@ -2941,9 +3101,9 @@ struct uwsgi_core {
 
 	struct wsgi_request req;
 
-	// uWSGI 2.1
-	time_t harakiri;
-	time_t user_harakiri;
+	// uWSGI 2.1 (deadlines in milliseconds)
+	uint64_t harakiri;
+	uint64_t user_harakiri;
 };
 
 struct uwsgi_worker {
@@ -2966,6 +3126,18 @@ struct uwsgi_worker {
 	uint64_t harakiri_count;
 	int pending_harakiri;
 
+	// connections rejected by --listen-shed
+	uint64_t shed;
+	// requests dropped as their deadline expired while queued
+	uint64_t expired;
+	// --thread-scheduler counters
+	uint64_t sched_stolen;
+	uint64_t sched_prioritized;
+	// the spare slot is ready to be handed over
+	int parked;
+	// respawns served by a --spare-workers process
+	uint64_t spare_respawns;
+
 	uint64_t vsz_size;
 	uint64_t rss_size;
 
@@ -3022,8 +3194,9 @@ struct uwsgi_mule {
 	int sig;
 	uint8_t signum;
 
-	time_t harakiri;
-	time_t user_harakiri;
+	// deadlines in milliseconds
+	uint64_t harakiri;
+	uint64_t user_harakiri;
 
 	char name[0xff];
 
@@ -3082,6 +3255,7 @@ void uwsgi_xml_config(char *, struct wsgi_request *, char *[]);
 #endif
 
 void uwsgi_500(struct wsgi_request *);
+void uwsgi_503(struct wsgi_request *);
 void uwsgi_403(struct wsgi_request *);
 void uwsgi_404(struct wsgi_request *);
 void uwsgi_405(struct wsgi_request *);
@@ -3120,6 +3294,7 @@ uint64_t uwsgi_swap64(uint64_t);
 
 int uwsgi_parse_request(int, struct wsgi_request *, int);
 int uwsgi_parse_vars(struct wsgi_request *);
+int64_t uwsgi_request_deadline_left(struct wsgi_request *);
 
 int uwsgi_enqueue_message(char *, int, uint8_t, uint8_t, char *, int, int);
 
@@ -3153,6 +3328,7 @@ void wsgi_req_setup(struct wsgi_request *, int, struct uwsgi_socket *);
 int wsgi_req_recv(int, struct wsgi_request *);
 int wsgi_req_async_recv(struct wsgi_request *);
 int wsgi_req_accept(int, struct wsgi_request *);
+void uwsgi_heartbeat(void);
 int wsgi_req_simple_accept(struct wsgi_request *, int);
 
 #define current_wsgi_req() (*uwsgi.current_wsgi_req)()
@@ -3227,6 +3403,9 @@ void add_exported_option_do(char *, char *, int, int);
 ssize_t uwsgi_send_empty_pkt(int, char *, uint8_t, uint8_t);
 
 int uwsgi_waitfd_event(int, int, int);
+int uwsgi_waitfd_event_ms(int, int, int);
+int uwsgi_wait_read_ms(int, int);
+int uwsgi_wait_write_ms(int, int);
 #define uwsgi_waitfd(a, b) uwsgi_waitfd_event(a, b, POLLIN)
 #define uwsgi_waitfd_write(a, b) uwsgi_waitfd_event(a, b, POLLOUT)
 
@@ -3277,6 +3456,8 @@ int event_queue_add_fd_write(int, int);
 int event_queue_del_fd(int, int, int);
 int event_queue_wait(int, int, int *);
 int event_queue_wait_multi(int, int, void *, int);
+int event_queue_wait_ms(int, int, int *);
+int event_queue_wait_multi_ms(int, int, void *, int);
 int event_queue_interesting_fd(void *, int);
 int event_queue_interesting_fd_has_error(void *, int);
 int event_queue_fd_write_to_read(int, int);
@@ -3308,6 +3489,9 @@ int uwsgi_start(void *);
 int uwsgi_register_rpc(char *, struct uwsgi_plugin *, uint8_t, void *);
 uint64_t uwsgi_rpc(char *, uint8_t, char **, uint16_t *, char **);
 char *uwsgi_do_rpc(char *, char *, uint8_t, char **, uint16_t *, uint64_t *);
+int uwsgi_rpc_remote_start(char *, char *, uint8_t, char **, uint16_t *);
+int uwsgi_rpc_remote_send(int, char *, uint8_t, char **, uint16_t *);
+char *uwsgi_rpc_remote_finish(int, uint64_t *);
 void uwsgi_rpc_init(void);
 
 char *uwsgi_cheap_string(char *, int);
@@ -3448,7 +3632,8 @@ char *uwsgi_amqp_consume(int, uint64_t *, char **);
 
 int uwsgi_file_serve(struct wsgi_request *, char *, uint16_t, char *, uint16_t, int);
 int uwsgi_starts_with(char *, int, char *, int);
-int uwsgi_static_want_gzip(struct wsgi_request *, char *, size_t *, struct stat *);
+char *uwsgi_static_want_encoding(struct wsgi_request *, char *, size_t *, struct stat *, int *);
+void uwsgi_static_compress_store_scan(uint64_t, int);
 
 #ifdef __sun__
 time_t timegm(struct tm *);
@@ -3471,6 +3656,15 @@ ssize_t uwsgi_proto_ssl_read_body(struct wsgi_request *, char *, size_t);
 
 
 int uwsgi_proto_base_accept(struct wsgi_request *, int);
+int uwsgi_accepted_fd(struct wsgi_request *);
+void uwsgi_accepted_close(void);
+
+void uwsgi_sched_init(void);
+void uwsgi_sched_add_to_queue(int, int);
+int uwsgi_sched_accept(int, struct wsgi_request *);
+void uwsgi_sched_wakeup(void);
+int uwsgi_sched_drain(struct wsgi_request *);
+void uwsgi_sched_join(void);
 void uwsgi_proto_base_close(struct wsgi_request *);
 #ifdef UWSGI_SSL
 int uwsgi_proto_ssl_accept(struct wsgi_request *, int);
@@ -3566,7 +3760,11 @@ long uwsgi_num_from_file(char *, int);
 #endif
 
 void uwsgi_add_sockets_to_queue(int, int);
-void uwsgi_del_sockets_from_queue(int);
+int uwsgi_socket_core_fd(struct uwsgi_socket *, int);
+int uwsgi_socket_has_core_fd(struct uwsgi_socket *, int);
+int uwsgi_reuseport_adopt(int);
+void uwsgi_setup_reuseport_sockets(void);
+void uwsgi_del_sockets_from_queue(int, int);
 
 int uwsgi_run_command_and_wait(char *, char *);
 int uwsgi_run_command_putenv_and_wait(char *, char *, char **, unsigned int);
@@ -3676,6 +3874,20 @@ struct uwsgi_subscribe_node {
 	char proto;
 };
 
+#ifdef UWSGI_SSL
+// session resumption state, shared by all of the processes
+struct uwsgi_ssl_sessions {
+	// ticket keys are derived from this secret for each rotation period
+	char secret[32];
+	uint64_t tickets_issued;
+	uint64_t tickets_resumed;
+	uint64_t tickets_renewed;
+	uint64_t tickets_unknown;
+	uint64_t cache_hits;
+	uint64_t cache_misses;
+};
+#endif
+
 struct uwsgi_subscribe_slot {
 
 	char key[0xff];
@@ -3792,6 +4004,7 @@ void uwsgi_opt_add_regexp_list(char *, char *, void *);
 void uwsgi_opt_add_regexp_custom_list(char *, char *, void *);
 #endif
 void uwsgi_opt_set_int(char *, char *, void *);
+void uwsgi_opt_set_msecs(char *, char *, void *);
 void uwsgi_opt_uid(char *, char *, void *);
 void uwsgi_opt_gid(char *, char *, void *);
 void uwsgi_opt_set_rawint(char *, char *, void *);
@@ -3972,6 +4185,7 @@ char *uwsgi_expand_path(char *, int, char *);
 int uwsgi_try_autoload(char *);
 
 uint64_t uwsgi_micros(void);
+uint64_t uwsgi_millis(void);
 int uwsgi_is_file(char *);
 int uwsgi_is_file2(char *, struct stat *);
 int uwsgi_is_dir(char *);
@@ -4080,6 +4294,8 @@ int uwsgi_subscription_sign_check(struct uwsgi_subscribe_slot *, struct uwsgi_su
 char *uwsgi_sha1(char *, size_t, char *);
 char *uwsgi_sha1_2n(char *, size_t, char *, size_t, char *);
 char *uwsgi_md5(char *, size_t, char *);
+int uwsgi_ssl_ktls_send(SSL *);
+int uwsgi_ssl_stats(struct uwsgi_stats *);
 #endif
 
 void uwsgi_opt_ssa(char *, char *, void *);
@@ -4215,6 +4431,22 @@ void uwsgi_map_sockets(void);
 
 void uwsgi_set_cpu_affinity(void);
 
+void uwsgi_numa_setup(void);
+void uwsgi_numa_worker(void);
+void uwsgi_numa_migrate(void);
+int uwsgi_numa_worker_node(int);
+void uwsgi_numa_bind(void *, size_t, int);
+void uwsgi_numa_interleave(void *, size_t);
+int uwsgi_numa_stats(struct uwsgi_stats *);
+
+int uwsgi_spare_slots(void);
+int uwsgi_spares_check(void);
+int uwsgi_spare_adopt(int);
+void uwsgi_spare_park(void);
+void uwsgi_spares_recycle(void);
+void uwsgi_spares_destroy(void);
+int uwsgi_master_check_spares_death(int);
+
 void uwsgi_emperor_start(void);
 
 void uwsgi_bind_sockets(void);
@@ -4256,6 +4488,7 @@ struct uwsgi_buffer *uwsgi_buffer_from_file(char *);
 ssize_t uwsgi_buffer_write_simple(struct wsgi_request *, struct uwsgi_buffer *);
 
 struct uwsgi_buffer *uwsgi_to_http(struct wsgi_request *, char *, uint16_t, char *, uint16_t);
+struct uwsgi_buffer *uwsgi_to_http11(struct wsgi_request *, char *, uint16_t, char *, uint16_t);
 struct uwsgi_buffer *uwsgi_to_http_dumb(struct wsgi_request *, char *, uint16_t, char *, uint16_t);
 
 ssize_t uwsgi_pipe(int, int, int);
@@ -4298,11 +4531,24 @@ struct uwsgi_thread {
 	// linked list for offloaded requests
 	struct uwsgi_offload_request *offload_requests_head;
 	struct uwsgi_offload_request *offload_requests_tail;
+	// fd -> offloaded request index and recycled requests
+	struct uwsgi_offload_request **offload_fds;
+	int offload_fds_size;
+	struct uwsgi_offload_request *offload_requests_free;
+	int offload_requests_free_cnt;
 	void (*func) (struct uwsgi_thread *);
 };
 struct uwsgi_thread *uwsgi_thread_new(void (*)(struct uwsgi_thread *));
 struct uwsgi_thread *uwsgi_thread_new_with_data(void (*)(struct uwsgi_thread *), void *data);
 
+// a memory part (from the task ubuf) followed by a file range
+struct uwsgi_sendfile_segment {
+	size_t header_pos;
+	size_t header_len;
+	off_t pos;
+	size_t len;
+};
+
 struct uwsgi_offload_request {
 	// the request socket
 	int s;
@@ -4360,6 +4606,14 @@ struct uwsgi_offload_request {
 
 	void *data;
 	void (*free)(struct uwsgi_offload_request *);
+
+	// cache engine
+	struct uwsgi_cache_lease lease;
+
+	// http engine, response headers edits (custom is the length of the header name)
+	struct uwsgi_string_list *http_add;
+	struct uwsgi_string_list *http_remove;
+	struct uwsgi_string_list *http_replace;
 };
 
 struct uwsgi_offload_engine {
@@ -4378,8 +4632,12 @@ void uwsgi_offload_engines_register_all(void);
 
 struct uwsgi_thread *uwsgi_offload_thread_start(void);
 int uwsgi_offload_request_sendfile_do(struct wsgi_request *, int, size_t);
+int uwsgi_offload_request_sendfile_range_do(struct wsgi_request *, int, size_t, size_t);
+int uwsgi_offload_request_sendfile_segments_do(struct wsgi_request *, int, struct uwsgi_buffer *, struct uwsgi_buffer *);
 int uwsgi_offload_request_net_do(struct wsgi_request *, char *, struct uwsgi_buffer *);
 int uwsgi_offload_request_memory_do(struct wsgi_request *, char *, size_t);
+int uwsgi_offload_request_cache_do(struct wsgi_request *, struct uwsgi_cache_lease *);
+int uwsgi_offload_request_http_do(struct wsgi_request *, char *, struct uwsgi_buffer *, struct uwsgi_string_list *, struct uwsgi_string_list *, struct uwsgi_string_list *);
 int uwsgi_offload_request_pipe_do(struct wsgi_request *, int, size_t);
 
 int uwsgi_simple_sendfile(struct wsgi_request *, int, size_t, size_t);
@@ -4529,6 +4787,7 @@ int uwsgi_master_check_workers_deadline(void);
 int uwsgi_master_check_gateways_deadline(void);
 int uwsgi_master_check_mules_deadline(void);
 int uwsgi_master_check_spoolers_deadline(void);
+int uwsgi_master_harakiri_wait(void);
 int uwsgi_master_check_crons_deadline(void);
 int uwsgi_master_check_spoolers_death(int);
 int uwsgi_master_check_emperor_death(int);
@@ -4605,6 +4864,9 @@ struct uwsgi_cache_magic_context {
 };
 
 char *uwsgi_cache_magic_get(char *, uint16_t, uint64_t *, uint64_t *, char *);
+int uwsgi_cache_lease(char *, uint16_t, char *, struct uwsgi_cache_lease *);
+char *uwsgi_cache_lease_value(struct uwsgi_cache_lease *);
+char *uwsgi_cache_lease_get(struct uwsgi_cache_lease *);
 int uwsgi_cache_magic_set(char *, uint16_t, char *, uint64_t, uint64_t, uint64_t, char *);
 int uwsgi_cache_magic_del(char *, uint16_t, char *);
 int uwsgi_cache_magic_exists(char *, uint16_t, char *);
@@ -4625,6 +4887,17 @@ struct uwsgi_buffer *uwsgi_zlib_decompress(char *, size_t);
 int uwsgi_gzip_fix(z_stream *, uint32_t, struct uwsgi_buffer *, size_t);
 char *uwsgi_gzip_chunk(z_stream *, uint32_t *, char *, size_t, size_t *);
 int uwsgi_gzip_prepare(z_stream *, char *, size_t, uint32_t *);
+extern struct uwsgi_compressor uwsgi_compressor_gzip;
+#endif
+
+#ifdef UWSGI_BROTLI
+struct uwsgi_buffer *uwsgi_brotli(char *, size_t);
+extern struct uwsgi_compressor uwsgi_compressor_brotli;
+#endif
+
+#ifdef UWSGI_ZSTD
+struct uwsgi_buffer *uwsgi_zstd(char *, size_t);
+extern struct uwsgi_compressor uwsgi_compressor_zstd;
 #endif
 
 char *uwsgi_get_cookie(struct wsgi_request *, char *, uint16_t, uint16_t *);
@@ -4647,6 +4920,14 @@ int uwsgi_apply_transformations(struct wsgi_request *wsgi_req, char *, size_t);
 int uwsgi_apply_final_transformations(struct wsgi_request *);
 void uwsgi_free_transformations(struct wsgi_request *);
 struct uwsgi_transformation *uwsgi_add_transformation(struct wsgi_request *wsgi_req, int (*func)(struct wsgi_request *, struct uwsgi_transformation *), void *);
+void uwsgi_transformation_iov_reset(struct wsgi_request *);
+int uwsgi_transformation_iov_append(struct wsgi_request *, char *, size_t);
+int uwsgi_transformation_iov_prepend(struct wsgi_request *, char *, size_t);
+struct iovec *uwsgi_transformation_iov(struct wsgi_request *, size_t *);
+size_t uwsgi_transformation_iov_len(struct wsgi_request *);
+int uwsgi_response_writev_transformed_do(struct wsgi_request *);
+struct uwsgi_compressor_ctx *uwsgi_compressor_get(struct wsgi_request *, struct uwsgi_compressor *);
+void uwsgi_compressor_put(struct wsgi_request *, struct uwsgi_compressor_ctx *);
 
 void uwsgi_file_write_do(struct uwsgi_string_list *);
 
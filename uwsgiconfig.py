@@ -82,6 +82,8 @@ report = {
     'debug': False,
     'plugin_dir': False,
     'zlib': False,
+    'brotli': False,
+    'zstd': False,
 }
 
 verbose_build = False
@@ -572,7 +574,7 @@ class uConf(object):
             'core/setup_utils', 'core/clock', 'core/init', 'core/buffer', 'core/reader', 'core/writer', 'core/alarm', 'core/cron', 'core/hooks',
             'core/plugins', 'core/lock', 'core/cache', 'core/daemons', 'core/errors', 'core/hash', 'core/master_events', 'core/chunked',
             'core/queue', 'core/event', 'core/signal', 'core/strings', 'core/progress', 'core/timebomb', 'core/ini', 'core/fsmon', 'core/mount',
-            'core/metrics', 'core/plugins_builder', 'core/sharedarea', 'core/fork_server', 'core/webdav', 'core/zeus',
+            'core/metrics', 'core/plugins_builder', 'core/sharedarea', 'core/numa', 'core/sched', 'core/spare', 'core/fork_server', 'core/webdav', 'core/zeus',
             'core/rpc', 'core/gateway', 'core/loop', 'core/cookie', 'core/querystring', 'core/rb_timers', 'core/transformations', 'core/uwsgi']
         # add protocols
         self.gcc_list.append('proto/base')
@@ -756,6 +758,18 @@ class uConf(object):
             self.gcc_list.append('core/zlib')
             report['zlib'] = True
 
+        if self.has_include('brotli/encode.h'):
+            self.cflags.append('-DUWSGI_BROTLI')
+            self.libs.append('-lbrotlienc')
+            self.gcc_list.append('core/brotli')
+            report['brotli'] = True
+
+        if self.has_include('zstd.h'):
+            self.cflags.append('-DUWSGI_ZSTD')
+            self.libs.append('-lzstd')
+            self.gcc_list.append('core/zstd')
+            report['zstd'] = True
+
         if uwsgi_os == 'OpenBSD':
             try:
                 obsd_major = int(uwsgi_os_k.split('.')[0])